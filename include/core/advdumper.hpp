@@ -2,6 +2,8 @@
 #define _advdumper__hpp__included__
 
 #include <string>
+#include <map>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <iostream>
@@ -253,6 +255,14 @@ public:
  * Call all notifiers (on_sample).
  */
 	void on_sample(short l, short r);
+/**
+ * Call all notifiers (on_samples).
+ *
+ * Parameter samples: The samples, interleaved if stereo.
+ * Parameter count: Number of samples (per channel).
+ * Parameter stereo: If true, samples are stereo, otherwise mono.
+ */
+	void on_samples(const int16_t* samples, size_t count, bool stereo);
 /**
  * Call all notifiers (on_rate_change)
  *
@@ -298,11 +308,64 @@ public:
 	template<bool X> bool render_video_hud(struct framebuffer::fb<X>& target, struct framebuffer::raw& source,
 		uint32_t hscl, uint32_t vscl, uint32_t lgap, uint32_t tgap, uint32_t rgap, uint32_t bgap,
 		std::function<void()> fn);
+/**
+ * Render Lua HUD on video, sharing the result between dumpers.
+ *
+ * Each distinct combination of pixel format, scale factors and gaps is rendered (and Lua HUD run) only once per
+ * frame. Must be called from on_frame().
+ *
+ * Parameter source: The source screen to read.
+ * Parameter hscl: The horizontal scale factor.
+ * Parameter vscl: The vertical scale factor.
+ * Parameter lgap: Left gap.
+ * Parameter tgap: Top gap.
+ * Parameter rgap: Right gap
+ * Parameter bgap: Bottom gap.
+ * Returns: The rendered frame, or NULL if frame should not be dumped. The frame must not be modified, and stays
+ *	valid as long as it is referenced.
+ */
+	template<bool X> std::shared_ptr<const framebuffer::fb<X>> render_video_hud_shared(
+		struct framebuffer::raw& source, uint32_t hscl, uint32_t vscl, uint32_t lgap, uint32_t tgap,
+		uint32_t rgap, uint32_t bgap);
 /**
  * Calculate number of sound samples to drop due to dropped frame.
  */
 	uint64_t killed_audio_length(uint32_t fps_n, uint32_t fps_d, double& fraction);
 private:
+	struct hud_key
+	{
+		bool hires;
+		uint32_t hscl, vscl, lgap, tgap, rgap, bgap;
+		bool operator<(const hud_key& k) const
+		{
+			if(hires != k.hires) return hires < k.hires;
+			if(hscl != k.hscl) return hscl < k.hscl;
+			if(vscl != k.vscl) return vscl < k.vscl;
+			if(lgap != k.lgap) return lgap < k.lgap;
+			if(tgap != k.tgap) return tgap < k.tgap;
+			if(rgap != k.rgap) return rgap < k.rgap;
+			return bgap < k.bgap;
+		}
+	};
+	struct hud_entry
+	{
+		hud_entry() : frame(0), killed(false) {}
+		uint64_t frame;
+		bool killed;
+		//Current frame and spare buffer, for dumpers holding the previous frame.
+		std::shared_ptr<framebuffer::fb<false>> fb32[2];
+		std::shared_ptr<framebuffer::fb<true>> fb64[2];
+	};
+	static std::shared_ptr<framebuffer::fb<false>>& hud_buffer(hud_entry& e, framebuffer::fb<false>* dummy,
+		unsigned i)
+	{
+		return e.fb32[i];
+	}
+	static std::shared_ptr<framebuffer::fb<true>>& hud_buffer(hud_entry& e, framebuffer::fb<true>* dummy,
+		unsigned i)
+	{
+		return e.fb64[i];
+	}
 	void statuschange();
 	friend class dumper_base;
 	std::map<dumper_factory_base*, dumper_base*> dumpers;
@@ -314,6 +377,8 @@ private:
 	std::ostream* output;
 	threads::rlock lock;
 	lua_state& lua2;
+	uint64_t frame_seq;
+	std::map<hud_key, hud_entry> hud_cache;
 };
 
 class dumper_base
@@ -328,8 +393,18 @@ public:
 	virtual void on_frame(struct framebuffer::raw& _frame, uint32_t fps_n, uint32_t fps_d) = 0;
 /**
  * New sample available.
+ *
+ * The default implementation calls on_samples().
+ */
+	virtual void on_sample(short l, short r);
+/**
+ * New block of samples available.
+ *
+ * Parameter samples: The samples, interleaved if stereo.
+ * Parameter count: Number of samples (per channel).
+ * Parameter stereo: If true, samples are stereo, otherwise mono.
  */
-	virtual void on_sample(short l, short r) = 0;
+	virtual void on_samples(const int16_t* samples, size_t count, bool stereo) = 0;
 /**
  * Sample rate is changing.
  */
@@ -367,6 +442,21 @@ public:
 			samples_killed += mdumper->killed_audio_length(fps_n, fps_d, akillfrac);
 		return r;
 	}
+/**
+ * Render Lua HUD on video, sharing the result with other dumpers. samples_killed is incremented if needed.
+ *
+ * Parameters are as in the other render_video_hud(), and return value is as in
+ * master_dumper::render_video_hud_shared().
+ */
+	template<bool X> std::shared_ptr<const framebuffer::fb<X>> render_video_hud_shared(
+		struct framebuffer::raw& source, uint32_t fps_n, uint32_t fps_d, uint32_t hscl, uint32_t vscl,
+		uint32_t lgap, uint32_t tgap, uint32_t rgap, uint32_t bgap)
+	{
+		auto r = mdumper->render_video_hud_shared<X>(source, hscl, vscl, lgap, tgap, rgap, bgap);
+		if(!r)
+			samples_killed += mdumper->killed_audio_length(fps_n, fps_d, akillfrac);
+		return r;
+	}
 private:
 	friend class master_dumper;
 	uint64_t samples_killed;
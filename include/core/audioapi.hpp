@@ -1,8 +1,10 @@
 #ifndef _audioapi__hpp__included__
 #define _audioapi__hpp__included__
 
+#include "library/spscring.hpp"
 #include "library/threads.hpp"
 
+#include <atomic>
 #include <map>
 #include <cstdint>
 #include <cstdlib>
@@ -13,32 +15,19 @@ class audioapi_instance
 {
 public:
 /**
- * Audio API music buffer.
+ * Audio buffer statistics.
  */
-	struct buffer
+	struct stats
 	{
-/**
- * The samples.
- *
- * Note: May be NULL if no samples are available..
- */
-		int16_t* samples;
-/**
- * Playback pointer in samples structure.
- */
-		size_t pointer;
-/**
- * Total number of samples in this buffer.
- */
-		size_t total;
-/**
- * True if buffer is stereo, false if mono.
- */
-		bool stereo;
-/**
- * The rate in samples per second the buffer is supposed to be played at.
- */
-		double rate;
+		uint64_t music_underruns;	//Number of times music buffer ran empty.
+		uint64_t music_silence;		//Number of samples of silence played due to empty music buffer.
+		uint64_t music_dropped;		//Number of music samples dropped due to buffer being too full.
+		uint64_t voice_underruns;	//Number of voice samples played as silence.
+		uint64_t voicer_dropped;	//Number of recorded voice samples dropped.
+		size_t music_fill;		//Number of music samples currently buffered.
+		size_t music_target;		//Target number of music samples buffered.
+		double music_rate;		//Music input rate.
+		double music_adjust;		//Current music resampling adjustment (0 is none).
 	};
 
 /**
@@ -194,15 +183,6 @@ public:
  * Parameter stereo: If true, return stereo buffer, else mono.
  */
 	void get_mixed(int16_t* samples, size_t count, bool stereo);
-/**
- * Get music channel buffer to play.
- *
- * Parameter played: Number of samples to ACK as played.
- * Returns: Buffer to play.
- *
- * Note: This should only be called from the sound driver.
- */
-	struct buffer get_music(size_t played);
 /**
  * Get voice channel buffer to play.
  *
@@ -232,6 +212,14 @@ public:
  * Note: Setting rate to 0 enables dummy callbacks.
  */
 	void voice_rate(unsigned rate_r, unsigned rate_p);
+/**
+ * Get buffer statistics.
+ */
+	stats get_stats();
+/**
+ * Reset buffer statistics counters.
+ */
+	void reset_stats();
 /**
  * Suppress all future VU updates.
  */
@@ -250,24 +238,26 @@ private:
 	};
 	dummy_cb_proc dummyproc;
 	threads::thread* dummythread;
-	//3 music buffers is not enough due to huge blocksizes used by SDL.
-	const static unsigned MUSIC_BUFFERS = 8;
+	double music_ratio(size_t request);
 	const static unsigned voicep_bufsize = 65536;
 	const static unsigned voicer_bufsize = 65536;
-	const static unsigned music_bufsize = 8192;
-	float voicep_buffer[voicep_bufsize];
-	float voicer_buffer[voicer_bufsize];
-	int16_t music_buffer[MUSIC_BUFFERS * music_bufsize];
-	volatile bool music_stereo[MUSIC_BUFFERS];
-	volatile double music_rate[MUSIC_BUFFERS];
-	volatile size_t music_size[MUSIC_BUFFERS];
-	unsigned music_ptr;
-	unsigned last_complete_music_seen;
-	volatile unsigned last_complete_music;
-	volatile unsigned voicep_get;
-	volatile unsigned voicep_put;
-	volatile unsigned voicer_get;
-	volatile unsigned voicer_put;
+	const static unsigned music_bufsize = 65536;	//In values, the buffer is always stereo.
+	//Music and voice playback go from emulator to driver, voice recording the other way around.
+	spsc_ring<float> voicep_ring;
+	spsc_ring<float> voicer_ring;
+	spsc_ring<int16_t> music_ring;
+	volatile double music_rate;		//Rate of last submitted music block.
+	volatile size_t music_block;		//Size of last submitted music block in samples.
+	double music_fill_avg;			//Smoothed fill level, driver side.
+	volatile size_t music_target;
+	volatile double music_adjust;
+	std::atomic<uint64_t> music_underruns;
+	std::atomic<uint64_t> music_silence;
+	std::atomic<uint64_t> music_dropped;
+	std::atomic<uint64_t> voice_underruns;
+	std::atomic<uint64_t> voicer_dropped;
+	bool music_running;
+	std::atomic<bool> music_suppressed;	//Emulator is not sending music (turbo seek).
 	volatile unsigned voice_rate_play;
 	volatile unsigned orig_voice_rate_play;
 	volatile unsigned voice_rate_rec;
@@ -278,7 +268,6 @@ private:
 	volatile float _voicep_volume;
 	volatile float _voicer_volume;
 	resampler music_resampler;
-	bool last_adjust;	//Adjusting consequtively is too hard.
 	static bool vu_disabled;
 };
 
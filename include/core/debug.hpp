@@ -4,8 +4,10 @@
 #include <functional>
 #include <fstream>
 #include <cstdint>
+#include "library/binarytrace.hpp"
 #include "library/command.hpp"
 #include "library/dispatch.hpp"
+#include "library/hooktable.hpp"
 
 class emulator_dispatch;
 class loaded_rom;
@@ -28,6 +30,7 @@ public:
 		DEBUG_EXEC,
 		DEBUG_TRACE,
 		DEBUG_FRAME,
+		DEBUG_TRACE_RAW,
 	};
 /**
  * Parameters for read/write/execute event.
@@ -46,6 +49,14 @@ public:
 		const char* decoded_insn;	//Decoded instruction
 		bool true_insn;			//True instruction flag.
 	};
+/**
+ * Parameters for raw trace event.
+ */
+	struct params_trace_raw
+	{
+		uint64_t cpu;				//CPU number.
+		const binarytrace::insn* insn;		//The instruction.
+	};
 /**
  * Parameters for frame event.
  */
@@ -63,6 +74,7 @@ public:
 		union {
 			params_rwx rwx;		//READ/WRITE/EXECUTE
 			params_trace trace;	//TRACE.
+			params_trace_raw trace_raw;	//TRACE_RAW.
 			params_frame frame;	//FRAME.
 		};
 	};
@@ -112,6 +124,10 @@ public:
  * Fire a trace callback.
  */
 	void do_callback_trace(uint64_t cpu, const char* str, bool true_insn = true);
+/**
+ * Fire a raw trace callback.
+ */
+	void do_callback_trace_raw(uint64_t cpu, const binarytrace::insn& insn);
 /**
  * Fire a frame callback.
  */
@@ -130,8 +146,14 @@ public:
 	void setxmask(uint64_t mask);
 /**
  * Set tracelog file.
+ *
+ * Parameter cpu: The processor to trace.
+ * Parameter filename: The file to trace to, or "" to stop tracing.
+ * Parameter binary: If true, write compact binary trace (see binarytrace::writer) instead of text.
+ * Parameter compression: Compression for binary trace ("" for none).
  */
-	void tracelog(uint64_t cpu, const std::string& filename);
+	void tracelog(uint64_t cpu, const std::string& filename, bool binary = false,
+		const std::string& compression = "");
 /**
  * Tracelogging on?
  */
@@ -149,17 +171,17 @@ public:
  */
 	void request_break();
 	//These are public only for some debugging stuff.
-	typedef std::list<callback_base*> cb_list;
-	std::map<uint64_t, cb_list> read_cb;
-	std::map<uint64_t, cb_list> write_cb;
-	std::map<uint64_t, cb_list> exec_cb;
-	std::map<uint64_t, cb_list> trace_cb;
-	std::map<uint64_t, cb_list> frame_cb;
+	typedef hooktable::table<callback_base> cb_table;
+	cb_table read_cb;
+	cb_table write_cb;
+	cb_table exec_cb;
+	cb_table trace_cb;
+	cb_table frame_cb;
+	cb_table trace_raw_cb;
 private:
 	void do_showhooks();
 	void do_genevent(const std::string& a);
-	void do_tracecmd(const std::string& a);
-	cb_list dummy_cb;  //Always empty.
+	void do_tracecmd(const std::string& a, bool binary);
 	uint64_t xmask = 1;
 	std::function<void()> tracelog_change_cb;
 	emulator_dispatch& edispatch;
@@ -172,10 +194,14 @@ private:
 	command::_fnptr<> showhooks;
 	command::_fnptr<const std::string&> genevent;
 	command::_fnptr<const std::string&> tracecmd;
+	command::_fnptr<const std::string&> tracebincmd;
+	uint64_t current_frame = 0;
 
 	struct tracelog_file : public callback_base
 	{
 		std::ofstream stream;
+		binarytrace::writer* binary;		//NULL for text trace.
+		std::map<uint64_t, etype> types;	//Type of trace callback for each CPU.
 		std::string full_filename;
 		unsigned refcnt;
 		tracelog_file(debug_context& parent);
@@ -183,11 +209,14 @@ private:
 		void callback(const params& p);
 		void killed(uint64_t addr, etype type);
 	private:
+		void binary_frame();
+		void binary_error(std::exception& e);
+		uint64_t last_frame;
 		debug_context& parent;
 	};
 	std::map<uint64_t, tracelog_file*> trace_outputs;
 
-	std::map<uint64_t, cb_list>& get_lists(etype type)
+	cb_table& get_lists(etype type)
 	{
 		switch(type) {
 		case DEBUG_READ: return read_cb;
@@ -195,6 +224,7 @@ private:
 		case DEBUG_EXEC: return exec_cb;
 		case DEBUG_TRACE: return trace_cb;
 		case DEBUG_FRAME: return frame_cb;
+		case DEBUG_TRACE_RAW: return trace_raw_cb;
 		default: throw std::runtime_error("Invalid debug callback type");
 		}
 	}
@@ -33,6 +33,7 @@ struct emulator_dispatch
 	dispatch::source<> subtitle_change;
 	dispatch::source<unsigned, unsigned, int> multitrack_change;
 	dispatch::source<> action_update;
+	dispatch::source<std::string, bool> save_complete;
 };
 
 extern dispatch::source<> notify_new_core;
@@ -30,6 +30,7 @@ class loaded_rom;
 class save_jukebox;
 class emulator_runmode;
 class status_updater;
+class save_writer;
 namespace command { class group; }
 namespace lua { class state; }
 namespace settingvar { class group; }
@@ -127,6 +128,7 @@ struct emulator_instance
 	save_jukebox* jukebox;
 	emulator_runmode* runmode;
 	status_updater* supdater;
+	save_writer* swriter;
 	threads::id emu_thread;
 	time_t random_seed_value;
 	dtor_list D;
@@ -24,7 +24,13 @@ extern std::string msu1_base_path;
  */
 void mainloop_signal_need_rewind(void* ptr);
 
-void set_stop_at_frame(uint64_t frame = 0);
+/**
+ * Run until specified frame and then pause.
+ *
+ * Parameter frame: The frame to stop at. 0 cancels the stop.
+ * Parameter turbo: If true, run in turbo seek mode (no frame rate limit, screen drawing or sound) until the stop.
+ */
+void set_stop_at_frame(uint64_t frame = 0, bool turbo = false);
 void switch_projects(const std::string& newproj);
 void close_rom();
 void load_new_rom(const romload_request& req);
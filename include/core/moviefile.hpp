@@ -9,6 +9,7 @@
 #include "core/rom-small.hpp"
 #include "core/subtitles.hpp"
 #include "interface/romtype.hpp"
+#include "library/pagestore.hpp"
 #include "library/rrdata.hpp"
 #include "library/zip.hpp"
 
@@ -31,6 +32,10 @@ struct dynamic_state
  * Core savestate (if is_savestate is true).
  */
 	std::vector<char> savestate;		//Savestate to load (if is_savestate is true).
+/**
+ * Core savestate in shared page store (if is_savestate is true and savestate is empty).
+ */
+	pagestore::snapshot paged_savestate;
 /**
  * Host memory (if is_savestate is true).
  */
@@ -75,6 +80,14 @@ struct dynamic_state
  * Swap the dynamic state with another.
  */
 	void swap(dynamic_state& s) throw();
+/**
+ * Move the core savestate to shared page store.
+ */
+	void page_out() throw(std::bad_alloc);
+/**
+ * Move the core savestate back from shared page store.
+ */
+	void page_in() throw(std::bad_alloc);
 };
 
 /**
@@ -10,6 +10,7 @@
 #include "core/romimage.hpp"
 #include "interface/romtype.hpp"
 #include "library/fileimage.hpp"
+#include "library/pagestore.hpp"
 
 /**
  * ROM loaded into memory.
@@ -56,6 +57,25 @@ struct loaded_rom
  * throws std::runtime_error: Loading state failed.
  */
 	void load_core_state(const std::vector<char>& buf, bool nochecksum = false) throw(std::runtime_error);
+/**
+ * Saves core state into shared page store. Only pages that changed since the previous paged save are hashed.
+ * WARNING: This takes emulated time.
+ *
+ * returns: The saved state.
+ * throws std::bad_alloc: Not enough memory.
+ */
+	pagestore::snapshot save_core_state_paged(bool nochecksum = false) throw(std::bad_alloc, std::runtime_error);
+/**
+ * Loads core state from page store.
+ *
+ * parameter buf: The state.
+ * throws std::runtime_error: Loading state failed.
+ */
+	void load_core_state(const pagestore::snapshot& buf, bool nochecksum = false) throw(std::runtime_error);
+/**
+ * Should in-memory savestates be kept in shared page store?
+ */
+	bool paged_savestates();
 
 /**
  * Get internal type representation.
@@ -109,6 +129,10 @@ struct loaded_rom
 	core_sysregion& combine_region(core_region& reg) { return rtype().combine_region(reg); }
 	bool isnull() { return rtype().isnull(); }
 	std::vector<std::string> get_trace_cpus() { return rtype().get_trace_cpus(); }
+	bool get_raw_trace_info(uint64_t cpu, binarytrace::cpu_info& info)
+	{
+		return rtype().get_raw_trace_info(cpu, info);
+	}
 	controller_set controllerconfig(std::map<std::string, std::string>& settings)
 	{
 		return rtype().controllerconfig(settings);
@@ -171,6 +195,8 @@ private:
 	rom_image_handle image;
 	//ROM region.
 	core_region* region;
+	//Last paged savestate, used to skip unchanged pages.
+	pagestore::snapshot last_paged;
 };
 
 /**
@@ -16,6 +16,7 @@ public:
 	const static uint64_t PAUSE;
 	const static uint64_t PAUSE_BREAK;
 	const static uint64_t CORRUPT;
+	const static uint64_t TURBO_SEEK;
 
 	const static unsigned P_START;
 	const static unsigned P_VIDEO;
@@ -70,9 +71,15 @@ public:
  */
 	bool is_skiplag() { return is(SKIPLAG); }
 /**
- * Is running free?
+ * Is running free (including turbo seek)?
  */
-	bool is_freerunning() { return is(NORMAL); }
+	bool is_freerunning() { return is(NORMAL|TURBO_SEEK); }
+/**
+ * Is turbo seeking?
+ *
+ * In turbo seek, the emulator runs without frame rate limit, and does not draw the screen nor play the game sound.
+ */
+	bool is_turbo_seek() { return is(TURBO_SEEK); }
 /**
  * Is special?
  */
@@ -101,6 +108,10 @@ public:
  * Set freerunning.
  */
 	void set_freerunning() { set(NORMAL); }
+/**
+ * Set turbo seek.
+ */
+	void set_turbo_seek() { set(TURBO_SEEK); }
 /**
  * Set advance frame.
  *
@@ -0,0 +1,90 @@
+#ifndef _savewriter__hpp__included__
+#define _savewriter__hpp__included__
+
+#include <functional>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include "library/threads.hpp"
+
+class input_queue;
+class emulator_dispatch;
+struct moviefile;
+
+/**
+ * Background writer for movie files.
+ *
+ * The emulation thread hands over an immutable snapshot of the movie file, and the writer thread does the
+ * compression and writing. Completion is reported back in emulation thread (via input queue).
+ */
+class save_writer
+{
+public:
+/**
+ * Ctor.
+ */
+	save_writer(input_queue& _iqueue, emulator_dispatch& _dispatch);
+/**
+ * Dtor. Waits for all pending writes.
+ */
+	~save_writer();
+/**
+ * Queue a write.
+ *
+ * Parameter mv: The movie file to write. Ownership is transferred (even on failure).
+ * Parameter rrd: Serialized rerecord data to write.
+ * Parameter filename: The filename to write to.
+ * Parameter compression: Compression level.
+ * Parameter binary: If true, write binary format.
+ * Parameter as_state: If true, write as savestate.
+ * Parameter done: Called in emulation thread on completion, with empty string on success and error message on
+ *	failure.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	void queue(moviefile* mv, std::vector<char>& rrd, const std::string& filename, unsigned compression,
+		bool binary, bool as_state, std::function<void(const std::string& err)> done) throw(std::bad_alloc);
+/**
+ * Wait until at most specified number of writes are pending.
+ *
+ * Parameter maxpending: The maximum number of pending writes.
+ */
+	void wait(size_t maxpending) throw();
+/**
+ * Wait until all writes have completed.
+ */
+	void flush() throw() { wait(0); }
+/**
+ * Get number of pending writes.
+ */
+	size_t pending() throw();
+/**
+ * Is file being written?
+ */
+	bool is_pending(const std::string& filename) throw();
+private:
+	class worker;
+	struct job
+	{
+		moviefile* mv;
+		std::vector<char> rrd;
+		std::string filename;
+		unsigned compression;
+		bool binary;
+		bool as_state;
+		std::function<void(const std::string& err)> done;
+	};
+	save_writer(const save_writer&);
+	save_writer& operator=(const save_writer&);
+	void run_job(job& j);
+	job* next_job();
+	void job_done(job* j);
+	input_queue& iqueue;
+	emulator_dispatch& edispatch;
+	worker* thread;
+	threads::lock mlock;
+	threads::cv condition;
+	std::deque<job*> jobs;		//The first job is the one being written.
+};
+
+#endif
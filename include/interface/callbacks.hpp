@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <string>
 #include <list>
+#include "library/binarytrace.hpp"
 #include "library/framebuffer.hpp"
 
 /**
@@ -71,6 +72,10 @@ public:
  * Notify trace event.
  */
 	virtual void memory_trace(uint64_t proc, const char* str, bool insn) = 0;
+/**
+ * Notify raw instruction trace event.
+ */
+	virtual void memory_trace_raw(uint64_t proc, const binarytrace::insn& i) = 0;
 };
 
 extern struct emucore_callbacks* ecore_callbacks;
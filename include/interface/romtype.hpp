@@ -7,6 +7,7 @@
 #include <vector>
 #include "interface/controller.hpp"
 #include "interface/setting.hpp"
+#include "library/binarytrace.hpp"
 #include "library/framebuffer.hpp"
 #include "library/threads.hpp"
 #include "library/loadlib.hpp"
@@ -307,6 +308,32 @@ private:
 	std::vector<unsigned> compatible;
 };
 
+/**
+ * A piece of savestate.
+ *
+ * A savestate is the concatenation of its spans, in order.
+ */
+struct core_state_span
+{
+	core_state_span() : data(NULL), size(0), is_volatile(true) {}
+	core_state_span(const char* _data, size_t _size, bool _volatile)
+		: data(_data), size(_size), is_volatile(_volatile) {}
+/**
+ * The data.
+ */
+	const char* data;
+/**
+ * Size of the data.
+ */
+	size_t size;
+/**
+ * If true, the data is in scratch buffer that is only valid until the next call to the core. If false, the data
+ * points to memory of the core that stays valid as long as the ROM is loaded (but its contents change as the
+ * core runs).
+ */
+	bool is_volatile;
+};
+
 struct core_romimage
 {
 	const char* markup;
@@ -328,6 +355,8 @@ struct core_core
 	void load_sram(std::map<std::string, std::vector<char>>& sram) throw(std::bad_alloc);
 	void serialize(std::vector<char>& out);
 	void unserialize(const char* in, size_t insize);
+	void serialize_spans(std::vector<core_state_span>& out);
+	void unserialize_spans(const std::vector<core_state_span>& in);
 	core_region& get_region();
 	void power();
 	void unload_cartridge();
@@ -360,6 +389,7 @@ struct core_core
 	void set_debug_flags(uint64_t addr, unsigned flags_set, unsigned flags_clear);
 	void set_cheat(uint64_t addr, uint64_t value, bool set);
 	std::vector<std::string> get_trace_cpus();
+	bool get_raw_trace_info(uint64_t cpu, binarytrace::cpu_info& info) { return c_get_raw_trace_info(cpu, info); }
 	void debug_reset();
 	bool isnull() const;
 	void reset_to_load() { c_reset_to_load(); }
@@ -402,12 +432,37 @@ protected:
 	virtual void c_load_sram(std::map<std::string, std::vector<char>>& sram) throw(std::bad_alloc) = 0;
 /**
  * Serialize the system state.
+ *
+ * Cores must override either this or c_serialize_spans(). The default gathers the spans.
+ *
+ * Throws std::logic_error: Neither is overridden.
  */
-	virtual void c_serialize(std::vector<char>& out) = 0;
+	virtual void c_serialize(std::vector<char>& out);
 /**
  * Unserialize the system state.
+ *
+ * Cores must override either this or c_unserialize_spans(). The default passes the data as one span.
+ *
+ * Throws std::logic_error: Neither is overridden.
+ */
+	virtual void c_unserialize(const char* in, size_t insize);
+/**
+ * Serialize the system state as list of spans, without copying it.
+ *
+ * Parameter out: The spans are written here. Any existing contents are replaced. The spans are valid until the
+ *	core is next called (but see core_state_span::is_volatile).
+ *
+ * The default calls c_serialize() and returns its result as one span.
  */
-	virtual void c_unserialize(const char* in, size_t insize) = 0;
+	virtual void c_serialize_spans(std::vector<core_state_span>& out);
+/**
+ * Unserialize the system state from list of spans.
+ *
+ * Parameter in: The savestate, as list of spans.
+ *
+ * The default gathers the spans (unless there is only one) and calls c_unserialize().
+ */
+	virtual void c_unserialize_spans(const std::vector<core_state_span>& in);
 /**
  * Get current region.
  */
@@ -516,7 +571,7 @@ protected:
  * Set/Clear debug callback flags for address.
  *
  * Address of 0xFFFFFFFFFFFFFFFF means all addresses.
- * Flags are 1 for read, 2 for write, 4 for execute, 8 for trace (addr is processor number)
+ * Flags are 1 for read, 2 for write, 4 for execute, 8 for trace and 16 for raw trace (addr is processor number)
  */
 	virtual void c_set_debug_flags(uint64_t addr, unsigned flags_set, unsigned flags_clear) = 0;
 /**
@@ -527,6 +582,17 @@ protected:
  * Get list of trace processor names.
  */
 	virtual std::vector<std::string> c_get_trace_cpus() = 0;
+/**
+ * Get description of raw instruction traces of processor.
+ *
+ * If the core supports raw traces for the processor, setting debug flag 16 for processor makes the core call
+ * memory_trace_raw() for each instruction.
+ *
+ * Parameter cpu: The processor number.
+ * Parameter info: The description is written here.
+ * Returns: True if raw traces are supported, false if not.
+ */
+	virtual bool c_get_raw_trace_info(uint64_t cpu, binarytrace::cpu_info& info);
 /**
  * Reset all debug hooks.
  */
@@ -544,6 +610,9 @@ private:
 	bool hidden;
 	std::map<std::string, interface_action> actions;
 	threads::lock actions_lock;
+	std::vector<char> span_scratch;
+	bool in_default_serialize;
+	bool in_default_unserialize;
 };
 
 struct core_type
@@ -585,6 +654,8 @@ public:
 	}
 	void serialize(std::vector<char>& out) { core->serialize(out); }
 	void unserialize(const char* in, size_t insize) { core->unserialize(in, insize); }
+	void serialize_spans(std::vector<core_state_span>& out) { core->serialize_spans(out); }
+	void unserialize_spans(const std::vector<core_state_span>& in) { core->unserialize_spans(in); }
 	core_region& get_region() { return core->get_region(); }
 	void power() { core->power(); }
 	void unload_cartridge() { core->unload_cartridge(); }
@@ -621,6 +692,10 @@ public:
 		return core->set_cheat(addr, value, set);
 	}
 	std::vector<std::string> get_trace_cpus() { return core->get_trace_cpus(); }
+	bool get_raw_trace_info(uint64_t cpu, binarytrace::cpu_info& info)
+	{
+		return core->get_raw_trace_info(cpu, info);
+	}
 	void debug_reset() { core->debug_reset(); }
 	bool isnull() const { return core->isnull(); }
 	void reset_to_load() { return core->reset_to_load(); }
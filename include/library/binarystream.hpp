@@ -215,6 +215,12 @@ public:
  * Parameter bufsize: The amount of data to read.
  */
 	void raw(void* buf, size_t bufsize);
+/**
+ * Skip over data. Seeks instead of reading if the underlying file allows.
+ *
+ * Parameter size: The amount of data to skip.
+ */
+	void skip(uint64_t size);
 /**
  * Read extension substreams.
  *
@@ -0,0 +1,171 @@
+#ifndef _library__binarytrace__hpp__included__
+#define _library__binarytrace__hpp__included__
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "threads.hpp"
+
+/**
+ * Compact binary trace logs.
+ *
+ * The file starts with magic "lsnestrc", version byte and the name of compression (length-prefixed, empty for
+ * none). It is followed by blocks, each consisting of uncompressed size (u32), stored size (u32) and the data. Each
+ * block is compressed independently and contains whole records only.
+ */
+namespace binarytrace
+{
+/**
+ * Instruction trace event, as filled by the emulator core.
+ */
+struct insn
+{
+	uint32_t pc;			//Address of instruction.
+	uint32_t stamp;			//Position within frame, core-defined (e.g. scanline << 16 | dot).
+	uint8_t variant;		//Disassembler variant (index to cpu_info::disassemblers).
+	uint8_t reglen;			//Number of bytes in register snapshot.
+	uint8_t opcode[4];		//Instruction bytes (may read past the end of instruction).
+	uint8_t regs[32];		//Register snapshot, layout given by cpu_info::registers.
+};
+
+/**
+ * Description of instruction traces of one processor.
+ */
+struct cpu_info
+{
+	std::vector<std::string> disassemblers;				//Disassembler names for variants.
+	std::vector<std::pair<std::string, unsigned>> registers;	//Register names and sizes (little-endian).
+};
+
+/**
+ * A record read from trace.
+ */
+struct record
+{
+	enum rtype
+	{
+		CPU,		//Processor description (name, info).
+		FRAME,		//Start of frame (frame).
+		INSN,		//Instruction (cpu, i).
+		TEXT,		//Textual trace event (cpu, text, true_insn).
+	};
+	rtype type;
+	unsigned cpu;
+	uint64_t frame;
+	insn i;
+	std::string name;
+	cpu_info info;
+	std::string text;
+	bool true_insn;
+};
+
+/**
+ * Buffered trace writer.
+ *
+ * Records are collected into large blocks, which are compressed and written out by a background thread. Not
+ * thread-safe.
+ */
+class writer
+{
+public:
+/**
+ * Create a new trace file.
+ *
+ * Parameter filename: The file to write.
+ * Parameter compression: Name of streamcompress compressor, or "" for no compression.
+ * Parameter args: Arguments to the compressor.
+ * Throws std::runtime_error: Can't open file or bad compressor.
+ */
+	writer(const std::string& filename, const std::string& compression = "", const std::string& args = "");
+/**
+ * Flush and close the file.
+ */
+	~writer();
+/**
+ * Write processor description. Should be written before instructions of that processor.
+ */
+	void cpu(unsigned cpu, const std::string& name, const cpu_info& info);
+/**
+ * Write start of frame.
+ */
+	void frame(uint64_t frame);
+/**
+ * Write instruction.
+ */
+	void instruction(unsigned cpu, const insn& i)
+	{
+		uint8_t* p = reserve(12 + sizeof(i.opcode) + i.reglen);
+		encode_insn(p, cpu, i);
+	}
+/**
+ * Write textual event.
+ */
+	void text(unsigned cpu, const char* str, bool true_insn);
+/**
+ * Hand the current block to background thread.
+ */
+	void flush();
+/**
+ * Block size.
+ */
+	const static size_t blocksize = 1 << 20;
+private:
+	writer(const writer&);
+	writer& operator=(const writer&);
+	uint8_t* reserve(size_t size)
+	{
+		if(fill + size > blocksize)
+			flush();
+		uint8_t* p = &current[fill];
+		fill += size;
+		return p;
+	}
+	static void encode_insn(uint8_t* p, unsigned cpu, const insn& i);
+	static void* worker_trampoline(writer* w);
+	void worker_loop();
+	std::ofstream stream;
+	std::string compression;
+	std::string args;
+	std::vector<uint8_t> current;
+	size_t fill;
+	std::deque<std::vector<uint8_t>> queue;
+	std::vector<std::vector<uint8_t>> spare;
+	bool quitting;
+	std::string error;
+	threads::lock mlock;
+	threads::cv condition;
+	threads::thread* thread;
+};
+
+/**
+ * Trace reader.
+ */
+class reader
+{
+public:
+/**
+ * Open a trace file.
+ *
+ * Throws std::runtime_error: Can't open file, not a trace, or unsupported compression.
+ */
+	reader(const std::string& filename);
+/**
+ * Read the next record.
+ *
+ * Parameter r: The record is stored here.
+ * Returns: True if record was read, false on end of file.
+ * Throws std::runtime_error: Corrupt trace.
+ */
+	bool read(record& r);
+private:
+	bool next_block();
+	std::ifstream stream;
+	std::string compression;
+	std::vector<uint8_t> block;
+	size_t pos;
+};
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef _library__fileimage_index__hpp__included__
+#define _library__fileimage_index__hpp__included__
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include "threads.hpp"
+
+namespace fileimage
+{
+/**
+ * Compute SHA-256 of file, skipping given number of bytes at start. Runs in calling thread.
+ *
+ * Parameter filename: The file to hash.
+ * Parameter prefix: Number of bytes to skip.
+ * Returns: The hash (hex).
+ * Throws std::runtime_error: Can't read the file.
+ */
+std::string hash_file(const std::string& filename, uint64_t prefix);
+
+/**
+ * Persistent index of file hashes.
+ *
+ * Entries are keyed by (filename, prefix) and remember the size and modification time the file had when hashed, so
+ * changed files are detected without reading them. The index is stored as a text file that is appended to on
+ * changes, and rewritten when it has accumulated enough dead lines. All methods are thread-safe.
+ */
+class hash_index
+{
+public:
+/**
+ * Create index backed by file. The file is read on first access.
+ */
+	hash_index(const std::string& filename);
+/**
+ * Look up hash of file.
+ *
+ * Parameter file: The filename.
+ * Parameter prefix: The prefix size.
+ * Parameter size: Current size of the file.
+ * Parameter mtime: Current modification time of the file.
+ * Returns: The hash, or "" if not known or the file has changed.
+ */
+	std::string lookup(const std::string& file, uint64_t prefix, uint64_t size, int64_t mtime);
+/**
+ * Store hash of file.
+ *
+ * Parameter file: The filename.
+ * Parameter prefix: The prefix size.
+ * Parameter size: Size of the file, or unknown_size if not known.
+ * Parameter mtime: Modification time of the file.
+ * Parameter hash: The hash. "" removes the entry.
+ */
+	void store(const std::string& file, uint64_t prefix, uint64_t size, int64_t mtime, const std::string& hash);
+/**
+ * Remove all entries of file.
+ */
+	void erase(const std::string& file);
+/**
+ * Get files (and prefixes) that have been seen with given hash. The files may have changed since.
+ */
+	std::list<std::pair<std::string, uint64_t>> by_hash(const std::string& hash);
+/**
+ * Rewrite the backing file with only the live entries.
+ */
+	void compact();
+/**
+ * Size value for unknown sizes.
+ */
+	const static uint64_t unknown_size = 0xFFFFFFFFFFFFFFFFULL;
+private:
+	struct entry
+	{
+		std::string hash;
+		uint64_t size;
+		int64_t mtime;
+	};
+	typedef std::pair<std::string, uint64_t> key_t;
+	void load();
+	void set(const key_t& key, const entry& e);
+	void append(const key_t& key, const entry& e);
+	void do_compact();
+	hash_index(const hash_index&);
+	hash_index& operator=(const hash_index&);
+	std::string filename;
+	bool loaded;
+	size_t lines;
+	std::map<key_t, entry> entries;
+	std::multimap<std::string, key_t> reverse;
+	threads::lock mlock;
+};
+}
+
+#endif
@@ -227,6 +227,16 @@ struct fb
  * throws std::bad_alloc: Not enough memory.
  */
 	void reallocate(size_t _width, size_t _height, bool upside_down = false) throw(std::bad_alloc);
+/**
+ * Make this framebuffer a view of band of rows of another framebuffer. The origin is moved so that drawing to the
+ * view at given coordinates draws to the same place as drawing to the whole framebuffer would (clipped to the band).
+ *
+ * parameter parent: The framebuffer to view. Must stay alive and unchanged while the view is used.
+ * parameter first: The first row of band.
+ * parameter count: Number of rows in band.
+ * returns: True on success, false if band can't be viewed (misaligned rows).
+ */
+	bool set_band(fb<X>& parent, size_t first, size_t count) throw();
 
 /**
  * Set origin
@@ -365,6 +375,20 @@ struct object
  * Return true if myobj and killobj are equal and not NULL.
  */
 	bool kill_request_ifeq(void* myobj, void* killobj);
+/**
+ * Can the object be drawn in bands of rows, concurrently with other bands? Such objects must only write pixels
+ * (at the same place regardless of band) and not modify themselves when drawn. Default is to return false.
+ *
+ * parameter first: Set to first row (relative to origin) the object may draw to.
+ * parameter last: Set to one past last row (relative to origin) the object may draw to.
+ * returns: True if object can be drawn in bands.
+ */
+	virtual bool get_band_rows(int64_t& first, int64_t& last) throw();
+/**
+ * Called from the thread running the queue before (enable=true) and after (enable=false) the object is drawn in
+ * bands. Objects can take copy of shared state here, so drawing the bands needs no locking. Default does nothing.
+ */
+	virtual void set_band_mode(bool enable) throw();
 /**
  * Draw the object.
  *
@@ -609,6 +633,101 @@ private:
 
 
 #define RENDER_PAGE_SIZE 65500
+#define RENDER_BATCH_SIZE 4096
+
+/**
+ * Run of objects of the same simple type, stored contiguously in render queue memory and drawn by one loop without
+ * virtual calls.
+ *
+ * T must be copy-constructible and have template<bool X> void draw(struct fb<X>& scr) throw() and
+ * void rows(int64_t& first, int64_t& last) const throw() giving the rows relative to origin draw() may touch. Drawing
+ * must not modify the object. Batched objects can't be killed.
+ */
+template<class T> struct batch : public object
+{
+/**
+ * Create empty batch with room for capacity objects. The objects are stored right after the header.
+ */
+	batch(size_t _capacity) throw() : count(0), capacity(_capacity), first_row(0), last_row(0) {}
+	~batch() throw()
+	{
+		T* i = items();
+		for(size_t j = 0; j < count; j++)
+			i[j].~T();
+	}
+/**
+ * Size of header, including padding before objects.
+ */
+	static size_t header_size() throw()
+	{
+		return (sizeof(batch<T>) + alignof(T) - 1) / alignof(T) * alignof(T);
+	}
+/**
+ * Number of objects to allocate room for in a new batch. Runs start with room for one object, and each batch
+ * continuing a run has twice the room of the previous, up to RENDER_BATCH_SIZE bytes.
+ *
+ * parameter previous: Capacity of the full batch the new one continues, 0 if it starts a run.
+ */
+	static size_t next_capacity(size_t previous) throw()
+	{
+		size_t c = (RENDER_BATCH_SIZE - header_size()) / sizeof(T);
+		if(2 * previous < c)
+			c = 2 * previous;
+		return (c > 0) ? c : 1;
+	}
+/**
+ * Is the batch full?
+ */
+	bool full() const throw() { return count == capacity; }
+/**
+ * Get number of objects batch has room for.
+ */
+	size_t get_capacity() const throw() { return capacity; }
+/**
+ * Construct new object at end of batch. Must not be full.
+ */
+	template<typename... U> void add(U... args)
+	{
+		T* i = new(items() + count) T(args...);
+		int64_t f, l;
+		i->rows(f, l);
+		if(!count || f < first_row) first_row = f;
+		if(!count || l > last_row) last_row = l;
+		count++;
+	}
+	template<bool X> void draw(struct fb<X>& scr) throw()
+	{
+		//Skip objects entirely above or below the screen (or the band being drawn).
+		int64_t top = -static_cast<int64_t>(scr.get_origin_y());
+		int64_t bottom = top + static_cast<int64_t>(scr.get_height());
+		T* i = items();
+		for(size_t j = 0; j < count; j++) {
+			int64_t f, l;
+			i[j].rows(f, l);
+			if(l > top && f < bottom)
+				i[j].draw(scr);
+		}
+	}
+	void operator()(struct fb<false>& scr) throw() { draw(scr); }
+	void operator()(struct fb<true>& scr) throw() { draw(scr); }
+	void clone(struct queue& q) const throw(std::bad_alloc);
+	bool get_band_rows(int64_t& first, int64_t& last) throw()
+	{
+		first = first_row;
+		last = last_row;
+		return true;
+	}
+private:
+	T* items() throw() { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + header_size()); }
+	const T* items() const throw()
+	{
+		return reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + header_size());
+	}
+	size_t count;
+	size_t capacity;
+	int64_t first_row;
+	int64_t last_row;
+};
 
 /**
  * Queue of render operations.
@@ -646,6 +765,22 @@ struct queue
  * Copy objects from another render queue.
  */
 	void copy_from(queue& q) throw(std::bad_alloc);
+/**
+ * Add object to the batch of same type at end of the queue, starting new batch if needed. Consecutive objects added
+ * this way are drawn by one loop.
+ */
+	template<class T, typename... U> void create_add_batched(U... args)
+	{
+		batch<T>* b = (open_batch_tag == batch_tag<T>()) ? reinterpret_cast<batch<T>*>(open_batch) : NULL;
+		if(!b || b->full()) {
+			size_t cap = batch<T>::next_capacity(b ? b->get_capacity() : 0);
+			b = new(alloc(batch<T>::header_size() + cap * sizeof(T))) batch<T>(cap);
+			add(*b);
+			open_batch = b;
+			open_batch_tag = batch_tag<T>();
+		}
+		b->add(args...);
+	}
 /**
  * Helper for clone.
  */
@@ -653,6 +788,13 @@ struct queue
 	{
 		create_add<T>(*obj);
 	}
+/**
+ * Force number of bands the screen is split to for drawing, and draw in bands regardless of amount of work. Meant
+ * for testing.
+ *
+ * parameter bands: Number of bands, 0 to choose automatically.
+ */
+	static void set_forced_bands(unsigned bands) throw();
 /**
  * Get number of objects.
  */
@@ -675,6 +817,15 @@ struct queue
  */
 	~queue() throw();
 private:
+	queue(const queue&);
+	queue& operator=(const queue&);
+	template<class T> static void* batch_tag()
+	{
+		static char tag;
+		return &tag;
+	}
+	struct band_item { struct object* obj; int64_t first; int64_t last; };
+	template<bool X> void run_bands(struct fb<X>& scr, struct fb<X>* views, unsigned bands) throw();
 	void add(struct object& obj) throw(std::bad_alloc);
 	struct node { struct object* obj; struct node* next; bool killed; };
 	struct page {
@@ -684,13 +835,23 @@ private:
 	};
 	struct node* queue_head;
 	struct node* queue_tail;
+	object* open_batch;
+	void* open_batch_tag;
 	size_t memory_allocated;
 	size_t pages;
 	threads::lock display_mutex; //Synchronize display and kill.
-	std::map<size_t, page> memory;
+	std::vector<page*> memory;
+	std::vector<band_item> band_items;	//Objects being drawn in bands, kept to reuse memory.
 	memtracker::autorelease tracker;
 };
 
+template<class T> void batch<T>::clone(struct queue& q) const throw(std::bad_alloc)
+{
+	const T* i = items();
+	for(size_t j = 0; j < count; j++)
+		q.create_add_batched<T>(i[j]);
+}
+
 /**
  * Drop every fourth byte of specified buffer.
  *
@@ -744,6 +905,60 @@ void copy_drop4s(uint16_t* dest, const uint64_t* src, size_t units);
  * Parameter units: Number of 8 byte units to copy. Must be multiple of 2.
  */
 void copy_swap4(uint16_t* dest, const uint64_t* src, size_t units);
+
+/**
+ * Horizontally scale a row of pixels by repeating each pixel.
+ *
+ * Parameter dest: Destination buffer, width * hscale pixels.
+ * Parameter src: Source buffer, width pixels. Must not overlap dest.
+ * Parameter width: Number of source pixels.
+ * Parameter hscale: The scale factor.
+ */
+void scale_row(uint32_t* dest, const uint32_t* src, size_t width, size_t hscale);
+void scale_row(uint64_t* dest, const uint64_t* src, size_t width, size_t hscale);
+
+/**
+ * Convert 0RGB pixels to specified channel shifts, using SIMD if available.
+ *
+ * Parameter dest: Destination buffer.
+ * Parameter src: Source buffer.
+ * Parameter width: Number of pixels.
+ * Parameter rshift: Red shift.
+ * Parameter gshift: Green shift.
+ * Parameter bshift: Blue shift.
+ * Returns: Number of pixels converted (from start). The caller converts the rest.
+ */
+size_t decode_rgb32_simd(uint32_t* dest, const uint32_t* src, size_t width, uint8_t rshift, uint8_t gshift,
+	uint8_t bshift);
+
+/**
+ * Convert 24-bit RGB (BGR if swap is set) pixels to specified channel shifts, using SIMD if available.
+ *
+ * Parameters and return value are as in decode_rgb32_simd().
+ */
+size_t decode_rgb24_simd(uint32_t* dest, const uint8_t* src, size_t width, bool swap, uint8_t rshift,
+	uint8_t gshift, uint8_t bshift);
+
+/**
+ * Look up 16-bit pixels (masked with mask) from palette, using SIMD if available.
+ *
+ * Parameter dest: Destination buffer.
+ * Parameter src: Source buffer.
+ * Parameter width: Number of pixels.
+ * Parameter palette: The palette, must have entry for every masked value.
+ * Parameter mask: The index mask.
+ * Returns: Number of pixels converted (from start). The caller converts the rest.
+ */
+size_t decode_pal16_simd(uint32_t* dest, const uint16_t* src, size_t width, const uint32_t* palette,
+	uint32_t mask);
+
+/**
+ * Look up 32-bit pixels (masked with mask) from palette, using SIMD if available.
+ *
+ * Parameters and return value are as in decode_pal16_simd().
+ */
+size_t decode_pal32_simd(uint32_t* dest, const uint32_t* src, size_t width, const uint32_t* palette,
+	uint32_t mask);
 }
 
 
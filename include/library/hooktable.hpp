@@ -0,0 +1,258 @@
+#ifndef _library__hooktable__hpp__included__
+#define _library__hooktable__hpp__included__
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace hooktable
+{
+/**
+ * Address filter.
+ *
+ * A bitmap indexed by folded address. A clear bit means that no hook exists on any address that folds to that bit,
+ * so unwatched addresses cost a single bit test. A set bit may be a false positive.
+ */
+class filter
+{
+public:
+/**
+ * Create an empty filter.
+ */
+	filter() throw()
+	{
+		clear();
+	}
+/**
+ * Clear the filter.
+ */
+	void clear() throw()
+	{
+		memset(bits, 0, sizeof(bits));
+	}
+/**
+ * Mark address as possibly hooked.
+ */
+	void set(uint64_t addr) throw()
+	{
+		uint32_t h = fold(addr);
+		bits[h >> 6] |= (1ULL << (h & 63));
+	}
+/**
+ * Is the address possibly hooked?
+ */
+	bool maybe(uint64_t addr) const throw()
+	{
+		uint32_t h = fold(addr);
+		return (bits[h >> 6] >> (h & 63)) & 1;
+	}
+private:
+	const static unsigned fold_bits = 16;
+	static uint32_t fold(uint64_t addr) throw()
+	{
+		return (addr ^ (addr >> 16) ^ (addr >> 32) ^ (addr >> 48)) & ((1U << fold_bits) - 1);
+	}
+	uint64_t bits[(1U << fold_bits) / 64];
+};
+
+/**
+ * Table of hooks keyed by address, with one wildcard slot.
+ *
+ * Hook lists are immutable once published: modifications build a new list and retire the old one. A retired list is
+ * only freed once no dispatch is in progress (see guard), so callbacks may freely add or remove hooks while the list
+ * they were called from is being walked, and dispatch never needs to copy.
+ *
+ * Not thread-safe: all calls are expected to come from the emulation thread.
+ */
+template<typename T>
+class table
+{
+public:
+/**
+ * Immutable list of hooks.
+ */
+	typedef std::vector<T*> list;
+/**
+ * Dispatch guard. Retired lists stay alive while any guard exists.
+ */
+	class guard
+	{
+	public:
+		guard(table& _t) throw() : t(_t) { t.depth++; }
+		~guard() throw() { if(!--t.depth) t.reclaim(); }
+	private:
+		guard(const guard&);
+		guard& operator=(const guard&);
+		table& t;
+	};
+/**
+ * Create a new table.
+ *
+ * Parameter _wildcard: The key that denotes all addresses.
+ */
+	table(uint64_t _wildcard) throw()
+		: wildcard_key(_wildcard), wildcard_list(NULL), depth(0)
+	{
+	}
+/**
+ * Destructor.
+ */
+	~table()
+	{
+		clear();
+		reclaim();
+	}
+/**
+ * Quick check: Could any hooks be called for the address?
+ */
+	bool maybe(uint64_t addr) const throw()
+	{
+		return wildcard_list || flt.maybe(addr);
+	}
+/**
+ * Get the hook list for wildcard, or NULL if none.
+ */
+	const list* wildcard() const throw() { return wildcard_list; }
+/**
+ * Get the hook list for specified address (not including wildcard), or NULL if none.
+ */
+	const list* lookup(uint64_t addr) const throw()
+	{
+		if(!flt.maybe(addr)) return NULL;
+		auto i = std::lower_bound(entries.begin(), entries.end(), addr, key_less);
+		if(i == entries.end() || i->first != addr) return NULL;
+		return i->second;
+	}
+/**
+ * Add a hook.
+ *
+ * Returns: True if there were no hooks on the address before.
+ */
+	bool add(uint64_t addr, T* hook)
+	{
+		list** slot = find_slot(addr, false);
+		list* nlist = (slot && *slot) ? new list(**slot) : new list();
+		try {
+			nlist->push_back(hook);
+			if(!slot) slot = find_slot(addr, true);
+		} catch(...) {
+			delete nlist;
+			throw;
+		}
+		bool first = !*slot;
+		publish(slot, nlist);
+		if(addr != wildcard_key)
+			flt.set(addr);
+		return first;
+	}
+/**
+ * Remove a hook. Only the first instance is removed.
+ *
+ * Returns: True if the address has no hooks anymore (and had before).
+ */
+	bool remove(uint64_t addr, T* hook)
+	{
+		list** slot = find_slot(addr, false);
+		if(!slot || !*slot) return false;
+		auto i = std::find((*slot)->begin(), (*slot)->end(), hook);
+		if(i == (*slot)->end()) return false;
+		list* nlist = NULL;
+		if((*slot)->size() > 1) {
+			nlist = new list(**slot);
+			nlist->erase(nlist->begin() + (i - (*slot)->begin()));
+		}
+		publish(slot, nlist);
+		if(nlist) return false;
+		if(addr != wildcard_key) {
+			entries.erase(std::lower_bound(entries.begin(), entries.end(), addr, key_less));
+			rebuild_filter();
+		}
+		return true;
+	}
+/**
+ * Remove all hooks, calling fn(addr, hook) for each.
+ */
+	template<typename F> void kill_all(F fn)
+	{
+		while(!empty()) {
+			uint64_t addr = wildcard_list ? wildcard_key : entries.begin()->first;
+			const list* l = wildcard_list ? wildcard_list : entries.begin()->second;
+			T* hook = (*l)[0];
+			remove(addr, hook);
+			fn(addr, hook);
+		}
+	}
+/**
+ * Iterate over all hooks, calling fn(addr, hook) for each.
+ */
+	template<typename F> void for_each(F fn) const
+	{
+		if(wildcard_list)
+			for(auto j : *wildcard_list)
+				fn(wildcard_key, j);
+		for(auto& i : entries)
+			for(auto j : *i.second)
+				fn(i.first, j);
+	}
+/**
+ * Is the table empty?
+ */
+	bool empty() const throw() { return !wildcard_list && entries.empty(); }
+/**
+ * Remove all hooks without notification.
+ */
+	void clear()
+	{
+		publish(&wildcard_list, NULL);
+		for(auto& i : entries)
+			publish(&i.second, NULL);
+		entries.clear();
+		flt.clear();
+	}
+private:
+	table(const table&);
+	table& operator=(const table&);
+	static bool key_less(const std::pair<uint64_t, list*>& a, uint64_t b) { return a.first < b; }
+	list** find_slot(uint64_t addr, bool create)
+	{
+		if(addr == wildcard_key) return &wildcard_list;
+		auto i = std::lower_bound(entries.begin(), entries.end(), addr, key_less);
+		if(i != entries.end() && i->first == addr) return &i->second;
+		if(!create) return NULL;
+		i = entries.insert(i, std::make_pair(addr, (list*)NULL));
+		return &i->second;
+	}
+	void publish(list** slot, list* nlist)
+	{
+		list* old = *slot;
+		*slot = nlist;
+		if(!old) return;
+		if(depth)
+			retired.push_back(old);
+		else
+			delete old;
+	}
+	void reclaim() throw()
+	{
+		for(auto i : retired)
+			delete i;
+		retired.clear();
+	}
+	void rebuild_filter() throw()
+	{
+		flt.clear();
+		for(auto& i : entries)
+			flt.set(i.first);
+	}
+	uint64_t wildcard_key;
+	list* wildcard_list;
+	std::vector<std::pair<uint64_t, list*>> entries;
+	filter flt;
+	unsigned depth;
+	std::vector<list*> retired;
+};
+}
+
+#endif
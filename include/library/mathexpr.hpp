@@ -44,6 +44,15 @@ struct operinfo
 	operinfo(std::string opername, unsigned _operands, int _percedence, bool _rtl = false);
 	virtual ~operinfo();
 	virtual void evaluate(value target, std::vector<std::function<value()>> promises) = 0;
+	//If true, the operator always evaluates all its arguments, so evaluate_strict() may be used instead of
+	//evaluate(), with arguments evaluated beforehand.
+	virtual bool is_strict();
+	//Evaluate with already evaluated arguments. The default implementation calls evaluate().
+	virtual void evaluate_strict(value target, void** args, size_t nargs);
+	//If true, the operator reads state outside the expression (e.g. memory).
+	virtual bool is_source();
+	//Version of the outside state. Changes whenever the value read might have changed.
+	virtual uint64_t source_version();
 	const std::string fnname;
 	const bool is_operator;
 	const unsigned  operands; 		//Only for operators (max 2 operands).
@@ -84,13 +93,15 @@ struct typeinfo
 
 template<class T> struct operinfo_wrapper : public operinfo
 {
-	operinfo_wrapper(std::string funcname, T (*_fn)(std::vector<std::function<T&()>> promises))
-		: operinfo(funcname), fn(_fn)
+	operinfo_wrapper(std::string funcname, T (*_fn)(std::vector<std::function<T&()>> promises),
+		void (*_sfn)(T& target, T** args, size_t nargs) = NULL)
+		: operinfo(funcname), fn(_fn), sfn(_sfn)
 	{
 	}
 	operinfo_wrapper(std::string opername, unsigned _operands, int _percedence, bool _rtl,
-		T (*_fn)(std::vector<std::function<T&()>> promises))
-		: operinfo(opername, _operands, _percedence, _rtl), fn(_fn)
+		T (*_fn)(std::vector<std::function<T&()>> promises),
+		void (*_sfn)(T& target, T** args, size_t nargs) = NULL)
+		: operinfo(opername, _operands, _percedence, _rtl), fn(_fn), sfn(_sfn)
 	{
 	}
 	~operinfo_wrapper()
@@ -99,17 +110,29 @@ template<class T> struct operinfo_wrapper : public operinfo
 	void evaluate(value target, std::vector<std::function<value()>> promises)
 	{
 		std::vector<std::function<T&()>> _promises;
-		for(auto i : promises) {
-			std::function<value()> f = i;
-			_promises.push_back([f, this]() -> T& {
-				auto r = f();
+		_promises.reserve(promises.size());
+		for(auto& i : promises) {
+			std::function<value()>* f = &i;
+			_promises.push_back([f]() -> T& {
+				auto r = (*f)();
 				return *(T*)r._value;
 			});
 		}
 		*(T*)(target._value) = fn(_promises);
 	}
+	bool is_strict()
+	{
+		return (sfn != NULL);
+	}
+	void evaluate_strict(value target, void** args, size_t nargs)
+	{
+		if(!sfn)
+			return operinfo::evaluate_strict(target, args, nargs);
+		sfn(*(T*)(target._value), (T**)args, nargs);
+	}
 private:
 	T (*fn)(std::vector<std::function<T&()>> promises);
+	void (*sfn)(T& target, T** args, size_t nargs);
 };
 
 template<class T> struct opfun_info
@@ -120,6 +143,7 @@ template<class T> struct opfun_info
 	unsigned operands;
 	int precedence;
 	bool rtl;
+	void (*_sfn)(T& target, T** args, size_t nargs);	//Strict form (NULL if none).
 };
 
 template<class T> struct operinfo_set
@@ -129,9 +153,9 @@ template<class T> struct operinfo_set
 		for(auto i : list) {
 			if(i.is_operator)
 				set.insert(new operinfo_wrapper<T>(i.name, i.operands, i.precedence,
-					i.rtl, i._fn));
+					i.rtl, i._fn, i._sfn));
 			else
-				set.insert(new operinfo_wrapper<T>(i.name, i._fn));
+				set.insert(new operinfo_wrapper<T>(i.name, i._fn, i._sfn));
 		}
 	}
 	~operinfo_set()
@@ -259,13 +283,23 @@ public:
 	typeinfo& get_type() { return type; }
 	//Reset.
 	void reset();
+	//Get all source operators (see operinfo::is_source()) the expression can use.
+	void get_sources(std::set<operinfo*>& sources);
 	//Parse an expression.
 	static GC::pointer<mathexpr> parse(typeinfo& _type, const std::string& expr,
 		std::function<GC::pointer<mathexpr>(const std::string&)> vars);
 protected:
 	void trace();
 private:
+	struct program;
 	void mark_error_and_throw(error::errorcode _errcode, const std::string& _error);
+	void mark_failed_and_rethrow();
+	bool is_operator_node();
+	void compile();
+	void compile_node(program& p, std::set<mathexpr*>& visited, std::set<mathexpr*>& active);
+	void evaluate_compiled();
+	void evaluate_strict(void** args);
+	program* compiled;			//Flattened strict subexpressions (NULL if not compiled yet).
 	eval_state state;
 	typeinfo& type;				//Type of value.
 	void* _value;				//Value if state is EVALUATED or FIXED.
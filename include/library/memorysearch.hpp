@@ -16,7 +16,39 @@ class memory_space;
  */
 class memory_search
 {
+	struct segment;
 public:
+/**
+ * Iterator over candidate addresses, in linear memory order.
+ *
+ * The iterator is invalidated by any operation modifying the candidate set.
+ */
+	class iterator
+	{
+	public:
+/**
+ * Create an iterator not pointing anywhere.
+ */
+		iterator() throw() { parent = NULL; seg = 0; idx = 0; }
+/**
+ * Get the address of candidate.
+ */
+		uint64_t operator*() const throw();
+/**
+ * Go to next candidate.
+ */
+		iterator& operator++() throw();
+		iterator operator++(int) throw() { iterator tmp = *this; ++*this; return tmp; }
+		bool operator==(const iterator& i) const throw() { return parent == i.parent && idx == i.idx; }
+		bool operator!=(const iterator& i) const throw() { return !(*this == i); }
+	private:
+		friend class memory_search;
+		iterator(memory_search* _parent, uint64_t _idx) throw();
+		void settle() throw();
+		memory_search* parent;
+		size_t seg;
+		uint64_t idx;
+	};
 /**
  * Creates a new memory search context with all addresses.
  *
@@ -55,6 +87,14 @@ public:
  * Returns list of all candidates. This function isn't lazy, so be careful when calling with many candidates.
  */
 	std::list<uint64_t> get_candidates() throw(std::bad_alloc);
+/**
+ * Get iterator to first candidate.
+ */
+	iterator begin() throw(std::bad_alloc);
+/**
+ * Get iterator past the last candidate.
+ */
+	iterator end() throw() { return iterator(this, previous_content.size()); }
 /**
  * Is specified address a candidate?
  */
@@ -102,9 +142,20 @@ public:
  */
 	void loadstate(const std::vector<char>& buffer);
 private:
+	//Part of linear memory mapped by single region.
+	struct segment
+	{
+		memory_space::region* region;
+		uint64_t rbase;		//Offset in region.
+		uint64_t ibase;		//Linear address.
+		uint64_t size;
+	};
+	void build_segments() throw(std::bad_alloc);
+	void copy_content() throw();
 	memory_space& mspace;
 	std::vector<uint8_t> previous_content;
 	std::vector<uint64_t> still_in;
+	std::vector<segment> segments;
 	uint64_t candidates;
 };
 
@@ -1,6 +1,7 @@
 #ifndef _library__memoryspace__hpp__included__
 #define _library__memoryspace__hpp__included__
 
+#include <atomic>
 #include <string>
 #include <list>
 #include <vector>
@@ -108,6 +109,14 @@ public:
  */
 		~region_direct() throw();
 	};
+/**
+ * Create a new memory space with no regions.
+ */
+	memory_space();
+/**
+ * Destructor.
+ */
+	~memory_space();
 /**
  * Get system endianess.
  */
@@ -129,6 +138,8 @@ public:
  *
  * Parameter address: The address to look up.
  * Returns: The region/offset pair, or NULL/0 if that address is unmapped.
+ *
+ * Note: Does not lock. Recently used regions are cached per thread.
  */
 	std::pair<region*, uint64_t> lookup(uint64_t address);
 /**
@@ -148,13 +159,13 @@ public:
 /**
  * Get number of regions.
  */
-	size_t get_region_count() { return u_regions.size(); }
+	size_t get_region_count() { return current.load(std::memory_order_acquire)->regions.size(); }
 /**
  * Get linear RAM size.
  *
  * Returns: The linear RAM size in bytes.
  */
-	uint64_t get_linear_size() { return linear_size; }
+	uint64_t get_linear_size() { return current.load(std::memory_order_acquire)->linear_size; }
 /**
  * Get list of all regions in memory space.
  */
@@ -249,11 +260,23 @@ public:
  */
 	std::string address_to_textual(uint64_t addr);
 private:
-	threads::lock mlock;
-	std::vector<region*> u_regions;
-	std::vector<region*> u_lregions;
-	std::vector<uint64_t> linear_bases;
-	uint64_t linear_size;
+	memory_space(const memory_space&);
+	memory_space& operator=(const memory_space&);
+/**
+ * Region table. Tables are never modified after being published, new table is published instead.
+ */
+	struct table
+	{
+		std::vector<region*> regions;		//Sorted by base.
+		std::vector<region*> lregions;
+		std::vector<uint64_t> linear_bases;
+		uint64_t linear_size;
+		uint64_t generation;			//Unique among all tables of all memory spaces.
+	};
+	threads::lock mlock;			//Serializes set_regions().
+	std::atomic<const table*> current;
+	//Readers do not lock, so they may still be using old tables. Those are freed with the memory space.
+	std::list<table*> tables;
 	static int _get_system_endian();
 	static int sysendian;
 };
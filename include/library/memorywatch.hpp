@@ -29,6 +29,16 @@ struct memread_oper : public mathexpr::operinfo
  * Note: The first promise is for the address.
  */
 	void evaluate(mathexpr::value target, std::vector<std::function<mathexpr::value()>> promises);
+/**
+ * Evaluate the operator with evaluated address.
+ */
+	void evaluate_strict(mathexpr::value target, void** args, size_t nargs);
+	bool is_strict() { return true; }
+/**
+ * Memory reads are sources. The version changes when the memory last read changes.
+ */
+	bool is_source() { return true; }
+	uint64_t source_version();
 	//Fields.
 	unsigned bytes;		//Number of bytes to read.
 	bool signed_flag;	//Is signed?
@@ -38,6 +48,12 @@ struct memread_oper : public mathexpr::operinfo
 	uint64_t addr_base;	//Address base.
 	uint64_t addr_size;	//Address size (0 => All).
 	memory_space* mspace;	//Memory space to read.
+private:
+	void read(mathexpr::value target, mathexpr::value address);
+	bool last_valid;	//Has something been read?
+	uint64_t last_addr;	//Last address read.
+	char last_data[8];	//Last data read.
+	uint64_t version;	//Source version.
 };
 
 /**
@@ -72,7 +88,7 @@ struct item
  * Parameter t: The type of the result.
  */
 	item(mathexpr::typeinfo& t)
-		: expr(GC::obj_tag(), &t)
+		: expr(GC::obj_tag(), &t), cache_valid(false), sources_known(false)
 	{
 	}
 /**
@@ -89,6 +105,13 @@ struct item
 	GC::pointer<item_printer> printer;		//Printer to use.
 	GC::pointer<mathexpr::mathexpr> expr;	//Expression to watch.
 	std::string format;				//Formatting to use.
+private:
+	bool cache_hit();
+	bool cache_valid;				//cached_value is valid for source_versions.
+	bool sources_known;				//sources has been filled.
+	std::string cached_value;			//Value last shown.
+	std::vector<mathexpr::operinfo*> sources;	//Sources the expression depends on.
+	std::vector<uint64_t> source_versions;		//Versions of sources when cached_value was computed.
 };
 
 /**
@@ -0,0 +1,127 @@
+#ifndef _library__pagestore__hpp__included__
+#define _library__pagestore__hpp__included__
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+namespace pagestore
+{
+/**
+ * Size of one page.
+ */
+const size_t page_size = 4096;
+
+struct page;
+
+/**
+ * Immutable blob stored as a list of content-addressed pages.
+ *
+ * Pages with identical content are stored once in a process-wide store and shared between all snapshots (so e.g.
+ * hundreds of savestates of the same game only cost the pages that actually differ). Copying a snapshot only
+ * copies the page references.
+ *
+ * Methods are thread-safe.
+ */
+class snapshot
+{
+public:
+/**
+ * Create an empty snapshot.
+ */
+	snapshot() throw();
+/**
+ * Create a snapshot of data.
+ *
+ * Parameter data: The data to store.
+ * Parameter size: Size of data.
+ * Parameter hint: If not NULL, a previous snapshot likely similar to this one. Pages that are unchanged from the
+ *	hint are reused without hashing, so the cost is mostly proportional to the amount of changed data.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	snapshot(const char* data, size_t size, const snapshot* hint = NULL) throw(std::bad_alloc);
+/**
+ * Create a snapshot of data.
+ */
+	snapshot(const std::vector<char>& data, const snapshot* hint = NULL) throw(std::bad_alloc);
+/**
+ * Create a snapshot of data given as list of (pointer, size) spans. The data is the concatenation of the spans.
+ */
+	snapshot(const std::vector<std::pair<const char*, size_t>>& data, const snapshot* hint = NULL)
+		throw(std::bad_alloc);
+/**
+ * Copy constructor.
+ */
+	snapshot(const snapshot& s) throw(std::bad_alloc);
+/**
+ * Assignment operator.
+ */
+	snapshot& operator=(const snapshot& s) throw(std::bad_alloc);
+/**
+ * Destructor.
+ */
+	~snapshot() throw();
+/**
+ * Get size of the data.
+ */
+	size_t size() const throw() { return length; }
+/**
+ * Is empty?
+ */
+	bool empty() const throw() { return !length; }
+/**
+ * Get number of pages that were not reused from hint when creating.
+ */
+	size_t changed_pages() const throw() { return changed; }
+/**
+ * Read back the data.
+ *
+ * Parameter out: The data is written here. Any existing contents are replaced.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	void materialize(std::vector<char>& out) const throw(std::bad_alloc);
+/**
+ * Read back the data.
+ */
+	std::vector<char> materialize() const throw(std::bad_alloc);
+/**
+ * Get the data as list of (pointer, size) spans, without copying it.
+ *
+ * Parameter out: The spans are written here. Any existing contents are replaced. The spans stay valid as long as
+ *	this snapshot is neither modified nor destroyed.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	void get_spans(std::vector<std::pair<const char*, size_t>>& out) const throw(std::bad_alloc);
+/**
+ * Swap with another snapshot.
+ */
+	void swap(snapshot& s) throw();
+/**
+ * Drop the contents, becoming empty.
+ */
+	void clear() throw();
+private:
+	void init(const std::vector<std::pair<const char*, size_t>>& data, const snapshot* hint);
+	std::vector<page*> pages;
+	size_t length;
+	size_t changed;
+};
+
+/**
+ * Statistics of the page store.
+ */
+struct stats
+{
+	size_t unique_pages;		//Number of distinct pages stored.
+	size_t references;		//Total number of page references.
+};
+
+/**
+ * Get statistics of the page store.
+ */
+stats get_stats() throw();
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <list>
 #include <set>
 #include "json.hpp"
@@ -1113,10 +1114,25 @@ public:
 		if(x >= frames)
 			throw std::runtime_error("frame_vector::operator[]: Illegal index");
 		if(page != cache_page_num) {
-			cache_page = &pages[page];
+			cache_page = writable_page(page);
 			cache_page_num = page;
 		}
-		return frame(cache_page->content + pageoffset, *types, this);
+		return frame(cache_page + pageoffset, *types, this);
+	}
+/**
+ * Read a frame without unsharing the page it is on.
+ *
+ * Parameter x: The frame number.
+ * Returns: Copy of the frame, not linked to this vector.
+ * Throws std::runtime_error: Index out of range.
+ */
+	frame operator[](size_t x) const
+	{
+		size_t page = x / frames_per_page;
+		size_t pageoffset = frame_size * (x % frames_per_page);
+		if(x >= frames)
+			throw std::runtime_error("frame_vector::operator[]: Illegal index");
+		return frame(frame(const_cast<unsigned char*>(readable_page(page)) + pageoffset, *types));
 	}
 /**
  * Append a subframe.
@@ -1204,11 +1220,37 @@ public:
 /**
  * Get content of given page.
  */
-	unsigned char* get_page_buffer(size_t page) { return pages[page].content; }
+	unsigned char* get_page_buffer(size_t page) { return writable_page(page); }
 /**
  * Get content of given page.
  */
-	const unsigned char* get_page_buffer(size_t page) const { return pages.find(page)->second.content; }
+	const unsigned char* get_page_buffer(size_t page) const { return readable_page(page); }
+/**
+ * Serialize range of frames to text, one line terminated by '\n' per frame.
+ *
+ * The pages are read directly, so shared pages are not copied. Large ranges are split into chunks that are
+ * serialized in parallel.
+ *
+ * Parameter first: The first frame to serialize.
+ * Parameter count: Number of frames to serialize.
+ * Parameter out: The text is appended to this.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	void serialize_text(uint64_t first, uint64_t count, std::string& out) const throw(std::bad_alloc);
+/**
+ * Deserialize frames from text and append them, one frame per line.
+ *
+ * Only complete lines (terminated by '\n') are read. Trailing CRs are ignored and empty lines are skipped. The
+ * frames are decoded straight into the pages. Large text is split into line-aligned chunks that are decoded in
+ * parallel. On failure, no frames are appended.
+ *
+ * Parameter buf: The text.
+ * Parameter size: Size of the text in bytes.
+ * Returns: Number of bytes read (to end of last complete line).
+ * Throws std::bad_alloc: Not enough memory.
+ * Throws std::runtime_error: Bad serialized representation.
+ */
+	size_t deserialize_text(const char* buf, size_t size) throw(std::bad_alloc, std::runtime_error);
 /**
  * Get binary save size.
  *
@@ -1223,13 +1265,35 @@ public:
  */
 	void save_binary(binarystream::output& stream) const throw(std::runtime_error);
 /**
- * Load from binary form. May partially overwrite on failure.
+ * Load from binary form. The record is read at once and its pages are used as in adopt_binary().
  *
  * Parameter stream: The stream to load from.
  * Throws std::bad_alloc: Not enough memory.
  * Throws std::runtime_error: Error saving.
  */
 	void load_binary(binarystream::input& stream) throw(std::bad_alloc, std::runtime_error);
+/**
+ * Replace the contents with binary data in memory, without copying it.
+ *
+ * The data is shared by all copies of this vector and pages are copied out of it when written.
+ *
+ * Parameter data: The data, in binary save format. Kept alive as long as referenced, must not be modified.
+ * Parameter size: Size of the data in bytes.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	void adopt_binary(const std::shared_ptr<unsigned char>& data, size_t size) throw(std::bad_alloc);
+/**
+ * Replace the contents with binary data from file, mapping the file to memory if possible.
+ *
+ * The file must not be modified in place while the data is in use.
+ *
+ * Parameter fd: The file descriptor. May be closed after the call.
+ * Parameter offset: Offset of the data in file.
+ * Parameter size: Size of the data in bytes.
+ * Throws std::bad_alloc: Not enough memory.
+ * Throws std::runtime_error: Error reading the file.
+ */
+	void map_binary(int fd, uint64_t offset, uint64_t size) throw(std::bad_alloc, std::runtime_error);
 /**
  * Check that the movies are compatible up to a point.
  *
@@ -1323,30 +1387,31 @@ public:
 	};
 private:
 	friend class notify_freeze;
-	class page
+/**
+ * A page of frames. Pages are shared between copies of frame vector and copied when written to.
+ */
+	struct page
 	{
-	public:
-		page() {
-			memtracker::singleton()(movie_page_id, CONTROLLER_PAGE_SIZE + 36);
-			memset(content, 0, CONTROLLER_PAGE_SIZE);
-		}
-		~page() { memtracker::singleton()(movie_page_id, -CONTROLLER_PAGE_SIZE - 36); }
-		unsigned char content[CONTROLLER_PAGE_SIZE];
+		std::shared_ptr<unsigned char> content;
+		bool owned;		//Content is a heap page, as opposed to part of adopted memory.
 	};
+	unsigned char* writable_page(size_t page);
+	const unsigned char* readable_page(size_t page) const { return pages[page].content.get(); }
+	void add_pages(size_t count);
 	size_t frames_per_page;
 	size_t frame_size;
 	size_t frames;
 	const type_set* types;
-	size_t cache_page_num;
-	page* cache_page;
-	std::map<size_t, page> pages;
+	mutable size_t cache_page_num;
+	mutable unsigned char* cache_page;	//Only points to unshared pages.
+	std::vector<page> pages;
 	uint64_t real_frame_count;
 	uint64_t frame_count_at_freeze;
 	size_t freeze_count;
 	std::set<fchange_listener*> on_framecount_change;
 	size_t walk_helper(size_t frame, bool sflag) throw();
 	threads::lock mlock;
-	void clear_cache()
+	void clear_cache() const
 	{
 		cache_page_num = 0;
 		cache_page_num--;
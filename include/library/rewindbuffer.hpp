@@ -0,0 +1,185 @@
+#ifndef _library__rewindbuffer__hpp__included__
+#define _library__rewindbuffer__hpp__included__
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <stdexcept>
+
+namespace rewindbuffer
+{
+/**
+ * Encode a XOR delta between two buffers.
+ *
+ * The delta is a run-length encoding of the XOR of the buffers, with the shorter buffer padded with zeroes. Unchanged
+ * regions encode to few bytes.
+ *
+ * Parameter out: The delta is written here (replacing old contents).
+ * Parameter a: The first buffer.
+ * Parameter asize: Size of the first buffer.
+ * Parameter b: The second buffer.
+ * Parameter bsize: Size of the second buffer.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+void encode_delta(std::vector<char>& out, const char* a, size_t asize, const char* b, size_t bsize)
+	throw(std::bad_alloc);
+/**
+ * Apply a XOR delta to buffer.
+ *
+ * Parameter target: The buffer to modify.
+ * Parameter size: Size of the buffer. Must be at least the size of the larger buffer delta was encoded from.
+ * Parameter delta: The delta to apply.
+ * Throws std::runtime_error: The delta is corrupt or larger than the buffer.
+ */
+void apply_delta(char* target, size_t size, const std::vector<char>& delta) throw(std::runtime_error);
+
+/**
+ * Bounded-memory ring of states.
+ *
+ * The newest state is kept in full; each older state is kept as a compressed XOR delta against its successor. When
+ * memory budget is exceeded, the oldest states are dropped. Each state carries an auxillary value of type T.
+ */
+template<typename T>
+class ring
+{
+public:
+/**
+ * Create a new ring.
+ *
+ * Parameter _budget: The memory budget in bytes.
+ */
+	ring(size_t _budget) throw()
+		: budget(_budget), used(0), valid(false)
+	{
+	}
+/**
+ * Set the memory budget.
+ */
+	void set_budget(size_t _budget) throw()
+	{
+		budget = _budget;
+		trim();
+	}
+/**
+ * Get the memory budget.
+ */
+	size_t get_budget() const throw() { return budget; }
+/**
+ * Get approximate memory usage in bytes.
+ */
+	size_t memory_usage() const throw() { return used; }
+/**
+ * Get number of states stored.
+ */
+	size_t size() const throw() { return valid ? deltas.size() + 1 : 0; }
+/**
+ * Is empty?
+ */
+	bool empty() const throw() { return !valid; }
+/**
+ * Drop all states.
+ */
+	void clear() throw()
+	{
+		deltas.clear();
+		std::vector<char> tmp;
+		std::swap(newest, tmp);
+		valid = false;
+		used = 0;
+	}
+/**
+ * Add a new state.
+ *
+ * Parameter state: The state.
+ * Parameter aux: The auxillary value.
+ * Throws std::bad_alloc: Not enough memory.
+ */
+	void push(const std::vector<char>& state, const T& aux) throw(std::bad_alloc)
+	{
+		if(valid) {
+			deltas.push_back(entry());
+			entry& e = deltas.back();
+			try {
+				encode_delta(e.delta, newest.empty() ? NULL : &newest[0], newest.size(),
+					state.empty() ? NULL : &state[0], state.size());
+				e.size = newest.size();
+				e.aux = newest_aux;
+			} catch(...) {
+				deltas.pop_back();
+				throw;
+			}
+			used += e.delta.size() + sizeof(entry);
+			used -= newest.size();
+		}
+		newest = state;
+		newest_aux = aux;
+		used += newest.size();
+		valid = true;
+		trim();
+	}
+/**
+ * Get the auxillary value of newest state.
+ *
+ * Returns: The value, or NULL if ring is empty.
+ */
+	const T* peek() const throw() { return valid ? &newest_aux : NULL; }
+/**
+ * Remove the newest state.
+ *
+ * Parameter state: If not NULL, the state is written here.
+ * Parameter aux: If not NULL, the auxillary value is written here.
+ * Returns: True if state was removed, false if ring was empty.
+ * Throws std::bad_alloc: Not enough memory.
+ * Throws std::runtime_error: Delta is corrupt (the ring is cleared).
+ */
+	bool pop(std::vector<char>* state, T* aux) throw(std::bad_alloc, std::runtime_error)
+	{
+		if(!valid)
+			return false;
+		if(state) *state = newest;
+		if(aux) *aux = newest_aux;
+		if(deltas.empty()) {
+			clear();
+			return true;
+		}
+		entry& e = deltas.back();
+		used -= newest.size() + e.delta.size() + sizeof(entry);
+		if(newest.size() < e.size)
+			newest.resize(e.size);
+		try {
+			apply_delta(newest.empty() ? NULL : &newest[0], newest.size(), e.delta);
+		} catch(...) {
+			clear();
+			throw;
+		}
+		newest.resize(e.size);
+		newest_aux = e.aux;
+		used += newest.size();
+		deltas.pop_back();
+		return true;
+	}
+private:
+	struct entry
+	{
+		std::vector<char> delta;	//Delta from successor to this state.
+		size_t size;			//Size of this state.
+		T aux;				//Auxillary value of this state.
+	};
+	void trim() throw()
+	{
+		while(used > budget && !deltas.empty()) {
+			used -= deltas.front().delta.size() + sizeof(entry);
+			deltas.pop_front();
+		}
+	}
+	size_t budget;
+	size_t used;
+	bool valid;
+	std::deque<entry> deltas;
+	std::vector<char> newest;
+	T newest_aux;
+};
+}
+
+#endif
@@ -9,7 +9,6 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
-#include <set>
 
 
 class rrdata_set
@@ -78,6 +77,10 @@ public:
  */
 		unsigned operator-(const struct instance& m) const throw();
 	};
+/**
+ * Sorted list of disjoint, non-adjacent half-open intervals of load IDs.
+ */
+	typedef std::vector<std::pair<instance, instance>> interval_list;
 /**
  * State block for emergency save.
  */
@@ -87,14 +90,14 @@ public:
 		{
 			initialized = false;
 		}
-		void init(const std::set<std::pair<instance, instance>>& obj)
+		void init(const interval_list& obj)
 		{
 			if(initialized) return;
 			initialized = true;
-			itr = obj.begin();
-			eitr = obj.end();
+			itr = 0;
+			eitr = obj.size();
 		}
-		std::set<std::pair<instance, instance>>::const_iterator next()
+		size_t next()
 		{
 			if(itr == eitr) return itr;
 			return itr++;
@@ -113,8 +116,8 @@ public:
 		instance pred;
 	private:
 		bool initialized;
-		std::set<std::pair<instance, instance>>::const_iterator itr;
-		std::set<std::pair<instance, instance>>::const_iterator eitr;
+		size_t itr;
+		size_t eitr;
 	};
 /**
  * Ctor
@@ -147,6 +150,8 @@ public:
 /**
  * Write compressed representation of current load ID set to stream.
  *
+ * The representation is cached, and only the intervals changed since the last write are encoded again.
+ *
  * parameter strm: The stream to write to.
  * returns: Rerecord count.
  * throws std::bad_alloc: Not enough memory.
@@ -201,17 +206,22 @@ public:
 	void debug_add(const instance& b, const instance& e) { return _add(b, e); }
 	bool debug_in_set(const instance& b) { return _in_set(b); }
 	bool debug_in_set(const instance& b, const instance& e) { return _in_set(b, e); }
-	uint64_t debug_nodecount(std::set<std::pair<instance, instance>>& set);
+	uint64_t debug_nodecount(interval_list& set);
 private:
 	bool _add(const instance& b);
 	void _add(const instance& b, const instance& e);
-	void _add(const instance& b, const instance& e, std::set<std::pair<instance, instance>>& set,
-		uint64_t& cnt);
+	static size_t _add(const instance& b, const instance& e, interval_list& set, uint64_t& cnt);
+	void set_dirty(size_t index) { if(index < wcache_dirty) wcache_dirty = index; }
 	bool _in_set(const instance& b) { return _in_set(b, b + 1); }
 	bool _in_set(const instance& b, const instance& e);
 	uint64_t emerg_action(struct esave_state& state, char* buf, size_t bufsize, uint64_t& scount) const;
 
-	std::set<std::pair<instance, instance>> data;
+	interval_list data;
+	//Encoded intervals, offset of each encoded interval and symbols up to the end of each.
+	std::vector<char> wcache;
+	std::vector<size_t> wcache_offset;
+	std::vector<uint64_t> wcache_symbols;
+	size_t wcache_dirty;		//First interval that might not match wcache.
 	std::ofstream ohandle;
 	bool handle_open;
 	std::string current_projectfile;
@@ -0,0 +1,135 @@
+#ifndef _library__spscring__hpp__included__
+#define _library__spscring__hpp__included__
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/**
+ * Wait-free single-producer single-consumer ring buffer.
+ *
+ * One thread may write (write(), space()) and one other thread may read (peek(), consume(), read(), fill()) at the
+ * same time without locking. Other operations may not run concurrently with either.
+ */
+template<typename T>
+class spsc_ring
+{
+public:
+/**
+ * Create a new ring.
+ *
+ * Parameter capacity: The capacity in elements. Rounded up to power of two.
+ */
+	spsc_ring(size_t capacity)
+	{
+		size_t c = 1;
+		while(c < capacity)
+			c <<= 1;
+		buffer.resize(c);
+		mask = c - 1;
+		put = 0;
+		get = 0;
+	}
+/**
+ * Get the capacity.
+ */
+	size_t capacity() const throw() { return mask + 1; }
+/**
+ * Get number of elements available for reading. Safe to call from either thread.
+ */
+	size_t fill() const throw()
+	{
+		return put.load(std::memory_order_acquire) - get.load(std::memory_order_acquire);
+	}
+/**
+ * Get number of elements that can be written. Safe to call from either thread.
+ */
+	size_t space() const throw() { return capacity() - fill(); }
+/**
+ * Write elements (producer).
+ *
+ * Parameter data: The elements to write.
+ * Parameter count: Number of elements to write.
+ * Returns: Number of elements written (less than count if the ring is full).
+ */
+	size_t write(const T* data, size_t count) throw()
+	{
+		size_t p = put.load(std::memory_order_relaxed);
+		size_t g = get.load(std::memory_order_acquire);
+		if(count > capacity() - (p - g))
+			count = capacity() - (p - g);
+		copy_in(p, data, count);
+		put.store(p + count, std::memory_order_release);
+		return count;
+	}
+/**
+ * Read elements without removing them (consumer).
+ *
+ * Parameter data: The elements are written here.
+ * Parameter count: Maximum number of elements to read.
+ * Returns: Number of elements read.
+ */
+	size_t peek(T* data, size_t count) const throw()
+	{
+		size_t g = get.load(std::memory_order_relaxed);
+		size_t p = put.load(std::memory_order_acquire);
+		if(count > p - g)
+			count = p - g;
+		copy_out(g, data, count);
+		return count;
+	}
+/**
+ * Remove elements (consumer).
+ *
+ * Parameter count: Number of elements to remove. Must not exceed fill().
+ */
+	void consume(size_t count) throw()
+	{
+		get.store(get.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+/**
+ * Read and remove elements (consumer).
+ *
+ * Parameter data: The elements are written here.
+ * Parameter count: Maximum number of elements to read.
+ * Returns: Number of elements read.
+ */
+	size_t read(T* data, size_t count) throw()
+	{
+		count = peek(data, count);
+		consume(count);
+		return count;
+	}
+/**
+ * Drop all elements. Neither producer nor consumer may be active.
+ */
+	void clear() throw()
+	{
+		put = 0;
+		get = 0;
+	}
+private:
+	spsc_ring(const spsc_ring<T>&);
+	spsc_ring<T>& operator=(const spsc_ring<T>&);
+	void copy_in(size_t pos, const T* data, size_t count)
+	{
+		size_t off = pos & mask;
+		size_t first = (count < capacity() - off) ? count : capacity() - off;
+		memcpy(&buffer[off], data, sizeof(T) * first);
+		memcpy(&buffer[0], data + first, sizeof(T) * (count - first));
+	}
+	void copy_out(size_t pos, T* data, size_t count) const
+	{
+		size_t off = pos & mask;
+		size_t first = (count < capacity() - off) ? count : capacity() - off;
+		memcpy(data, &buffer[off], sizeof(T) * first);
+		memcpy(data + first, &buffer[0], sizeof(T) * (count - first));
+	}
+	std::vector<T> buffer;
+	size_t mask;
+	std::atomic<size_t> put;	//Total elements written, only modified by producer.
+	std::atomic<size_t> get;	//Total elements read, only modified by consumer.
+};
+
+#endif
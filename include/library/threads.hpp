@@ -2,6 +2,7 @@
 #define _library_threads__hpp__included__
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 #ifdef NATIVE_THREADS
@@ -65,6 +66,19 @@ void lock_multiple(std::initializer_list<lock*> locks);
 void unlock_multiple(std::initializer_list<lock*> locks);
 void unlock_multiple(std::vector<lock*> locks);
 
+/**
+ * Run fn(i) for each i from 0 to count - 1, spread across threads. The threads are shared by all callers, and
+ * kept running once started. If the threads are already in use, or there is only one thread, runs the items in
+ * calling thread.
+ *
+ * Parameter count: Number of items.
+ * Parameter fn: The function to run for each item. May be called from multiple threads at once.
+ * Parameter nthreads: Maximum number of threads (including calling thread), 0 for number of CPUs.
+ * Throws: Whatever fn throws. The first exception thrown is rethrown after running items stop, and items not yet
+ *	started are skipped.
+ */
+void parallel_for(size_t count, const std::function<void(size_t i)>& fn, unsigned nthreads = 0);
+
 class alock_multiple
 {
 public:
@@ -2,6 +2,7 @@
 #define _library__zip__hpp__included__
 
 #include <boost/iostreams/filtering_stream.hpp>
+#include <deque>
 #include <iostream>
 #include <iterator>
 #include <string>
@@ -335,6 +336,9 @@ bool file_exists(const std::string& name) throw(std::bad_alloc);
 
 /**
  * This class handles writing a ZIP archives.
+ *
+ * Closed members are compressed by background threads (if there are multiple cores) and written to the archive in
+ * the order they were created.
  */
 class writer
 {
@@ -344,7 +348,7 @@ public:
  *
  * parameter zipfile: The zipfile to create.
  * parameter stream: The stream to write the ZIP to.
- * parameter _compression: Compression. 0 is uncompressed, 1-9 are deflate compression levels.
+ * parameter _compression: Compression. 0 is uncompressed, 1-9 are deflate compression levels (higher means 9).
  * throws std::bad_alloc: Not enough memory.
  * throws std::runtime_error: Can't open archive or invalid argument.
  */
@@ -418,7 +422,33 @@ public:
 	{
 		write_linefile(member, (stringfmt() << value).str());
 	}
+/**
+ * Enable or disable splitting large members into blocks that are deflated in parallel. Enabled by default.
+ *
+ * The result is a valid deflate stream, but compresses slightly worse than deflating the member in one piece.
+ */
+	void set_block_parallel(bool enable) throw() { block_parallel = enable; }
+/**
+ * Set number of threads compressing members.
+ *
+ * Parameter nthreads: Number of threads, 0 for number of CPUs (the default).
+ */
+	void set_threads(unsigned nthreads) throw() { max_threads = nthreads; }
+/**
+ * Size of blocks in block-parallel compression.
+ */
+	const static size_t parallel_blocksize = 1 << 20;
 private:
+	struct pending_file
+	{
+		std::string name;
+		std::vector<char> data;
+		std::vector<std::vector<char>> blocks;
+		std::vector<uint32_t> crcs;
+	};
+	void compress_block(pending_file& f, size_t block);
+	void write_member(pending_file& f);
+	void write_pending();
 	struct file_info
 	{
 		uint32_t crc;
@@ -435,12 +465,17 @@ private:
 	std::string zipfile_path;
 	std::string open_file;
 	uint32_t base_offset;
-	std::vector<char> current_compressed_file;
+	std::vector<char> current_file;
 	std::map<std::string, file_info> files;
 	unsigned compression;
 	boost::iostreams::filtering_ostream* s;
 	uint32_t basepos;
 	bool committed;
+	bool block_parallel;
+	unsigned max_threads;
+	//Members not yet written, in order.
+	std::deque<pending_file*> pending;
+	size_t pending_bytes;
 };
 }
 #endif
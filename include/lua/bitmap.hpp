@@ -103,17 +103,23 @@ struct lua_loaded_bitmap
 template<bool T> class lua_bitmap_holder
 {
 public:
-	lua_bitmap_holder(lua_bitmap& _b, lua_palette& _p) : b(_b), p(_p) {};
+	lua_bitmap_holder(lua_bitmap& _b, lua_palette& _p) : b(_b), p(&_p) {};
+	//Use copy of palette, which needs no locking.
+	lua_bitmap_holder(lua_bitmap& _b, framebuffer::color* _palette, size_t _pallim)
+		: b(_b), p(NULL), palette(_palette), pallim(_pallim) {};
 	size_t stride() { return b.width; }
 	void lock()
 	{
-		p.palette_mutex.lock();
-		palette = p.colors;
-		pallim = p.color_count;
+		if(!p)
+			return;
+		p->palette_mutex.lock();
+		palette = p->colors;
+		pallim = p->color_count;
 	}
 	void unlock()
 	{
-		p.palette_mutex.unlock();
+		if(p)
+			p->palette_mutex.unlock();
 	}
 	void draw(size_t bmpidx, typename framebuffer::fb<T>::element_t& target)
 	{
@@ -123,7 +129,7 @@ public:
 	}
 private:
 	lua_bitmap& b;
-	lua_palette& p;
+	lua_palette* p;
 	framebuffer::color* palette;
 	size_t pallim;
 };
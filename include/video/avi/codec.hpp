@@ -5,6 +5,7 @@
 #include <vector>
 #include <cstdlib>
 #include <map>
+#include <deque>
 #include "video/avi/structure.hpp"
 #include "video/avi/samplequeue.hpp"
 #include "video/avi/timer.hpp"
@@ -103,6 +104,22 @@ struct avi_video_codec
  * Parameter w: Amount of workwaiting by dumper.
  */
 	virtual void send_performance_counters(uint64_t b, uint64_t w);
+/**
+ * Get the keyframe interval.
+ *
+ * Returns: The codec emits a keyframe every this many frames after reset (and no other keyframes), or 0 if
+ *	unknown. Default implementation returns 0.
+ *
+ * Note: If this is nonzero, groups of frames may be compressed in parallel by separate instances of the codec.
+ *	All packets for a frame must then be readable right after frame() (until ready() returns true), and not be
+ *	held back to later frames. Any number of packets per frame, including none, is fine.
+ */
+	virtual unsigned keyframe_interval();
+/**
+ * Flush the video state. After this, packets for all frames sent so far can be read. Default implementation does
+ * nothing.
+ */
+	virtual void flush();
 };
 
 /**
@@ -287,6 +304,8 @@ struct avi_output_stream
  */
 	void end();
 private:
+	void write_video_packets();
+	void write_audio_packet(const avi_packet& pkt);
 	bool in_segment;
 	avi_file_structure avifile;
 	avi_video_codec* vcodec;
@@ -294,6 +313,11 @@ private:
 	uint16_t achans;
 	timer video_timer;
 	timer audio_timer;
+	//Video codec may return packets late. Audio packets are held until video packets for the same frame are
+	//written, in order to keep the streams interleaved.
+	uint64_t video_frames_in;
+	uint64_t video_packets_out;
+	std::deque<std::pair<uint64_t, avi_packet>> held_audio;
 };
 
 #endif
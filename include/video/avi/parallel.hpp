@@ -0,0 +1,73 @@
+#ifndef _avi__avi_parallel__hpp__included__
+#define _avi__avi_parallel__hpp__included__
+
+#include <deque>
+#include <string>
+#include "video/avi/codec.hpp"
+#include "library/threads.hpp"
+
+/**
+ * Video codec compressing keyframe-delimited groups of frames in parallel.
+ *
+ * Each group of frames is handed to one of the worker threads, each with its own instance of the real codec, which
+ * is reset at the start of every group. The packets are read back in the original order. If the real codec does not
+ * report a keyframe interval, or there is only one thread, the frames are passed through to single instance.
+ */
+class avi_parallel_codec : public avi_video_codec
+{
+public:
+/**
+ * Create a new parallel codec.
+ *
+ * Parameter type: The type of real codec. The instances are created in calling thread.
+ * Parameter threads: Number of worker threads.
+ * Parameter maxbuffer: Maximum amount of frame data to buffer, in bytes.
+ */
+	avi_parallel_codec(avi_video_codec_type& type, unsigned threads, size_t maxbuffer);
+	~avi_parallel_codec();
+	avi_video_codec::format reset(uint32_t width, uint32_t height, uint32_t fps_n, uint32_t fps_d);
+	void frame(uint32_t* data, uint32_t stride);
+	bool ready();
+	avi_packet getpacket();
+	void send_performance_counters(uint64_t b, uint64_t w);
+	unsigned keyframe_interval();
+	void flush();
+private:
+	struct worker;
+	struct group
+	{
+		worker* w;			//The worker compressing the group.
+		size_t frames;			//Frames still to be compressed.
+		size_t packets;			//Packets compressed but not yet read.
+	};
+	struct job
+	{
+		bool reset;			//Reset the codec before this frame.
+		group* g;			//The group the frame is in.
+		std::vector<uint32_t> data;	//The frame, stride is width.
+	};
+	avi_parallel_codec(const avi_parallel_codec&);
+	avi_parallel_codec& operator=(const avi_parallel_codec&);
+	void worker_loop(worker& w);
+	void check_error();
+	static void* worker_trampoline(worker* w);
+	std::vector<worker*> workers;
+	std::deque<group> groups;		//Groups in output order.
+	bool parallel;
+	bool quitting;
+	size_t current;				//Worker taking the open group.
+	unsigned group_size;
+	unsigned group_left;			//Frames still to send to the open group.
+	size_t queued_frames;
+	size_t max_queued;
+	size_t maxbuffer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps_n;
+	uint32_t fps_d;
+	std::string error;
+	threads::lock mlock;
+	threads::cv condition;
+};
+
+#endif
@@ -48,6 +48,18 @@ public:
 	{
 		sample2<0>(a...);
 	}
+
+/**
+ * Dump a block of 16-bit samples.
+ *
+ * parameter samples: The samples, interleaved if stereo.
+ * parameter count: Number of samples (per channel).
+ * parameter stereo: If true, samples are stereo, otherwise mono (sent to both of the first two channels).
+ *
+ * throws std::bad_alloc: Not enough memory
+ * throws std::runtime_error: Error writing .sox file
+ */
+	void samples(const int16_t* samples, size_t count, bool stereo) throw(std::bad_alloc, std::runtime_error);
 private:
 	template<size_t o>
 	void sample2()
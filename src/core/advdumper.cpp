@@ -2,6 +2,7 @@
 #include "core/instance.hpp"
 #include "core/misc.hpp"
 #include "library/globalwrap.hpp"
+#include "library/minmax.hpp"
 #include "library/string.hpp"
 #include "lua/lua.hpp"
 
@@ -180,6 +181,12 @@ dumper_base::~dumper_base() throw()
 	mdumper->statuschange();
 }
 
+void dumper_base::on_sample(short l, short r)
+{
+	int16_t s[2] = {l, r};
+	on_samples(s, 1, true);
+}
+
 master_dumper::notifier::~notifier() throw()
 {
 }
@@ -190,6 +197,7 @@ master_dumper::master_dumper(lua_state& _lua2)
 	current_rate_n = 48000;
 	current_rate_d = 1;
 	output = &std::cerr;
+	frame_seq = 0;
 }
 
 dumper_base* master_dumper::get_instance(dumper_factory_base* f) throw()
@@ -257,6 +265,7 @@ unsigned master_dumper::get_dumper_count() throw()
 void master_dumper::on_frame(struct framebuffer::raw& _frame, uint32_t fps_n, uint32_t fps_d)
 {
 	threads::arlock h(lock);
+	frame_seq++;
 	for(auto i : sdumpers)
 		try {
 			i->on_frame(_frame, fps_n, fps_d);
@@ -265,18 +274,33 @@ void master_dumper::on_frame(struct framebuffer::raw& _frame, uint32_t fps_n, ui
 		} catch(...) {
 			(*output) << "Error in on_frame: <unknown error>" << std::endl;
 		}
+	//Forget the variants nobody wanted this frame (dumpers may still hold the buffers).
+	for(auto i = hud_cache.begin(); i != hud_cache.end();)
+		if(i->second.frame != frame_seq)
+			hud_cache.erase(i++);
+		else
+			i++;
 }
 
 void master_dumper::on_sample(short l, short r)
+{
+	int16_t s[2] = {l, r};
+	on_samples(s, 1, true);
+}
+
+void master_dumper::on_samples(const int16_t* samples, size_t count, bool stereo)
 {
 	threads::arlock h(lock);
 	for(auto i : sdumpers)
 		try {
+			//Skip the samples of dropped frames from start of the block.
+			size_t skip = 0;
 			if(__builtin_expect(i->samples_killed, 0)) {
-				i->samples_killed--;
-				continue;
+				skip = min(i->samples_killed, (uint64_t)count);
+				i->samples_killed -= skip;
 			}
-			i->on_sample(l, r);
+			if(skip < count)
+				i->on_samples(samples + (stereo ? 2 : 1) * skip, count - skip, stereo);
 		} catch(std::exception& e) {
 			(*output) << "Error in on_sample: " << e.what() << std::endl;
 		} catch(...) {
@@ -368,6 +392,33 @@ template<bool X> bool master_dumper::render_video_hud(struct framebuffer::fb<X>&
 	return !lua_kill_video;
 }
 
+template<bool X> std::shared_ptr<const framebuffer::fb<X>> master_dumper::render_video_hud_shared(
+	struct framebuffer::raw& source, uint32_t hscl, uint32_t vscl, uint32_t lgap, uint32_t tgap, uint32_t rgap,
+	uint32_t bgap)
+{
+	threads::arlock h(lock);
+	hud_key k = {X, hscl, vscl, lgap, tgap, rgap, bgap};
+	hud_entry& e = hud_cache[k];
+	std::shared_ptr<framebuffer::fb<X>>& buf = hud_buffer(e, (framebuffer::fb<X>*)NULL, 0);
+	std::shared_ptr<framebuffer::fb<X>>& spare = hud_buffer(e, (framebuffer::fb<X>*)NULL, 1);
+	if(e.frame != frame_seq || !buf) {
+		//If a dumper still holds the previous frame (e.g. encoding it), render to the spare buffer and keep
+		//the previous frame as the spare. A buffer is only reused if no dumper holds it anymore.
+		if(buf && buf.use_count() > 1) {
+			std::swap(buf, spare);
+			if(buf && buf.use_count() > 1)
+				buf.reset();
+		}
+		if(!buf)
+			buf.reset(new framebuffer::fb<X>());
+		e.killed = !render_video_hud(*buf, source, hscl, vscl, lgap, tgap, rgap, bgap, NULL);
+		e.frame = frame_seq;
+	}
+	if(e.killed)
+		return std::shared_ptr<const framebuffer::fb<X>>();
+	return buf;
+}
+
 uint64_t master_dumper::killed_audio_length(uint32_t fps_n, uint32_t fps_d, double& fraction)
 {
 	auto r = get_rate();
@@ -383,3 +434,9 @@ template bool master_dumper::render_video_hud(struct framebuffer::fb<false>& tar
 template bool master_dumper::render_video_hud(struct framebuffer::fb<true>& target, struct framebuffer::raw& source,
 	uint32_t hscl, uint32_t vscl, uint32_t lgap, uint32_t tgap, uint32_t rgap, uint32_t bgap,
 	std::function<void()> fn);
+template std::shared_ptr<const framebuffer::fb<false>> master_dumper::render_video_hud_shared(
+	struct framebuffer::raw& source, uint32_t hscl, uint32_t vscl, uint32_t lgap, uint32_t tgap, uint32_t rgap,
+	uint32_t bgap);
+template std::shared_ptr<const framebuffer::fb<true>> master_dumper::render_video_hud_shared(
+	struct framebuffer::raw& source, uint32_t hscl, uint32_t vscl, uint32_t lgap, uint32_t tgap, uint32_t rgap,
+	uint32_t bgap);
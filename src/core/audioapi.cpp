@@ -1,8 +1,12 @@
+#include "cmdhelp/sound.hpp"
 #include "core/advdumper.hpp"
 #include "core/audioapi.hpp"
+#include "core/command.hpp"
 #include "core/dispatch.hpp"
 #include "core/framerate.hpp"
 #include "core/instance.hpp"
+#include "core/messages.hpp"
+#include "core/runmode.hpp"
 #include "library/minmax.hpp"
 #include "library/threads.hpp"
 
@@ -12,8 +16,9 @@
 #include <unistd.h>
 #include <sys/time.h>
 
-#define MUSIC_BUFFERS 8
-#define MAX_VOICE_ADJUST 200
+//Relative music rate adjustment per relative fill level error, and the maximum adjustment.
+#define MUSIC_ADJUST_GAIN 0.005
+#define MAX_MUSIC_ADJUST 0.005
 
 bool audioapi_instance::vu_disabled = false;
 
@@ -44,6 +49,25 @@ int audioapi_instance::dummy_cb_proc::operator()()
 
 namespace
 {
+	command::fnptr<> CMD_audio_status(lsnes_cmds, CSOUND::status,
+		[]() throw(std::bad_alloc, std::runtime_error) {
+			audioapi_instance::stats s = CORE().audio->get_stats();
+			messages << "Music: " << s.music_fill << " samples buffered (";
+			if(s.music_rate)
+				messages << (1000 * s.music_fill / s.music_rate) << "ms, ";
+			messages << "target " << s.music_target << "), rate adjust " << (1e6 * s.music_adjust)
+				<< "ppm" << std::endl;
+			messages << "Music: " << s.music_underruns << " underrun(s), " << s.music_silence
+				<< " samples of silence, " << s.music_dropped << " samples dropped" << std::endl;
+			messages << "Voice: " << s.voice_underruns << " samples of playback underrun, "
+				<< s.voicer_dropped << " recorded samples dropped" << std::endl;
+		});
+
+	command::fnptr<> CMD_audio_status_reset(lsnes_cmds, CSOUND::statusreset,
+		[]() throw(std::bad_alloc, std::runtime_error) {
+			CORE().audio->reset_stats();
+		});
+
 //  | -1  1 -1  1 | 1  0  0  0 |
 //  |  0  0  0  1 | 0  1  0  0 |
 //  |  1  1  1  1 | 0  0  1  0 |
@@ -104,20 +128,16 @@ exit:
 }
 
 audioapi_instance::audioapi_instance()
-	: dummyproc(*this)
-{
-	music_ptr = 0;
-	last_complete_music_seen = MUSIC_BUFFERS + 1;
-	last_complete_music = MUSIC_BUFFERS;
-	for(unsigned i = 0; i < MUSIC_BUFFERS; i++) {
-		music_size[i] = 0;
-		music_rate[i] = 48000;
-		music_stereo[i] = false;
-	}
-	voicep_get = 0;
-	voicep_put = 0;
-	voicer_get = 0;
-	voicer_put = 0;
+	: dummyproc(*this), voicep_ring(voicep_bufsize), voicer_ring(voicer_bufsize), music_ring(music_bufsize)
+{
+	music_rate = 48000;
+	music_block = 0;
+	music_fill_avg = 0;
+	music_target = 0;
+	music_adjust = 0;
+	music_running = false;
+	music_suppressed = false;
+	reset_stats();
 	voice_rate_play = 40000;
 	orig_voice_rate_play = 40000;
 	voice_rate_rec = 40000;
@@ -127,7 +147,6 @@ audioapi_instance::audioapi_instance()
 	_music_volume = 1;
 	_voicep_volume = 32767.0;
 	_voicer_volume = 1.0/32768;
-	last_adjust = false;
 }
 
 audioapi_instance::~audioapi_instance()
@@ -161,187 +180,122 @@ void audioapi_instance::voice_rate(unsigned rate_rec, unsigned rate_play)
 
 unsigned audioapi_instance::voice_p_status()
 {
-	unsigned p = voicep_put;
-	unsigned g = voicep_get;
-	if(g > p)
-		return g - p - 1;
-	else
-		return voicep_bufsize - (p - g) - 1;
+	return voicep_ring.space();
 }
 
 unsigned audioapi_instance::voice_p_status2()
 {
-	unsigned p = voicep_put;
-	unsigned g = voicep_get;
-	if(g > p)
-		return voicep_bufsize - (g - p);
-	else
-		return (p - g);
+	return voicep_ring.fill();
 }
 
 unsigned audioapi_instance::voice_r_status()
 {
-	unsigned p = voicer_put;
-	unsigned g = voicer_get;
-	if(g > p)
-		return voicer_bufsize - (g - p);
-	else
-		return (p - g);
+	return voicer_ring.fill();
 }
 
 void audioapi_instance::play_voice(float* samples, size_t count)
 {
-	unsigned ptr = voicep_put;
-	for(size_t i = 0; i < count; i++) {
-		voicep_buffer[ptr++] = samples[i];
-		if(ptr == voicep_bufsize)
-			ptr = 0;
-	}
-	voicep_put = ptr;
+	voicep_ring.write(samples, count);
 }
 
 void audioapi_instance::record_voice(float* samples, size_t count)
 {
-	unsigned ptr = voicer_get;
-	for(size_t i = 0; i < count; i++) {
-		samples[i] = voicer_buffer[ptr++];
-		if(ptr == voicer_bufsize)
-			ptr = 0;
-	}
-	voicer_get = ptr;
+	size_t got = voicer_ring.read(samples, count);
+	for(size_t i = got; i < count; i++)
+		samples[i] = 0.0;
 }
 
 void audioapi_instance::submit_buffer(int16_t* samples, size_t count, bool stereo, double rate)
 {
-	if(stereo)
-		for(unsigned i = 0; i < count; i++)
-			CORE().mdumper->on_sample(samples[2 * i + 0], samples[2 * i + 1]);
-	else
-		for(unsigned i = 0; i < count; i++)
-			CORE().mdumper->on_sample(samples[i], samples[i]);
-	//Limit buffers to avoid overrunning.
-	if(count > music_bufsize / (stereo ? 2 : 1))
-		count = music_bufsize / (stereo ? 2 : 1);
-	unsigned bidx = last_complete_music;
-	bidx = (bidx > (MUSIC_BUFFERS - 2)) ? 0 : bidx + 1;
-	memcpy(music_buffer + bidx * music_bufsize, samples, count * (stereo ? 2 : 1) * sizeof(int16_t));
-	music_stereo[bidx] = stereo;
-	music_rate[bidx] = rate;
-	music_size[bidx] = count;
-	last_complete_music = bidx;
-}
-
-struct audioapi_instance::buffer audioapi_instance::get_music(size_t played)
-{
-	unsigned midx = last_complete_music_seen;
-	unsigned midx2 = last_complete_music;
-	if(midx2 >= MUSIC_BUFFERS) {
-		//Special case: No buffer.
-		struct buffer out;
-		out.samples = NULL;
-		out.pointer = 0;
-		//The rest are arbitrary.
-		out.total = 64;
-		out.stereo = false;
-		out.rate = 48000;
-		return out;
+	CORE().mdumper->on_samples(samples, count, stereo);
+	music_rate = rate;
+	music_block = count;
+	//Turbo seek does not play the sound (it is still dumped above).
+	music_suppressed = CORE().runmode->is_turbo_seek();
+	if(music_suppressed)
+		return;
+	//Whatever does not fit is dropped, the consumer is far behind anyway.
+	size_t space = music_ring.space() / 2;
+	if(count > space) {
+		music_dropped += count - space;
+		count = space;
 	}
-	//Handle ACK. If the current buffer is too old, we want to ignore the ACK.
-	if(midx >= MUSIC_BUFFERS) {
-		//Load initial buffer.
-		midx = last_complete_music_seen = 0;
-		music_ptr = 0;
-	} else {
-		music_ptr += played;
-		//Otherwise, check if current buffer is not next on the line to be overwritten.
-		if((midx2 + 1) % MUSIC_BUFFERS == midx) {
-			//It is, bump buffer by one.
-			if(!last_adjust && voice_rate_play > orig_voice_rate_play - MAX_VOICE_ADJUST)
-				voice_rate_play--;
-			last_adjust = true;
-			midx = last_complete_music_seen = (midx + 1) % MUSIC_BUFFERS;
-			music_ptr = 0;
-		} else if(music_ptr >= music_size[midx] && midx != midx2) {
-			//It isn't, but current buffer is finished.
-			midx = last_complete_music_seen = (midx + 1) % MUSIC_BUFFERS;
-			music_ptr = 0;
-			last_adjust = false;
-		} else if(music_ptr >= music_size[midx] && midx == midx2) {
-			if(!last_adjust && voice_rate_play < orig_voice_rate_play + MAX_VOICE_ADJUST)
-				voice_rate_play++;
-			last_adjust = true;
-			//Current buffer is finished, but there is no new buffer.
-			//Send silence.
-		} else {
-			last_adjust = false;
-			//Can continue.
+	if(stereo)
+		music_ring.write(samples, 2 * count);
+	else {
+		//The buffer is always stereo.
+		int16_t tmp[512];
+		for(size_t i = 0; i < count; i += 256) {
+			size_t n = min(count - i, (size_t)256);
+			for(size_t j = 0; j < n; j++)
+				tmp[2 * j + 0] = tmp[2 * j + 1] = samples[i + j];
+			music_ring.write(tmp, 2 * n);
 		}
 	}
-	//Fill the structure.
-	struct buffer out;
-	if(music_ptr < music_size[midx]) {
-		out.samples = music_buffer + midx * music_bufsize;
-		out.pointer = music_ptr;
-		out.total = music_size[midx];
-		out.stereo = music_stereo[midx];
-		out.rate = music_rate[midx];
-	} else {
-		//Run out of buffers to play.
-		out.samples = NULL;
-		out.pointer = 0;
-		out.total = 64;		//Arbitrary.
-		out.stereo = music_stereo[midx];
-		out.rate = music_rate[midx];
-		if(out.rate < 100)
-			out.rate = 48000;	//Apparently there are buffers with zero rate.
+}
+
+double audioapi_instance::music_ratio(size_t request)
+{
+	double in_rate = music_rate;
+	if(in_rate < 100)
+		in_rate = 48000;	//Apparently there are buffers with zero rate.
+	double nominal = voice_rate_play / in_rate;
+	//Keep enough buffered to cover one submitted block and two requests.
+	size_t target = music_block + 2 * (request / nominal + 1);
+	size_t fill = music_ring.fill() / 2;
+	if(fill > 4 * target) {
+		//Way behind (e.g. after fast-forward). Skip ahead instead of slowly catching up.
+		music_ring.consume(2 * (fill - target));
+		music_dropped += fill - target;
+		music_fill_avg = fill = target;
 	}
-	return out;
+	music_fill_avg += (fill - music_fill_avg) / 16;
+	//Play slightly faster if there is too much buffered and slightly slower if too little, instead of skipping
+	//or repeating blocks.
+	double adjust = (music_fill_avg - target) / target * MUSIC_ADJUST_GAIN;
+	adjust = max(min(adjust, MAX_MUSIC_ADJUST), -MAX_MUSIC_ADJUST);
+	music_target = target;
+	music_adjust = adjust;
+	return nominal / (1 + adjust);
 }
 
 void audioapi_instance::get_voice(float* samples, size_t count)
 {
-	unsigned g = voicep_get;
-	unsigned p = voicep_put;
+	size_t got;
 	if(samples) {
-		for(size_t i = 0; i < count; i++) {
-			if(g != p)
-				samples[i] = _voicep_volume * voicep_buffer[g++];
-			else
-				samples[i] = 0.0;
-			if(g == voicep_bufsize)
-				g = 0;
-		}
+		got = voicep_ring.read(samples, count);
+		for(size_t i = 0; i < got; i++)
+			samples[i] *= _voicep_volume;
+		for(size_t i = got; i < count; i++)
+			samples[i] = 0.0;
 	} else {
-		for(size_t i = 0; i < count; i++) {
-			if(g != p)
-				g++;
-			if(g == voicep_bufsize)
-				g = 0;
-		}
+		got = min(count, voicep_ring.fill());
+		voicep_ring.consume(got);
 	}
-	voicep_get = g;
+	//Voice running out in middle of request is underrun, no voice at all is just silence.
+	if(got && got < count)
+		voice_underruns += count - got;
 }
 
 void audioapi_instance::put_voice(float* samples, size_t count)
 {
-	unsigned ptr = voicer_put;
 	vu_vin(samples, count, false, voice_rate_rec, _voicer_volume);
-	for(size_t i = 0; i < count; i++) {
-		voicer_buffer[ptr++] = samples ? _voicer_volume * samples[i] : 0.0;
-		if(ptr == voicer_bufsize)
-			ptr = 0;
+	float tmp[256];
+	for(size_t i = 0; i < count; i += 256) {
+		size_t n = min(count - i, (size_t)256);
+		for(size_t j = 0; j < n; j++)
+			tmp[j] = samples ? _voicer_volume * samples[i + j] : 0.0;
+		voicer_dropped += n - voicer_ring.write(tmp, n);
 	}
-	voicer_put = ptr;
 }
 
 void audioapi_instance::init()
 {
-	voicep_get = 0;
-	voicep_put = 0;
-	voicer_get = 0;
-	voicer_put = 0;
-	last_complete_music = 3;
-	last_complete_music_seen = 4;
+	voicep_ring.clear();
+	voicer_ring.clear();
+	music_ring.clear();
+	music_fill_avg = 0;
+	music_running = false;
 	dummy_cb_active_play = true;
 	dummy_cb_active_record = true;
 	dummy_cb_quit = false;
@@ -390,79 +344,79 @@ float audioapi_instance::voicer_volume()
 void audioapi_instance::get_mixed(int16_t* samples, size_t count, bool stereo)
 {
 	const size_t intbuf_size = 256;
+	int16_t rawbuf[intbuf_size];
 	float intbuf[intbuf_size];
 	float intbuf2[intbuf_size];
+	double ratio = music_ratio(count);
 	while(count > 0) {
-		buffer b = get_music(0);
-		float* in = intbuf;
-		float* out = intbuf2;
+		size_t outdata = min(intbuf_size / 2, count);
 		size_t outdata_used;
-		if(b.stereo) {
-			size_t indata = min(b.total - b.pointer, intbuf_size / 2);
-			size_t outdata = min(intbuf_size / 2, count);
-			size_t indata_used = indata;
-			outdata_used = outdata;
-			if(b.samples)
-				for(size_t i = 0; i < 2 * indata; i++)
-					intbuf[i] = _music_volume * b.samples[i + 2 * b.pointer];
-			else
-				for(size_t i = 0; i < 2 * indata; i++)
-					intbuf[i] = 0;
-			music_resampler.resample(in, indata, out, outdata, (double)voice_rate_play / b.rate, true);
-			indata_used -= indata;
-			outdata_used -= outdata;
-			get_music(indata_used);
-			get_voice(intbuf, outdata_used);
-
-			vu_mleft(intbuf2, outdata_used, true, voice_rate_play, 1 / 32768.0);
-			vu_mright(intbuf2 + 1, outdata_used, true, voice_rate_play, 1 / 32768.0);
-			vu_vout(intbuf, outdata_used, false, voice_rate_play, 1 / 32768.0);
-
-			for(size_t i = 0; i < outdata_used * (stereo ? 2 : 1); i++)
-				intbuf2[i] = max(min(intbuf2[i] + intbuf[i / 2], 32766.0f), -32767.0f);
-			if(stereo)
-				for(size_t i = 0; i < outdata_used * 2; i++)
-					samples[i] = intbuf2[i];
-			else
-				for(size_t i = 0; i < outdata_used; i++)
-					samples[i] = (intbuf2[2 * i + 0] + intbuf2[2 * i + 1]) / 2;
+		size_t indata = music_ring.peek(rawbuf, intbuf_size) / 2;
+		if(indata) {
+			music_running = true;
+			for(size_t i = 0; i < 2 * indata; i++)
+				intbuf[i] = _music_volume * rawbuf[i];
+			float* in = intbuf;
+			float* out = intbuf2;
+			size_t inleft = indata;
+			size_t outleft = outdata;
+			music_resampler.resample(in, inleft, out, outleft, ratio, true);
+			music_ring.consume(2 * (indata - inleft));
+			outdata_used = outdata - outleft;
 		} else {
-			size_t indata = min(b.total - b.pointer, intbuf_size);
-			size_t outdata = min(intbuf_size, count);
-			size_t indata_used = indata;
+			//Out of music, play silence. Not an underrun if the emulator is not sending sound.
+			if(music_running && !music_suppressed)
+				music_underruns++;
+			music_running = false;
+			if(!music_suppressed)
+				music_silence += outdata;
+			for(size_t i = 0; i < 2 * outdata; i++)
+				intbuf2[i] = 0;
 			outdata_used = outdata;
-			if(b.samples)
-				for(size_t i = 0; i < indata; i++)
-					intbuf[i] = _music_volume * b.samples[i + b.pointer];
-			else
-				for(size_t i = 0; i < indata; i++)
-					intbuf[i] = 0;
-			music_resampler.resample(in, indata, out, outdata, (double)voice_rate_play / b.rate, false);
-			indata_used -= indata;
-			outdata_used -= outdata;
-			get_music(indata_used);
-			get_voice(intbuf, outdata_used);
-
-			vu_mleft(intbuf2, outdata_used, false, voice_rate_play, 1 / 32768.0);
-			vu_mright(intbuf2, outdata_used, false, voice_rate_play, 1 / 32768.0);
-			vu_vout(intbuf, outdata_used, false, voice_rate_play, 1 / 32768.0);
+		}
+		get_voice(intbuf, outdata_used);
 
+		vu_mleft(intbuf2, outdata_used, true, voice_rate_play, 1 / 32768.0);
+		vu_mright(intbuf2 + 1, outdata_used, true, voice_rate_play, 1 / 32768.0);
+		vu_vout(intbuf, outdata_used, false, voice_rate_play, 1 / 32768.0);
+
+		for(size_t i = 0; i < 2 * outdata_used; i++)
+			intbuf2[i] = max(min(intbuf2[i] + intbuf[i / 2], 32766.0f), -32767.0f);
+		if(stereo)
+			for(size_t i = 0; i < outdata_used * 2; i++)
+				samples[i] = intbuf2[i];
+		else
 			for(size_t i = 0; i < outdata_used; i++)
-				intbuf2[i] = max(min(intbuf2[i] + intbuf[i], 32766.0f), -32767.0f);
-			if(stereo)
-				for(size_t i = 0; i < outdata_used; i++) {
-					samples[2 * i + 0] = intbuf2[i];
-					samples[2 * i + 1] = intbuf2[i];
-				}
-			else
-				for(size_t i = 0; i < outdata_used; i++)
-					samples[i] = intbuf2[i];
-		}
+				samples[i] = (intbuf2[2 * i + 0] + intbuf2[2 * i + 1]) / 2;
 		samples += (stereo ? 2 : 1) * outdata_used;
 		count -= outdata_used;
 	}
 }
 
+audioapi_instance::stats audioapi_instance::get_stats()
+{
+	stats s;
+	s.music_underruns = music_underruns;
+	s.music_silence = music_silence;
+	s.music_dropped = music_dropped;
+	s.voice_underruns = voice_underruns;
+	s.voicer_dropped = voicer_dropped;
+	s.music_fill = music_ring.fill() / 2;
+	s.music_target = music_target;
+	s.music_rate = music_rate;
+	s.music_adjust = music_adjust;
+	return s;
+}
+
+void audioapi_instance::reset_stats()
+{
+	music_underruns = 0;
+	music_silence = 0;
+	music_dropped = 0;
+	voice_underruns = 0;
+	voicer_dropped = 0;
+}
+
 audioapi_instance::vumeter::vumeter()
 {
 	accumulator = 0;
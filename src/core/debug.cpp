@@ -27,6 +27,7 @@ namespace
 		case debug_context::DEBUG_EXEC: return 4;
 		case debug_context::DEBUG_TRACE: return 8;
 		case debug_context::DEBUG_FRAME: return 0;
+		case debug_context::DEBUG_TRACE_RAW: return 16;
 		default: throw std::runtime_error("Invalid debug callback type");
 		}
 	}
@@ -34,28 +35,29 @@ namespace
 
 namespace
 {
-	template<class T> void kill_hooks(T& cblist, debug_context::etype type)
+	void kill_hooks(debug_context::cb_table& cblist, debug_context::etype type)
 	{
-		while(!cblist.empty()) {
-			if(cblist.begin()->second.empty()) {
-				cblist.erase(cblist.begin()->first);
-				continue;
-			}
-			auto key = cblist.begin()->first;
-			auto tmp = cblist.begin()->second.begin();
-			(*tmp)->killed(key, type);
-			cblist.begin()->second.erase(cblist.begin()->second.begin());
-		}
-		cblist.clear();
+		cblist.kill_all([type](uint64_t addr, debug_context::callback_base* cb) {
+			cb->killed(addr, type);
+		});
+	}
+
+	void run_hooks(const debug_context::cb_table::list* cblist, const debug_context::params& p)
+	{
+		if(!cblist) return;
+		for(auto i : *cblist)
+			i->callback(p);
 	}
 }
 
 debug_context::debug_context(emulator_dispatch& _dispatch, loaded_rom& _rom, memory_space& _mspace,
 	command::group& _cmd)
-	: edispatch(_dispatch), rom(_rom), mspace(_mspace), cmd(_cmd),
+	: read_cb(all_addresses), write_cb(all_addresses), exec_cb(all_addresses), trace_cb(all_addresses),
+	frame_cb(all_addresses), trace_raw_cb(all_addresses), edispatch(_dispatch), rom(_rom), mspace(_mspace), cmd(_cmd),
 	showhooks(cmd, CDEBUG::scb, [this]() { this->do_showhooks(); }),
 	genevent(cmd, CDEBUG::genevt, [this](const std::string& a) { this->do_genevent(a); }),
-	tracecmd(cmd, CDEBUG::tr, [this](const std::string& a) { this->do_tracecmd(a); })
+	tracecmd(cmd, CDEBUG::tr, [this](const std::string& a) { this->do_tracecmd(a, false); }),
+	tracebincmd(cmd, CDEBUG::trb, [this](const std::string& a) { this->do_tracecmd(a, true); })
 {
 }
 
@@ -68,93 +70,88 @@ const uint64_t debug_context::all_addresses = 0xFFFFFFFFFFFFFFFFULL;
 void debug_context::add_callback(uint64_t addr, debug_context::etype type, debug_context::callback_base& cb)
 {
 	auto& core = CORE();
-	std::map<uint64_t, cb_list>& xcb = get_lists(type);
+	cb_table& xcb = get_lists(type);
 	if(!corechange_r) {
 		corechange.set(edispatch.core_change, [this]() { this->core_change(); });
 		corechange_r = true;
 	}
-	if(!xcb.count(addr) && type != DEBUG_FRAME)
+	if(type == DEBUG_FRAME) addr = 0;
+	if(xcb.add(addr, &cb) && type != DEBUG_FRAME)
 		core.rom->set_debug_flags(addr, debug_flag(type), 0);
-	auto& lst = xcb[addr];
-	lst.push_back(&cb);
 }
 
 void debug_context::remove_callback(uint64_t addr, debug_context::etype type, debug_context::callback_base& cb)
 {
-	std::map<uint64_t, cb_list>& xcb = get_lists(type);
+	cb_table& xcb = get_lists(type);
 	if(type == DEBUG_FRAME) addr = 0;
-	if(!xcb.count(addr)) return;
-	auto& l = xcb[addr];
-	for(auto i = l.begin(); i != l.end(); i++) {
-		if(*i == &cb) {
-			l.erase(i);
-			break;
-		}
-	}
-	if(xcb[addr].empty()) {
-		xcb.erase(addr);
-		if(type != DEBUG_FRAME)
-			rom.set_debug_flags(addr, 0, debug_flag(type));
-	}
+	if(xcb.remove(addr, &cb) && type != DEBUG_FRAME)
+		rom.set_debug_flags(addr, 0, debug_flag(type));
 }
 
 void debug_context::do_callback_read(uint64_t addr, uint64_t value)
 {
+	if(!read_cb.maybe(addr)) return;
 	params p;
 	p.type = DEBUG_READ;
 	p.rwx.addr = addr;
 	p.rwx.value = value;
 
 	requesting_break = false;
-	cb_list* cb1 = read_cb.count(all_addresses) ? &read_cb[all_addresses] : &dummy_cb;
-	cb_list* cb2 = read_cb.count(addr) ? &read_cb[addr] : &dummy_cb;
-	auto _cb1 = *cb1;
-	auto _cb2 = *cb2;
-	for(auto& i : _cb1) i->callback(p);
-	for(auto& i : _cb2) i->callback(p);
+	{
+		cb_table::guard g(read_cb);
+		auto cb1 = read_cb.wildcard();
+		auto cb2 = read_cb.lookup(addr);
+		run_hooks(cb1, p);
+		run_hooks(cb2, p);
+	}
 	if(requesting_break)
 		do_break_pause();
 }
 
 void debug_context::do_callback_write(uint64_t addr, uint64_t value)
 {
+	if(!write_cb.maybe(addr)) return;
 	params p;
 	p.type = DEBUG_WRITE;
 	p.rwx.addr = addr;
 	p.rwx.value = value;
 
 	requesting_break = false;
-	cb_list* cb1 = write_cb.count(all_addresses) ? &write_cb[all_addresses] : &dummy_cb;
-	cb_list* cb2 = write_cb.count(addr) ? &write_cb[addr] : &dummy_cb;
-	auto _cb1 = *cb1;
-	auto _cb2 = *cb2;
-	for(auto& i : _cb1) i->callback(p);
-	for(auto& i : _cb2) i->callback(p);
+	{
+		cb_table::guard g(write_cb);
+		auto cb1 = write_cb.wildcard();
+		auto cb2 = write_cb.lookup(addr);
+		run_hooks(cb1, p);
+		run_hooks(cb2, p);
+	}
 	if(requesting_break)
 		do_break_pause();
 }
 
 void debug_context::do_callback_exec(uint64_t addr, uint64_t cpu)
 {
+	if(!exec_cb.maybe(addr)) return;
 	params p;
 	p.type = DEBUG_EXEC;
 	p.rwx.addr = addr;
 	p.rwx.value = cpu;
 
 	requesting_break = false;
-	cb_list* cb1 = exec_cb.count(all_addresses) ? &exec_cb[all_addresses] : &dummy_cb;
-	cb_list* cb2 = exec_cb.count(addr) ? &exec_cb[addr] : &dummy_cb;
-	auto _cb1 = *cb1;
-	auto _cb2 = *cb2;
-	if((1ULL << cpu) & xmask)
-		for(auto& i : _cb1) i->callback(p);
-	for(auto& i : _cb2) i->callback(p);
+	{
+		cb_table::guard g(exec_cb);
+		auto cb1 = exec_cb.wildcard();
+		auto cb2 = exec_cb.lookup(addr);
+		if((1ULL << cpu) & xmask)
+			run_hooks(cb1, p);
+		run_hooks(cb2, p);
+	}
 	if(requesting_break)
 		do_break_pause();
 }
 
 void debug_context::do_callback_trace(uint64_t cpu, const char* str, bool true_insn)
 {
+	if(!trace_cb.maybe(cpu)) return;
 	params p;
 	p.type = DEBUG_TRACE;
 	p.trace.cpu = cpu;
@@ -162,23 +159,36 @@ void debug_context::do_callback_trace(uint64_t cpu, const char* str, bool true_i
 	p.trace.true_insn = true_insn;
 
 	requesting_break = false;
-	cb_list* cb = trace_cb.count(cpu) ? &trace_cb[cpu] : &dummy_cb;
-	auto _cb = *cb;
-	for(auto& i : _cb) i->callback(p);
+	{
+		cb_table::guard g(trace_cb);
+		run_hooks(trace_cb.lookup(cpu), p);
+	}
 	if(requesting_break)
 		do_break_pause();
 }
 
+void debug_context::do_callback_trace_raw(uint64_t cpu, const binarytrace::insn& insn)
+{
+	if(!trace_raw_cb.maybe(cpu)) return;
+	params p;
+	p.type = DEBUG_TRACE_RAW;
+	p.trace_raw.cpu = cpu;
+	p.trace_raw.insn = &insn;
+
+	cb_table::guard g(trace_raw_cb);
+	run_hooks(trace_raw_cb.lookup(cpu), p);
+}
+
 void debug_context::do_callback_frame(uint64_t frame, bool loadstate)
 {
+	current_frame = frame;
 	params p;
 	p.type = DEBUG_FRAME;
 	p.frame.frame = frame;
 	p.frame.loadstated = loadstate;
 
-	cb_list* cb = frame_cb.count(0) ? &frame_cb[0] : &dummy_cb;
-	auto _cb = *cb;
-	for(auto& i : _cb) i->callback(p);
+	cb_table::guard g(frame_cb);
+	run_hooks(frame_cb.lookup(0), p);
 }
 
 void debug_context::set_cheat(uint64_t addr, uint64_t value)
@@ -213,6 +223,7 @@ void debug_context::core_change()
 	kill_hooks(write_cb, DEBUG_WRITE);
 	kill_hooks(exec_cb, DEBUG_EXEC);
 	kill_hooks(trace_cb, DEBUG_TRACE);
+	kill_hooks(trace_raw_cb, DEBUG_TRACE_RAW);
 }
 
 void debug_context::request_break()
@@ -223,16 +234,54 @@ void debug_context::request_break()
 debug_context::tracelog_file::tracelog_file(debug_context& _parent)
 	: parent(_parent)
 {
+	binary = NULL;
+	last_frame = 0xFFFFFFFFFFFFFFFFULL;
 }
 
 debug_context::tracelog_file::~tracelog_file()
 {
+	delete binary;
+}
+
+void debug_context::tracelog_file::binary_frame()
+{
+	if(parent.current_frame == last_frame)
+		return;
+	binary->frame(parent.current_frame);
+	last_frame = parent.current_frame;
+}
+
+void debug_context::tracelog_file::binary_error(std::exception& e)
+{
+	//Called from inside the core, so don't throw. Stop writing the file instead.
+	messages << "Error writing trace '" << full_filename << "': " << e.what() << std::endl;
+	delete binary;
+	binary = NULL;
+	stream.setstate(std::ios::badbit);
 }
 
 void debug_context::tracelog_file::callback(const debug_context::params& p)
 {
+	if(p.type == DEBUG_TRACE_RAW) {
+		if(!binary) return;
+		try {
+			binary_frame();
+			binary->instruction(p.trace_raw.cpu, *p.trace_raw.insn);
+		} catch(std::exception& e) {
+			binary_error(e);
+		}
+		return;
+	}
 	if(!parent.trace_outputs.count(p.trace.cpu)) return;
-	parent.trace_outputs[p.trace.cpu]->stream << p.trace.decoded_insn << std::endl;
+	if(binary) {
+		try {
+			binary_frame();
+			binary->text(p.trace.cpu, p.trace.decoded_insn, p.trace.true_insn);
+		} catch(std::exception& e) {
+			binary_error(e);
+		}
+	} else if(stream)
+		stream << p.trace.decoded_insn << "\n";
 }
 
 void debug_context::tracelog_file::killed(uint64_t addr, debug_context::etype type)
@@ -242,12 +291,14 @@ void debug_context::tracelog_file::killed(uint64_t addr, debug_context::etype ty
 		delete this;
 }
 
-void debug_context::tracelog(uint64_t proc, const std::string& filename)
+void debug_context::tracelog(uint64_t proc, const std::string& filename, bool binary,
+	const std::string& compression)
 {
 	if(filename == "") {
 		if(!trace_outputs.count(proc))
 			return;
-		remove_callback(proc, DEBUG_TRACE, *trace_outputs[proc]);
+		remove_callback(proc, trace_outputs[proc]->types[proc], *trace_outputs[proc]);
+		trace_outputs[proc]->types.erase(proc);
 		trace_outputs[proc]->refcnt--;
 		if(!trace_outputs[proc]->refcnt)
 			delete trace_outputs[proc];
@@ -261,6 +312,8 @@ void debug_context::tracelog(uint64_t proc, const std::string& filename)
 	bool found = false;
 	for(auto i : trace_outputs) {
 		if(i.second->full_filename == full_filename) {
+			if((i.second->binary != NULL) != binary)
+				throw std::runtime_error("'" + full_filename + "' is already used by another trace type");
 			i.second->refcnt++;
 			trace_outputs[proc] = i.second;
 			found = true;
@@ -271,15 +324,32 @@ void debug_context::tracelog(uint64_t proc, const std::string& filename)
 		trace_outputs[proc] = new tracelog_file(*this);
 		trace_outputs[proc]->refcnt = 1;
 		trace_outputs[proc]->full_filename = full_filename;
-		trace_outputs[proc]->stream.open(full_filename);
-		if(!trace_outputs[proc]->stream) {
+		try {
+			if(binary)
+				trace_outputs[proc]->binary = new binarytrace::writer(full_filename, compression);
+			else {
+				trace_outputs[proc]->stream.open(full_filename);
+				if(!trace_outputs[proc]->stream)
+					throw std::runtime_error("Can't open '" + full_filename + "'");
+			}
+		} catch(...) {
 			delete trace_outputs[proc];
 			trace_outputs.erase(proc);
-			throw std::runtime_error("Can't open '" + full_filename + "'");
+			throw;
 		}
 	}
 	try {
-		add_callback(proc, DEBUG_TRACE, *trace_outputs[proc]);
+		etype type = DEBUG_TRACE;
+		if(binary) {
+			//Use raw instruction events if the core has those for this CPU, textual ones otherwise.
+			binarytrace::cpu_info info;
+			if(rom.get_raw_trace_info(proc, info))
+				type = DEBUG_TRACE_RAW;
+			auto cpus = rom.get_trace_cpus();
+			trace_outputs[proc]->binary->cpu(proc, (proc < cpus.size()) ? cpus[proc] : "", info);
+		}
+		add_callback(proc, type, *trace_outputs[proc]);
+		trace_outputs[proc]->types[proc] = type;
 	} catch(std::exception& e) {
 		messages << "Error starting tracelogging: " << e.what() << std::endl;
 		trace_outputs[proc]->refcnt--;
@@ -294,24 +364,24 @@ void debug_context::tracelog(uint64_t proc, const std::string& filename)
 
 void debug_context::do_showhooks()
 {
-	for(auto& i : read_cb)
-		for(auto& j : i.second)
-			messages << "READ addr=" << mspace.address_to_textual(i.first) << " handle=" << &j
-				<< std::endl;
-	for(auto& i : write_cb)
-		for(auto& j : i.second)
-			messages << "WRITE addr=" << mspace.address_to_textual(i.first) << " handle=" << &j
-				<< std::endl;
-	for(auto& i : exec_cb)
-		for(auto& j : i.second)
-			messages << "EXEC addr=" << mspace.address_to_textual(i.first) << " handle=" << &j
-				<< std::endl;
-	for(auto& i : trace_cb)
-		for(auto& j : i.second)
-			messages << "TRACE proc=" << i.first << " handle=" << &j << std::endl;
-	for(auto& i : frame_cb)
-		for(auto& j : i.second)
-			messages << "FRAME handle=" << &j << std::endl;
+	read_cb.for_each([this](uint64_t addr, callback_base* cb) {
+		messages << "READ addr=" << mspace.address_to_textual(addr) << " handle=" << cb << std::endl;
+	});
+	write_cb.for_each([this](uint64_t addr, callback_base* cb) {
+		messages << "WRITE addr=" << mspace.address_to_textual(addr) << " handle=" << cb << std::endl;
+	});
+	exec_cb.for_each([this](uint64_t addr, callback_base* cb) {
+		messages << "EXEC addr=" << mspace.address_to_textual(addr) << " handle=" << cb << std::endl;
+	});
+	trace_cb.for_each([](uint64_t proc, callback_base* cb) {
+		messages << "TRACE proc=" << proc << " handle=" << cb << std::endl;
+	});
+	frame_cb.for_each([](uint64_t addr, callback_base* cb) {
+		messages << "FRAME handle=" << cb << std::endl;
+	});
+	trace_raw_cb.for_each([](uint64_t proc, callback_base* cb) {
+		messages << "TRACE_RAW proc=" << proc << " handle=" << cb << std::endl;
+	});
 }
 
 void debug_context::do_genevent(const std::string& args)
@@ -338,12 +408,14 @@ void debug_context::do_genevent(const std::string& args)
 		throw std::runtime_error("Invalid operation");
 }
 
-void debug_context::do_tracecmd(const std::string& args)
+void debug_context::do_tracecmd(const std::string& args, bool binary)
 {
-	regex_results r = regex("([^ \t]+)([ \t]+(.+))?", args);
+	regex_results r = binary ? regex("([^ \t]+)([ \t]+([^ \t]+)([ \t]+([^ \t]+))?)?", args) :
+		regex("([^ \t]+)([ \t]+(.+))?", args);
 	if(!r) throw std::runtime_error("tracelog: Bad arguments");
 	std::string cpu = r[1];
 	std::string filename = r[3];
+	std::string compression = binary ? r[5] : "";
 	uint64_t _cpu = 0;
 	for(auto i : rom.get_trace_cpus()) {
 		if(cpu == i)
@@ -352,5 +424,5 @@ void debug_context::do_tracecmd(const std::string& args)
 	}
 	throw std::runtime_error("tracelog: Invalid CPU");
 out:
-	tracelog(_cpu, filename);
+	tracelog(_cpu, filename, binary, compression);
 }
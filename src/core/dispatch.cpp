@@ -12,7 +12,7 @@ emulator_dispatch::emulator_dispatch()
 	title_change("title_change"), branch_change("branch_change"), mbranch_change("mbranch_change"),
 	core_changed("core_changed"), voice_stream_change("voice_stream_change"),
 	vu_change("vu_change"), subtitle_change("subtitle_change"), multitrack_change("multitrack_change"),
-	action_update("action_update")
+	action_update("action_update"), save_complete("save_complete")
 {
 }
 
@@ -37,6 +37,7 @@ void emulator_dispatch::set_error_streams(std::ostream* stream)
 	branch_change.errors_to(stream);
 	mbranch_change.errors_to(stream);
 	action_update.errors_to(stream);
+	save_complete.errors_to(stream);
 }
 
 dispatch::source<> notify_new_core("new_core");
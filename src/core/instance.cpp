@@ -25,6 +25,7 @@
 #include "core/random.hpp"
 #include "core/rom.hpp"
 #include "core/runmode.hpp"
+#include "core/savewriter.hpp"
 #include "core/settings.hpp"
 #include "fonts/wrapper.hpp"
 #include "library/command.hpp"
@@ -114,6 +115,7 @@ emulator_instance::emulator_instance()
 	D.init(framerate, *command);
 	D.init(mdumper, *lua2);
 	D.init(runmode);
+	D.init(swriter, *iqueue, *dispatch);
 	D.init(supdater, *project, *mlogic, *commentary, *status, *runmode, *mdumper, *jukebox, *slotcache,
 	       *framerate, *controls, *mteditor, *lua2, *rom, *mwatch, *dispatch);
 
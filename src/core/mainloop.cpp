@@ -26,12 +26,14 @@
 #include "core/random.hpp"
 #include "core/rom.hpp"
 #include "core/runmode.hpp"
+#include "core/savewriter.hpp"
 #include "core/settings.hpp"
 #include "core/window.hpp"
 #include "interface/callbacks.hpp"
 #include "interface/c-interface.hpp"
 #include "interface/romtype.hpp"
 #include "library/framebuffer.hpp"
+#include "library/rewindbuffer.hpp"
 #include "library/settingvar.hpp"
 #include "library/string.hpp"
 #include "library/zip.hpp"
@@ -59,6 +61,10 @@ namespace
 		"advance-subframe-timeout", "Delays‣Subframe advance", 100);
 	settingvar::supervariable<settingvar::model_bool<settingvar::yes_no>> SET_pause_on_end(lsnes_setgrp,
 		"pause-on-end", "Movie‣Pause on end", false);
+	settingvar::supervariable<settingvar::model_int<0,65535>> SET_rewind_buffer(lsnes_setgrp,
+		"rewind-buffer", "Movie‣Rewind‣Buffer size (MB)", 0);
+	settingvar::supervariable<settingvar::model_int<1,3600>> SET_rewind_interval(lsnes_setgrp,
+		"rewind-interval", "Movie‣Rewind‣Capture interval (frames)", 1);
 
 	//Mode and filename of pending load, one of LOAD_* constants.
 	int loadmode;
@@ -69,12 +75,38 @@ namespace
 	//Unsafe rewind.
 	bool do_unsafe_rewind = false;
 	void* unsafe_rewind_obj = NULL;
+	//Native rewind.
+	struct rewind_point
+	{
+		uint64_t frame;
+		uint64_t ptr;
+		uint64_t lagged;
+		std::vector<uint32_t> pollcounters;
+		int64_t rtc_second;
+		int64_t rtc_subsecond;
+		bool poll_flag;
+	};
+	rewindbuffer::ring<rewind_point> rewind_ring(0);
+	bool rewind_held = false;
+	bool rewind_unpaused = false;
+	bool rewind_rerecorded = false;
 	//Stop at frame.
 	bool stop_at_frame_active = false;
 	uint64_t stop_at_frame = 0;
+	//Turbo seek start.
+	uint64_t seek_start_frame = 0;
+	uint64_t seek_start_time = 0;
 	//Macro hold.
 	bool macro_hold_1;
 	bool macro_hold_2;
+
+	void report_turbo_seek(emulator_instance& core)
+	{
+		uint64_t frames = core.mlogic->get_movie().get_current_frame() - seek_start_frame;
+		uint64_t t = framerate_regulator::get_utime() - seek_start_time;
+		messages << "Turbo seek: " << frames << " frames in " << (t / 1000) << "ms ("
+			<< (t ? 1000000.0 * frames / t : 0.0) << " fps)" << std::endl;
+	}
 }
 
 void mainloop_signal_need_rewind(void* ptr)
@@ -94,7 +126,7 @@ bool movie_logic::notify_user_poll() throw(std::bad_alloc, std::runtime_error)
 portctrl::frame movie_logic::update_controls(bool subframe, bool forced) throw(std::bad_alloc, std::runtime_error)
 {
 	auto& core = CORE();
-	if(core.lua2->requests_subframe_paint)
+	if(core.lua2->requests_subframe_paint && !core.runmode->is_turbo_seek())
 		core.fbuf->redraw_framebuffer();
 
 	if(subframe) {
@@ -154,6 +186,8 @@ portctrl::frame movie_logic::update_controls(bool subframe, bool forced) throw(s
 			}
 		} else if(core.runmode->is_freerunning() && stop_at_frame_active) {
 			if(core.mlogic->get_movie().get_current_frame() >= stop_at_frame) {
+				if(core.runmode->is_turbo_seek())
+					report_turbo_seek(core);
 				stop_at_frame_active = false;
 				core.runmode->set_pause();
 				platform::set_paused(true);
@@ -175,6 +209,12 @@ portctrl::frame movie_logic::update_controls(bool subframe, bool forced) throw(s
 
 namespace
 {
+	//Skip drawing this frame? The last frame before stop is drawn, as it will be on screen while paused.
+	bool skip_frame_output(emulator_instance& core)
+	{
+		return core.runmode->is_turbo_seek() && stop_at_frame_active &&
+			core.mlogic->get_movie().get_current_frame() + 1 < stop_at_frame;
+	}
 
 	//Do pending load (automatically unpauses).
 	void mark_pending_load(std::string filename, int lmode)
@@ -282,7 +322,8 @@ public:
 		auto& core = CORE();
 		core.lua2->callback_do_frame_emulated();
 		core.runmode->set_point(emulator_runmode::P_VIDEO);
-		core.fbuf->redraw_framebuffer(screen, false, true);
+		if(!skip_frame_output(core))
+			core.fbuf->redraw_framebuffer(screen, false, true);
 		auto rate = core.rom->get_audio_rate();
 		uint32_t gv = gcd(fps_n, fps_d);
 		uint32_t ga = gcd(rate.first, rate.second);
@@ -314,6 +355,11 @@ public:
 	{
 		CORE().dbg->do_callback_trace(proc, str, insn);
 	}
+
+	void memory_trace_raw(uint64_t proc, const binarytrace::insn& i)
+	{
+		CORE().dbg->do_callback_trace_raw(proc, i);
+	}
 };
 
 namespace
@@ -350,6 +396,48 @@ namespace
 			messages << x << " rerecord(s)" << std::endl;
 		});
 
+	void report_savestate_speed(const char* what, uint64_t count, uint64_t usec)
+	{
+		messages << what << ": " << (usec ? 1000000.0 * count / usec : 0.0) << " savestates/s ("
+			<< (double)usec / count << "us each)" << std::endl;
+	}
+
+	command::fnptr<const std::string&> CMD_benchmark_savestates(lsnes_cmds, "benchmark-savestates",
+		"Benchmark savestates", "Syntax: benchmark-savestates [<count>]\nSaves and loads the current core state "
+		"<count> (default 100) times and reports the speed.\n",
+		[](const std::string& args) throw(std::bad_alloc, std::runtime_error) {
+			auto& core = CORE();
+			uint64_t count = (args != "") ? parse_value<uint64_t>(args) : 100;
+			if(!count)
+				throw std::runtime_error("Count must be positive");
+			if(core.rom->isnull())
+				throw std::runtime_error("No ROM loaded");
+			std::vector<char> state = core.rom->save_core_state(true);
+			messages << "Savestate size: " << state.size() << " bytes" << std::endl;
+			uint64_t t = framerate_regulator::get_utime();
+			for(uint64_t i = 0; i < count; i++)
+				core.rom->save_core_state(true);
+			report_savestate_speed("Save", count, framerate_regulator::get_utime() - t);
+			t = framerate_regulator::get_utime();
+			for(uint64_t i = 0; i < count; i++)
+				core.rom->save_core_state(false);
+			report_savestate_speed("Save with checksum", count, framerate_regulator::get_utime() - t);
+			t = framerate_regulator::get_utime();
+			for(uint64_t i = 0; i < count; i++)
+				core.rom->save_core_state_paged(true);
+			report_savestate_speed("Save paged", count, framerate_regulator::get_utime() - t);
+			pagestore::snapshot paged = core.rom->save_core_state_paged(true);
+			t = framerate_regulator::get_utime();
+			for(uint64_t i = 0; i < count; i++)
+				core.rom->load_core_state(paged, true);
+			report_savestate_speed("Load paged", count, framerate_regulator::get_utime() - t);
+			//Loading the plain state last leaves the core where it was.
+			t = framerate_regulator::get_utime();
+			for(uint64_t i = 0; i < count; i++)
+				core.rom->load_core_state(state, true);
+			report_savestate_speed("Load", count, framerate_regulator::get_utime() - t);
+		});
+
 	command::fnptr<const std::string&> CMD_quit_emulator(lsnes_cmds, "quit-emulator", "Quit the emulator",
 		"Syntax: quit-emulator [/y]\nQuits emulator (/y => don't ask for confirmation).\n",
 		[](const std::string& args) throw(std::bad_alloc, std::runtime_error) {
@@ -369,6 +457,20 @@ namespace
 			platform::cancel_wait();
 		});
 
+	command::fnptr<const std::string&> CMD_turbo_seek(lsnes_cmds, "turbo-seek", "Seek to frame quickly",
+		"Syntax: turbo-seek <frame>\nRuns to <frame> as fast as possible without drawing the screen or playing "
+		"sound, then pauses.\n",
+		[](const std::string& args) throw(std::bad_alloc, std::runtime_error) {
+			auto& core = CORE();
+			uint64_t frame = parse_value<uint64_t>(args);
+			if(core.runmode->is_special())
+				return;
+			if(frame <= core.mlogic->get_movie().get_current_frame())
+				throw std::runtime_error("Already past that frame");
+			set_stop_at_frame(frame, true);
+			platform::cancel_wait();
+		});
+
 	command::fnptr<> CMD_pause_emulator(lsnes_cmds, "pause-emulator", "(Un)pause the emulator",
 		"Syntax: pause-emulator\n(Un)pauses the emulator.\n",
 		[]() throw(std::bad_alloc, std::runtime_error) {
@@ -462,6 +564,47 @@ namespace
 			platform::set_paused(false);
 		});
 
+	command::fnptr<> CMD_prewind(lsnes_cmds, "+rewind", "Rewind",
+		"Syntax: +rewind\nSteps the emulation backwards using the rewind buffer while held.\n",
+		[]() throw(std::bad_alloc, std::runtime_error) {
+			auto& core = CORE();
+			if(core.runmode->is_special())
+				return;
+			if(!SET_rewind_buffer(*core.settings)) {
+				messages << "Rewind buffer is disabled (set rewind-buffer)." << std::endl;
+				return;
+			}
+			rewind_held = true;
+			rewind_rerecorded = false;
+			rewind_unpaused = !core.runmode->is_freerunning();
+			core.runmode->set_freerunning();
+			platform::cancel_wait();
+			platform::set_paused(false);
+		});
+
+	command::fnptr<> CMD_nrewind(lsnes_cmds, "-rewind", "Rewind",
+		"No help available\n",
+		[]() throw(std::bad_alloc, std::runtime_error) {
+			auto& core = CORE();
+			if(!rewind_held)
+				return;
+			rewind_held = false;
+			if(rewind_unpaused && !core.runmode->is_special())
+				core.runmode->set_pause();
+			rewind_unpaused = false;
+		});
+
+	command::fnptr<> CMD_rewind_status(lsnes_cmds, "rewind-status", "Show rewind buffer status",
+		"Syntax: rewind-status\nShows number of rewind points and memory used.\n",
+		[]() throw(std::bad_alloc, std::runtime_error) {
+			const rewind_point* last = rewind_ring.peek();
+			messages << rewind_ring.size() << " rewind point(s), " << rewind_ring.memory_usage()
+				<< " of " << rewind_ring.get_budget() << " bytes used";
+			if(last)
+				messages << ", newest at frame " << last->frame;
+			messages << "." << std::endl;
+		});
+
 	command::fnptr<> CMD_advance_skiplag(lsnes_cmds, "advance-skiplag", "Skip to next poll",
 		"Syntax: advance-skiplag\nAdvances the emulation to the next poll.\n",
 		[]() throw(std::bad_alloc, std::runtime_error) {
@@ -669,6 +812,7 @@ namespace
 	keyboard::invbind_info IBIND_iadvframe(lsnes_invbinds, "+advance-frame", "Speed‣Advance frame");
 	keyboard::invbind_info IBIND_iadvsubframe(lsnes_invbinds, "+advance-poll", "Speed‣Advance subframe");
 	keyboard::invbind_info IBIND_iskiplag(lsnes_invbinds, "advance-skiplag", "Speed‣Advance poll");
+	keyboard::invbind_info IBIND_irewind(lsnes_invbinds, "+rewind", "Speed‣Rewind");
 	keyboard::invbind_info IBIND_ireset(lsnes_invbinds, "reset", "System‣Reset");
 	keyboard::invbind_info IBIND_iset_rwmode(lsnes_invbinds, "set-rwmode", "Movie‣Switch to recording");
 	keyboard::invbind_info IBIND_itoggle_romode(lsnes_invbinds, "set-romode", "Movie‣Switch to playback");
@@ -803,7 +947,14 @@ nothing_to_do:
 			}
 			if(do_unsafe_rewind && !unsafe_rewind_obj) {
 				uint64_t t = framerate_regulator::get_utime();
-				core.mlogic->get_mfile().dyn.savestate = core.rom->save_core_state(true);
+				auto& dyn = core.mlogic->get_mfile().dyn;
+				if(core.rom->paged_savestates()) {
+					dyn.savestate.clear();
+					dyn.paged_savestate = core.rom->save_core_state_paged(true);
+				} else {
+					dyn.savestate = core.rom->save_core_state(true);
+					dyn.paged_savestate.clear();
+				}
 				core.lua2->callback_do_unsafe_rewind(core.mlogic->get_movie(), NULL);
 				do_unsafe_rewind = false;
 				messages << "Rewind point set in " << (framerate_regulator::get_utime() - t)
@@ -813,6 +964,76 @@ nothing_to_do:
 		queued_saves.clear();
 	}
 
+	//Capture a rewind point if one is due.
+	void rewind_capture()
+	{
+		auto& core = CORE();
+		size_t budget = 1048576ULL * SET_rewind_buffer(*core.settings);
+		rewind_ring.set_budget(budget);
+		if(!budget) {
+			rewind_ring.clear();
+			return;
+		}
+		if(!*core.mlogic)
+			return;
+		auto& mov = core.mlogic->get_movie();
+		auto& dyn = core.mlogic->get_mfile().dyn;
+		uint64_t frame = mov.get_current_frame();
+		if(frame % SET_rewind_interval(*core.settings))
+			return;
+		const rewind_point* last = rewind_ring.peek();
+		if(last && last->frame == frame)
+			return;
+		rewind_point p;
+		mov.fast_save(p.frame, p.ptr, p.lagged, p.pollcounters);
+		p.rtc_second = dyn.rtc_second;
+		p.rtc_subsecond = dyn.rtc_subsecond;
+		p.poll_flag = core.rom->get_pflag();
+		core.rom->runtosave();
+		rewind_ring.push(core.rom->save_core_state(true), p);
+	}
+
+	//Step back if rewinding. Returns true if state was rewound.
+	bool rewind_step()
+	{
+		auto& core = CORE();
+		if(!rewind_held || !*core.mlogic)
+			return false;
+		auto& mov = core.mlogic->get_movie();
+		auto& dyn = core.mlogic->get_mfile().dyn;
+		uint64_t frame = mov.get_current_frame();
+		//One frame is emulated after restoring, so points less than two frames back would not move backwards.
+		while(rewind_ring.peek() && rewind_ring.peek()->frame + 1 >= frame)
+			rewind_ring.pop(NULL, NULL);
+		if(rewind_ring.empty()) {
+			messages << "Rewind buffer exhausted." << std::endl;
+			rewind_held = false;
+			rewind_unpaused = false;
+			core.runmode->set_pause();
+			return false;
+		}
+		std::vector<char> state;
+		rewind_point p;
+		rewind_ring.pop(&state, &p);
+		if(!rewind_rerecorded) {
+			core.lua2->callback_movie_lost("rewind");
+			//Force unlazy rrdata.
+			core.mlogic->get_rrdata().read_base(rrdata::filename(core.mlogic->get_mfile().projectid),
+				false);
+			core.mlogic->get_rrdata().add((*core.nrrdata)());
+			rewind_rerecorded = true;
+		}
+		core.rom->load_core_state(state, true);
+		core.rom->set_pflag(p.poll_flag);
+		mov.fast_load(p.frame, p.ptr, p.lagged, p.pollcounters);
+		dyn.rtc_second = p.rtc_second;
+		dyn.rtc_subsecond = p.rtc_subsecond;
+		core.dispatch->mode_change(false);
+		core.runmode->set_point(emulator_runmode::P_SAVE);
+		core.supdater->update();
+		return true;
+	}
+
 	bool handle_corrupt()
 	{
 		auto& core = CORE();
@@ -905,11 +1126,15 @@ void main_loop(struct loaded_rom& rom, struct moviefile& initial, bool load_has_
 			int r = 0;
 			if(queued_saves.empty())
 				r = handle_load();
+			if(r != 0 || core.runmode->is_corrupt())
+				rewind_ring.clear();
 			if(r > 0 || core.runmode->is_corrupt()) {
 				core.mlogic->get_movie().get_pollcounters().set_framepflag(
 					core.mlogic->get_mfile().dyn.save_frame != 0);
 				first_round = core.mlogic->get_mfile().dyn.save_frame;
 				stop_at_frame_active = false;
+				if(core.runmode->is_turbo_seek())
+					core.runmode->set_freerunning();
 				just_did_loadstate = first_round;
 				core.controls->reset_framehold();
 				core.dbg->do_callback_frame(core.mlogic->get_movie().get_current_frame(), true);
@@ -921,6 +1146,15 @@ void main_loop(struct loaded_rom& rom, struct moviefile& initial, bool load_has_
 					goto out;
 				core.runmode->set_pause();
 			}
+			if(r == 0 && rewind_step()) {
+				first_round = true;
+				just_did_loadstate = true;
+				core.controls->reset_framehold();
+				core.dbg->do_callback_frame(core.mlogic->get_movie().get_current_frame(), true);
+				continue;
+			}
+			if(r == 0 && !rewind_held)
+				rewind_capture();
 		}
 		if(just_did_loadstate) {
 			//If we just loadstated, we are up to date.
@@ -936,12 +1170,15 @@ void main_loop(struct loaded_rom& rom, struct moviefile& initial, bool load_has_
 		core.dbg->do_callback_frame(core.mlogic->get_movie().get_current_frame(), false);
 		core.rom->emulate();
 		random_mix_timing_entropy();
-		if(core.runmode->is_freerunning())
+		if(core.runmode->is_freerunning() && !core.runmode->is_turbo_seek())
 			platform::wait(core.framerate->to_wait_frame(framerate_regulator::get_utime()));
 		first_round = false;
 		core.lua2->callback_do_frame();
 	}
 out:
+	//Finish background saves while completions can still be run.
+	core.swriter->flush();
+	core.iqueue->run_queue(false);
 	core.jukebox->unset_update();
 	core.mdumper->end_dumps();
 	core_core::uninstall_all_handlers();
@@ -956,13 +1193,19 @@ out:
 	do_load_rom();
 }
 
-void set_stop_at_frame(uint64_t frame)
+void set_stop_at_frame(uint64_t frame, bool turbo)
 {
 	auto& core = CORE();
 	stop_at_frame = frame;
 	stop_at_frame_active = (frame != 0);
-	if(!core.runmode->is_special())
-		core.runmode->set_freerunning();
+	if(!core.runmode->is_special()) {
+		if(turbo && stop_at_frame_active) {
+			seek_start_frame = core.mlogic->get_movie().get_current_frame();
+			seek_start_time = framerate_regulator::get_utime();
+			core.runmode->set_turbo_seek();
+		} else
+			core.runmode->set_freerunning();
+	}
 	platform::set_paused(false);
 }
 
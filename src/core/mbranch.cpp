@@ -159,7 +159,7 @@ void movie_branches::export_branch(const std::string& filename, const std::strin
 	auto& mv = mlogic.get_mfile();
 	if(!mv.branches.count(branchname))
 		(stringfmt() << "Branch '" << branchname << "' does not exist.").throwex();
-	auto& v = mv.branches[branchname];
+	const auto& v = mv.branches[branchname];
 	std::ofstream file(filename, binary ? std::ios_base::binary : std::ios_base::out);
 	if(!file)
 		(stringfmt() << "Can't open '" << filename << "' for writing.").throwex();
@@ -171,8 +171,8 @@ void movie_branches::export_branch(const std::string& filename, const std::strin
 		while(vsize > 0) {
 			uint64_t count = (vsize > pageframes) ? pageframes : vsize;
 			size_t bytes = count * stride;
-			unsigned char* content = v.get_page_buffer(pagenum++);
-			file.write(reinterpret_cast<char*>(content), bytes);
+			const unsigned char* content = v.get_page_buffer(pagenum++);
+			file.write(reinterpret_cast<const char*>(content), bytes);
 			vsize -= count;
 		}
 	} else {
@@ -106,9 +106,13 @@ namespace
 		~regread_oper();
 		//The first promise is the register name.
 		void evaluate(mathexpr::value target, std::vector<std::function<mathexpr::value()>> promises);
+		//Registers are not tracked, so assume they always change.
+		bool is_source() { return true; }
+		uint64_t source_version() { return ++version; }
 		//Fields.
 		bool signed_flag;
 		loaded_rom* rom;
+		uint64_t version;
 	};
 
 	regread_oper::regread_oper()
@@ -116,6 +120,7 @@ namespace
 	{
 		signed_flag = false;
 		rom = NULL;
+		version = 0;
 	}
 	regread_oper::~regread_oper()
 	{
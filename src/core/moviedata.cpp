@@ -15,6 +15,7 @@
 #include "core/random.hpp"
 #include "core/rom.hpp"
 #include "core/runmode.hpp"
+#include "core/savewriter.hpp"
 #include "core/settings.hpp"
 #include "interface/romtype.hpp"
 #include "library/directory.hpp"
@@ -32,6 +33,8 @@ namespace
 {
 	settingvar::supervariable<settingvar::model_int<0, 9>> SET_savecompression(lsnes_setgrp, "savecompression",
 		"Movie‣Saving‣Compression",  7);
+	settingvar::supervariable<settingvar::model_int<0, 64>> SET_save_queue(lsnes_setgrp, "save-queue",
+		"Movie‣Saving‣Background saves in flight (0 to save synchronously)",  2);
 	settingvar::supervariable<settingvar::model_bool<settingvar::yes_no>> SET_readonly_load_preserves(
 		lsnes_setgrp, "preserve_on_readonly_load", "Movie‣Loading‣Preserve on readonly load", true);
 	threads::lock mprefix_lock;
@@ -238,6 +241,7 @@ void do_save_state(const std::string& filename, int binary) throw(std::bad_alloc
 			target.namehint[i] = img.namehint;
 		}
 		target.dyn.savestate = core.rom->save_core_state();
+		target.dyn.paged_savestate.clear();
 		core.fbuf->get_framebuffer().save(target.dyn.screenshot);
 		core.mlogic->get_movie().save_state(target.projectid, target.dyn.save_frame,
 			target.dyn.lagged_frames, target.dyn.pollcounters);
@@ -248,13 +252,50 @@ void do_save_state(const std::string& filename, int binary) throw(std::bad_alloc
 			target.authors = prj->authors;
 		}
 		target.dyn.active_macros = core.controls->get_macro_frames();
-		target.save(filename2, SET_savecompression(*core.settings), binary > 0,
-			core.mlogic->get_rrdata(), true);
-		uint64_t took = framerate_regulator::get_utime() - origtime;
 		std::string kind = (binary > 0) ? "(binary format)" : "(zip format)";
-		messages << "Saved state " << kind << " '" << filename2 << "' in " << took << " microseconds."
-			<< std::endl;
-		core.lua2->callback_post_save(filename2, true);
+		unsigned inflight = SET_save_queue(*core.settings);
+		if(inflight && !regex_match("\\$MEMORY:.*", filename2)) {
+			//Hand a snapshot over to the writer thread, waiting if too many saves are in flight.
+			target.coreversion = target.gametype->get_type().get_core_identifier();
+			moviefile* snap = new moviefile();
+			try {
+				snap->copy_fields(target);
+			} catch(...) {
+				delete snap;
+				throw;
+			}
+			std::vector<char> rrd;
+			try {
+				core.mlogic->get_rrdata().write(rrd);
+			} catch(...) {
+				delete snap;
+				throw;
+			}
+			core.swriter->wait(inflight - 1);
+			uint64_t stall = framerate_regulator::get_utime() - origtime;
+			core.swriter->queue(snap, rrd, filename2, SET_savecompression(*core.settings), binary > 0, true,
+				[filename2, kind, origtime, stall](const std::string& err) {
+					auto& core = CORE();
+					if(err != "") {
+						platform::error_message(std::string("Save failed: ") + err);
+						messages << "Save failed: " << err << std::endl;
+						core.lua2->callback_err_save(filename2);
+					} else {
+						uint64_t took = framerate_regulator::get_utime() - origtime;
+						messages << "Saved state " << kind << " '" << filename2 << "' in " << took
+							<< " microseconds (" << stall << " in emulation)." << std::endl;
+						core.lua2->callback_post_save(filename2, true);
+					}
+					core.slotcache->flush(filename2);
+				});
+		} else {
+			target.save(filename2, SET_savecompression(*core.settings), binary > 0,
+				core.mlogic->get_rrdata(), true);
+			uint64_t took = framerate_regulator::get_utime() - origtime;
+			messages << "Saved state " << kind << " '" << filename2 << "' in " << took << " microseconds."
+				<< std::endl;
+			core.lua2->callback_post_save(filename2, true);
+		}
 	} catch(std::bad_alloc& e) {
 		throw;
 	} catch(std::exception& e) {
@@ -281,6 +322,8 @@ void do_save_movie(const std::string& filename, int binary) throw(std::bad_alloc
 	}
 	auto& target = core.mlogic->get_mfile();
 	std::string filename2 = translate_name_mprefix(filename, binary, 0);
+	//Don't race with background write of the same file.
+	core.swriter->flush();
 	core.lua2->callback_pre_save(filename2, false);
 	try {
 		uint64_t origtime = framerate_regulator::get_utime();
@@ -854,6 +897,9 @@ bool do_load_state(const std::string& filename, int lmode)
 	int tmp = -1;
 	std::string filename2 = translate_name_mprefix(filename, tmp, -1);
 	uint64_t origtime = framerate_regulator::get_utime();
+	//The file may still be being written.
+	if(core.swriter->is_pending(filename2))
+		core.swriter->flush();
 	core.lua2->callback_pre_load(filename2);
 	struct moviefile* mfile = NULL;
 	bool used = false;
@@ -894,7 +940,10 @@ void mainloop_restore_state(const dynamic_state& state)
 	core.mlogic->get_rrdata().read_base(rrdata::filename(core.mlogic->get_mfile().projectid),
 		false);
 	core.mlogic->get_rrdata().add((*core.nrrdata)());
-	core.rom->load_core_state(state.savestate, true);
+	if(state.savestate.empty() && !state.paged_savestate.empty())
+		core.rom->load_core_state(state.paged_savestate, true);
+	else
+		core.rom->load_core_state(state.savestate, true);
 }
 
 rrdata::rrdata()
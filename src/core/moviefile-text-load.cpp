@@ -8,6 +8,7 @@
 #include "library/string.hpp"
 #include "library/zip.hpp"
 
+#include <cstring>
 #include <fcntl.h>
 #include <unistd.h>
 #include <iostream>
@@ -135,16 +136,25 @@ namespace
 	void read_input(zip::reader& r, const std::string& mname, portctrl::frame_vector& input)
 		throw(std::bad_alloc, std::runtime_error)
 	{
-		portctrl::frame tmp = input.blank_frame(false);
 		std::istream& m = r[mname];
 		try {
-			std::string x;
-			while(std::getline(m, x)) {
-				istrip_CR(x);
-				if(x != "") {
-					tmp.deserialize(x.c_str());
-					input.append(tmp);
-				}
+			//Decode whole lines at a time, carrying the partial last line over to next block. The blocks are
+			//big enough to be split between threads.
+			std::vector<char> buffer(4 << 20);
+			size_t fill = 0;
+			while(m) {
+				if(fill == buffer.size())
+					buffer.resize(2 * buffer.size());
+				m.read(&buffer[fill], buffer.size() - fill);
+				fill += m.gcount();
+				size_t used = input.deserialize_text(&buffer[0], fill);
+				memmove(&buffer[0], &buffer[used], fill - used);
+				fill -= used;
+			}
+			if(fill) {
+				buffer.resize(fill + 1);
+				buffer[fill++] = '\n';
+				input.deserialize_text(&buffer[0], fill);
 			}
 			delete &m;
 		} catch(...) {
@@ -87,12 +87,14 @@ namespace
 	void write_input(zip::writer& w, const std::string& mname, portctrl::frame_vector& input)
 		throw(std::bad_alloc, std::runtime_error)
 	{
+		const uint64_t frames_per_write = 262144;
 		std::ostream& m = w.create_file(mname);
 		try {
-			char buffer[MAX_SERIALIZED_SIZE];
-			for(size_t i = 0; i < input.size(); i++) {
-				input[i].serialize(buffer);
-				m << buffer << std::endl;
+			std::string buffer;
+			for(uint64_t i = 0; i < input.size(); i += frames_per_write) {
+				buffer.clear();
+				input.serialize_text(i, frames_per_write, buffer);
+				m.write(buffer.data(), buffer.size());
 			}
 			if(!m)
 				throw std::runtime_error("Can't write ZIP file member");
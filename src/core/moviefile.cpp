@@ -1,3 +1,4 @@
+#include "core/instance.hpp"
 #include "core/moviefile-common.hpp"
 #include "core/moviefile.hpp"
 #include "core/random.hpp"
@@ -157,6 +158,7 @@ moviefile::moviefile(const std::string& movie, core_type& romtype) throw(std::ba
 			throw std::runtime_error("No such memory save");
 		moviefile& s = *memory_saves[rr[1]];
 		copy_fields(s);
+		dyn.page_in();
 		return;
 	}
 	input = NULL;
@@ -196,6 +198,8 @@ void moviefile::save(const std::string& movie, unsigned compression, bool binary
 		auto tmp = new moviefile();
 		try {
 			tmp->copy_fields(*this);
+			if(CORE().rom->paged_savestates())
+				tmp->dyn.page_out();
 			memory_saves[rr[1]] = tmp;
 		} catch(...) {
 			delete tmp;
@@ -422,6 +426,7 @@ void dynamic_state::clear(int64_t sec, int64_t ssec, const std::map<std::string,
 {
 	sram = initsram;
 	savestate.clear();
+	paged_savestate.clear();
 	host_memory.clear();
 	screenshot.clear();
 	save_frame = 0;
@@ -438,6 +443,7 @@ void dynamic_state::swap(dynamic_state& s) throw()
 {
 	std::swap(sram, s.sram);
 	std::swap(savestate, s.savestate);
+	paged_savestate.swap(s.paged_savestate);
 	std::swap(host_memory, s.host_memory);
 	std::swap(screenshot, s.screenshot);
 	std::swap(save_frame, s.save_frame);
@@ -448,3 +454,20 @@ void dynamic_state::swap(dynamic_state& s) throw()
 	std::swap(rtc_subsecond, s.rtc_subsecond);
 	std::swap(active_macros, s.active_macros);
 }
+
+void dynamic_state::page_out() throw(std::bad_alloc)
+{
+	if(savestate.empty())
+		return;
+	paged_savestate = pagestore::snapshot(savestate);
+	std::vector<char> tmp;
+	std::swap(savestate, tmp);
+}
+
+void dynamic_state::page_in() throw(std::bad_alloc)
+{
+	if(paged_savestate.empty())
+		return;
+	paged_savestate.materialize(savestate);
+	paged_savestate.clear();
+}
@@ -41,6 +41,8 @@ namespace
 {
 	settingvar::supervariable<settingvar::model_bool<settingvar::yes_no>> savestate_no_check(lsnes_setgrp,
 		"dont-check-savestate", "Movie‣Loading‣Don't check savestates", false);
+	settingvar::supervariable<settingvar::model_bool<settingvar::yes_no>> SET_paged_savestates(lsnes_setgrp,
+		"delta-savestates", "Movie‣Saving‣Share unchanged pages between memory savestates", true);
 
 	core_type* current_rom_type = &get_null_type();
 	core_region* current_region = &get_null_region();
@@ -148,22 +150,72 @@ std::map<std::string, std::vector<char>> load_sram_commandline(const std::vector
 
 std::vector<char> loaded_rom::save_core_state(bool nochecksum) throw(std::bad_alloc, std::runtime_error)
 {
+	//Copy straight from the core, reserving room for the checksum.
+	std::vector<core_state_span> spans;
+	rtype().serialize_spans(spans);
+	size_t offset = 0;
+	for(auto& i : spans)
+		offset += i.size;
 	std::vector<char> ret;
-	rtype().serialize(ret);
+	ret.resize(offset + (nochecksum ? 0 : 32));
+	size_t off = 0;
+	for(auto& i : spans) {
+		if(i.size)
+			memcpy(&ret[off], i.data, i.size);
+		off += i.size;
+	}
 	if(nochecksum)
 		return ret;
-	size_t offset = ret.size();
 	unsigned char tmp[32];
 #ifdef USE_LIBGCRYPT_SHA256
 	gcry_md_hash_buffer(GCRY_MD_SHA256, tmp, &ret[0], offset);
 #else
-	sha256::hash(tmp, ret);
+	sha256::hash(tmp, reinterpret_cast<const uint8_t*>(&ret[0]), offset);
 #endif
-	ret.resize(offset + 32);
 	memcpy(&ret[offset], tmp, 32);
 	return ret;
 }
 
+pagestore::snapshot loaded_rom::save_core_state_paged(bool nochecksum) throw(std::bad_alloc, std::runtime_error)
+{
+	if(!nochecksum) {
+		pagestore::snapshot ret(save_core_state(nochecksum), &last_paged);
+		last_paged = ret;
+		return ret;
+	}
+	//Page the state straight from the core memory.
+	std::vector<core_state_span> spans;
+	rtype().serialize_spans(spans);
+	std::vector<std::pair<const char*, size_t>> data;
+	data.reserve(spans.size());
+	for(auto& i : spans)
+		data.push_back(std::make_pair(i.data, i.size));
+	pagestore::snapshot ret(data, &last_paged);
+	last_paged = ret;
+	return ret;
+}
+
+void loaded_rom::load_core_state(const pagestore::snapshot& buf, bool nochecksum) throw(std::runtime_error)
+{
+	if(!nochecksum) {
+		load_core_state(buf.materialize(), nochecksum);
+		return;
+	}
+	//Hand the pages to the core as they are.
+	std::vector<std::pair<const char*, size_t>> data;
+	buf.get_spans(data);
+	std::vector<core_state_span> spans;
+	spans.reserve(data.size());
+	for(auto& i : data)
+		spans.push_back(core_state_span(i.first, i.second, false));
+	rtype().unserialize_spans(spans);
+}
+
+bool loaded_rom::paged_savestates()
+{
+	return SET_paged_savestates(*CORE().settings);
+}
+
 void loaded_rom::load_core_state(const std::vector<char>& buf, bool nochecksum) throw(std::runtime_error)
 {
 	if(nochecksum) {
@@ -4,96 +4,78 @@
 #include "core/window.hpp"
 #include "interface/romtype.hpp"
 #include "library/directory.hpp"
+#include "library/fileimage-index.hpp"
+#include "library/threads.hpp"
 #include "library/zip.hpp"
 
 #include <fstream>
 
 namespace
 {
-	bool db_loaded;
-	std::map<std::pair<std::string, uint64_t>, std::string> our_db;
-	std::string database_name()
+	fileimage::hash_index& rom_db()
 	{
-		return get_config_path() + "/rom.db";
+		static fileimage::hash_index db(get_config_path() + "/rom.db");
+		return db;
 	}
 
-	void load_db()
+	//Get size and modification time of file. Returns false if file isn't a regular file.
+	bool stat_file(const std::string& file, uint64_t& size, int64_t& mtime)
 	{
-		std::ifstream db(database_name());
-		if(db) {
-			std::string line;
-			while(std::getline(db, line)) {
-				istrip_CR(line);
-				size_t split = line.find_first_of("|");
-				if(split >= line.length())
-					continue;
-				std::string hash = line.substr(0, split);
-				std::string filename = line.substr(split + 1);
-				uint64_t prefix = 0;
-				size_t split2 = hash.find_first_of(":");
-				if(split2 < hash.length()) {
-					std::string _prefix = hash.substr(split2 + 1);
-					hash = hash.substr(0, split2);
-					try { prefix = parse_value<uint64_t>(_prefix); } catch(...) {};
-				}
-				if(hash != "") {
-					our_db[std::make_pair(filename, prefix)] = hash;
-				} else {
-					our_db.erase(std::make_pair(filename, prefix));
-				}
-			}
+		if(!directory::is_regular(file))
+			return false;
+		try {
+			size = directory::size(file);
+		} catch(...) {
+			return false;
 		}
-		db_loaded = true;
+		mtime = directory::mtime(file);
+		return true;
 	}
 
 	void record_hash(const std::string& _file, uint64_t prefix, const std::string& hash)
 	{
-		if(!db_loaded) load_db();
 		//Database write. If there is existing entry for file, it is overwritten.
 		std::string file = directory::absolute_path(_file);
-		std::pair<std::string, uint64_t> key = std::make_pair(file, prefix);
-		if(hash == "" && !our_db.count(key))
-			return;		//Already correct.
-		if(our_db.count(key) && our_db[key] == hash)
-			return;		//Already correct.
-		if(hash != "")
-			our_db[key] = hash;
-		else
-			our_db.erase(key);
-		std::ofstream db(database_name(), std::ios::app);
-		db << hash << ":" << prefix << "|" << file << std::endl;
+		uint64_t size = fileimage::hash_index::unknown_size;
+		int64_t mtime = 0;
+		if(hash != "" && !stat_file(file, size, mtime))
+			size = fileimage::hash_index::unknown_size;
+		rom_db().store(file, prefix, size, mtime, hash);
 	}
 
 	void record_hash_deleted(const std::string& _file)
 	{
-		if(!db_loaded) load_db();
-		auto itr = our_db.begin();
-		while(true) {
-			itr = our_db.lower_bound(std::make_pair(_file, 0));
-			if(itr == our_db.end() || itr->first.first != _file)
-				return;
-			record_hash(_file, itr->first.second, "");
-		}
+		rom_db().erase(directory::absolute_path(_file));
 	}
 
 	std::list<std::pair<std::string, uint64_t>> retretive_files_by_hash(const std::string& hash)
 	{
-		if(!db_loaded) load_db();
-		//Database read. The read is for keys with given value.
-		std::list<std::pair<std::string, uint64_t>> x;
-		for(auto i : our_db)
-			if(i.second == hash) {
-				x.push_back(i.first);
-			}
-		return x;
+		return rom_db().by_hash(hash);
 	}
 
-	std::string hash_file(const std::string& file, uint64_t hsize)
+	std::string hash_file(const std::string& _file, uint64_t hsize)
 	{
-		if(!zip::file_exists(file)) {
-			record_hash_deleted(file);
+		if(!zip::file_exists(_file)) {
+			record_hash_deleted(_file);
 			return "";
 		}
+		std::string file = directory::absolute_path(_file);
+		uint64_t size;
+		int64_t mtime;
+		if(stat_file(file, size, mtime)) {
+			//Plain file, use the cached hash if the file hasn't changed.
+			uint64_t prefix = fileimage::std_headersize_fn(hsize)(size);
+			std::string hash = rom_db().lookup(file, prefix, size, mtime);
+			if(hash != "")
+				return hash;
+			try {
+				hash = fileimage::hash_file(file, prefix);
+			} catch(std::exception& e) {
+				return "";	//Error.
+			}
+			rom_db().store(file, prefix, size, mtime, hash);
+			return hash;
+		}
 		try {
 			fileimage::hashval f = lsnes_image_hasher(file, fileimage::std_headersize_fn(hsize));
 			std::string hash = f.read();
@@ -105,6 +87,12 @@ namespace
 		}
 	}
 
+	//Hash the files (into database), using multiple threads.
+	void hash_files_parallel(const std::vector<std::string>& files, uint64_t hsize)
+	{
+		threads::parallel_for(files.size(), [&files, hsize](size_t i) { hash_file(files[i], hsize); });
+	}
+
 	std::string try_basename(const std::string& hash, const std::string& xhash,
 		const std::string& file, uint64_t headersize)
 	{
@@ -134,6 +122,34 @@ namespace
 		return "";
 	}
 
+	std::string try_scan_dir(const std::string& hash, const std::string& xhash, const std::string& dir,
+		const std::set<std::string>& extensions, uint64_t headersize)
+	{
+		if(dir == "")
+			return "";
+		std::set<std::string> files;
+		try {
+			files = directory::enumerate(dir, ".*");
+		} catch(...) {
+			return "";
+		}
+		std::vector<std::string> candidates;
+		for(auto& i : files) {
+			size_t split = i.find_last_of(".");
+			if(split >= i.length() || !extensions.count(i.substr(split + 1)))
+				continue;
+			if(directory::is_regular(i))
+				candidates.push_back(i);
+		}
+		//Hash everything not already known at once, then check against the (now up to date) database.
+		hash_files_parallel(candidates, headersize);
+		std::string x;
+		for(auto& i : candidates)
+			if((x = try_basename(hash, xhash, i, headersize)) != "")
+				return x;
+		return "";
+	}
+
 	std::string try_guess_rom_core(const std::string& hint, const std::string& hash, const std::string& xhash,
 		const std::set<std::string>& extensions, uint64_t headersize, bool bios)
 	{
@@ -148,6 +164,8 @@ namespace
 			if((x = try_basename(hash, xhash, j.first, headersize)) != "")
 				return x;
 		}
+		if((x = try_scan_dir(hash, xhash, romdir, extensions, headersize)) != "") return x;
+		if(bios && (x = try_scan_dir(hash, xhash, biosdir, extensions, headersize)) != "") return x;
 		return "";
 	}
 
@@ -19,6 +19,7 @@ const uint64_t emulator_runmode::SKIPLAG_PENDING = 64;
 const uint64_t emulator_runmode::PAUSE = 128;
 const uint64_t emulator_runmode::PAUSE_BREAK = 256;
 const uint64_t emulator_runmode::CORRUPT = 512;
+const uint64_t emulator_runmode::TURBO_SEEK = 1024;
 
 const unsigned emulator_runmode::P_START = 0;
 const unsigned emulator_runmode::P_VIDEO = 1;
@@ -43,7 +44,7 @@ uint64_t emulator_runmode::get()
 
 void emulator_runmode::set(uint64_t m)
 {
-	if(!m || m & (m - 1) || m > CORRUPT)
+	if(!m || m & (m - 1) || m > TURBO_SEEK)
 		throw std::logic_error("Trying to set invalid runmode");
 	if(m == QUIT) {
 		magic = QUIT_MAGIC;
@@ -101,7 +102,7 @@ void emulator_runmode::decay_break()
 
 void emulator_runmode::revalidate()
 {
-	if(!mode || mode & (mode - 1) || (mode == QUIT && magic != QUIT_MAGIC) || mode > CORRUPT) {
+	if(!mode || mode & (mode - 1) || (mode == QUIT && magic != QUIT_MAGIC) || mode > TURBO_SEEK) {
 		//Uh, oh.
 		auto& core = CORE();
 		if(core.mlogic)
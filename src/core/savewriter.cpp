@@ -0,0 +1,145 @@
+#include "core/dispatch.hpp"
+#include "core/moviefile.hpp"
+#include "core/queue.hpp"
+#include "core/savewriter.hpp"
+#include "library/rrdata.hpp"
+#include "library/workthread.hpp"
+
+namespace
+{
+	const uint32_t WORKFLAG_QUEUE = 1;
+}
+
+class save_writer::worker : public workthread
+{
+public:
+	worker(save_writer& _writer)
+		: writer(_writer)
+	{
+		fire();
+	}
+protected:
+	void entry()
+	{
+		while(true) {
+			wait_workflag();
+			uint32_t work = clear_workflag(~workthread::quit_request);
+			//Write everything queued before quitting.
+			job* j;
+			while((j = writer.next_job()) != NULL) {
+				writer.run_job(*j);
+				writer.job_done(j);
+			}
+			if(work & workthread::quit_request)
+				return;
+		}
+	}
+private:
+	save_writer& writer;
+};
+
+save_writer::save_writer(input_queue& _iqueue, emulator_dispatch& _dispatch)
+	: iqueue(_iqueue), edispatch(_dispatch)
+{
+	//The thread is started on first write.
+	thread = NULL;
+}
+
+save_writer::~save_writer()
+{
+	if(thread)
+		thread->request_quit();
+	delete thread;
+}
+
+void save_writer::queue(moviefile* mv, std::vector<char>& rrd, const std::string& filename, unsigned compression,
+	bool binary, bool as_state, std::function<void(const std::string& err)> done) throw(std::bad_alloc)
+{
+	job* j = NULL;
+	try {
+		j = new job;
+		j->mv = mv;
+		std::swap(j->rrd, rrd);
+		j->filename = filename;
+		j->compression = compression;
+		j->binary = binary;
+		j->as_state = as_state;
+		j->done = done;
+		threads::alock h(mlock);
+		if(!thread)
+			thread = new worker(*this);
+		jobs.push_back(j);
+	} catch(...) {
+		if(j)
+			j->mv = NULL;
+		delete j;
+		delete mv;
+		throw;
+	}
+	thread->set_workflag(WORKFLAG_QUEUE);
+}
+
+void save_writer::wait(size_t maxpending) throw()
+{
+	threads::alock h(mlock);
+	while(jobs.size() > maxpending)
+		condition.wait(h);
+}
+
+size_t save_writer::pending() throw()
+{
+	threads::alock h(mlock);
+	return jobs.size();
+}
+
+bool save_writer::is_pending(const std::string& filename) throw()
+{
+	threads::alock h(mlock);
+	for(auto i : jobs)
+		if(i->filename == filename)
+			return true;
+	return false;
+}
+
+save_writer::job* save_writer::next_job()
+{
+	threads::alock h(mlock);
+	return jobs.empty() ? NULL : jobs.front();
+}
+
+void save_writer::run_job(job& j)
+{
+	std::string err;
+	try {
+		rrdata_set rrd;
+		rrd.read(j.rrd);
+		j.mv->save(j.filename, j.compression, j.binary, rrd, j.as_state);
+	} catch(std::bad_alloc& e) {
+		err = "Out of memory";
+	} catch(std::exception& e) {
+		err = e.what();
+		if(err == "")
+			err = "Unknown error";
+	}
+	delete j.mv;
+	j.mv = NULL;
+	//Report completion in emulation thread.
+	auto done = j.done;
+	auto filename = j.filename;
+	emulator_dispatch* d = &edispatch;
+	try {
+		iqueue.run_async([done, filename, err, d]() {
+			done(err);
+			d->save_complete(filename, err == "");
+		}, [](std::exception& e) {});
+	} catch(...) {
+	}
+}
+
+void save_writer::job_done(job* j)
+{
+	threads::alock h(mlock);
+	jobs.pop_front();
+	delete j;
+	condition.notify_all();
+}
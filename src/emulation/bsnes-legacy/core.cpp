@@ -84,12 +84,17 @@ namespace
 	bool trace_cpu_enable;
 	bool trace_smp_enable;
 	bool trace_sa1_enable;
+	bool trace_cpu_raw;
+	bool trace_smp_raw;
+	bool trace_sa1_raw;
 	SNES::Interface* old;
 	bool stepping_into_save;
 	bool video_refresh_done;
 	bool forced_hook = false;
 	std::map<int16_t, std::pair<uint64_t, uint64_t>> ptrmap;
 	std::vector<uint8_t> init_savestate;
+	//Last savestate, handed out as span.
+	serializer saved_state;
 	uint32_t cover_fbmem[512 * 448];
 	//Delay reset.
 	unsigned long long delayreset_cycles_run;
@@ -806,6 +811,30 @@ namespace
 		}
 	} my_interface_obj;
 
+#ifdef BSNES_HAS_DEBUGGER
+	//Fill raw trace event for S-CPU or SA-1. Variant indexes snes-xa, snes-xA, snes-Xa and snes-XA.
+	template<typename T> void raw_trace_65816(T& cpu, binarytrace::insn& i)
+	{
+		uint32_t pc = cpu.regs.pc;
+		i.pc = pc;
+		i.stamp = (SNES::cpu.vcounter() << 16) | SNES::cpu.hcounter();
+		for(unsigned j = 0; j < sizeof(i.opcode); j++)
+			i.opcode[j] = cpu.dreadb((pc & 0xFF0000) | ((pc + j) & 0xFFFF));
+		bool native = !cpu.regs.e;
+		i.variant = ((native && !cpu.regs.p.x) ? 2 : 0) | ((native && !cpu.regs.p.m) ? 1 : 0);
+		uint16_t w[5] = {(uint16_t)cpu.regs.a, (uint16_t)cpu.regs.x, (uint16_t)cpu.regs.y,
+			(uint16_t)cpu.regs.s, (uint16_t)cpu.regs.d};
+		for(unsigned j = 0; j < 5; j++) {
+			i.regs[2 * j + 0] = w[j];
+			i.regs[2 * j + 1] = w[j] >> 8;
+		}
+		i.regs[10] = cpu.regs.db;
+		i.regs[11] = (unsigned)cpu.regs.p;
+		i.regs[12] = cpu.regs.e;
+		i.reglen = 13;
+	}
+#endif
+
 	bool trace_fn()
 	{
 #ifdef BSNES_HAS_DEBUGGER
@@ -818,6 +847,11 @@ namespace
 			SNES::cpu.disassemble_opcode(buffer, SNES::cpu.regs.pc);
 			ecore_callbacks->memory_trace(0, buffer, true);
 		}
+		if(trace_cpu_raw) {
+			binarytrace::insn i;
+			raw_trace_65816(SNES::cpu, i);
+			ecore_callbacks->memory_trace_raw(0, i);
+		}
 		return false;
 #endif
 	}
@@ -829,6 +863,17 @@ namespace
 			std::string disasm(_disasm, _disasm.length());
 			ecore_callbacks->memory_trace(1, disasm.c_str(), true);
 		}
+		if(trace_smp_raw) {
+			binarytrace::insn i;
+			uint16_t pc = SNES::smp.regs.pc;
+			i.pc = pc;
+			i.stamp = (SNES::cpu.vcounter() << 16) | SNES::cpu.hcounter();
+			for(unsigned j = 0; j < sizeof(i.opcode); j++)
+				i.opcode[j] = SNES::smp.apuram[(uint16_t)(pc + j)];
+			i.variant = 0;
+			i.reglen = 0;
+			ecore_callbacks->memory_trace_raw(1, i);
+		}
 		return false;
 #endif
 	}
@@ -840,6 +885,11 @@ namespace
 			SNES::sa1.disassemble_opcode(buffer, SNES::sa1.regs.pc);
 			ecore_callbacks->memory_trace(2, buffer, true);
 		}
+		if(trace_sa1_raw) {
+			binarytrace::insn i;
+			raw_trace_65816(SNES::sa1, i);
+			ecore_callbacks->memory_trace_raw(2, i);
+		}
 #endif
 	}
 	void cpu_dma_fn(const char* buf)
@@ -860,7 +910,7 @@ namespace
 
 	bool trace_enabled()
 	{
-		return (trace_counter || !!trace_cpu_enable);
+		return (trace_counter || !!trace_cpu_enable || trace_cpu_raw);
 	}
 
 	void update_trace_hook_state()
@@ -872,16 +922,16 @@ namespace
 			SNES::cpu.step_event = nall::function<bool()>();
 		else
 			SNES::cpu.step_event = trace_fn;
-		if(!trace_smp_enable)
+		if(!trace_smp_enable && !trace_smp_raw)
 			SNES::smp.step_event = nall::function<bool()>();
 		else
 			SNES::smp.step_event = smp_trace_fn;
 #ifdef BSNES_SUPPORTS_TRACE_SA1
-		if(!trace_sa1_enable)
+		if(!trace_sa1_enable && !trace_sa1_raw)
 			SNES::sa1.step_event = nall::function<void()>();
 		else
 			SNES::sa1.step_event = sa1_trace_fn;
-		SNES::sa1.trace_enabled = trace_sa1_enable;
+		SNES::sa1.trace_enabled = trace_sa1_enable || trace_sa1_raw;
 #endif
 #ifdef BSNES_SUPPORTS_DMA_TRACE
 		if(!trace_enabled())
@@ -1210,12 +1260,13 @@ namespace
 					messages << "WARNING: SRAM '" << i.first << ": Not found on cartridge."
 						<< std::endl;
 		}
-		void c_serialize(std::vector<char>& out) {
+		void c_serialize_spans(std::vector<core_state_span>& out) {
 			if(!internal_rom)
 				throw std::runtime_error("No ROM loaded");
-			serializer s = SNES::system.serialize();
-			out.resize(s.size());
-			memcpy(&out[0], s.data(), s.size());
+			saved_state = SNES::system.serialize();
+			out.clear();
+			out.push_back(core_state_span(reinterpret_cast<const char*>(saved_state.data()),
+				saved_state.size(), true));
 		}
 		void c_unserialize(const char* in, size_t insize) {
 			if(!internal_rom)
@@ -1446,16 +1497,22 @@ again2:
 			if(addr == 0) {
 				if(sflags & 8) trace_cpu_enable = true;
 				if(cflags & 8) trace_cpu_enable = false;
+				if(sflags & 16) trace_cpu_raw = true;
+				if(cflags & 16) trace_cpu_raw = false;
 				update_trace_hook_state();
 			}
 			if(addr == 1) {
 				if(sflags & 8) trace_smp_enable = true;
 				if(cflags & 8) trace_smp_enable = false;
+				if(sflags & 16) trace_smp_raw = true;
+				if(cflags & 16) trace_smp_raw = false;
 				update_trace_hook_state();
 			}
 			if(addr == 2) {
 				if(sflags & 8) trace_sa1_enable = true;
 				if(cflags & 8) trace_sa1_enable = false;
+				if(sflags & 16) trace_sa1_raw = true;
+				if(cflags & 16) trace_sa1_raw = false;
 				update_trace_hook_state();
 			}
 #ifdef BSNES_SUPPORTS_ADV_BREAKPOINTS
@@ -1533,6 +1590,9 @@ again2:
 #endif
 			trace_cpu_enable = false;
 			trace_smp_enable = false;
+			trace_cpu_raw = false;
+			trace_smp_raw = false;
+			trace_sa1_raw = false;
 			update_trace_hook_state();
 		}
 		std::vector<std::string> c_get_trace_cpus()
@@ -1546,6 +1606,23 @@ again2:
 			//TODO: Trace various chips.
 			return r;
 		}
+		bool c_get_raw_trace_info(uint64_t cpu, binarytrace::cpu_info& info)
+		{
+#ifdef BSNES_HAS_DEBUGGER
+			if(cpu == 0 || cpu == 2) {
+				info.disassemblers = {"snes-xa", "snes-xA", "snes-Xa", "snes-XA"};
+				info.registers = {{"a", 2}, {"x", 2}, {"y", 2}, {"s", 2}, {"d", 2}, {"db", 1}, {"p", 1},
+					{"e", 1}};
+				return true;
+			}
+			if(cpu == 1) {
+				info.disassemblers = {"snes-smp"};
+				info.registers.clear();
+				return true;
+			}
+#endif
+			return false;
+		}
 		void c_reset_to_load()
 		{
 			serializer s(&init_savestate[0], init_savestate.size());
@@ -74,6 +74,9 @@ namespace
 	std::vector<char> init_savestate;
 	uint32_t cover_fbmem[480 * 432];
 	uint32_t primary_framebuffer[160*144];
+	//Savestate buffers, reused between saves and loads.
+	std::vector<char> state_buffer;
+	char state_trailer[4 * 160 * 144 + 2];
 	uint32_t accumulator_l = 0;
 	uint32_t accumulator_r = 0;
 	unsigned accumulator_s = 0;
@@ -600,31 +603,45 @@ namespace
 				instance->setRtcBase(timebase);
 			}
 		}
-		void c_serialize(std::vector<char>& out) {
+		void c_serialize_spans(std::vector<core_state_span>& out) {
 			if(!internal_rom)
 				throw std::runtime_error("Can't save without ROM");
-			instance->saveState(out);
-			size_t osize = out.size();
-			out.resize(osize + 4 * sizeof(primary_framebuffer) / sizeof(primary_framebuffer[0]));
+			instance->saveState(state_buffer);
 			for(size_t i = 0; i < sizeof(primary_framebuffer) / sizeof(primary_framebuffer[0]); i++)
-				serialization::u32b(&out[osize + 4 * i], primary_framebuffer[i]);
-			out.push_back(frame_overflow >> 8);
-			out.push_back(frame_overflow);
+				serialization::u32b(&state_trailer[4 * i], primary_framebuffer[i]);
+			state_trailer[sizeof(state_trailer) - 2] = frame_overflow >> 8;
+			state_trailer[sizeof(state_trailer) - 1] = frame_overflow;
+			out.clear();
+			out.push_back(core_state_span(state_buffer.empty() ? NULL : &state_buffer[0], state_buffer.size(),
+				true));
+			out.push_back(core_state_span(state_trailer, sizeof(state_trailer), true));
 		}
-		void c_unserialize(const char* in, size_t insize) {
+		void c_unserialize_spans(const std::vector<core_state_span>& in) {
 			if(!internal_rom)
 				throw std::runtime_error("Can't load without ROM");
-			size_t foffset = insize - 2 - 4 * sizeof(primary_framebuffer) /
-				sizeof(primary_framebuffer[0]);
-			std::vector<char> tmp;
-			tmp.resize(foffset);
-			memcpy(&tmp[0], in, foffset);
-			instance->loadState(tmp);
+			size_t insize = 0;
+			for(auto& i : in)
+				insize += i.size;
+			if(insize < sizeof(state_trailer))
+				throw std::runtime_error("Savestate too short");
+			//Split the spans into the gambatte state and the trailer.
+			size_t foffset = insize - sizeof(state_trailer);
+			state_buffer.resize(foffset);
+			size_t off = 0;
+			for(auto& i : in) {
+				size_t s1 = (off < foffset) ? min(i.size, foffset - off) : 0;
+				if(s1)
+					memcpy(&state_buffer[off], i.data, s1);
+				if(i.size > s1)
+					memcpy(&state_trailer[off + s1 - foffset], i.data + s1, i.size - s1);
+				off += i.size;
+			}
+			instance->loadState(state_buffer);
 			for(size_t i = 0; i < sizeof(primary_framebuffer) / sizeof(primary_framebuffer[0]); i++)
-				primary_framebuffer[i] = serialization::u32b(&in[foffset + 4 * i]);
+				primary_framebuffer[i] = serialization::u32b(&state_trailer[4 * i]);
 
-			unsigned x1 = (unsigned char)in[insize - 2];
-			unsigned x2 = (unsigned char)in[insize - 1];
+			unsigned x1 = (unsigned char)state_trailer[sizeof(state_trailer) - 2];
+			unsigned x2 = (unsigned char)state_trailer[sizeof(state_trailer) - 1];
 			frame_overflow = x1 * 256 + x2;
 			do_reset_flag = false;
 		}
@@ -280,16 +280,23 @@ namespace sky
 			else
 				memset(corei.state.sram, 0, 32);
 		}
-		void c_serialize(std::vector<char>& out) {
+		void c_serialize_spans(std::vector<core_state_span>& out) {
 			auto wram = corei.state.as_ram();
-			out.resize(wram.second);
-			memcpy(&out[0], wram.first, wram.second);
+			out.clear();
+			out.push_back(core_state_span(reinterpret_cast<const char*>(wram.first), wram.second, false));
 		}
-		void c_unserialize(const char* in, size_t insize) {
+		void c_unserialize_spans(const std::vector<core_state_span>& in) {
 			auto wram = corei.state.as_ram();
-			if(insize != wram.second)
+			size_t size = 0;
+			for(auto& i : in)
+				size += i.size;
+			if(size != wram.second)
 				throw std::runtime_error("Save is of wrong size");
-			memcpy(wram.first, in, wram.second);
+			char* ptr = reinterpret_cast<char*>(wram.first);
+			for(auto& i : in) {
+				memcpy(ptr, i.data, i.size);
+				ptr += i.size;
+			}
 			handle_loadstate(corei);
 		}
 		core_region& c_get_region() { return *this; }
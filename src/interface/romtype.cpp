@@ -8,6 +8,7 @@
 #include <string>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <stdexcept>
 #include <list>
 #include <limits>
@@ -65,6 +66,24 @@ namespace
 	{
 		return (a->get_handle() < b->get_handle());
 	}
+
+	//Marks a default (un)serialization method as running, so the defaults can't call each other forever.
+	struct default_guard
+	{
+		default_guard(bool& _flag, const char* what)
+			: flag(_flag)
+		{
+			if(flag)
+				throw std::logic_error(std::string("Core implements neither ") + what);
+			flag = true;
+		}
+		~default_guard()
+		{
+			flag = false;
+		}
+	private:
+		bool& flag;
+	};
 }
 
 bool interface_action::is_toggle() const
@@ -330,6 +349,11 @@ bool core_core::c_isnull() const
 	return false;
 }
 
+bool core_core::c_get_raw_trace_info(uint64_t cpu, binarytrace::cpu_info& info)
+{
+	return false;
+}
+
 core_sysregion::core_sysregion(const std::string& _name, core_type& _type, core_region& _region)
 	: name(_name), type(_type), region(_region)
 {
@@ -384,6 +408,8 @@ core_core::core_core(std::initializer_list<portctrl::type*> ports, std::initiali
 	uninitialized_cores_set().insert(this);
 	all_cores_set().insert(this);
 	new_core_flag = true;
+	in_default_serialize = false;
+	in_default_unserialize = false;
 	mark_against_loading(this);
 }
 
@@ -398,6 +424,8 @@ core_core::core_core(std::vector<portctrl::type*> ports, std::vector<interface_a
 	uninitialized_cores_set().insert(this);
 	all_cores_set().insert(this);
 	new_core_flag = true;
+	in_default_serialize = false;
+	in_default_unserialize = false;
 	mark_against_loading(this);
 }
 
@@ -478,6 +506,69 @@ void core_core::unserialize(const char* in, size_t insize)
 	c_unserialize(in, insize);
 }
 
+void core_core::serialize_spans(std::vector<core_state_span>& out)
+{
+	c_serialize_spans(out);
+}
+
+void core_core::unserialize_spans(const std::vector<core_state_span>& in)
+{
+	c_unserialize_spans(in);
+}
+
+void core_core::c_serialize(std::vector<char>& out)
+{
+	default_guard g(in_default_serialize, "c_serialize() nor c_serialize_spans()");
+	std::vector<core_state_span> spans;
+	c_serialize_spans(spans);
+	size_t size = 0;
+	for(auto& i : spans)
+		size += i.size;
+	out.resize(size);
+	size_t off = 0;
+	for(auto& i : spans) {
+		if(i.size)
+			memcpy(&out[off], i.data, i.size);
+		off += i.size;
+	}
+}
+
+void core_core::c_unserialize(const char* in, size_t insize)
+{
+	default_guard g(in_default_unserialize, "c_unserialize() nor c_unserialize_spans()");
+	std::vector<core_state_span> spans;
+	spans.push_back(core_state_span(in, insize, true));
+	c_unserialize_spans(spans);
+}
+
+void core_core::c_serialize_spans(std::vector<core_state_span>& out)
+{
+	default_guard g(in_default_serialize, "c_serialize() nor c_serialize_spans()");
+	c_serialize(span_scratch);
+	out.clear();
+	out.push_back(core_state_span(span_scratch.empty() ? NULL : &span_scratch[0], span_scratch.size(), true));
+}
+
+void core_core::c_unserialize_spans(const std::vector<core_state_span>& in)
+{
+	default_guard g(in_default_unserialize, "c_unserialize() nor c_unserialize_spans()");
+	if(in.size() == 1) {
+		c_unserialize(in[0].data, in[0].size);
+		return;
+	}
+	size_t size = 0;
+	for(auto& i : in)
+		size += i.size;
+	span_scratch.resize(size);
+	size_t off = 0;
+	for(auto& i : in) {
+		if(i.size)
+			memcpy(&span_scratch[off], i.data, i.size);
+		off += i.size;
+	}
+	c_unserialize(span_scratch.empty() ? NULL : &span_scratch[0], span_scratch.size());
+}
+
 core_region& core_core::get_region()
 {
 	return c_get_region();
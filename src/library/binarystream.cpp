@@ -7,6 +7,7 @@
 #include <iterator>
 #include <map>
 #include <unistd.h>
+#include <sys/stat.h>
 
 //Damn Windows.
 #ifndef EWOULDBLOCK
@@ -37,7 +38,7 @@ namespace
 	{
 		size_t r = 0;
 		while(r < size) {
-			int maxr = 32767;
+			int maxr = 0x1000000;
 			if((size_t)maxr > (size - r))
 				maxr = size - r;
 			int x = read(s, buf + r, maxr);
@@ -286,9 +287,33 @@ void input::flush()
 {
 	if(!parent)
 		throw std::logic_error("binarystream::input::flush() can only be used in substreams");
-	char buf[256];
-	while(left)
-		read(buf, min(left, (uint64_t)256));
+	skip(left);
+}
+
+void input::skip(uint64_t size)
+{
+	if(parent) {
+		if(size > left)
+			throw std::runtime_error("Substream unexpected EOF");
+		parent->skip(size);
+		left -= size;
+		return;
+	}
+	//Seek over the data if possible, checking that it actually is there.
+	off_t pos = lseek(strm, 0, SEEK_CUR);
+	struct stat st;
+	if(pos >= 0 && !fstat(strm, &st) && S_ISREG(st.st_mode)) {
+		if((uint64_t)(st.st_size - pos) < size)
+			throw std::runtime_error("Unexpected EOF");
+		if(lseek(strm, size, SEEK_CUR) >= 0)
+			return;
+	}
+	char buf[4096];
+	while(size) {
+		size_t chunk = min(size, (uint64_t)sizeof(buf));
+		read(buf, chunk);
+		size -= chunk;
+	}
 }
 
 bool input::read(char* buf, size_t size, bool allow_none)
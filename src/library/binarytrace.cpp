@@ -0,0 +1,377 @@
+#include "binarytrace.hpp"
+#include "serialization.hpp"
+#include "streamcompress.hpp"
+#include "minmax.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <zlib.h>
+#ifdef LIBLZMA_AVAILABLE
+#include <lzma.h>
+#endif
+
+namespace binarytrace
+{
+namespace
+{
+	const char* magic = "lsnestrc";
+	const uint8_t version = 1;
+	//Maximum number of blocks waiting for the writer thread.
+	const size_t max_queued = 4;
+
+	std::vector<uint8_t> compress_block(const std::vector<uint8_t>& in, const std::string& name,
+		const std::string& args)
+	{
+		std::vector<uint8_t> out;
+		streamcompress::base* c = streamcompress::base::create_compressor(name, args);
+		try {
+			uint8_t* inp = const_cast<uint8_t*>(&in[0]);
+			size_t insize = in.size();
+			size_t used = 0;
+			out.resize(in.size() / 2 + 4096);
+			while(true) {
+				if(used == out.size())
+					out.resize(2 * out.size());
+				uint8_t* outp = &out[used];
+				size_t outsize = out.size() - used;
+				bool done = c->process(inp, insize, outp, outsize, true);
+				used = out.size() - outsize;
+				if(done)
+					break;
+			}
+			out.resize(used);
+		} catch(...) {
+			delete c;
+			throw;
+		}
+		delete c;
+		return out;
+	}
+
+	void decompress_gzip(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+	{
+		z_stream s;
+		memset(&s, 0, sizeof(s));
+		if(inflateInit2(&s, 16 + MAX_WBITS) != Z_OK)
+			throw std::runtime_error("Can't initialize decompressor");
+		s.next_in = const_cast<uint8_t*>(&in[0]);
+		s.avail_in = in.size();
+		s.next_out = &out[0];
+		s.avail_out = out.size();
+		int r = inflate(&s, Z_FINISH);
+		size_t left = s.avail_out;
+		inflateEnd(&s);
+		if(r != Z_STREAM_END || left)
+			throw std::runtime_error("Corrupt compressed block");
+	}
+
+	void decompress_lzma(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+	{
+#ifdef LIBLZMA_AVAILABLE
+		lzma_stream s = LZMA_STREAM_INIT;
+		if(lzma_auto_decoder(&s, UINT64_MAX, 0) != LZMA_OK)
+			throw std::runtime_error("Can't initialize decompressor");
+		s.next_in = &in[0];
+		s.avail_in = in.size();
+		s.next_out = &out[0];
+		s.avail_out = out.size();
+		lzma_ret r = lzma_code(&s, LZMA_FINISH);
+		size_t left = s.avail_out;
+		lzma_end(&s);
+		if(r != LZMA_STREAM_END || left)
+			throw std::runtime_error("Corrupt compressed block");
+#else
+		throw std::runtime_error("LZMA support not available");
+#endif
+	}
+
+	void write_string(std::vector<uint8_t>& out, const std::string& str)
+	{
+		size_t len = min(str.length(), (size_t)255);
+		out.push_back(len);
+		out.insert(out.end(), str.begin(), str.begin() + len);
+	}
+
+	struct parser
+	{
+		parser(const std::vector<uint8_t>& _data, size_t& _pos) : data(_data), pos(_pos) {}
+		const uint8_t* get(size_t size)
+		{
+			if(pos + size > data.size())
+				throw std::runtime_error("Truncated trace record");
+			const uint8_t* p = &data[pos];
+			pos += size;
+			return p;
+		}
+		uint8_t byte() { return *get(1); }
+		std::string string()
+		{
+			size_t len = byte();
+			const uint8_t* p = get(len);
+			return std::string((const char*)p, len);
+		}
+		const std::vector<uint8_t>& data;
+		size_t& pos;
+	};
+}
+
+writer::writer(const std::string& filename, const std::string& _compression, const std::string& _args)
+{
+	compression = _compression;
+	args = _args;
+	if(compression != "" && !streamcompress::base::get_compressors().count(compression))
+		throw std::runtime_error("Unknown compression '" + compression + "'");
+	stream.open(filename, std::ios::binary);
+	if(!stream)
+		throw std::runtime_error("Can't open '" + filename + "'");
+	stream.write(magic, 8);
+	std::vector<uint8_t> hdr;
+	hdr.push_back(version);
+	write_string(hdr, compression);
+	stream.write((const char*)&hdr[0], hdr.size());
+	current.resize(blocksize);
+	fill = 0;
+	quitting = false;
+	thread = new threads::thread(worker_trampoline, this);
+}
+
+writer::~writer()
+{
+	try {
+		flush();
+	} catch(...) {
+	}
+	{
+		threads::alock h(mlock);
+		quitting = true;
+		condition.notify_all();
+	}
+	thread->join();
+	delete thread;
+}
+
+void writer::cpu(unsigned cpu, const std::string& name, const cpu_info& info)
+{
+	std::vector<uint8_t> r;
+	r.push_back('C');
+	r.push_back(cpu);
+	write_string(r, name);
+	r.push_back(info.disassemblers.size());
+	for(auto& i : info.disassemblers)
+		write_string(r, i);
+	r.push_back(info.registers.size());
+	for(auto& i : info.registers) {
+		write_string(r, i.first);
+		r.push_back(i.second);
+	}
+	memcpy(reserve(r.size()), &r[0], r.size());
+}
+
+void writer::frame(uint64_t frame)
+{
+	uint8_t* p = reserve(9);
+	p[0] = 'F';
+	serialization::u64l(p + 1, frame);
+}
+
+void writer::text(unsigned cpu, const char* str, bool true_insn)
+{
+	size_t len = min(strlen(str), (size_t)65535);
+	uint8_t* p = reserve(5 + len);
+	p[0] = 'T';
+	p[1] = cpu;
+	p[2] = true_insn ? 1 : 0;
+	serialization::u16l(p + 3, len);
+	memcpy(p + 5, str, len);
+}
+
+void writer::encode_insn(uint8_t* p, unsigned cpu, const insn& i)
+{
+	p[0] = 'I';
+	p[1] = cpu;
+	p[2] = i.variant;
+	p[3] = i.reglen;
+	serialization::u32l(p + 4, i.pc);
+	serialization::u32l(p + 8, i.stamp);
+	memcpy(p + 12, i.opcode, sizeof(i.opcode));
+	memcpy(p + 12 + sizeof(i.opcode), i.regs, i.reglen);
+}
+
+void writer::flush()
+{
+	if(!fill)
+		return;
+	threads::alock h(mlock);
+	while(queue.size() >= max_queued && error == "")
+		condition.wait(h);
+	if(error != "")
+		throw std::runtime_error(error);
+	current.resize(fill);
+	queue.push_back(std::vector<uint8_t>());
+	std::swap(queue.back(), current);
+	//Reuse buffers the thread is done with.
+	if(!spare.empty()) {
+		std::swap(current, spare.back());
+		spare.pop_back();
+	}
+	current.resize(blocksize);
+	fill = 0;
+	condition.notify_all();
+}
+
+void* writer::worker_trampoline(writer* w)
+{
+	w->worker_loop();
+	return NULL;
+}
+
+void writer::worker_loop()
+{
+	threads::alock h(mlock);
+	while(true) {
+		while(!quitting && queue.empty())
+			condition.wait(h);
+		if(queue.empty())
+			return;
+		//Only this thread removes from the queue, so the front stays put.
+		std::vector<uint8_t>& b = queue.front();
+		h.unlock();
+		try {
+			std::vector<uint8_t> c;
+			uint8_t hdr[8];
+			serialization::u32l(hdr, b.size());
+			if(compression != "") {
+				c = compress_block(b, compression, args);
+				serialization::u32l(hdr + 4, c.size());
+			} else
+				serialization::u32l(hdr + 4, b.size());
+			stream.write((const char*)hdr, 8);
+			if(compression != "")
+				stream.write((const char*)&c[0], c.size());
+			else
+				stream.write((const char*)&b[0], b.size());
+			stream.flush();
+			if(!stream)
+				throw std::runtime_error("Error writing trace");
+		} catch(std::bad_alloc& e) {
+			h.lock();
+			error = "Out of memory";
+			h.unlock();
+		} catch(std::exception& e) {
+			h.lock();
+			error = e.what();
+			h.unlock();
+		}
+		h.lock();
+		spare.push_back(std::vector<uint8_t>());
+		std::swap(spare.back(), queue.front());
+		queue.pop_front();
+		condition.notify_all();
+	}
+}
+
+reader::reader(const std::string& filename)
+{
+	stream.open(filename, std::ios::binary);
+	if(!stream)
+		throw std::runtime_error("Can't open '" + filename + "'");
+	char hdr[10];
+	stream.read(hdr, 10);
+	if(!stream || memcmp(hdr, magic, 8))
+		throw std::runtime_error("Not a binary trace file");
+	if((uint8_t)hdr[8] != version)
+		throw std::runtime_error("Unsupported trace version");
+	size_t len = (uint8_t)hdr[9];
+	std::vector<char> name(len + 1);
+	stream.read(&name[0], len);
+	if(!stream)
+		throw std::runtime_error("Truncated trace header");
+	compression = std::string(&name[0], len);
+	if(compression != "" && compression != "gzip" && compression != "xz" && compression != "lzma")
+		throw std::runtime_error("Unsupported trace compression '" + compression + "'");
+	pos = 0;
+}
+
+bool reader::next_block()
+{
+	uint8_t hdr[8];
+	stream.read((char*)hdr, 8);
+	if(!stream)
+		return false;
+	size_t size = serialization::u32l(hdr);
+	size_t stored = serialization::u32l(hdr + 4);
+	std::vector<uint8_t> data(stored);
+	stream.read((char*)&data[0], stored);
+	if(!stream)
+		throw std::runtime_error("Truncated trace block");
+	if(compression == "") {
+		if(size != stored)
+			throw std::runtime_error("Bad trace block size");
+		std::swap(block, data);
+	} else {
+		block.resize(size);
+		if(compression == "gzip")
+			decompress_gzip(data, block);
+		else
+			decompress_lzma(data, block);
+	}
+	pos = 0;
+	return true;
+}
+
+bool reader::read(record& r)
+{
+	while(pos == block.size())
+		if(!next_block())
+			return false;
+	parser p(block, pos);
+	uint8_t t = p.byte();
+	switch(t) {
+	case 'C': {
+		r.type = record::CPU;
+		r.cpu = p.byte();
+		r.name = p.string();
+		r.info.disassemblers.clear();
+		r.info.registers.clear();
+		size_t n = p.byte();
+		for(size_t i = 0; i < n; i++)
+			r.info.disassemblers.push_back(p.string());
+		n = p.byte();
+		for(size_t i = 0; i < n; i++) {
+			std::string name = p.string();
+			r.info.registers.push_back(std::make_pair(name, p.byte()));
+		}
+		break;
+	}
+	case 'F':
+		r.type = record::FRAME;
+		r.frame = serialization::u64l(p.get(8));
+		break;
+	case 'I': {
+		r.type = record::INSN;
+		r.cpu = p.byte();
+		r.i.variant = p.byte();
+		r.i.reglen = p.byte();
+		if(r.i.reglen > sizeof(r.i.regs))
+			throw std::runtime_error("Bad register snapshot size");
+		r.i.pc = serialization::u32l(p.get(4));
+		r.i.stamp = serialization::u32l(p.get(4));
+		memcpy(r.i.opcode, p.get(sizeof(r.i.opcode)), sizeof(r.i.opcode));
+		if(r.i.reglen)
+			memcpy(r.i.regs, p.get(r.i.reglen), r.i.reglen);
+		break;
+	}
+	case 'T': {
+		r.type = record::TEXT;
+		const uint8_t* h = p.get(4);
+		r.cpu = h[0];
+		r.true_insn = h[1];
+		size_t len = serialization::u16l(h + 2);
+		r.text = std::string((const char*)p.get(len), len);
+		break;
+	}
+	default:
+		throw std::runtime_error("Unknown trace record type");
+	}
+	return true;
+}
+}
@@ -0,0 +1,213 @@
+#include "fileimage-index.hpp"
+#include "directory.hpp"
+#include "sha256.hpp"
+#include "string.hpp"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace fileimage
+{
+namespace
+{
+	//Compact when there are more dead lines than this plus number of live entries.
+	const size_t compact_slack = 256;
+
+	std::string format_line(const std::string& file, uint64_t prefix, const std::string& hash, uint64_t size,
+		int64_t mtime)
+	{
+		if(hash == "")
+			return (stringfmt() << ":" << prefix << "|" << file).str();
+		if(size == hash_index::unknown_size)
+			return (stringfmt() << hash << ":" << prefix << "|" << file).str();
+		return (stringfmt() << hash << ":" << prefix << ":" << size << ":" << mtime << "|" << file).str();
+	}
+}
+
+std::string hash_file(const std::string& filename, uint64_t prefix)
+{
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if(!fp)
+		throw std::runtime_error("Can't open file");
+	sha256 hash;
+	uint64_t toskip = prefix;
+	unsigned char buf[65536];
+	while(!feof(fp) && !ferror(fp)) {
+		size_t s = fread(buf, 1, sizeof(buf), fp);
+		size_t offset = (toskip < s) ? toskip : s;
+		toskip -= offset;
+		if(s > offset)
+			hash.write(buf + offset, s - offset);
+	}
+	bool err = ferror(fp);
+	fclose(fp);
+	if(err)
+		throw std::runtime_error("Can't read file");
+	return hash.read();
+}
+
+hash_index::hash_index(const std::string& _filename)
+	: filename(_filename)
+{
+	loaded = false;
+	lines = 0;
+}
+
+void hash_index::load()
+{
+	if(loaded)
+		return;
+	loaded = true;
+	std::ifstream db(filename);
+	if(!db)
+		return;
+	std::string line;
+	while(std::getline(db, line)) {
+		istrip_CR(line);
+		lines++;
+		size_t split = line.find_first_of("|");
+		if(split >= line.length())
+			continue;
+		std::string file = line.substr(split + 1);
+		//hash:prefix:size:mtime, or hash:prefix / hash in older files.
+		std::string fields = line.substr(0, split);
+		std::vector<std::string> f;
+		for(auto i : token_iterator<char>::foreach(fields, {":"}))
+			f.push_back(i);
+		entry e;
+		uint64_t prefix = 0;
+		e.hash = f.size() > 0 ? f[0] : "";
+		e.size = unknown_size;
+		e.mtime = 0;
+		try {
+			if(f.size() > 1) prefix = parse_value<uint64_t>(f[1]);
+			if(f.size() > 3) {
+				e.size = parse_value<uint64_t>(f[2]);
+				e.mtime = parse_value<int64_t>(f[3]);
+			}
+		} catch(...) {
+			continue;
+		}
+		set(std::make_pair(file, prefix), e);
+	}
+	if(lines > entries.size() + compact_slack)
+		do_compact();
+}
+
+void hash_index::set(const key_t& key, const entry& e)
+{
+	auto i = entries.find(key);
+	if(i != entries.end()) {
+		auto r = reverse.equal_range(i->second.hash);
+		for(auto j = r.first; j != r.second; j++)
+			if(j->second == key) {
+				reverse.erase(j);
+				break;
+			}
+		entries.erase(i);
+	}
+	if(e.hash == "")
+		return;
+	entries[key] = e;
+	reverse.insert(std::make_pair(e.hash, key));
+}
+
+void hash_index::append(const key_t& key, const entry& e)
+{
+	if(lines + 1 > entries.size() + compact_slack) {
+		do_compact();
+		return;
+	}
+	std::ofstream db(filename, std::ios::app);
+	db << format_line(key.first, key.second, e.hash, e.size, e.mtime) << std::endl;
+	lines++;
+}
+
+void hash_index::do_compact()
+{
+	std::string tmpfile = filename + ".tmp";
+	{
+		std::ofstream db(tmpfile);
+		if(!db)
+			return;
+		for(auto& i : entries)
+			db << format_line(i.first.first, i.first.second, i.second.hash, i.second.size,
+				i.second.mtime) << "\n";
+		if(!db) {
+			remove(tmpfile.c_str());
+			return;
+		}
+	}
+	if(directory::rename_overwrite(tmpfile.c_str(), filename.c_str()) < 0) {
+		remove(tmpfile.c_str());
+		return;
+	}
+	lines = entries.size();
+}
+
+std::string hash_index::lookup(const std::string& file, uint64_t prefix, uint64_t size, int64_t mtime)
+{
+	threads::alock h(mlock);
+	load();
+	auto i = entries.find(std::make_pair(file, prefix));
+	if(i == entries.end() || i->second.size == unknown_size || i->second.size != size ||
+		i->second.mtime != mtime)
+		return "";
+	return i->second.hash;
+}
+
+void hash_index::store(const std::string& file, uint64_t prefix, uint64_t size, int64_t mtime,
+	const std::string& hash)
+{
+	threads::alock h(mlock);
+	load();
+	key_t key = std::make_pair(file, prefix);
+	auto i = entries.find(key);
+	if(hash == "" && i == entries.end())
+		return;		//Already correct.
+	if(i != entries.end() && i->second.hash == hash && i->second.size == size && i->second.mtime == mtime)
+		return;		//Already correct.
+	entry e;
+	e.hash = hash;
+	e.size = size;
+	e.mtime = mtime;
+	set(key, e);
+	append(key, e);
+}
+
+void hash_index::erase(const std::string& file)
+{
+	threads::alock h(mlock);
+	load();
+	entry e;
+	e.size = unknown_size;
+	e.mtime = 0;
+	while(true) {
+		auto i = entries.lower_bound(std::make_pair(file, 0));
+		if(i == entries.end() || i->first.first != file)
+			return;
+		key_t key = i->first;
+		set(key, e);
+		append(key, e);
+	}
+}
+
+std::list<std::pair<std::string, uint64_t>> hash_index::by_hash(const std::string& hash)
+{
+	threads::alock h(mlock);
+	load();
+	std::list<std::pair<std::string, uint64_t>> x;
+	auto r = reverse.equal_range(hash);
+	for(auto i = r.first; i != r.second; i++)
+		x.push_back(i->second);
+	return x;
+}
+
+void hash_index::compact()
+{
+	threads::alock h(mlock);
+	load();
+	do_compact();
+}
+}
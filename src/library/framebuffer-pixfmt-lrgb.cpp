@@ -28,7 +28,8 @@ void _pixfmt_lrgb::decode(uint32_t* target, const uint8_t* src, size_t width,
 	const auxpalette<false>& auxp) throw()
 {
 	const uint32_t* _src = reinterpret_cast<const uint32_t*>(src);
-	for(size_t i = 0; i < width; i++)
+	size_t i = decode_pal32_simd(target, _src, width, &auxp.pcache[0], 0x7FFFF);
+	for(; i < width; i++)
 		target[i] = auxp.pcache[_src[i] & 0x7FFFF];
 }
 
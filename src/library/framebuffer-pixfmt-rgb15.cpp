@@ -29,7 +29,8 @@ void _pixfmt_rgb15<uvswap>::decode(uint32_t* target, const uint8_t* src, size_t
 	const auxpalette<false>& auxp) throw()
 {
 	const uint16_t* _src = reinterpret_cast<const uint16_t*>(src);
-	for(size_t i = 0; i < width; i++)
+	size_t i = decode_pal16_simd(target, _src, width, &auxp.pcache[0], 0x7FFF);
+	for(; i < width; i++)
 		target[i] = auxp.pcache[_src[i] & 0x7FFF];
 }
 
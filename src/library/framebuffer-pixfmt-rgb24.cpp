@@ -10,14 +10,15 @@ _pixfmt_rgb24<uvswap>::~_pixfmt_rgb24() throw() {}
 template<bool uvswap>
 void _pixfmt_rgb24<uvswap>::decode(uint32_t* target, const uint8_t* src, size_t width) throw()
 {
+	size_t i = decode_rgb24_simd(target, src, width, uvswap, 16, 8, 0);
 	if(uvswap) {
-		for(size_t i = 0; i < width; i++) {
+		for(; i < width; i++) {
 			target[i] = (uint32_t)src[3 * i + 2] << 16;
 			target[i] |= (uint32_t)src[3 * i + 1] << 8;
 			target[i] |= src[3 * i + 0];
 		}
 	} else {
-		for(size_t i = 0; i < width; i++) {
+		for(; i < width; i++) {
 			target[i] = (uint32_t)src[3 * i + 0] << 16;
 			target[i] |= (uint32_t)src[3 * i + 1] << 8;
 			target[i] |= src[3 * i + 2];
@@ -29,7 +30,8 @@ template<bool uvswap>
 void _pixfmt_rgb24<uvswap>::decode(uint32_t* target, const uint8_t* src, size_t width,
 	const auxpalette<false>& auxp) throw()
 {
-	for(size_t i = 0; i < width; i++) {
+	size_t i = decode_rgb24_simd(target, src, width, uvswap, auxp.rshift, auxp.gshift, auxp.bshift);
+	for(; i < width; i++) {
 		target[i] = static_cast<uint32_t>(src[3 * i + (uvswap ? 2 : 0)]) << auxp.rshift;
 		target[i] |= static_cast<uint32_t>(src[3 * i + 1]) << auxp.gshift;
 		target[i] |= static_cast<uint32_t>(src[3 * i + (uvswap ? 0 : 2)]) << auxp.bshift;
@@ -16,7 +16,8 @@ void _pixfmt_rgb32::decode(uint32_t* target, const uint8_t* src, size_t width,
 	const auxpalette<false>& auxp) throw()
 {
 	const uint32_t* _src = reinterpret_cast<const uint32_t*>(src);
-	for(size_t i = 0; i < width; i++) {
+	size_t i = decode_rgb32_simd(target, _src, width, auxp.rshift, auxp.gshift, auxp.bshift);
+	for(; i < width; i++) {
 		target[i] = ((_src[i] >> 16) & 0xFF) << auxp.rshift;
 		target[i] |= ((_src[i] >> 8) & 0xFF) << auxp.gshift;
 		target[i] |= (_src[i] & 0xFF) << auxp.bshift;
@@ -0,0 +1,289 @@
+#include "framebuffer.hpp"
+#include "arch-detect.hpp"
+#include <cstring>
+
+namespace framebuffer
+{
+namespace
+{
+	const unsigned CPU_SSE2 = 1;
+	const unsigned CPU_SSSE3 = 2;
+	const unsigned CPU_AVX2 = 4;
+
+	unsigned detect_features()
+	{
+		unsigned f = 0;
+#ifdef ARCH_IS_I386
+		uint32_t a, b, c, d;
+		asm volatile("cpuid\n" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(0), "c"(0));
+		uint32_t maxleaf = a;
+		asm volatile("cpuid\n" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1), "c"(0));
+		if(d & (1U << 26))
+			f |= CPU_SSE2;
+		if(c & (1U << 9))
+			f |= CPU_SSSE3;
+		//AVX2 also needs the OS to save YMM state (OSXSAVE, and XCR0 bits 1 and 2).
+		if(maxleaf >= 7 && (c & (1U << 27)) && (c & (1U << 28))) {
+			uint32_t xcr0, xcr0h;
+			asm volatile(".byte 0x0f, 0x01, 0xd0\n" : "=a"(xcr0), "=d"(xcr0h) : "c"(0));	//XGETBV
+			asm volatile("cpuid\n" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+			if((xcr0 & 6) == 6 && (b & (1U << 5)))
+				f |= CPU_AVX2;
+		}
+#endif
+		return f;
+	}
+
+	unsigned cpu_features()
+	{
+		static unsigned features = detect_features();
+		return features;
+	}
+
+#ifdef ARCH_IS_I386
+	const char mask_rgb24[] __attribute__ ((aligned (16))) = {
+		 2,  1,  0, -1,  5,  4,  3, -1,  8,  7,  6, -1, 11, 10,  9, -1,
+	};
+	const char mask_bgr24[] __attribute__ ((aligned (16))) = {
+		 0,  1,  2, -1,  3,  4,  5, -1,  6,  7,  8, -1,  9, 10, 11, -1,
+	};
+
+//Load 0xFF mask to xmm4 and channel shifts to xmm5-xmm7.
+#define SSE2_LOAD_SHIFTS(r, g, b) \
+	"\tPCMPEQD %%xmm4,%%xmm4\n" \
+	"\tPSRLD $24,%%xmm4\n" \
+	"\tMOVD " r ",%%xmm5\n" \
+	"\tMOVD " g ",%%xmm6\n" \
+	"\tMOVD " b ",%%xmm7\n"
+//Convert 0RGB pixels in xmm0 to shifted channels. Trashes xmm1 and xmm2.
+#define SSE2_CONVERT \
+	"\tMOVDQA %%xmm0,%%xmm1\n" \
+	"\tMOVDQA %%xmm0,%%xmm2\n" \
+	"\tPSRLD $16,%%xmm1\n" \
+	"\tPSRLD $8,%%xmm2\n" \
+	"\tPAND %%xmm4,%%xmm0\n" \
+	"\tPAND %%xmm4,%%xmm1\n" \
+	"\tPAND %%xmm4,%%xmm2\n" \
+	"\tPSLLD %%xmm5,%%xmm1\n" \
+	"\tPSLLD %%xmm6,%%xmm2\n" \
+	"\tPSLLD %%xmm7,%%xmm0\n" \
+	"\tPOR %%xmm1,%%xmm0\n" \
+	"\tPOR %%xmm2,%%xmm0\n"
+#define SSE2_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm4", "xmm5", "xmm6", "xmm7", "memory", "cc"
+
+	void sse2_rgb32(uint32_t* dest, const uint32_t* src, size_t blocks, uint32_t r, uint32_t g, uint32_t b)
+	{
+		asm volatile(
+			SSE2_LOAD_SHIFTS("%3", "%4", "%5")
+			"1:\n"
+			"\tMOVDQU (%1),%%xmm0\n"
+			SSE2_CONVERT
+			"\tMOVDQU %%xmm0,(%0)\n"
+			"\tADD $16,%0\n"
+			"\tADD $16,%1\n"
+			"\tDEC %2\n"
+			"\tJNZ 1b\n"
+			: "+r"(dest), "+r"(src), "+r"(blocks) : "m"(r), "m"(g), "m"(b) : SSE2_CLOBBERS);
+	}
+
+	void ssse3_rgb24(uint32_t* dest, const uint8_t* src, size_t blocks, const char* mask, uint32_t r,
+		uint32_t g, uint32_t b)
+	{
+		asm volatile(
+			SSE2_LOAD_SHIFTS("%4", "%5", "%6")
+			"\tMOVDQA (%3),%%xmm3\n"
+			"1:\n"
+			"\tMOVDQU (%1),%%xmm0\n"
+			"\tPSHUFB %%xmm3,%%xmm0\n"
+			SSE2_CONVERT
+			"\tMOVDQU %%xmm0,(%0)\n"
+			"\tADD $16,%0\n"
+			"\tADD $12,%1\n"
+			"\tDEC %2\n"
+			"\tJNZ 1b\n"
+			: "+r"(dest), "+r"(src), "+r"(blocks) : "r"(mask), "m"(r), "m"(g), "m"(b)
+			: "xmm3", SSE2_CLOBBERS);
+	}
+
+	void avx2_rgb32(uint32_t* dest, const uint32_t* src, size_t blocks, uint32_t r, uint32_t g, uint32_t b)
+	{
+		asm volatile(
+			"\tVPCMPEQD %%ymm4,%%ymm4,%%ymm4\n"
+			"\tVPSRLD $24,%%ymm4,%%ymm4\n"
+			"\tVMOVD %3,%%xmm5\n"
+			"\tVMOVD %4,%%xmm6\n"
+			"\tVMOVD %5,%%xmm7\n"
+			"1:\n"
+			"\tVMOVDQU (%1),%%ymm0\n"
+			"\tVPSRLD $16,%%ymm0,%%ymm1\n"
+			"\tVPSRLD $8,%%ymm0,%%ymm2\n"
+			"\tVPAND %%ymm4,%%ymm0,%%ymm0\n"
+			"\tVPAND %%ymm4,%%ymm1,%%ymm1\n"
+			"\tVPAND %%ymm4,%%ymm2,%%ymm2\n"
+			"\tVPSLLD %%xmm5,%%ymm1,%%ymm1\n"
+			"\tVPSLLD %%xmm6,%%ymm2,%%ymm2\n"
+			"\tVPSLLD %%xmm7,%%ymm0,%%ymm0\n"
+			"\tVPOR %%ymm1,%%ymm0,%%ymm0\n"
+			"\tVPOR %%ymm2,%%ymm0,%%ymm0\n"
+			"\tVMOVDQU %%ymm0,(%0)\n"
+			"\tADD $32,%0\n"
+			"\tADD $32,%1\n"
+			"\tDEC %2\n"
+			"\tJNZ 1b\n"
+			"\tVZEROUPPER\n"
+			: "+r"(dest), "+r"(src), "+r"(blocks) : "m"(r), "m"(g), "m"(b) : SSE2_CLOBBERS);
+	}
+
+	//Palette lookups: zero-extend 8 indices into ymm0, mask them and gather.
+#define AVX2_GATHER(load, srcstep) \
+		asm volatile( \
+			"\tVMOVD %4,%%xmm6\n" \
+			"\tVPBROADCASTD %%xmm6,%%ymm6\n" \
+			"1:\n" \
+			"\t" load " (%1),%%ymm0\n" \
+			"\tVPAND %%ymm6,%%ymm0,%%ymm0\n" \
+			"\tVPCMPEQD %%ymm2,%%ymm2,%%ymm2\n" \
+			"\tVPXOR %%ymm1,%%ymm1,%%ymm1\n" \
+			"\tVPGATHERDD %%ymm2,(%3,%%ymm0,4),%%ymm1\n" \
+			"\tVMOVDQU %%ymm1,(%0)\n" \
+			"\tADD $32,%0\n" \
+			"\tADD $" srcstep ",%1\n" \
+			"\tDEC %2\n" \
+			"\tJNZ 1b\n" \
+			"\tVZEROUPPER\n" \
+			: "+r"(dest), "+r"(src), "+r"(blocks) : "r"(palette), "m"(mask) \
+			: "xmm0", "xmm1", "xmm2", "xmm6", "memory", "cc");
+
+	void avx2_pal16(uint32_t* dest, const uint16_t* src, size_t blocks, const uint32_t* palette, uint32_t mask)
+	{
+		AVX2_GATHER("VPMOVZXWD", "16")
+	}
+
+	void avx2_pal32(uint32_t* dest, const uint32_t* src, size_t blocks, const uint32_t* palette, uint32_t mask)
+	{
+		AVX2_GATHER("VMOVDQU", "32")
+	}
+
+//Replicate each of 4 pixels in xmm0 hscale times.
+#define SSE2_SCALE(stores, dstep) \
+		asm volatile( \
+			"1:\n" \
+			"\tMOVDQU (%1),%%xmm0\n" \
+			stores \
+			"\tADD $" dstep ",%0\n" \
+			"\tADD $16,%1\n" \
+			"\tDEC %2\n" \
+			"\tJNZ 1b\n" \
+			: "+r"(dest), "+r"(src), "+r"(blocks) : : "xmm0", "xmm1", "memory", "cc");
+#define SSE2_STORE(shuffle, offset) \
+			"\tPSHUFD $" shuffle ",%%xmm0,%%xmm1\n" \
+			"\tMOVDQU %%xmm1," offset "(%0)\n"
+
+	void sse2_scale2(uint32_t* dest, const uint32_t* src, size_t blocks)
+	{
+		SSE2_SCALE(SSE2_STORE("0x50", "0") SSE2_STORE("0xFA", "16"), "32")
+	}
+
+	void sse2_scale3(uint32_t* dest, const uint32_t* src, size_t blocks)
+	{
+		SSE2_SCALE(SSE2_STORE("0x40", "0") SSE2_STORE("0xA5", "16") SSE2_STORE("0xFE", "32"), "48")
+	}
+
+	void sse2_scale4(uint32_t* dest, const uint32_t* src, size_t blocks)
+	{
+		SSE2_SCALE(SSE2_STORE("0x00", "0") SSE2_STORE("0x55", "16") SSE2_STORE("0xAA", "32")
+			SSE2_STORE("0xFF", "48"), "64")
+	}
+#endif
+}
+
+size_t decode_rgb32_simd(uint32_t* dest, const uint32_t* src, size_t width, uint8_t rshift, uint8_t gshift,
+	uint8_t bshift)
+{
+#ifdef ARCH_IS_I386
+	unsigned f = cpu_features();
+	if((f & CPU_AVX2) && width >= 8) {
+		avx2_rgb32(dest, src, width / 8, rshift, gshift, bshift);
+		return width / 8 * 8;
+	}
+	if((f & CPU_SSE2) && width >= 4) {
+		sse2_rgb32(dest, src, width / 4, rshift, gshift, bshift);
+		return width / 4 * 4;
+	}
+#endif
+	return 0;
+}
+
+size_t decode_rgb24_simd(uint32_t* dest, const uint8_t* src, size_t width, bool swap, uint8_t rshift,
+	uint8_t gshift, uint8_t bshift)
+{
+#ifdef ARCH_IS_I386
+	//Each block reads 16 bytes but only consumes 12, don't read past the end.
+	if((cpu_features() & CPU_SSSE3) && 3 * width >= 16) {
+		size_t blocks = (3 * width - 16) / 12 + 1;
+		ssse3_rgb24(dest, src, blocks, swap ? mask_bgr24 : mask_rgb24, rshift, gshift, bshift);
+		return 4 * blocks;
+	}
+#endif
+	return 0;
+}
+
+size_t decode_pal16_simd(uint32_t* dest, const uint16_t* src, size_t width, const uint32_t* palette,
+	uint32_t mask)
+{
+#ifdef ARCH_IS_I386
+	if((cpu_features() & CPU_AVX2) && width >= 8) {
+		avx2_pal16(dest, src, width / 8, palette, mask);
+		return width / 8 * 8;
+	}
+#endif
+	return 0;
+}
+
+size_t decode_pal32_simd(uint32_t* dest, const uint32_t* src, size_t width, const uint32_t* palette,
+	uint32_t mask)
+{
+#ifdef ARCH_IS_I386
+	if((cpu_features() & CPU_AVX2) && width >= 8) {
+		avx2_pal32(dest, src, width / 8, palette, mask);
+		return width / 8 * 8;
+	}
+#endif
+	return 0;
+}
+
+void scale_row(uint32_t* dest, const uint32_t* src, size_t width, size_t hscale)
+{
+	if(hscale == 1) {
+		memcpy(dest, src, sizeof(uint32_t) * width);
+		return;
+	}
+	size_t done = 0;
+#ifdef ARCH_IS_I386
+	if((cpu_features() & CPU_SSE2) && width >= 4 && hscale >= 2 && hscale <= 4) {
+		size_t blocks = width / 4;
+		switch(hscale) {
+		case 2:		sse2_scale2(dest, src, blocks); break;
+		case 3:		sse2_scale3(dest, src, blocks); break;
+		case 4:		sse2_scale4(dest, src, blocks); break;
+		}
+		done = 4 * blocks;
+		dest += done * hscale;
+	}
+#endif
+	for(size_t i = done; i < width; i++)
+		for(size_t j = 0; j < hscale; j++)
+			*(dest++) = src[i];
+}
+
+void scale_row(uint64_t* dest, const uint64_t* src, size_t width, size_t hscale)
+{
+	if(hscale == 1) {
+		memcpy(dest, src, sizeof(uint64_t) * width);
+		return;
+	}
+	for(size_t i = 0; i < width; i++)
+		for(size_t j = 0; j < hscale; j++)
+			*(dest++) = src[i];
+}
+}
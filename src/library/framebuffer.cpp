@@ -8,6 +8,7 @@
 #include <cstring>
 #include <iostream>
 #include <list>
+#include <memory>
 
 #define TABSTOPS 64
 #define SCREENSHOT_RGB_MAGIC	0x74212536U
@@ -121,6 +122,42 @@ namespace
 		static std::map<std::string, std::pair<std::function<void(int64_t& v)>, bool>> c;
 		return c;
 	}
+
+	//Screens lower than this many rows per band are not split further.
+	const size_t min_band_rows = 32;
+	//Runs of objects covering fewer pixels (rows times screen width) than this are drawn without the band threads.
+	const uint64_t min_band_area = 65536;
+	//Number of bands forced by queue::set_forced_bands(), 0 if not forced.
+	unsigned forced_bands = 0;
+
+	//Number of bands to split screen of given height to for drawing.
+	unsigned band_count(size_t height)
+	{
+		if(forced_bands)
+			return max(min((size_t)forced_bands, height), (size_t)1);
+		size_t n = threads::thread::hardware_concurrency();
+		if(n < 2)
+			return 1;
+		n = min(4 * n, height / min_band_rows);
+		return max(n, (size_t)1);
+	}
+
+	//Make views of each band of screen.
+	template<bool X> bool make_band_views(fb<X>& scr, unsigned bands, std::unique_ptr<fb<X>[]>& views) throw()
+	{
+		size_t height = scr.get_height();
+		try {
+			views.reset(new fb<X>[bands]);
+		} catch(...) {
+			return false;
+		}
+		for(unsigned b = 0; b < bands; b++)
+			if(!views[b].set_band(scr, b * height / bands, (b + 1) * height / bands - b * height / bands)) {
+				views.reset();
+				return false;
+			}
+		return true;
+	}
 }
 
 basecolor::basecolor(const std::string& name, int64_t value)
@@ -394,40 +431,45 @@ void fb<X>::copy_from(raw& scr, size_t hscale, size_t vscale) throw()
 		current_fmt = scr.fmt;
 	}
 
-	for(size_t y = 0; y < height; y++)
-		memset(rowptr(y), 0, sizeof(typename fb<X>::element_t) * width);
-	if(width < offset_x || height < offset_y) {
-		//Just clear the screen.
-		return;
-	}
 	size_t copyable_width = 0, copyable_height = 0;
-	if(hscale)
-		copyable_width = (width - offset_x) / hscale;
-	if(vscale)
-		copyable_height = (height - offset_y) / vscale;
-	copyable_width = (copyable_width > scr.width) ? scr.width : copyable_width;
-	copyable_height = (copyable_height > scr.height) ? scr.height : copyable_height;
+	if(width >= offset_x && height >= offset_y) {
+		if(hscale)
+			copyable_width = (width - offset_x) / hscale;
+		if(vscale)
+			copyable_height = (height - offset_y) / vscale;
+		copyable_width = (copyable_width > scr.width) ? scr.width : copyable_width;
+		copyable_height = (copyable_height > scr.height) ? scr.height : copyable_height;
+	}
+	//Only clear the parts of the screen that are not overwritten.
+	size_t copy_left = offset_x, copy_right = offset_x + copyable_width * hscale;
+	size_t copy_top = offset_y, copy_bottom = offset_y + copyable_height * vscale;
+	if(!copyable_width || !copyable_height)
+		copy_top = copy_bottom = 0;
+	for(size_t y = 0; y < height; y++) {
+		if(y < copy_top || y >= copy_bottom)
+			memset(rowptr(y), 0, sizeof(typename fb<X>::element_t) * width);
+		else {
+			memset(rowptr(y), 0, sizeof(typename fb<X>::element_t) * copy_left);
+			memset(rowptr(y) + copy_right, 0, sizeof(typename fb<X>::element_t) * (width - copy_right));
+		}
+	}
 
+	size_t bpp = scr.fmt->get_bpp();
 	for(size_t y = 0; y < copyable_height; y++) {
 		size_t line = y * vscale + offset_y;
 		const uint8_t* sbase = reinterpret_cast<uint8_t*>(scr.addr) + y * scr.stride;
 		typename fb<X>::element_t* ptr = rowptr(line) + offset_x;
-		size_t bpp = scr.fmt->get_bpp();
-		size_t xptr = 0;
-		size_t old_copyable_width = copyable_width;
-		while(copyable_width > DECBUF_SIZE) {
-			scr.fmt->decode(decbuf, sbase + xptr * bpp, DECBUF_SIZE, auxpal);
-			for(size_t k = 0; k < DECBUF_SIZE; k++)
-				for(size_t i = 0; i < hscale; i++)
-					*(ptr++) = decbuf[k];
-			xptr += DECBUF_SIZE;
-			copyable_width -= DECBUF_SIZE;
+		for(size_t xptr = 0; xptr < copyable_width; xptr += DECBUF_SIZE) {
+			size_t chunk = min(copyable_width - xptr, (size_t)DECBUF_SIZE);
+			//Without horizontal scaling, decode straight into the framebuffer.
+			if(hscale == 1)
+				scr.fmt->decode(ptr, sbase + xptr * bpp, chunk, auxpal);
+			else {
+				scr.fmt->decode(decbuf, sbase + xptr * bpp, chunk, auxpal);
+				scale_row(ptr, decbuf, chunk, hscale);
+			}
+			ptr += chunk * hscale;
 		}
-		scr.fmt->decode(decbuf, sbase + xptr * bpp, copyable_width, auxpal);
-		for(size_t k = 0; k < copyable_width; k++)
-			for(size_t i = 0; i < hscale; i++)
-				*(ptr++) = decbuf[k];
-		copyable_width = old_copyable_width;
 		for(size_t j = 1; j < vscale; j++)
 			memcpy(rowptr(line + j) + offset_x, rowptr(line) + offset_x,
 				sizeof(typename fb<X>::element_t) * hscale * copyable_width);
@@ -465,6 +507,32 @@ void fb<X>::set(element_t* _memory, size_t _width, size_t _height, size_t _pitch
 	upside_down = false;
 }
 
+template<bool X>
+bool fb<X>::set_band(fb<X>& parent, size_t first, size_t count) throw()
+{
+	element_t* base = parent.rowptr(parent.upside_down ? first + count - 1 : first);
+	//rowptr() realigns the memory, so the band has to start aligned.
+	if((16 - reinterpret_cast<size_t>(base)) % 16 / 4)
+		return false;
+	if(user_mem && mem)
+		delete[] mem;
+	mem = base;
+	width = parent.width;
+	height = count;
+	stride = parent.stride;
+	user_mem = false;
+	upside_down = parent.upside_down;
+	offset_x = parent.offset_x;
+	offset_y = parent.offset_y - first;
+	last_blit_w = parent.last_blit_w;
+	last_blit_h = parent.last_blit_h;
+	current_fmt = parent.current_fmt;
+	active_rshift = parent.active_rshift;
+	active_gshift = parent.active_gshift;
+	active_bshift = parent.active_bshift;
+	return true;
+}
+
 template<bool X>
 void fb<X>::reallocate(size_t _width, size_t _height, bool _upside_down) throw(std::bad_alloc)
 {
@@ -506,7 +574,8 @@ const typename fb<X>::element_t* fb<X>::rowptr(size_t row) const throw()
 {
 	if(upside_down)
 		row = height - row - 1;
-	return mem + stride * row;
+	uint32_t align = (16 - reinterpret_cast<size_t>(mem)) % 16 / 4;
+	return mem + stride * row + align;
 }
 
 template<bool X> uint8_t fb<X>::get_palette_r() const throw() { return auxpal.rshift; }
@@ -524,6 +593,8 @@ void queue::add(struct object& obj) throw(std::bad_alloc)
 	n->obj = &obj;
 	n->next = NULL;
 	n->killed = false;
+	open_batch = NULL;
+	open_batch_tag = NULL;
 	if(queue_tail)
 		queue_tail = queue_tail->next = n;
 	else
@@ -546,8 +617,45 @@ template<bool X> void queue::run(struct fb<X>& scr) throw()
 {
 	//Take queue lock in order to syncronize this with killing the queue.
 	threads::alock h(display_mutex);
+	unsigned bands = band_count(scr.get_height());
+	std::unique_ptr<fb<X>[]> views;		//Made when first needed.
+	int64_t top = -static_cast<int64_t>(scr.get_origin_y());
+	int64_t bottom = top + static_cast<int64_t>(scr.get_height());
 	struct node* tmp = queue_head;
 	while(tmp) {
+		//Runs of objects that can be drawn in bands are drawn band by band, in parallel. Other objects are
+		//drawn on the whole screen, between the runs.
+		band_items.clear();
+		uint64_t rows = 0;
+		int64_t first, last;
+		while(bands > 1 && tmp && (tmp->killed || tmp->obj->get_band_rows(first, last))) {
+			if(!tmp->killed) {
+				band_item i = {tmp->obj, first, last};
+				try {
+					band_items.push_back(i);
+				} catch(...) {
+					break;
+				}
+				rows += max(min(last, bottom) - max(first, top), (int64_t)0);
+			}
+			tmp = tmp->next;
+		}
+		if(!band_items.empty()) {
+			//Runs with little to draw are not worth waking the band threads for.
+			bool parallel = forced_bands || rows * scr.get_width() >= min_band_area;
+			if(parallel && !views && !make_band_views(scr, bands, views)) {
+				//Can't split the screen, stop trying.
+				bands = 1;
+				parallel = false;
+			}
+			if(parallel)
+				run_bands(scr, views.get(), bands);
+			else
+				for(auto& i : band_items)
+					(*i.obj)(scr);
+		}
+		if(!tmp)
+			break;
 		try {
 			if(!tmp->killed)
 				(*(tmp->obj))(scr);
@@ -557,6 +665,29 @@ template<bool X> void queue::run(struct fb<X>& scr) throw()
 	}
 }
 
+template<bool X> void queue::run_bands(struct fb<X>& scr, struct fb<X>* views, unsigned bands) throw()
+{
+	size_t height = scr.get_height();
+	int64_t origin = static_cast<int64_t>(scr.get_origin_y());
+	for(auto& i : band_items)
+		i.obj->set_band_mode(true);
+	threads::parallel_for(bands, [this, views, height, bands, origin](size_t b) {
+		//Rows of this band relative to origin.
+		int64_t top = static_cast<int64_t>(b * height / bands) - origin;
+		int64_t bottom = static_cast<int64_t>((b + 1) * height / bands) - origin;
+		for(auto& i : band_items)
+			if(i.last > top && i.first < bottom)
+				(*i.obj)(views[b]);
+	}, forced_bands);
+	for(auto& i : band_items)
+		i.obj->set_band_mode(false);
+}
+
+void queue::set_forced_bands(unsigned bands) throw()
+{
+	forced_bands = bands;
+}
+
 void queue::clear() throw()
 {
 	while(queue_head) {
@@ -568,6 +699,8 @@ void queue::clear() throw()
 	memory_allocated = 0;
 	pages = 0;
 	queue_tail = NULL;
+	open_batch = NULL;
+	open_batch_tag = NULL;
 }
 
 void* queue::alloc(size_t block) throw(std::bad_alloc)
@@ -576,10 +709,15 @@ void* queue::alloc(size_t block) throw(std::bad_alloc)
 	if(block > RENDER_PAGE_SIZE)
 		throw std::bad_alloc();
 	if(pages == 0 || memory_allocated + block > pages * RENDER_PAGE_SIZE) {
+		//Pages are kept over clear(), so only first use of page allocates.
+		if(pages == memory.size()) {
+			memory.reserve(pages + 1);
+			memory.push_back(new page);
+		}
 		memory_allocated = pages * RENDER_PAGE_SIZE;
-		memory[pages++];
+		pages++;
 	}
-	void* mem = memory[memory_allocated / RENDER_PAGE_SIZE].content + (memory_allocated % RENDER_PAGE_SIZE);
+	void* mem = memory[memory_allocated / RENDER_PAGE_SIZE]->content + (memory_allocated % RENDER_PAGE_SIZE);
 	memory_allocated += block;
 	return mem;
 }
@@ -607,6 +745,8 @@ queue::queue() throw()
 {
 	queue_head = NULL;
 	queue_tail = NULL;
+	open_batch = NULL;
+	open_batch_tag = NULL;
 	memory_allocated = 0;
 	pages = 0;
 }
@@ -614,6 +754,8 @@ queue::queue() throw()
 queue::~queue() throw()
 {
 	clear();
+	for(auto i : memory)
+		delete i;
 }
 
 object::object() throw()
@@ -638,6 +780,15 @@ bool object::kill_request(void* obj) throw()
 	return false;
 }
 
+bool object::get_band_rows(int64_t& first, int64_t& last) throw()
+{
+	return false;
+}
+
+void object::set_band_mode(bool enable) throw()
+{
+}
+
 font::font() throw(std::bad_alloc)
 {
 	bad_glyph_data[0] = 0x018001AAU;
@@ -895,6 +895,97 @@ namespace
 				return U(promises[0](), promises[1]());
 			throw error(error::ARGCOUNT, "Operation takes 1 or 2 arguments");
 		}
+		//Strict forms of operations. Arguments are already evaluated, and the result is written in place.
+		void set_numeric(const expr_val_numeric& v)
+		{
+			type = T_NUMERIC;
+			v_numeric = v;
+			if(!v_string.empty())
+				v_string.clear();
+		}
+		void set_boolean(bool b)
+		{
+			type = T_BOOLEAN;
+			v_boolean = b;
+			if(!v_string.empty())
+				v_string.clear();
+		}
+		template<expr_val (*T)(expr_val a)>
+		static void s_unary(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			if(nargs != 1)
+				throw error(error::ARGCOUNT, "Operation takes 1 argument");
+			tgt = T(*args[0]);
+		}
+		template<expr_val (*T)(expr_val a, expr_val b)>
+		static void s_binary(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			if(nargs != 2)
+				throw error(error::ARGCOUNT, "Operation takes 2 arguments");
+			tgt = T(*args[0], *args[1]);
+		}
+		template<expr_val (*T)(expr_val a),expr_val (*U)(expr_val a, expr_val b)>
+		static void s_unary_binary(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			if(nargs == 1)
+				tgt = T(*args[0]);
+			else if(nargs == 2)
+				tgt = U(*args[0], *args[1]);
+			else
+				throw error(error::ARGCOUNT, "Operation takes 1 or 2 arguments");
+		}
+		//Fast path for numbers: Operate directly on the numeric parts.
+		template<expr_val_numeric (*N)(const expr_val_numeric& a, const expr_val_numeric& b),
+			expr_val (*T)(expr_val a, expr_val b)>
+		static void s_arith(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			if(nargs != 2)
+				throw error(error::ARGCOUNT, "Operation takes 2 arguments");
+			if(args[0]->type == T_NUMERIC && args[1]->type == T_NUMERIC)
+				tgt.set_numeric(N(args[0]->v_numeric, args[1]->v_numeric));
+			else
+				tgt = T(*args[0], *args[1]);
+		}
+		template<bool (*C)(int cmp), expr_val (*T)(expr_val a, expr_val b)>
+		static void s_compare(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			if(nargs != 2)
+				throw error(error::ARGCOUNT, "Operation takes 2 arguments");
+			if(args[0]->type == T_NUMERIC && args[1]->type == T_NUMERIC)
+				tgt.set_boolean(C(expr_val_numeric::_cmp(args[0]->v_numeric, args[1]->v_numeric)));
+			else
+				tgt = T(*args[0], *args[1]);
+		}
+		template<expr_val (*T)(expr_val& a, expr_val& b)>
+		static void s_fold(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			if(!nargs) {
+				tgt.set_boolean(false);
+				return;
+			}
+			expr_val v = *args[0];
+			for(size_t i = 1; i < nargs; i++)
+				v = T(v, *args[i]);
+			tgt = v;
+		}
+		static void s_pi(expr_val& tgt, expr_val** args, size_t nargs)
+		{
+			tgt.set_numeric(expr_val_numeric::op_pi());
+		}
+		static expr_val_numeric n_add(const expr_val_numeric& a, const expr_val_numeric& b) { return a + b; }
+		static expr_val_numeric n_sub(const expr_val_numeric& a, const expr_val_numeric& b) { return a - b; }
+		static expr_val_numeric n_mul(const expr_val_numeric& a, const expr_val_numeric& b) { return a * b; }
+		static expr_val_numeric n_div(const expr_val_numeric& a, const expr_val_numeric& b) { return a / b; }
+		static expr_val_numeric n_rem(const expr_val_numeric& a, const expr_val_numeric& b) { return a % b; }
+		static expr_val_numeric n_and(const expr_val_numeric& a, const expr_val_numeric& b) { return a & b; }
+		static expr_val_numeric n_or(const expr_val_numeric& a, const expr_val_numeric& b) { return a | b; }
+		static expr_val_numeric n_xor(const expr_val_numeric& a, const expr_val_numeric& b) { return a ^ b; }
+		static bool c_lt(int c) { return c < 0; }
+		static bool c_le(int c) { return c <= 0; }
+		static bool c_gt(int c) { return c > 0; }
+		static bool c_ge(int c) { return c >= 0; }
+		static bool c_eq(int c) { return c == 0; }
+		static bool c_ne(int c) { return c != 0; }
 		static expr_val bnot(expr_val a)
 		{
 			return ~a.as_numeric();
@@ -1043,62 +1134,132 @@ namespace
 		static std::set<operinfo*> operations()
 		{
 			static operinfo_set<expr_val> x({
-				{"-", expr_val::op_unary<expr_val::neg>, true, 1, -3, true},
+				{"-", expr_val::op_unary<expr_val::neg>, true, 1, -3, true,
+					expr_val::s_unary<expr_val::neg>},
 				{"!", expr_val::op_lnot, true, 1, -3, true},
-				{"~", expr_val::op_unary<expr_val::bnot>, true, 1, -3, true},
-				{"*", expr_val::op_binary<expr_val::mul>, true, 2, -5, false},
-				{"/", expr_val::op_binary<expr_val::div>, true, 2, -5, false},
-				{"%", expr_val::op_binary<expr_val::rem>, true, 2, -5, false},
-				{"+", expr_val::op_binary<expr_val::add>, true, 2, -6, false},
-				{"-", expr_val::op_binary<expr_val::sub>, true, 2, -6, false},
-				{"<<", expr_val::op_binary<expr_val::lshift>, true, 2, -7, false},
-				{">>", expr_val::op_binary<expr_val::rshift>, true, 2, -7, false},
-				{"<", expr_val::op_binary<expr_val::lt>, true, 2, -8, false},
-				{"<=", expr_val::op_binary<expr_val::le>, true, 2, -8, false},
-				{">", expr_val::op_binary<expr_val::gt>, true, 2, -8, false},
-				{">=", expr_val::op_binary<expr_val::ge>, true, 2, -8, false},
-				{"==", expr_val::op_binary<expr_val::eq>, true, 2, -9, false},
-				{"!=", expr_val::op_binary<expr_val::ne>, true, 2, -9, false},
-				{"&", expr_val::op_binary<expr_val::band>, true, 2, -10, false},
-				{"^", expr_val::op_binary<expr_val::bxor>, true, 2, -11, false},
-				{"|", expr_val::op_binary<expr_val::bor>, true, 2, -12, false},
+				{"~", expr_val::op_unary<expr_val::bnot>, true, 1, -3, true,
+					expr_val::s_unary<expr_val::bnot>},
+				{"*", expr_val::op_binary<expr_val::mul>, true, 2, -5, false,
+					expr_val::s_arith<expr_val::n_mul, expr_val::mul>},
+				{"/", expr_val::op_binary<expr_val::div>, true, 2, -5, false,
+					expr_val::s_arith<expr_val::n_div, expr_val::div>},
+				{"%", expr_val::op_binary<expr_val::rem>, true, 2, -5, false,
+					expr_val::s_arith<expr_val::n_rem, expr_val::rem>},
+				{"+", expr_val::op_binary<expr_val::add>, true, 2, -6, false,
+					expr_val::s_arith<expr_val::n_add, expr_val::add>},
+				{"-", expr_val::op_binary<expr_val::sub>, true, 2, -6, false,
+					expr_val::s_arith<expr_val::n_sub, expr_val::sub>},
+				{"<<", expr_val::op_binary<expr_val::lshift>, true, 2, -7, false,
+					expr_val::s_binary<expr_val::lshift>},
+				{">>", expr_val::op_binary<expr_val::rshift>, true, 2, -7, false,
+					expr_val::s_binary<expr_val::rshift>},
+				{"<", expr_val::op_binary<expr_val::lt>, true, 2, -8, false,
+					expr_val::s_compare<expr_val::c_lt, expr_val::lt>},
+				{"<=", expr_val::op_binary<expr_val::le>, true, 2, -8, false,
+					expr_val::s_compare<expr_val::c_le, expr_val::le>},
+				{">", expr_val::op_binary<expr_val::gt>, true, 2, -8, false,
+					expr_val::s_compare<expr_val::c_gt, expr_val::gt>},
+				{">=", expr_val::op_binary<expr_val::ge>, true, 2, -8, false,
+					expr_val::s_compare<expr_val::c_ge, expr_val::ge>},
+				{"==", expr_val::op_binary<expr_val::eq>, true, 2, -9, false,
+					expr_val::s_compare<expr_val::c_eq, expr_val::eq>},
+				{"!=", expr_val::op_binary<expr_val::ne>, true, 2, -9, false,
+					expr_val::s_compare<expr_val::c_ne, expr_val::ne>},
+				{"&", expr_val::op_binary<expr_val::band>, true, 2, -10, false,
+					expr_val::s_arith<expr_val::n_and, expr_val::band>},
+				{"^", expr_val::op_binary<expr_val::bxor>, true, 2, -11, false,
+					expr_val::s_arith<expr_val::n_xor, expr_val::bxor>},
+				{"|", expr_val::op_binary<expr_val::bor>, true, 2, -12, false,
+					expr_val::s_arith<expr_val::n_or, expr_val::bor>},
 				{"&&", expr_val::op_land, true, 2, -13, false},
 				{"||", expr_val::op_lor, true, 2, -14, false},
-				{"π", expr_val::op_pi, true, 0, 0, false},
+				{"π", expr_val::op_pi, true, 0, 0, false, expr_val::s_pi},
 				{"if", expr_val::fun_if},
 				{"select", expr_val::fun_select},
-				{"unsigned", expr_val::op_unary<expr_val::x_nconv<expr_val_numeric::x_unsigned>>},
-				{"signed", expr_val::op_unary<expr_val::x_nconv<expr_val_numeric::x_signed>>},
-				{"float", expr_val::op_unary<expr_val::x_nconv<expr_val_numeric::x_float>>},
-				{"min", expr_val::fun_fold<expr_val::fold_min>},
-				{"max", expr_val::fun_fold<expr_val::fold_max>},
-				{"sum", expr_val::fun_fold<expr_val::fold_sum>},
-				{"prod", expr_val::fun_fold<expr_val::fold_prod>},
-				{"sqrt", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::sqrt>>},
+				{"unsigned", expr_val::op_unary<expr_val::x_nconv<expr_val_numeric::x_unsigned>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::x_nconv<expr_val_numeric::x_unsigned>>},
+				{"signed", expr_val::op_unary<expr_val::x_nconv<expr_val_numeric::x_signed>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::x_nconv<expr_val_numeric::x_signed>>},
+				{"float", expr_val::op_unary<expr_val::x_nconv<expr_val_numeric::x_float>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::x_nconv<expr_val_numeric::x_float>>},
+				{"min", expr_val::fun_fold<expr_val::fold_min>, false, 0, 0, false,
+					expr_val::s_fold<expr_val::fold_min>},
+				{"max", expr_val::fun_fold<expr_val::fold_max>, false, 0, 0, false,
+					expr_val::s_fold<expr_val::fold_max>},
+				{"sum", expr_val::fun_fold<expr_val::fold_sum>, false, 0, 0, false,
+					expr_val::s_fold<expr_val::fold_sum>},
+				{"prod", expr_val::fun_fold<expr_val::fold_prod>, false, 0, 0, false,
+					expr_val::s_fold<expr_val::fold_prod>},
+				{"sqrt", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::sqrt>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::sqrt>>},
 				{"log", expr_val::op_unary_binary<expr_val::f_n_fn<&expr_val_numeric::log>,
+					expr_val::f_n_fn2<expr_val_numeric::log2>>, false, 0, 0, false,
+					expr_val::s_unary_binary<expr_val::f_n_fn<&expr_val_numeric::log>,
 					expr_val::f_n_fn2<expr_val_numeric::log2>>},
 				{"exp", expr_val::op_unary_binary<expr_val::f_n_fn<&expr_val_numeric::exp>,
+					expr_val::f_n_fn2<expr_val_numeric::exp2>>, false, 0, 0, false,
+					expr_val::s_unary_binary<expr_val::f_n_fn<&expr_val_numeric::exp>,
 					expr_val::f_n_fn2<expr_val_numeric::exp2>>},
-				{"sin", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::sin>>},
-				{"cos", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::cos>>},
-				{"tan", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::tan>>},
+				{"sin", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::sin>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::sin>>},
+				{"cos", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::cos>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::cos>>},
+				{"tan", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::tan>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::tan>>},
 				{"atan", expr_val::op_unary_binary<expr_val::f_n_fn<&expr_val_numeric::atan>,
+					expr_val::f_n_fn2<expr_val_numeric::atan2>>, false, 0, 0, false,
+					expr_val::s_unary_binary<expr_val::f_n_fn<&expr_val_numeric::atan>,
 					expr_val::f_n_fn2<expr_val_numeric::atan2>>},
-				{"asin", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::asin>>},
-				{"acos", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::acos>>},
-				{"sinh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::sinh>>},
-				{"cosh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::cosh>>},
-				{"tanh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::tanh>>},
-				{"artanh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::artanh>>},
-				{"arsinh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::arsinh>>},
-				{"arcosh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::arcosh>>},
-				{"torad", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::torad>>},
-				{"todeg", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::todeg>>},
-				{"re", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::re>>},
-				{"im", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::im>>},
-				{"conj", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::conj>>},
-				{"abs", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::abs>>},
-				{"arg", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::arg>>},
+				{"asin", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::asin>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::asin>>},
+				{"acos", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::acos>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::acos>>},
+				{"sinh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::sinh>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::sinh>>},
+				{"cosh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::cosh>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::cosh>>},
+				{"tanh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::tanh>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::tanh>>},
+				{"artanh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::artanh>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::artanh>>},
+				{"arsinh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::arsinh>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::arsinh>>},
+				{"arcosh", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::arcosh>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::arcosh>>},
+				{"torad", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::torad>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::torad>>},
+				{"todeg", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::todeg>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::todeg>>},
+				{"re", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::re>>, false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::re>>},
+				{"im", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::im>>, false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::im>>},
+				{"conj", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::conj>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::conj>>},
+				{"abs", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::abs>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::abs>>},
+				{"arg", expr_val::op_unary<expr_val::f_n_fn<&expr_val_numeric::arg>>,
+					false, 0, 0, false,
+					expr_val::s_unary<expr_val::f_n_fn<&expr_val_numeric::arg>>},
 				{"pyth", expr_val::fun_pyth},
 			});
 			return x.get_set();
@@ -5,6 +5,31 @@
 
 namespace mathexpr
 {
+namespace
+{
+	//Bumped whenever expression structure changes, invalidating compiled programs.
+	uint64_t structure_generation = 0;
+}
+
+/**
+ * Compiled form of strict operator subtree: the subexpressions in evaluation order. The registers are the values of
+ * the nodes themselves.
+ */
+struct mathexpr::program
+{
+	struct step
+	{
+		mathexpr* node;		//Node to evaluate.
+		size_t args;		//Index of first argument register (strict steps only).
+		bool strict;		//If false, evaluate the node using evaluate().
+	};
+	uint64_t generation;		//Structure generation compiled against.
+	bool usable;			//If false, the root can't be evaluated strictly.
+	std::vector<step> steps;
+	std::vector<void*> args;	//Argument registers.
+	size_t root_args;		//Index of first argument register of the root.
+};
+
 operinfo::operinfo(std::string funcname)
 	: fnname(funcname), is_operator(false), operands(0), precedence(0), rtl(false)
 {
@@ -17,6 +42,33 @@ operinfo::~operinfo()
 {
 }
 
+bool operinfo::is_strict()
+{
+	return false;
+}
+
+void operinfo::evaluate_strict(value target, void** args, size_t nargs)
+{
+	std::vector<std::function<value()>> promises;
+	for(size_t i = 0; i < nargs; i++) {
+		value v;
+		v.type = target.type;
+		v._value = args[i];
+		promises.push_back([v]() { return v; });
+	}
+	evaluate(target, promises);
+}
+
+bool operinfo::is_source()
+{
+	return false;
+}
+
+uint64_t operinfo::source_version()
+{
+	return 0;
+}
+
 typeinfo::~typeinfo()
 {
 }
@@ -25,6 +77,7 @@ mathexpr::mathexpr(typeinfo* _type)
 	: type(*_type)
 {
 	owns_operator = false;
+	compiled = NULL;
 	state = UNDEFINED;
 	_value = NULL;
 	fn = (operinfo*)0xDEADBEEF;
@@ -34,6 +87,7 @@ mathexpr::mathexpr(typeinfo* _type, GC::pointer<mathexpr> fwd)
 	: type(*_type)
 {
 	owns_operator = false;
+	compiled = NULL;
 	state = FORWARD;
 	_value = type.allocate();
 	arguments.push_back(&*fwd);
@@ -44,6 +98,7 @@ mathexpr::mathexpr(value _val)
 	: type(*_val.type)
 {
 	owns_operator = false;
+	compiled = NULL;
 	state = FIXED;
 	_value = type.copy_allocate(_val._value);
 	fn = NULL;
@@ -53,6 +108,7 @@ mathexpr::mathexpr(typeinfo* _type, const std::string& _val, bool string)
 	: type(*_type)
 {
 	owns_operator = false;
+	compiled = NULL;
 	state = FIXED;
 	_value = type.parse(_val, string);
 	fn = NULL;
@@ -61,6 +117,7 @@ mathexpr::mathexpr(typeinfo* _type, const std::string& _val, bool string)
 mathexpr::mathexpr(typeinfo* _type, operinfo* _fn, std::vector<GC::pointer<mathexpr>> _args, bool _owns_operator)
 	: type(*_type), fn(_fn), owns_operator(_owns_operator)
 {
+	compiled = NULL;
 	try {
 		for(auto& i : _args)
 			arguments.push_back(&*i);
@@ -78,6 +135,7 @@ mathexpr::~mathexpr()
 	if(owns_operator && fn)
 		delete fn;
 	type.deallocate(_value);
+	delete compiled;
 }
 
 void mathexpr::reset()
@@ -97,6 +155,7 @@ mathexpr::mathexpr(const mathexpr& m)
 	: state(m.state), type(m.type), fn(m.fn), _error(m._error), arguments(m.arguments)
 {
 	_value = m._value ? type.copy_allocate(m._value) : NULL;
+	compiled = NULL;
 	if(state == EVALUATING) state = TO_BE_EVALUATED;
 }
 
@@ -123,6 +182,9 @@ mathexpr& mathexpr::operator=(const mathexpr& m)
 	m.owns_operator = false;
 	std::swap(arguments, _arguments);
 	std::swap(_error, _xerror);
+	delete compiled;
+	compiled = NULL;
+	structure_generation++;
 	return *this;
 }
 
@@ -133,6 +195,15 @@ value mathexpr::evaluate()
 	switch(state) {
 	case TO_BE_EVALUATED:
 		//Need to evaluate.
+		if(fn->is_strict()) {
+			if(!compiled || compiled->generation != structure_generation)
+				compile();
+			if(compiled->usable) {
+				evaluate_compiled();
+				ret._value = _value;
+				return ret;
+			}
+		}
 		try {
 			for(auto i : arguments) {
 				if(&i->type != &type) {
@@ -151,21 +222,8 @@ value mathexpr::evaluate()
 			tmp._value = _value;
 			fn->evaluate(tmp, promises);
 			state = EVALUATED;
-		} catch(error& e) {
-			state = FAILED;
-			errcode = e.get_code();
-			_error = e.what();
-			throw;
-		} catch(std::exception& e) {
-			state = FAILED;
-			errcode = error::UNKNOWN;
-			_error = e.what();
-			throw;
 		} catch(...) {
-			state = FAILED;
-			errcode = error::UNKNOWN;
-			_error = "Unknown error";
-			throw;
+			mark_failed_and_rethrow();
 		}
 		ret._value = _value;
 		return ret;
@@ -197,12 +255,151 @@ value mathexpr::evaluate()
 	throw error(error::INTERNAL, "Internal error (shouldn't be here)");
 }
 
+bool mathexpr::is_operator_node()
+{
+	return (state == TO_BE_EVALUATED || state == EVALUATING || state == EVALUATED || state == FAILED);
+}
+
+void mathexpr::compile()
+{
+	program* p = new program;
+	try {
+		std::set<mathexpr*> visited;
+		std::set<mathexpr*> active;
+		visited.insert(this);
+		active.insert(this);
+		p->generation = structure_generation;
+		p->usable = true;
+		for(auto i : arguments)
+			if(&i->type != &type)
+				p->usable = false;
+		for(auto i : arguments)
+			i->compile_node(*p, visited, active);
+		p->root_args = p->args.size();
+		for(auto i : arguments)
+			p->args.push_back(i->_value);
+	} catch(...) {
+		delete p;
+		throw;
+	}
+	delete compiled;
+	compiled = p;
+}
+
+void mathexpr::compile_node(program& p, std::set<mathexpr*>& visited, std::set<mathexpr*>& active)
+{
+	program::step s;
+	s.node = this;
+	s.args = 0;
+	s.strict = false;
+	if(active.count(this)) {
+		//Circular reference. Let evaluate() report it.
+		p.steps.push_back(s);
+		return;
+	}
+	if(visited.count(this))
+		return;
+	visited.insert(this);
+	if(state == FIXED)
+		return;
+	if(!is_operator_node() || !fn->is_strict()) {
+		//Lazily evaluated, undefined or forwarding node.
+		p.steps.push_back(s);
+		return;
+	}
+	for(auto i : arguments)
+		if(&i->type != &type) {
+			//Let evaluate() report the mismatch.
+			p.steps.push_back(s);
+			return;
+		}
+	active.insert(this);
+	for(auto i : arguments)
+		i->compile_node(p, visited, active);
+	active.erase(this);
+	s.strict = true;
+	s.args = p.args.size();
+	for(auto i : arguments)
+		p.args.push_back(i->_value);
+	p.steps.push_back(s);
+}
+
+void mathexpr::evaluate_compiled()
+{
+	program& p = *compiled;
+	state = EVALUATING;
+	try {
+		for(auto& i : p.steps) {
+			if(i.strict && i.node->state == TO_BE_EVALUATED)
+				i.node->evaluate_strict(&p.args[i.args]);
+			else
+				i.node->evaluate();
+		}
+	} catch(...) {
+		mark_failed_and_rethrow();
+	}
+	evaluate_strict(p.args.empty() ? NULL : &p.args[p.root_args]);
+}
+
+void mathexpr::evaluate_strict(void** args)
+{
+	try {
+		value tmp;
+		tmp.type = &type;
+		tmp._value = _value;
+		fn->evaluate_strict(tmp, args, arguments.size());
+		state = EVALUATED;
+	} catch(...) {
+		mark_failed_and_rethrow();
+	}
+}
+
+void mathexpr::get_sources(std::set<operinfo*>& sources)
+{
+	std::set<mathexpr*> visited;
+	std::vector<mathexpr*> queue;
+	queue.push_back(this);
+	while(!queue.empty()) {
+		mathexpr* m = queue.back();
+		queue.pop_back();
+		if(visited.count(m))
+			continue;
+		visited.insert(m);
+		if(m->is_operator_node() && m->fn->is_source())
+			sources.insert(m->fn);
+		for(auto i : m->arguments)
+			queue.push_back(i);
+	}
+}
+
 void mathexpr::trace()
 {
 	for(auto i : arguments)
 		i->mark();
 }
 
+void mathexpr::mark_failed_and_rethrow()
+{
+	try {
+		throw;
+	} catch(error& e) {
+		state = FAILED;
+		errcode = e.get_code();
+		_error = e.what();
+		throw;
+	} catch(std::exception& e) {
+		state = FAILED;
+		errcode = error::UNKNOWN;
+		_error = e.what();
+		throw;
+	} catch(...) {
+		state = FAILED;
+		errcode = error::UNKNOWN;
+		_error = "Unknown error";
+		throw;
+	}
+}
+
 void mathexpr::mark_error_and_throw(error::errorcode _errcode, const std::string& _xerror)
 {
 	if(state == EVALUATING) {
@@ -4,6 +4,8 @@
 #include "minmax.hpp"
 #include "serialization.hpp"
 #include "int24.hpp"
+#include "threads.hpp"
+#include <atomic>
 #include <iostream>
 
 memory_search::memory_search(memory_space& space) throw(std::bad_alloc)
@@ -13,12 +15,6 @@ memory_search::memory_search(memory_space& space) throw(std::bad_alloc)
 }
 
 
-struct search_update
-{
-	typedef uint8_t value_type;
-	bool operator()(uint8_t oldv, uint8_t newv) const throw() { return true; }
-};
-
 template<typename T>
 struct search_value
 {
@@ -128,44 +124,12 @@ struct search_seqgt
 };
 
 
-template<typename T>
-struct search_value_helper
-{
-	typedef typename T::value_type value_type;
-	search_value_helper(const T& v)  throw()
-		: val(v)
-	{
-	}
-	bool operator()(const uint8_t* newv, const uint8_t* oldv, uint64_t left, int endian) const throw()
-	{
-		if(left < sizeof(value_type))
-			return false;
-		value_type v1 = serialization::read_endian<value_type>(oldv, endian);
-		value_type v2 = serialization::read_endian<value_type>(newv, endian);
-		return val(v1, v2);
-	}
-	const T& val;
-};
-
 namespace
 {
-	void dq_all_after(uint64_t* still_in, uint64_t& candidates, uint64_t size, uint64_t after)
-	{
-		for(uint64_t i = after; i < size; i++) {
-			if((still_in[i / 64] >> (i % 64)) & 1) {
-				still_in[i / 64] &= ~(1ULL << (i % 64));
-				candidates--;
-			}
-		}
-	}
-
-	inline void dq_entry(uint64_t* still_in, uint64_t& candidates, uint64_t i)
-	{
-		if((still_in[i / 64] >> (i % 64)) & 1) {
-			still_in[i / 64] &= ~(1ULL << (i % 64));
-			candidates--;
-		}
-	}
+	//Work is split into chunks of this many addresses (multiple of 64) between threads.
+	const uint64_t chunk_size = 1 << 18;
+	//Memory smaller than this is searched in calling thread.
+	const uint64_t parallel_min = 1 << 20;
 
 	inline uint64_t next_multiple_of_64(uint64_t i)
 	{
@@ -177,182 +141,212 @@ namespace
 		return ((i - 64) >> 6 << 6) + 63;
 	}
 
-	template<typename T>
-	void search_block_mapped(uint64_t* still_in, uint64_t& candidates, memory_space::region& region,
-		uint64_t rbase, uint64_t ibase, T& helper, std::vector<uint8_t>& previous_content)
+	inline unsigned popcount(uint64_t x)
 	{
-		if(ibase >= previous_content.size())
-			return;
-		unsigned char* mem = region.direct_map;
-		uint64_t rsize = region.size;
-		int endian = region.endian;
-		uint64_t i = ibase;
-		uint64_t switch_at = ibase + rsize - rbase;	//The smallest i not in this region.
-		rsize = min(rsize, previous_content.size() - ibase);
-		for(unsigned j = rbase; j < rsize; i++, j++) {
-			//Advance blocks of 64 addresses if none of the addresses match.
-			while(still_in[i / 64] == 0 && next_multiple_of_64(i) <= switch_at) {
-				uint64_t old_i = i;
-				i = next_multiple_of_64(i);
-				j += i - old_i;
-			}
-			//This might match. Check it.
-			if(!helper(mem + j, &previous_content[i], rsize - j, endian))
-				dq_entry(still_in, candidates, i);
-		}
-	}
-
-	template<typename T>
-	void search_block_read(uint64_t* still_in, uint64_t& candidates, memory_space::region& region, uint64_t rbase,
-		uint64_t ibase, T& helper, std::vector<uint8_t>& previous_content)
-	{
-		if(ibase >= previous_content.size())
-			return;
-		uint64_t rsize = region.size;
-		int endian = region.endian;
-		uint64_t i = ibase;
-		uint64_t switch_at = ibase + rsize - rbase;	//The smallest i not in this region.
-
-		//The buffer.
-		const size_t buffer_capacity = 4096;
-		unsigned char buffer[buffer_capacity];
-		uint64_t buffer_offset = 0;		//The offset in buffer.
-		uint64_t buffer_remaining = 0;		//Number of bytes remaining in buffer.
-		uint64_t buffer_soffset = rbase;	//The offset buffer start corresponds to.
-		uint64_t buffer_eoffset = rbase;	//The first offset not in buffer.
-
-		rsize = min(rsize, previous_content.size() - ibase);
-		for(unsigned j = rbase; j < rsize; i++, j++) {
-			//Fill the buffer again if it has gotten low enough.
-			if(buffer_remaining < 256 && buffer_eoffset != rsize) {
-				if(buffer_remaining)
-					memmove(buffer, buffer + buffer_offset, buffer_remaining);
-				buffer_offset = 0;
-				size_t fill_amount = min((uint64_t)buffer_capacity, rsize - buffer_eoffset);
-				region.read(buffer_eoffset, buffer + buffer_remaining, fill_amount);
-				buffer_eoffset += fill_amount;
-				buffer_remaining += fill_amount;
-			}
-			//Advance blocks of 64 addresses if none of the addresses match.
-			while(still_in[i / 64] == 0 && next_multiple_of_64(i) <= switch_at) {
-				uint64_t old_i = i;
-				i = next_multiple_of_64(i);
-				uint64_t advance = i - old_i;
-				j += advance;
-				buffer_offset += advance;
-				buffer_remaining -= advance;
-				buffer_soffset += advance;
-			}
-			//This might match. Check it.
-			if(!helper(buffer + buffer_offset, &previous_content[i], buffer_remaining, endian))
-				dq_entry(still_in, candidates, i);
-			buffer_offset++;
-			buffer_remaining--;
-			buffer_soffset++;
-		}
+		return __builtin_popcountll(x);
 	}
 
-	void copy_block_mapped(uint8_t* old, memory_space::region& region, uint64_t rbase, uint64_t maxr)
+	inline bool needs_swap(int endian)
 	{
-		memcpy(old, region.direct_map + rbase, min(region.size - rbase, maxr));
+		short _magic = 258;
+		char magic = *reinterpret_cast<char*>(&_magic);
+		return (endian == -1 && magic == 1) || (endian == 1 && magic == 2);
 	}
 
-	void copy_block_read(uint8_t* old, memory_space::region& region, uint64_t rbase, uint64_t maxr)
+	//Compare count (at most 64) consecutive addresses, returning bitmask of matches. Fixed-length full blocks
+	//are written as straight loops the compiler can vectorize.
+	template<typename T, bool swap>
+	uint64_t match_block(const T& cmp, const uint8_t* newv, const uint8_t* oldv, unsigned count)
 	{
-		region.read(rbase, old, min(region.size - rbase, maxr));
+		typedef typename T::value_type value_type;
+		if(count == 64) {
+			uint8_t r[64];
+			for(unsigned k = 0; k < 64; k++) {
+				value_type o, n;
+				memcpy(&o, oldv + k, sizeof(value_type));
+				memcpy(&n, newv + k, sizeof(value_type));
+				if(swap) {
+					serialization::swap_endian(o);
+					serialization::swap_endian(n);
+				}
+				r[k] = cmp(o, n) ? 1 : 0;
+			}
+			uint64_t m = 0;
+			for(unsigned k = 0; k < 64; k++)
+				m |= (uint64_t)r[k] << k;
+			return m;
+		}
+		uint64_t m = 0;
+		for(unsigned k = 0; k < count; k++) {
+			value_type o, n;
+			memcpy(&o, oldv + k, sizeof(value_type));
+			memcpy(&n, newv + k, sizeof(value_type));
+			if(swap) {
+				serialization::swap_endian(o);
+				serialization::swap_endian(n);
+			}
+			m |= (uint64_t)(cmp(o, n) ? 1 : 0) << k;
+		}
+		return m;
 	}
 
-	void dq_block(uint64_t* still_in, uint64_t& candidates, memory_space::region& region, uint64_t rbase,
-		uint64_t ibase, uint64_t first, uint64_t last, uint64_t ramsize)
+	//Search linear addresses [first, last) of a segment ending at linear address segend. newv and oldv point to
+	//the new and old contents of address first. Returns number of candidates DQ'd.
+	template<typename T, bool swap>
+	uint64_t search_range(uint64_t* still_in, const T& cmp, const uint8_t* newv, const uint8_t* oldv,
+		uint64_t first, uint64_t last, uint64_t segend)
 	{
-		if(ibase >= ramsize)
-			return;
-		if(last < region.base + rbase || first >= region.base + region.size)
-			return;		//Nothing to DQ in this block.
-		first = max(first, region.base + rbase) - region.base + rbase;
-		last = last - region.base - rbase;
-		last = min(last, ramsize - ibase);
-		uint64_t ilast = ibase + last;
-		for(uint64_t i = ibase + first; i <= ilast; i++) {
-			while(still_in[i / 64] == 0 && next_multiple_of_64(i) <= ilast) {
-				i = next_multiple_of_64(i);
-				continue;
+		typedef typename T::value_type value_type;
+		uint64_t dq = 0;
+		uint64_t i = first;
+		while(i < last) {
+			uint64_t w = i / 64;
+			unsigned bit = i % 64;
+			uint64_t n = min(last - i, (uint64_t)(64 - bit));
+			uint64_t sel = ((n == 64) ? ~0ULL : ((1ULL << n) - 1)) << bit;
+			if(still_in[w] & sel) {
+				//Addresses too close to end of region never match.
+				uint64_t left = segend - i;
+				uint64_t count = (left >= sizeof(value_type)) ? min(n, left - sizeof(value_type) + 1) : 0;
+				uint64_t m = count ? match_block<T, swap>(cmp, newv + (i - first), oldv + (i - first),
+					count) << bit : 0;
+				uint64_t old = still_in[w];
+				still_in[w] &= (m | ~sel);
+				dq += popcount(old) - popcount(still_in[w]);
 			}
-			dq_entry(still_in, candidates, i);
+			i += n;
 		}
+		return dq;
 	}
 
-	void candidates_block(std::list<uint64_t>& out, memory_space::region& region, uint64_t rbase, uint64_t ibase,
-		uint64_t* still_in, uint64_t ramsize)
+	//DQ linear addresses [first, last). Returns number of candidates DQ'd.
+	uint64_t dq_bits(uint64_t* still_in, uint64_t first, uint64_t last)
 	{
-		if(ibase >= ramsize)
-			return;
-		uint64_t rsize = region.size;
-		uint64_t i = ibase;
-		uint64_t switch_at = ibase + rsize - rbase;	//The smallest i not in this region.
-		rsize = min(rsize, ramsize - ibase);
-		for(unsigned j = rbase; j < rsize; i++, j++) {
-			//Advance blocks of 64 addresses if none of the addresses match.
-			while(still_in[i / 64] == 0 && next_multiple_of_64(i) <= switch_at) {
-				uint64_t old_i = i;
-				i = next_multiple_of_64(i);
-				j += i - old_i;
-			}
-			if((still_in[i / 64] >> (i % 64)) & 1)
-				out.push_back(region.base + j);
+		uint64_t dq = 0;
+		uint64_t i = first;
+		while(i < last) {
+			uint64_t w = i / 64;
+			unsigned bit = i % 64;
+			uint64_t n = min(last - i, (uint64_t)(64 - bit));
+			uint64_t sel = ((n == 64) ? ~0ULL : ((1ULL << n) - 1)) << bit;
+			dq += popcount(still_in[w] & sel);
+			still_in[w] &= ~sel;
+			i += n;
 		}
+		return dq;
 	}
-
 }
 
-void memory_search::dq_range(uint64_t first, uint64_t last)
+void memory_search::build_segments() throw(std::bad_alloc)
 {
-	auto t = mspace.lookup_linear(0);
-	if(!t.first)
-		return;
-	uint64_t i = 0;
+	segments.clear();
 	uint64_t size = previous_content.size();
-	while(true) {
-		//Switch blocks.
-		t = mspace.lookup_linear(i);
-		if(!t.first) {
-			//DQ all rest.
-			dq_all_after(&still_in[0], candidates, size, i);
+	uint64_t i = 0;
+	while(i < size) {
+		auto t = mspace.lookup_linear(i);
+		if(!t.first)
 			break;
-		}
-		dq_block(&still_in[0], candidates, *t.first, t.second, i, first, last, previous_content.size());
+		segment s;
+		s.region = t.first;
+		s.rbase = t.second;
+		s.ibase = i;
+		s.size = min(t.first->size - t.second, size - i);
+		segments.push_back(s);
 		i += t.first->size - t.second;
 	}
 }
 
+void memory_search::copy_content() throw()
+{
+	//Non-mapped regions may not be safe to read from multiple threads, read those here.
+	for(auto& s : segments)
+		if(!s.region->direct_map)
+			s.region->read(s.rbase, &previous_content[s.ibase], s.size);
+	uint64_t size = previous_content.size();
+	uint64_t chunks = (size + chunk_size - 1) / chunk_size;
+	threads::parallel_for(chunks, [this](size_t c) {
+		uint64_t cfirst = c * chunk_size;
+		uint64_t clast = cfirst + chunk_size;
+		for(auto& s : segments) {
+			uint64_t first = max(cfirst, s.ibase);
+			uint64_t last = min(clast, s.ibase + s.size);
+			if(!s.region->direct_map || first >= last)
+				continue;
+			memcpy(&previous_content[first], s.region->direct_map + s.rbase + (first - s.ibase),
+				last - first);
+		}
+	}, (size < parallel_min) ? 1 : 0);
+}
+
+void memory_search::dq_range(uint64_t first, uint64_t last)
+{
+	build_segments();
+	for(auto& s : segments) {
+		uint64_t sbase = s.region->base + s.rbase;
+		if(last < sbase || first >= sbase + s.size)
+			continue;
+		uint64_t ifirst = max(first, sbase) - sbase + s.ibase;
+		uint64_t ilast = min(last - sbase, s.size - 1) + 1 + s.ibase;
+		candidates -= dq_bits(&still_in[0], ifirst, ilast);
+	}
+}
+
 template<class T> void memory_search::search(const T& obj) throw()
 {
-	search_value_helper<T> helper(obj);
-	auto t = mspace.lookup_linear(0);
-	if(!t.first)
+	if(previous_content.empty())
 		return;
+	build_segments();
 	uint64_t size = previous_content.size();
-	uint64_t i = 0;
-	while(true) {
-		//Switch blocks.
-		t = mspace.lookup_linear(i);
-		if(!t.first) {
-			//DQ all rest.
-			dq_all_after(&still_in[0], candidates, size, i);
-			break;
+	//Anything not in any region is never a candidate.
+	uint64_t covered = segments.empty() ? 0 : segments.back().ibase + segments.back().size;
+	candidates -= dq_bits(&still_in[0], covered, size);
+
+	//Mapped regions are searched in parallel. Each thread works on whole words of candidate bitmap, so they
+	//don't interfere. The old contents are not updated until all comparisons are done.
+	std::atomic<uint64_t> dq(0);
+	uint64_t chunks = (covered + chunk_size - 1) / chunk_size;
+	threads::parallel_for(chunks, [this, &obj, &dq](size_t c) {
+		uint64_t cfirst = c * chunk_size;
+		uint64_t clast = cfirst + chunk_size;
+		uint64_t cdq = 0;
+		for(auto& s : segments) {
+			uint64_t first = max(cfirst, s.ibase);
+			uint64_t last = min(clast, s.ibase + s.size);
+			if(!s.region->direct_map || first >= last)
+				continue;
+			const uint8_t* newv = s.region->direct_map + s.rbase + (first - s.ibase);
+			if(needs_swap(s.region->endian))
+				cdq += search_range<T, true>(&still_in[0], obj, newv, &previous_content[first], first,
+					last, s.ibase + s.size);
+			else
+				cdq += search_range<T, false>(&still_in[0], obj, newv, &previous_content[first], first,
+					last, s.ibase + s.size);
 		}
-		if(t.first->direct_map) {
-			search_block_mapped(&still_in[0], candidates, *t.first, t.second, i, helper,
-				previous_content);
-			copy_block_mapped(&previous_content[i], *t.first, t.second,
-				  max((uint64_t)previous_content.size(), i) - i);
-		} else {
-			search_block_read(&still_in[0], candidates, *t.first, t.second, i, helper, previous_content);
-			copy_block_read(&previous_content[i], *t.first, t.second,
-				  max((uint64_t)previous_content.size(), i) - i);
+		dq += cdq;
+	}, (covered < parallel_min) ? 1 : 0);
+	//The rest go through buffer in this thread.
+	const size_t buffer_capacity = 4096;
+	const size_t lookahead = 16;
+	uint8_t buffer[buffer_capacity + lookahead];
+	for(auto& s : segments) {
+		if(s.region->direct_map)
+			continue;
+		bool swap = needs_swap(s.region->endian);
+		for(uint64_t off = 0; off < s.size; off += buffer_capacity) {
+			uint64_t amount = min((uint64_t)buffer_capacity, s.size - off);
+			uint64_t bamount = min((uint64_t)(buffer_capacity + lookahead), s.size - off);
+			s.region->read(s.rbase + off, buffer, bamount);
+			uint64_t first = s.ibase + off;
+			if(swap)
+				dq += search_range<T, true>(&still_in[0], obj, buffer, &previous_content[first],
+					first, first + amount, s.ibase + s.size);
+			else
+				dq += search_range<T, false>(&still_in[0], obj, buffer, &previous_content[first],
+					first, first + amount, s.ibase + s.size);
 		}
-		i += t.first->size - t.second;
 	}
+	candidates -= dq;
+	copy_content();
 }
 
 template<typename T> void memory_search::s_value(T value) throw() { search(search_value<T>(value)); }
@@ -448,7 +442,11 @@ void memorysearch_pull_all(memory_search& s)
 	memorysearch_pull_type2<double>(s);
 }
 
-void memory_search::update() throw() { search(search_update()); }
+void memory_search::update() throw()
+{
+	build_segments();
+	copy_content();
+}
 
 uint64_t memory_search::get_candidate_count() throw()
 {
@@ -458,21 +456,56 @@ uint64_t memory_search::get_candidate_count() throw()
 std::list<uint64_t> memory_search::get_candidates() throw(std::bad_alloc)
 {
 	std::list<uint64_t> out;
-	auto t = mspace.lookup_linear(0);
-	if(!t.first)
-		return out;
-	uint64_t i = 0;
-	while(true) {
-		//Switch blocks.
-		t = mspace.lookup_linear(i);
-		if(!t.first)
-			return out;
-		candidates_block(out, *t.first, t.second, i, &still_in[0], previous_content.size());
-		i += t.first->size - t.second;
-	}
+	for(auto i = begin(); i != end(); ++i)
+		out.push_back(*i);
 	return out;
 }
 
+memory_search::iterator memory_search::begin() throw(std::bad_alloc)
+{
+	build_segments();
+	return iterator(this, 0);
+}
+
+memory_search::iterator::iterator(memory_search* _parent, uint64_t _idx) throw()
+{
+	parent = _parent;
+	seg = 0;
+	idx = _idx;
+	settle();
+}
+
+uint64_t memory_search::iterator::operator*() const throw()
+{
+	const segment& s = parent->segments[seg];
+	return s.region->base + s.rbase + (idx - s.ibase);
+}
+
+memory_search::iterator& memory_search::iterator::operator++() throw()
+{
+	idx++;
+	settle();
+	return *this;
+}
+
+void memory_search::iterator::settle() throw()
+{
+	uint64_t size = parent->previous_content.size();
+	while(idx < size) {
+		uint64_t w = parent->still_in[idx / 64] >> (idx % 64);
+		if(w) {
+			idx += __builtin_ctzll(w);
+			break;
+		}
+		idx = (idx / 64 + 1) * 64;
+	}
+	auto& segs = parent->segments;
+	while(idx < size && seg < segs.size() && segs[seg].ibase + segs[seg].size <= idx)
+		seg++;
+	if(idx >= size || seg >= segs.size())
+		idx = size;
+}
+
 bool memory_search::is_candidate(uint64_t addr) throw()
 {
 	auto t = mspace.lookup_linear(0);
@@ -573,24 +606,8 @@ void memory_search::reset() throw(std::bad_alloc)
 	if(linearram % 64)
 		still_in[linearram / 64] = (1ULL << (linearram % 64)) - 1;
 	candidates = linearram;
-
-	auto t = mspace.lookup_linear(0);
-	if(!t.first)
-		return;
-	uint64_t i = 0;
-	while(true) {
-		//Switch blocks.
-		t = mspace.lookup_linear(i);
-		if(!t.first)
-			break;
-		if(t.first->direct_map)
-			copy_block_mapped(&previous_content[i], *t.first, t.second,
-				max((uint64_t)previous_content.size(), i) - i);
-		else
-			copy_block_read(&previous_content[i], *t.first, t.second,
-				max((uint64_t)previous_content.size(), i) - i);
-		i += t.first->size - t.second;
-	}
+	build_segments();
+	copy_content();
 }
 
 
@@ -641,12 +658,15 @@ void memory_search::loadstate(const std::vector<char>& buffer)
 		offset += linsize;
 	}
 	if(type == ST_SET || type == ST_ALL) {
-		candidates = serialization::u64b(&buffer[offset]);
 		offset += 8;
 		size_t bound = min((linsize + 63) / 64, (uint64_t)still_in.size());
 		for(unsigned i = 0; i < bound; i++) {
 			still_in[i] = serialization::u64b(&buffer[offset]);
 			offset += 8;
 		}
+		//Count the candidates instead of trusting the saved count.
+		candidates = 0;
+		for(auto i : still_in)
+			candidates += __builtin_popcountll(i);
 	}
 }
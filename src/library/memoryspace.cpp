@@ -7,6 +7,28 @@
 
 namespace
 {
+	//Source of table generation numbers. Generation 0 is never used, so zeroed cache entries never match.
+	std::atomic<uint64_t> next_generation(1);
+
+	//Per-thread translation cache entry.
+	struct tlb_entry
+	{
+		uint64_t generation;
+		uint64_t base;
+		uint64_t last;
+		memory_space::region* region;
+	};
+	//Indexed by hash of 4kB page number, plus the last hit. Region bases tend to be aligned to large powers of
+	//two, so plain low page number bits would collide.
+	const unsigned tlb_bits = 4;
+	thread_local tlb_entry tlb[1 << tlb_bits];
+	thread_local tlb_entry tlb_last;
+
+	inline tlb_entry& tlb_slot(uint64_t address)
+	{
+		return tlb[((address >> 12) * 0x9E3779B97F4A7C15ULL) >> (64 - tlb_bits)];
+	}
+
 	template<typename T, bool linear> inline T internal_read(memory_space& m, uint64_t addr)
 	{
 		std::pair<memory_space::region*, uint64_t> g;
@@ -99,44 +121,73 @@ bool memory_space::region::write(uint64_t offset, const void* buffer, size_t tsi
 	return true;
 }
 
+memory_space::memory_space()
+{
+	table* t = new table;
+	t->linear_size = 0;
+	t->linear_bases.push_back(0);
+	t->generation = next_generation++;
+	tables.push_back(t);
+	current = t;
+}
+
+memory_space::~memory_space()
+{
+	for(auto i : tables)
+		delete i;
+}
+
 std::pair<memory_space::region*, uint64_t> memory_space::lookup(uint64_t address)
 {
-	threads::alock m(mlock);
+	const table* t = current.load(std::memory_order_acquire);
+	if(tlb_last.generation == t->generation && address - tlb_last.base <= tlb_last.last - tlb_last.base)
+		return std::make_pair(tlb_last.region, address - tlb_last.base);
+	tlb_entry& e = tlb_slot(address);
+	if(e.generation == t->generation && address - e.base <= e.last - e.base) {
+		tlb_last = e;
+		return std::make_pair(e.region, address - e.base);
+	}
 	size_t lb = 0;
-	size_t ub = u_regions.size();
+	size_t ub = t->regions.size();
 	while(lb < ub) {
 		size_t mb = (lb + ub) / 2;
-		if(u_regions[mb]->base > address) {
+		region* r = t->regions[mb];
+		if(r->base > address) {
 			ub = mb;
 			continue;
 		}
-		if(u_regions[mb]->last_address() < address) {
+		if(r->last_address() < address) {
 			lb = mb + 1;
 			continue;
 		}
-		return std::make_pair(u_regions[mb], address - u_regions[mb]->base);
+		e.generation = t->generation;
+		e.base = r->base;
+		e.last = r->last_address();
+		e.region = r;
+		tlb_last = e;
+		return std::make_pair(r, address - r->base);
 	}
 	return std::make_pair(reinterpret_cast<region*>(NULL), 0);
 }
 
 std::pair<memory_space::region*, uint64_t> memory_space::lookup_linear(uint64_t linear)
 {
-	threads::alock m(mlock);
-	if(linear >= linear_size)
+	const table* t = current.load(std::memory_order_acquire);
+	if(linear >= t->linear_size)
 		return std::make_pair(reinterpret_cast<region*>(NULL), 0);
 	size_t lb = 0;
-	size_t ub = linear_bases.size() - 1;
+	size_t ub = t->linear_bases.size() - 1;
 	while(lb < ub) {
 		size_t mb = (lb + ub) / 2;
-		if(linear_bases[mb] > linear) {
+		if(t->linear_bases[mb] > linear) {
 			ub = mb;
 			continue;
 		}
-		if(linear_bases[mb + 1] <= linear) {
+		if(t->linear_bases[mb + 1] <= linear) {
 			lb = mb + 1;
 			continue;
 		}
-		return std::make_pair(u_lregions[mb], linear - linear_bases[mb]);
+		return std::make_pair(t->lregions[mb], linear - t->linear_bases[mb]);
 	}
 	return std::make_pair(reinterpret_cast<region*>(NULL), 0);
 }
@@ -244,18 +295,18 @@ bool memory_space::write_range_linear(uint64_t address, const void* buffer, size
 
 memory_space::region* memory_space::lookup_n(size_t n)
 {
-	threads::alock m(mlock);
-	if(n >= u_regions.size())
+	const table* t = current.load(std::memory_order_acquire);
+	if(n >= t->regions.size())
 		return NULL;
-	return u_regions[n];
+	return t->regions[n];
 }
 
 
 std::list<memory_space::region*> memory_space::get_regions()
 {
-	threads::alock m(mlock);
+	const table* t = current.load(std::memory_order_acquire);
 	std::list<region*> r;
-	for(auto i : u_regions)
+	for(auto i : t->regions)
 		r.push_back(i);
 	return r;
 }
@@ -310,10 +361,20 @@ void memory_space::set_regions(const std::list<memory_space::region*>& regions)
 	}
 	n_linear_bases[i] = base;
 
-	std::swap(u_regions, n_regions);
-	std::swap(u_lregions, n_lregions);
-	std::swap(linear_bases, n_linear_bases);
-	linear_size = base;
+	table* t = new table;
+	std::swap(t->regions, n_regions);
+	std::swap(t->lregions, n_lregions);
+	std::swap(t->linear_bases, n_linear_bases);
+	t->linear_size = base;
+	t->generation = next_generation++;
+	try {
+		tables.push_back(t);
+	} catch(...) {
+		delete t;
+		throw;
+	}
+	//New generation invalidates all cached translations.
+	current.store(t, std::memory_order_release);
 }
 
 int memory_space::_get_system_endian()
@@ -328,8 +389,8 @@ int memory_space::sysendian = 0;
 
 std::string memory_space::address_to_textual(uint64_t addr)
 {
-	threads::alock m(mlock);
-	for(auto i : u_regions) {
+	const table* t = current.load(std::memory_order_acquire);
+	for(auto i : t->regions) {
 		if(addr >= i->base && addr <= i->last_address()) {
 			return (stringfmt() << i->name << "+" << std::hex << (addr - i->base)).str();
 		}
@@ -5,6 +5,7 @@
 #include "mathexpr-error.hpp"
 #include "mathexpr.hpp"
 #include <sstream>
+#include <cstring>
 #include "string.hpp"
 
 namespace memorywatch
@@ -20,6 +21,10 @@ namespace
 memread_oper::memread_oper()
 	: operinfo("(readmemory)")
 {
+	last_valid = false;
+	last_addr = 0;
+	memset(last_data, 0, sizeof(last_data));
+	version = 0;
 }
 
 memread_oper::~memread_oper() {}
@@ -28,11 +33,43 @@ void memread_oper::evaluate(mathexpr::value target, std::vector<std::function<ma
 {
 	if(promises.size() != 1)
 		throw mathexpr::error(mathexpr::error::ARGCOUNT, "Memory read operator takes 1 argument");
-	static const int system_endian = memory_space::get_system_endian();
-	uint64_t addr;
 	mathexpr::value val;
 	try {
 		val = promises[0]();
+	} catch(std::exception& e) {
+		throw mathexpr::error(mathexpr::error::ADDR, e.what());
+	}
+	read(target, val);
+}
+
+void memread_oper::evaluate_strict(mathexpr::value target, void** args, size_t nargs)
+{
+	if(nargs != 1)
+		throw mathexpr::error(mathexpr::error::ARGCOUNT, "Memory read operator takes 1 argument");
+	mathexpr::value val;
+	val.type = target.type;
+	val._value = args[0];
+	read(target, val);
+}
+
+uint64_t memread_oper::source_version()
+{
+	if(!last_valid || bytes > 8)
+		return version;
+	char buf[8];
+	mspace->read_range(last_addr, buf, bytes);
+	if(memcmp(buf, last_data, bytes)) {
+		memcpy(last_data, buf, bytes);
+		version++;
+	}
+	return version;
+}
+
+void memread_oper::read(mathexpr::value target, mathexpr::value val)
+{
+	static const int system_endian = memory_space::get_system_endian();
+	uint64_t addr;
+	try {
 		void* res = val._value;
 		addr = val.type->tounsigned(res);
 		if(addr_size)
@@ -45,6 +82,12 @@ void memread_oper::evaluate(mathexpr::value target, std::vector<std::function<ma
 		throw mathexpr::error(mathexpr::error::SIZE, "Memory read size out of range");
 	char buf[8];
 	mspace->read_range(addr, buf, bytes);
+	if(!last_valid || addr != last_addr || memcmp(buf, last_data, bytes)) {
+		last_valid = true;
+		last_addr = addr;
+		memcpy(last_data, buf, bytes);
+		version++;
+	}
 	//Endian swap if needed.
 	if(endianess && system_endian != endianess)
 		for(unsigned i = 0; i < bytes / 2; i++)
@@ -210,20 +253,49 @@ std::string item::get_value()
 	return out.str();
 }
 
+bool item::cache_hit()
+{
+	if(!sources_known) {
+		std::set<mathexpr::operinfo*> _sources;
+		expr->get_sources(_sources);
+		sources = std::vector<mathexpr::operinfo*>(_sources.begin(), _sources.end());
+		source_versions.resize(sources.size());
+		sources_known = true;
+	}
+	//Poll all sources even on miss, so the versions recorded are current.
+	bool hit = cache_valid;
+	for(size_t i = 0; i < sources.size(); i++) {
+		uint64_t v = sources[i]->source_version();
+		if(v != source_versions[i])
+			hit = false;
+		source_versions[i] = v;
+	}
+	return hit;
+}
+
 void item::show(const std::string& n)
 {
-	std::string x;
-	try {
-		x = get_value();
-	} catch(std::bad_alloc& e) {
-		throw;
-	} catch(mathexpr::error& e) {
-		x = e.get_short_error();
-	} catch(std::runtime_error& e) {
-		x = e.what();
+	//If nothing the expression reads has changed, the value can't have changed.
+	if(!cache_hit()) {
+		std::string x;
+		cache_valid = false;
+		try {
+			x = get_value();
+		} catch(std::bad_alloc& e) {
+			throw;
+		} catch(mathexpr::error& e) {
+			x = e.get_short_error();
+		} catch(std::runtime_error& e) {
+			x = e.what();
+		}
+		std::swap(cached_value, x);
+		//The evaluation may have read different data than the poll above.
+		for(size_t i = 0; i < sources.size(); i++)
+			source_versions[i] = sources[i]->source_version();
+		cache_valid = true;
 	}
 	if(printer)
-		printer->show(n, x);
+		printer->show(n, cached_value);
 }
 
 
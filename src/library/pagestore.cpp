@@ -0,0 +1,270 @@
+#include "pagestore.hpp"
+#include "memtracker.hpp"
+#include "threads.hpp"
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace pagestore
+{
+struct page
+{
+	uint64_t hash;
+	size_t refcount;
+	size_t length;
+	char data[page_size];
+};
+
+namespace
+{
+	const char* pagestore_id = "Savestate pages";
+
+	uint64_t hash_page(const char* data, size_t size)
+	{
+		uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+		size_t i = 0;
+		for(; i + 8 <= size; i += 8) {
+			uint64_t w;
+			memcpy(&w, data + i, 8);
+			h = (h ^ w) * 0x100000001B3ULL;
+			h ^= h >> 29;
+		}
+		for(; i < size; i++)
+			h = (h ^ (unsigned char)data[i]) * 0x100000001B3ULL;
+		h ^= h >> 32;
+		return h;
+	}
+
+	struct store
+	{
+		threads::lock mlock;
+		std::unordered_multimap<uint64_t, page*> pages;
+		size_t references;
+		store() : references(0) {}
+		//Must be called with lock held.
+		page* intern(const char* data, size_t size)
+		{
+			uint64_t h = hash_page(data, size);
+			auto r = pages.equal_range(h);
+			for(auto i = r.first; i != r.second; i++) {
+				page* p = i->second;
+				if(p->length == size && !memcmp(p->data, data, size)) {
+					p->refcount++;
+					references++;
+					return p;
+				}
+			}
+			page* p = new page;
+			p->hash = h;
+			p->refcount = 1;
+			p->length = size;
+			memcpy(p->data, data, size);
+			try {
+				pages.insert(std::make_pair(h, p));
+			} catch(...) {
+				delete p;
+				throw;
+			}
+			references++;
+			memtracker::singleton()(pagestore_id, sizeof(page));
+			return p;
+		}
+		//Must be called with lock held.
+		void ref(page* p)
+		{
+			p->refcount++;
+			references++;
+		}
+		//Must be called with lock held.
+		void unref(page* p)
+		{
+			references--;
+			if(--p->refcount)
+				return;
+			auto r = pages.equal_range(p->hash);
+			for(auto i = r.first; i != r.second; i++)
+				if(i->second == p) {
+					pages.erase(i);
+					break;
+				}
+			delete p;
+			memtracker::singleton()(pagestore_id, -(ssize_t)sizeof(page));
+		}
+		void unref_all(std::vector<page*>& list)
+		{
+			for(auto i : list)
+				unref(i);
+			list.clear();
+		}
+	};
+
+	store& get_store()
+	{
+		//Leaked on purpose: snapshots in static objects may outlive any static store.
+		static store* s = new store;
+		return *s;
+	}
+}
+
+snapshot::snapshot() throw()
+{
+	length = 0;
+	changed = 0;
+}
+
+snapshot::snapshot(const std::vector<char>& data, const snapshot* hint) throw(std::bad_alloc)
+	: snapshot(data.empty() ? NULL : &data[0], data.size(), hint)
+{
+}
+
+snapshot::snapshot(const char* data, size_t size, const snapshot* hint) throw(std::bad_alloc)
+{
+	std::vector<std::pair<const char*, size_t>> spans;
+	spans.push_back(std::make_pair(data, size));
+	init(spans, hint);
+}
+
+snapshot::snapshot(const std::vector<std::pair<const char*, size_t>>& data, const snapshot* hint)
+	throw(std::bad_alloc)
+{
+	init(data, hint);
+}
+
+void snapshot::init(const std::vector<std::pair<const char*, size_t>>& data, const snapshot* hint)
+{
+	length = 0;
+	changed = 0;
+	size_t size = 0;
+	for(auto& i : data)
+		size += i.second;
+	size_t npages = (size + page_size - 1) / page_size;
+	pages.reserve(npages);
+	//Pages that straddle span boundaries are assembled here, others are read in place.
+	char tmp[page_size];
+	size_t span = 0;
+	size_t spanoff = 0;
+	store& s = get_store();
+	threads::alock h(s.mlock);
+	try {
+		for(size_t i = 0; i < npages; i++) {
+			size_t psize = std::min(page_size, size - i * page_size);
+			while(spanoff == data[span].second) {
+				span++;
+				spanoff = 0;
+			}
+			const char* pdata;
+			if(data[span].second - spanoff >= psize) {
+				pdata = data[span].first + spanoff;
+				spanoff += psize;
+			} else {
+				size_t filled = 0;
+				while(filled < psize) {
+					if(spanoff == data[span].second) {
+						span++;
+						spanoff = 0;
+						continue;
+					}
+					size_t c = std::min(psize - filled, data[span].second - spanoff);
+					memcpy(tmp + filled, data[span].first + spanoff, c);
+					filled += c;
+					spanoff += c;
+				}
+				pdata = tmp;
+			}
+			page* hp = (hint && i < hint->pages.size()) ? hint->pages[i] : NULL;
+			if(hp && hp->length == psize && !memcmp(hp->data, pdata, psize)) {
+				s.ref(hp);
+				pages.push_back(hp);
+			} else {
+				page* p = s.intern(pdata, psize);
+				pages.push_back(p);
+				changed++;
+			}
+		}
+	} catch(...) {
+		s.unref_all(pages);
+		throw;
+	}
+	length = size;
+}
+
+snapshot::snapshot(const snapshot& s) throw(std::bad_alloc)
+{
+	store& st = get_store();
+	pages.reserve(s.pages.size());
+	threads::alock h(st.mlock);
+	for(auto i : s.pages) {
+		st.ref(i);
+		pages.push_back(i);
+	}
+	length = s.length;
+	changed = s.changed;
+}
+
+snapshot& snapshot::operator=(const snapshot& s) throw(std::bad_alloc)
+{
+	if(this == &s)
+		return *this;
+	snapshot tmp(s);
+	swap(tmp);
+	return *this;
+}
+
+snapshot::~snapshot() throw()
+{
+	clear();
+}
+
+void snapshot::clear() throw()
+{
+	if(pages.empty())
+		return;
+	store& s = get_store();
+	threads::alock h(s.mlock);
+	s.unref_all(pages);
+	length = 0;
+	changed = 0;
+}
+
+void snapshot::swap(snapshot& s) throw()
+{
+	std::swap(pages, s.pages);
+	std::swap(length, s.length);
+	std::swap(changed, s.changed);
+}
+
+void snapshot::materialize(std::vector<char>& out) const throw(std::bad_alloc)
+{
+	out.resize(length);
+	size_t off = 0;
+	for(auto i : pages) {
+		memcpy(&out[off], i->data, i->length);
+		off += i->length;
+	}
+}
+
+void snapshot::get_spans(std::vector<std::pair<const char*, size_t>>& out) const throw(std::bad_alloc)
+{
+	out.clear();
+	out.reserve(pages.size());
+	for(auto i : pages)
+		out.push_back(std::make_pair(i->data, i->length));
+}
+
+std::vector<char> snapshot::materialize() const throw(std::bad_alloc)
+{
+	std::vector<char> out;
+	materialize(out);
+	return out;
+}
+
+stats get_stats() throw()
+{
+	stats ret;
+	store& s = get_store();
+	threads::alock h(s.mlock);
+	ret.unique_pages = s.pages.size();
+	ret.references = s.references;
+	return ret;
+}
+}
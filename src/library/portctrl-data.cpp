@@ -8,16 +8,81 @@
 #include "sha256.hpp"
 #include <iostream>
 #include <sys/time.h>
+#include <unistd.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#endif
 #include <sstream>
 #include <list>
 #include <deque>
 #include <complex>
+#include <limits>
 
 namespace portctrl
 {
 const char* movie_page_id = "Input tracks";
 namespace
 {
+	struct page_deleter
+	{
+		void operator()(unsigned char* p)
+		{
+			memtracker::singleton()(movie_page_id, -CONTROLLER_PAGE_SIZE - 36);
+			delete[] p;
+		}
+	};
+
+	//Allocate a heap page, initialized with size bytes from src and rest zero.
+	std::shared_ptr<unsigned char> alloc_page(const unsigned char* src, size_t size)
+	{
+		unsigned char* p = new unsigned char[CONTROLLER_PAGE_SIZE];
+		memtracker::singleton()(movie_page_id, CONTROLLER_PAGE_SIZE + 36);
+		std::shared_ptr<unsigned char> r(p, page_deleter());
+		if(size)
+			memcpy(p, src, size);
+		memset(p + size, 0, CONTROLLER_PAGE_SIZE - size);
+		return r;
+	}
+
+	//Text smaller than this is coded in one piece.
+	const size_t text_chunk_bytes = 65536;
+	const uint64_t text_chunk_frames = 4096;
+
+	//Number of chunks to split work of given size to.
+	size_t chunk_count(uint64_t size, uint64_t min_chunk)
+	{
+		uint64_t n = threads::thread::hardware_concurrency();
+		if(n < 2)
+			return 1;
+		n = min(4 * n, size / min_chunk);
+		return max(n, (uint64_t)1);
+	}
+
+	//Length of line starting at buf, without the terminating LF and trailing CRs.
+	size_t text_line_length(const char* buf, const char* nl)
+	{
+		size_t len = nl - buf;
+		while(len > 0 && buf[len - 1] == '\r')
+			len--;
+		return len;
+	}
+
+	//Count the nonempty lines in text.
+	uint64_t count_text_lines(const char* buf, size_t size)
+	{
+		uint64_t count = 0;
+		size_t ptr = 0;
+		while(ptr < size) {
+			const char* nl = reinterpret_cast<const char*>(memchr(buf + ptr, '\n', size - ptr));
+			if(!nl)
+				break;
+			if(text_line_length(buf + ptr, nl))
+				count++;
+			ptr = nl - buf + 1;
+		}
+		return count;
+	}
+
 	controller simple_controller = {"(system)", "system", {}};
 	controller_set simple_port = {"system", "system", "system", {simple_controller},{0}};
 
@@ -262,7 +327,7 @@ namespace
 		return i;
 	}
 
-	uint64_t find_next_sync(frame_vector& movie, uint64_t after)
+	uint64_t find_next_sync(const frame_vector& movie, uint64_t after)
 	{
 		if(after >= movie.size())
 			return after;
@@ -490,19 +555,15 @@ size_t frame_vector::walk_helper(size_t frame, bool sflag) throw()
 	size_t page = frame / frames_per_page;
 	size_t offset = frame_size * (frame % frames_per_page);
 	size_t index = frame % frames_per_page;
-	if(cache_page_num != page) {
-		cache_page = &pages[page];
-		cache_page_num = page;
-	}
+	const unsigned char* content = (frame < frames) ? readable_page(page) : NULL;
 	while(frame < frames) {
 		if(index == frames_per_page) {
 			page++;
-			cache_page = &pages[page];
-			cache_page_num = page;
+			content = readable_page(page);
 			index = 0;
 			offset = 0;
 		}
-		if(frame::sync(cache_page->content + offset))
+		if(frame::sync(content + offset))
 			break;
 		index++;
 		offset += frame_size;
@@ -516,20 +577,22 @@ size_t frame_vector::recount_frames() throw()
 {
 	uint64_t old_frame_count = real_frame_count;
 	size_t ret = 0;
-	if(!frames)
+	if(!frames) {
+		real_frame_count = 0;
+		call_framecount_notification(old_frame_count);
 		return 0;
-	cache_page_num = 0;
-	cache_page = &pages[0];
+	}
+	size_t page = 0;
+	const unsigned char* content = readable_page(0);
 	size_t offset = 0;
 	size_t index = 0;
 	for(size_t i = 0; i < frames; i++) {
 		if(index == frames_per_page) {
-			cache_page_num++;
-			cache_page = &pages[cache_page_num];
+			content = readable_page(++page);
 			index = 0;
 			offset = 0;
 		}
-		if(frame::sync(cache_page->content + offset))
+		if(frame::sync(content + offset))
 			ret++;
 		index++;
 		offset += frame_size;
@@ -582,16 +645,16 @@ void frame_vector::append(frame cframe) throw(std::bad_alloc, std::runtime_error
 		throw std::runtime_error("frame_vector::append: Type mismatch");
 	if(frames % frames_per_page == 0) {
 		//Create new page.
-		pages[frames / frames_per_page];
+		add_pages(1);
 	}
 	//Write the entry.
 	size_t page = frames / frames_per_page;
 	size_t offset = frame_size * (frames % frames_per_page);
 	if(cache_page_num != page) {
+		cache_page = writable_page(page);
 		cache_page_num = page;
-		cache_page = &pages[page];
 	}
-	frame(cache_page->content + offset, *types) = cframe;
+	frame(cache_page + offset, *types) = cframe;
 	if(cframe.sync()) real_frame_count++;
 	frames++;
 }
@@ -611,22 +674,17 @@ frame_vector& frame_vector::operator=(const frame_vector& v)
 	if(this == &v)
 		return *this;
 	uint64_t old_frame_count = real_frame_count;
-	resize(v.frames);
+	//The pages are shared, not copied. Neither side may keep writable pointers to them.
+	pages = v.pages;
 	clear_cache();
+	v.clear_cache();
 
 	//Copy the fields.
 	frame_size = v.frame_size;
 	frames_per_page = v.frames_per_page;
+	frames = v.frames;
 	types = v.types;
 	real_frame_count = v.real_frame_count;
-
-	//This can't fail anymore. Copy the raw page contents.
-	size_t pagecount = (frames + frames_per_page - 1) / frames_per_page;
-	for(size_t i = 0; i < pagecount; i++) {
-		page& pg = pages[i];
-		const page& pg2 = v.pages.find(i)->second;
-		pg = pg2;
-	}
 	call_framecount_notification(old_frame_count);
 	return *this;
 }
@@ -640,15 +698,14 @@ void frame_vector::resize(size_t newsize) throw(std::bad_alloc)
 		//Shrink movie.
 		uint64_t old_frame_count = real_frame_count;
 		for(size_t i = newsize; i < frames; i++)
-			if((*this)[i].sync()) real_frame_count--;
-		size_t current_pages = (frames + frames_per_page - 1) / frames_per_page;
+			if(frame::sync(readable_page(i / frames_per_page) + frame_size * (i % frames_per_page)))
+				real_frame_count--;
 		size_t pages_needed = (newsize + frames_per_page - 1) / frames_per_page;
-		for(size_t i = pages_needed; i < current_pages; i++)
-			pages.erase(i);
+		pages.resize(pages_needed);
 		//Now zeroize the excess memory.
 		if(newsize < pages_needed * frames_per_page) {
 			size_t offset = frame_size * (newsize % frames_per_page);
-			memset(pages[pages_needed - 1].content + offset, 0, CONTROLLER_PAGE_SIZE - offset);
+			memset(writable_page(pages_needed - 1) + offset, 0, CONTROLLER_PAGE_SIZE - offset);
 		}
 		frames = newsize;
 		call_framecount_notification(old_frame_count);
@@ -657,16 +714,7 @@ void frame_vector::resize(size_t newsize) throw(std::bad_alloc)
 		size_t current_pages = (frames + frames_per_page - 1) / frames_per_page;
 		size_t pages_needed = (newsize + frames_per_page - 1) / frames_per_page;
 		//Create the needed pages.
-		for(size_t i = current_pages; i < pages_needed; i++) {
-			try {
-				pages[i];
-			} catch(...) {
-				for(size_t i = current_pages; i < pages_needed; i++)
-					if(pages.count(i))
-						pages.erase(i);
-				throw;
-			}
-		}
+		add_pages(pages_needed - current_pages);
 		frames = newsize;
 		//This can use real_frame_count, because the real frame count won't change.
 		call_framecount_notification(real_frame_count);
@@ -679,6 +727,9 @@ bool frame_vector::compatible(frame_vector& with, uint64_t nframe, const uint32_
 	if(get_types() != with.get_types())
 		return false;
 	const type_set& pset = with.get_types();
+	//Read through const references, so nothing gets unshared.
+	const frame_vector& cold = *this;
+	const frame_vector& cnew = with;
 	//If new movie is before first frame, anything with same project_id is compatible.
 	if(nframe == 0)
 		return true;
@@ -694,8 +745,8 @@ bool frame_vector::compatible(frame_vector& with, uint64_t nframe, const uint32_
 	size_t complete_pages = min(ocomplete_pages, ncomplete_pages);
 	while(syncs_seen + frames_per_page < nframe - 1 && pagenum < complete_pages) {
 		//Fast process page. The above condition guarantees that these pages are completely used.
-		auto opagedata = pages[pagenum].content;
-		auto npagedata = with.pages[pagenum].content;
+		auto opagedata = readable_page(pagenum);
+		auto npagedata = with.readable_page(pagenum);
 		size_t pagedataamt = frames_per_page * frame_size;
 		if(memcmp(opagedata, npagedata, pagedataamt))
 			return false;
@@ -707,9 +758,9 @@ bool frame_vector::compatible(frame_vector& with, uint64_t nframe, const uint32_
 	while(syncs_seen < nframe - 1) {
 		frame oldc = blank_frame(true), newc = with.blank_frame(true);
 		if(frames_read < old_size)
-			oldc = (*this)[frames_read];
+			oldc = cold[frames_read];
 		if(frames_read < new_size)
-			newc = with[frames_read];
+			newc = cnew[frames_read];
 		if(oldc != newc)
 			return false;	//Mismatch.
 		frames_read++;
@@ -732,9 +783,9 @@ bool frame_vector::compatible(frame_vector& with, uint64_t nframe, const uint32_
 		short ov = 0, nv = 0;
 		for(uint32_t j = 0; j < p; j++) {
 			if(j < readable_old_subframes)
-				ov = (*this)[j + frames_read].axis2(i);
+				ov = cold[j + frames_read].axis2(i);
 			if(j < readable_new_subframes)
-				nv = with[j + frames_read].axis2(i);
+				nv = cnew[j + frames_read].axis2(i);
 			if(ov != nv)
 				return false;
 		}
@@ -742,6 +793,112 @@ bool frame_vector::compatible(frame_vector& with, uint64_t nframe, const uint32_
 	return true;
 }
 
+void frame_vector::serialize_text(uint64_t first, uint64_t count, std::string& out) const throw(std::bad_alloc)
+{
+	uint64_t last = min(first + count, (uint64_t)frames);
+	if(first >= last)
+		return;
+	//Serialize chunks into separate buffers, then join them in order.
+	size_t nchunks = chunk_count(last - first, text_chunk_frames);
+	std::vector<std::string> parts(nchunks);
+	threads::parallel_for(nchunks, [this, first, last, nchunks, &parts](size_t c) {
+		char buffer[MAX_SERIALIZED_SIZE + 1];
+		uint64_t cfirst = first + (last - first) * c / nchunks;
+		uint64_t clast = first + (last - first) * (c + 1) / nchunks;
+		std::string& part = parts[c];
+		for(uint64_t i = cfirst; i < clast; i++) {
+			unsigned char* content = const_cast<unsigned char*>(readable_page(i / frames_per_page)) +
+				frame_size * (i % frames_per_page);
+			frame(content, *types).serialize(buffer);
+			size_t len = strlen(buffer);
+			buffer[len++] = '\n';
+			part.append(buffer, len);
+		}
+	});
+	if(nchunks == 1 && out.empty()) {
+		std::swap(out, parts[0]);
+		return;
+	}
+	size_t total = out.size();
+	for(auto& i : parts)
+		total += i.size();
+	out.reserve(total);
+	for(auto& i : parts)
+		out.append(i);
+}
+
+size_t frame_vector::deserialize_text(const char* buf, size_t size) throw(std::bad_alloc, std::runtime_error)
+{
+	//Only complete lines are decoded.
+	size_t end = size;
+	while(end > 0 && buf[end - 1] != '\n')
+		end--;
+	if(!end)
+		return 0;
+	//Split the text to line-aligned chunks, and find the frame each starts from.
+	size_t nchunks = chunk_count(end, text_chunk_bytes);
+	std::vector<size_t> bounds;
+	bounds.push_back(0);
+	for(size_t i = 1; i < nchunks; i++) {
+		size_t p = max((size_t)((uint64_t)end * i / nchunks), bounds.back());
+		//Terminates, as the last character is LF.
+		p = reinterpret_cast<const char*>(memchr(buf + p, '\n', end - p)) - buf + 1;
+		if(p < end)
+			bounds.push_back(p);
+	}
+	bounds.push_back(end);
+	nchunks = bounds.size() - 1;
+	std::vector<uint64_t> start(nchunks + 1);
+	threads::parallel_for(nchunks, [buf, &bounds, &start](size_t c) {
+		start[c + 1] = count_text_lines(buf + bounds[c], bounds[c + 1] - bounds[c]);
+	});
+	start[0] = frames;
+	for(size_t i = 0; i < nchunks; i++)
+		start[i + 1] += start[i];
+	uint64_t newframes = start[nchunks];
+	//Create the pages and make them writable before decoding, so decoding does not modify the page table.
+	clear_cache();
+	size_t old_pages = pages.size();
+	size_t first_page = frames / frames_per_page;
+	add_pages((newframes + frames_per_page - 1) / frames_per_page - old_pages);
+	std::vector<unsigned char*> page_ptr;
+	std::vector<uint64_t> syncs(nchunks);
+	try {
+		for(size_t i = first_page; i < pages.size(); i++)
+			page_ptr.push_back(writable_page(i));
+		threads::parallel_for(nchunks, [this, buf, first_page, &bounds, &start, &page_ptr, &syncs](size_t c) {
+			uint64_t n = start[c];
+			size_t ptr = bounds[c];
+			while(ptr < bounds[c + 1]) {
+				const char* nl = reinterpret_cast<const char*>(memchr(buf + ptr, '\n',
+					bounds[c + 1] - ptr));
+				if(text_line_length(buf + ptr, nl)) {
+					unsigned char* content = page_ptr[n / frames_per_page - first_page] +
+						frame_size * (n % frames_per_page);
+					frame(content, *types).deserialize(buf + ptr);
+					if(frame::sync(content)) syncs[c]++;
+					n++;
+				}
+				ptr = nl - buf + 1;
+			}
+		});
+	} catch(...) {
+		//Drop the new frames. The rest of the old last page has to stay zeroes.
+		pages.resize(old_pages);
+		if(frames % frames_per_page) {
+			size_t offset = frame_size * (frames % frames_per_page);
+			memset(writable_page(old_pages - 1) + offset, 0, CONTROLLER_PAGE_SIZE - offset);
+		}
+		throw;
+	}
+	uint64_t old_frame_count = real_frame_count;
+	for(auto i : syncs)
+		real_frame_count += i;
+	frames = newframes;
+	if(!freeze_count) call_framecount_notification(old_frame_count);
+	return end;
+}
+
 uint64_t frame_vector::binary_size() const throw()
 {
 	return size() * get_stride();
@@ -764,20 +921,14 @@ void frame_vector::save_binary(binarystream::output& stream) const throw(std::ru
 
 void frame_vector::load_binary(binarystream::input& stream) throw(std::bad_alloc, std::runtime_error)
 {
-	uint64_t stride = get_stride();
-	uint64_t pageframes = get_frames_per_page();
-	uint64_t vsize = 0;
-	size_t pagenum = 0;
-	uint64_t pagesize = stride * pageframes;
-	while(stream.get_left()) {
-		resize(vsize + pageframes);
-		unsigned char* contents = get_page_buffer(pagenum++);
-		uint64_t gcount = min(pagesize, stream.get_left());
-		stream.raw(contents, gcount);
-		vsize += (gcount / stride);
-	}
-	resize(vsize);
-	recount_frames();
+	//Read the whole record at once and use it as pages directly, instead of copying page by page.
+	uint64_t size = stream.get_left();
+	if(size > std::numeric_limits<size_t>::max())
+		throw std::bad_alloc();
+	std::shared_ptr<unsigned char> data(new unsigned char[size ? size : 1],
+		std::default_delete<unsigned char[]>());
+	stream.raw(data.get(), size);
+	adopt_binary(data, size);
 }
 
 void frame_vector::swap_data(frame_vector& v) throw()
@@ -798,6 +949,87 @@ void frame_vector::swap_data(frame_vector& v) throw()
 		v.call_framecount_notification(voldsize);
 }
 
+void frame_vector::adopt_binary(const std::shared_ptr<unsigned char>& data, size_t size) throw(std::bad_alloc)
+{
+	size_t pagesize = frame_size * frames_per_page;
+	size_t nframes = size / frame_size;
+	size_t full_pages = nframes / frames_per_page;
+	size_t tail = nframes % frames_per_page;
+	std::vector<page> npages;
+	npages.resize(full_pages + (tail ? 1 : 0));
+	for(size_t i = 0; i < full_pages; i++) {
+		npages[i].content = std::shared_ptr<unsigned char>(data, data.get() + i * pagesize);
+		npages[i].owned = false;
+	}
+	//Partial page has to be copied, as the end of the page has to be zeroes.
+	if(tail) {
+		npages[full_pages].content = alloc_page(data.get() + full_pages * pagesize, tail * frame_size);
+		npages[full_pages].owned = true;
+	}
+	clear_cache();
+	std::swap(pages, npages);
+	frames = nframes;
+	recount_frames();
+}
+
+void frame_vector::map_binary(int fd, uint64_t offset, uint64_t size) throw(std::bad_alloc, std::runtime_error)
+{
+	if(size > std::numeric_limits<size_t>::max())
+		throw std::bad_alloc();
+#if !defined(_WIN32) && !defined(_WIN64)
+	uint64_t base = offset / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+	size_t maplen = size + (offset - base);
+	void* m = size ? mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, base) : MAP_FAILED;
+	if(m != MAP_FAILED) {
+		std::shared_ptr<unsigned char> mapping(reinterpret_cast<unsigned char*>(m),
+			[maplen](unsigned char* p) { munmap(p, maplen); });
+		adopt_binary(std::shared_ptr<unsigned char>(mapping, mapping.get() + (offset - base)), size);
+		return;
+	}
+#endif
+	//Can't map, read the data into memory instead.
+	std::shared_ptr<unsigned char> data(new unsigned char[size ? size : 1],
+		std::default_delete<unsigned char[]>());
+	if(lseek(fd, offset, SEEK_SET) < 0)
+		throw std::runtime_error("Can't seek to movie data");
+	size_t done = 0;
+	while(done < size) {
+		ssize_t r = read(fd, data.get() + done, size - done);
+		if(r <= 0)
+			throw std::runtime_error("Can't read movie data");
+		done += r;
+	}
+	adopt_binary(data, size);
+}
+
+unsigned char* frame_vector::writable_page(size_t page)
+{
+	struct page& p = pages[page];
+	if(!p.owned || p.content.use_count() > 1) {
+		//Adopted pages are full, heap pages are copied with their zero tails.
+		size_t valid = p.owned ? CONTROLLER_PAGE_SIZE : frame_size * frames_per_page;
+		p.content = alloc_page(p.content.get(), valid);
+		p.owned = true;
+	}
+	return p.content.get();
+}
+
+void frame_vector::add_pages(size_t count)
+{
+	size_t old = pages.size();
+	try {
+		for(size_t i = 0; i < count; i++) {
+			page p;
+			p.content = alloc_page(NULL, 0);
+			p.owned = true;
+			pages.push_back(p);
+		}
+	} catch(...) {
+		pages.resize(old);
+		throw;
+	}
+}
+
 int64_t frame_vector::find_frame(uint64_t n)
 {
 	if(!n) return -1;
@@ -807,7 +1039,7 @@ int64_t frame_vector::find_frame(uint64_t n)
 	size_t pagenum = 0;
 	while(vsize > 0) {
 		uint64_t count = (vsize > pageframes) ? pageframes : vsize;
-		const unsigned char* content = get_page_buffer(pagenum++);
+		const unsigned char* content = readable_page(pagenum++);
 		size_t offset = 0;
 		for(unsigned i = 0; i < count; i++) {
 			if(frame::sync(content + offset)) n--;
@@ -829,7 +1061,7 @@ int64_t frame_vector::subframe_to_frame(uint64_t n)
 	size_t pagenum = 0;
 	size_t cpage = n / pageframes;
 	for(uint64_t p = 0; p < cpage; p++) {
-		const unsigned char* content = get_page_buffer(pagenum++);
+		const unsigned char* content = readable_page(pagenum++);
 		size_t offset = 0;
 		for(unsigned i = 0; i < pageframes; i++) {
 			if(frame::sync(content + offset)) ret++;
@@ -837,7 +1069,7 @@ int64_t frame_vector::subframe_to_frame(uint64_t n)
 		}
 	}
 	{
-		const unsigned char* content = get_page_buffer(pagenum++);
+		const unsigned char* content = readable_page(pagenum++);
 		size_t offset = 0;
 		unsigned idx = n % pageframes;
 		for(unsigned i = 0; i < idx; i++) {
@@ -734,6 +734,9 @@ size_t type_generic::port_size(const JSON::node& root, const std::string& ptr)
 
 void type_generic::make_dynamic_blocks()
 {
+	//Allow forcing the interpreted routines, e.g. for comparing against them.
+	if(getenv("PTG_NO_DYNAMIC"))
+		return;
 	try {
 		assembler::label_list labels;
 		assembler::assembler a;
@@ -0,0 +1,112 @@
+#include "rewindbuffer.hpp"
+#include <cstring>
+
+namespace rewindbuffer
+{
+namespace
+{
+	//Literal runs shorter than this are merged into surrounding literals.
+	const size_t min_skip = 8;
+
+	void write_varint(std::vector<char>& out, size_t v)
+	{
+		while(v >= 128) {
+			out.push_back(0x80 | (v & 0x7F));
+			v >>= 7;
+		}
+		out.push_back(v);
+	}
+
+	size_t read_varint(const std::vector<char>& in, size_t& ptr)
+	{
+		size_t v = 0;
+		unsigned shift = 0;
+		while(true) {
+			if(ptr >= in.size() || shift >= 8 * sizeof(size_t))
+				throw std::runtime_error("Rewind delta corrupt");
+			unsigned char c = in[ptr++];
+			v |= static_cast<size_t>(c & 0x7F) << shift;
+			if(!(c & 0x80))
+				return v;
+			shift += 7;
+		}
+	}
+
+	inline unsigned char byte_at(const char* buf, size_t size, size_t i)
+	{
+		return (i < size) ? buf[i] : 0;
+	}
+
+	//Find the first differing byte at or after i.
+	size_t skip_equal(const char* a, const char* b, size_t common, size_t i)
+	{
+		while(i + 8 <= common) {
+			uint64_t x, y;
+			memcpy(&x, a + i, 8);
+			memcpy(&y, b + i, 8);
+			if(x != y)
+				break;
+			i += 8;
+		}
+		while(i < common && a[i] == b[i])
+			i++;
+		return i;
+	}
+}
+
+void encode_delta(std::vector<char>& out, const char* a, size_t asize, const char* b, size_t bsize)
+	throw(std::bad_alloc)
+{
+	out.clear();
+	size_t common = (asize < bsize) ? asize : bsize;
+	size_t total = (asize > bsize) ? asize : bsize;
+	size_t i = 0;
+	while(i < total) {
+		//Equal run (only possible in the common part; past that, compare against zero).
+		size_t j = skip_equal(a, b, common, i);
+		if(j >= common)
+			while(j < total && !(byte_at(a, asize, j) ^ byte_at(b, bsize, j)))
+				j++;
+		if(j == total)
+			break;
+		size_t skip = j - i;
+		//Literal run: extend until at least min_skip equal bytes follow.
+		size_t k = j;
+		size_t eq = 0;
+		while(k < total && eq < min_skip) {
+			if(byte_at(a, asize, k) ^ byte_at(b, bsize, k))
+				eq = 0;
+			else
+				eq++;
+			k++;
+		}
+		size_t len = k - j - eq;
+		write_varint(out, skip);
+		write_varint(out, len);
+		size_t base = out.size();
+		out.resize(base + len);
+		for(size_t l = 0; l < len; l++)
+			out[base + l] = byte_at(a, asize, j + l) ^ byte_at(b, bsize, j + l);
+		i = j + len;
+	}
+	std::vector<char> tmp(out);
+	std::swap(out, tmp);
+}
+
+void apply_delta(char* target, size_t size, const std::vector<char>& delta) throw(std::runtime_error)
+{
+	size_t ptr = 0;
+	size_t pos = 0;
+	while(ptr < delta.size()) {
+		size_t skip = read_varint(delta, ptr);
+		size_t len = read_varint(delta, ptr);
+		if(skip > size - pos || len > size - pos - skip || len > delta.size() - ptr)
+			throw std::runtime_error("Rewind delta corrupt");
+		pos += skip;
+		for(size_t l = 0; l < len; l++)
+			target[pos + l] ^= delta[ptr + l];
+		pos += len;
+		ptr += len;
+	}
+}
+}
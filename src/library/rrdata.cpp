@@ -4,6 +4,7 @@
 #include <limits>
 #include <functional>
 #include <cassert>
+#include <algorithm>
 
 #define MAXRUN 16843009
 
@@ -106,6 +107,7 @@ rrdata_set::rrdata_set() throw()
 	rcount = 0;
 	lazy_mode = false;
 	handle_open = false;
+	wcache_dirty = 0;
 }
 
 void rrdata_set::read_base(const std::string& projectfile, bool lazy) throw(std::bad_alloc)
@@ -113,8 +115,8 @@ void rrdata_set::read_base(const std::string& projectfile, bool lazy) throw(std:
 	if(projectfile == current_projectfile && (!lazy_mode || lazy))
 		return;
 	if(lazy) {
-		std::set<std::pair<instance, instance>> new_rrset;
-		data = new_rrset;
+		data.clear();
+		set_dirty(0);
 		current_projectfile = projectfile;
 		rcount = 0;
 		lazy_mode = true;
@@ -123,7 +125,7 @@ void rrdata_set::read_base(const std::string& projectfile, bool lazy) throw(std:
 		handle_open = false;
 		return;
 	}
-	std::set<std::pair<instance, instance>> new_rrset;
+	interval_list new_rrset;
 	uint64_t new_count = 0;
 	if(projectfile == current_projectfile) {
 		new_rrset = data;
@@ -157,7 +159,8 @@ void rrdata_set::read_base(const std::string& projectfile, bool lazy) throw(std:
 			ohandle.flush();
 		}
 	}
-	data = new_rrset;
+	std::swap(data, new_rrset);
+	set_dirty(0);
 	rcount = new_count;
 	current_projectfile = projectfile;
 	lazy_mode = lazy;
@@ -236,9 +239,9 @@ uint64_t rrdata_set::emerg_action(struct rrdata_set::esave_state& state, char* b
 	state.init(data);
 	while(!state.finished() || state.segptr != state.segend) {
 		if(state.segptr == state.segend) {
-			auto i = state.next();
-			state.segptr = i->first;
-			state.segend = i->second;
+			auto& i = data[state.next()];
+			state.segptr = i.first;
+			state.segend = i.second;
 		}
 		unsigned syms = state.segend - state.segptr;
 		if(syms > MAXRUN)
@@ -260,18 +263,32 @@ uint64_t rrdata_set::emerg_action(struct rrdata_set::esave_state& state, char* b
 
 uint64_t rrdata_set::write(std::vector<char>& strm) throw(std::bad_alloc)
 {
-	uint64_t scount = 0;
-	esave_state cstate;
-	size_t ssize = emerg_action(cstate, NULL, 0, scount);
-	cstate.reset();
-	strm.resize(ssize);
-	uint64_t scount2 = 0;
-	size_t ssize2 = emerg_action(cstate, &strm[0], ssize, scount2);
-	if(ssize != ssize2 || scount != scount2) {
-		std::cerr << "RRDATA mismatch!" << std::endl;
-		std::cerr << "Length: Prepare: " << ssize << " Write: " << ssize2 << std::endl;
-		std::cerr << "Scount: Prepare: " << scount << " Write: " << scount2 << std::endl;
+	//Drop the stale part of the cache. Encoding of an interval depends on the end of previous one only.
+	size_t k = std::min(wcache_dirty, wcache_offset.size());
+	if(k < wcache_offset.size())
+		wcache.resize(wcache_offset[k]);
+	wcache_offset.resize(k);
+	wcache_symbols.resize(k);
+	uint64_t scount = k ? wcache_symbols[k - 1] : 0;
+	instance pred = k ? data[k - 1].second : instance();
+	for(size_t i = k; i < data.size(); i++) {
+		wcache_offset.push_back(wcache.size());
+		instance segptr = data[i].first;
+		while(segptr != data[i].second) {
+			unsigned syms = data[i].second - segptr;
+			if(syms > MAXRUN)
+				syms = MAXRUN;
+			char tmp[RRDATA_BYTES + 4];
+			size_t lbytes = _flush_symbol(tmp, segptr, pred, syms);
+			wcache.insert(wcache.end(), tmp, tmp + lbytes);
+			scount += syms;
+			segptr = segptr + syms;
+			pred = segptr;
+		}
+		wcache_symbols.push_back(scount);
 	}
+	wcache_dirty = data.size();
+	strm = wcache;
 	if(scount)
 		return scount - 1;
 	else
@@ -362,95 +379,61 @@ std::ostream& operator<<(std::ostream& os, const struct rrdata_set::instance& j)
 
 bool rrdata_set::_add(const instance& b)
 {
-	uint64_t c = rcount;
-	_add(b, b + 1, data, rcount);
-	return (c != rcount);
+	size_t i = _add(b, b + 1, data, rcount);
+	if(i == std::numeric_limits<size_t>::max())
+		return false;
+	set_dirty(i);
+	return true;
 }
 
 void rrdata_set::_add(const instance& b, const instance& e)
 {
-	_add(b, e, data, rcount);
+	size_t i = _add(b, e, data, rcount);
+	if(i != std::numeric_limits<size_t>::max())
+		set_dirty(i);
 }
 
-void rrdata_set::_add(const instance& b, const instance& e, std::set<std::pair<instance, instance>>& set,
-	uint64_t& cnt)
+size_t rrdata_set::_add(const instance& b, const instance& e, interval_list& set, uint64_t& cnt)
 {
-	//Special case: Nothing.
-	if(set.empty()) {
-		set.insert(std::make_pair(b, e));
+	if(!(b < e))
+		return std::numeric_limits<size_t>::max();
+	//Intervals are disjoint and non-adjacent, so both ends are sorted. [lo, hi) are the ones that touch the new
+	//interval.
+	auto lo = std::lower_bound(set.begin(), set.end(), b,
+		[](const std::pair<instance, instance>& x, const instance& y) -> bool { return x.second < y; });
+	auto hi = std::upper_bound(lo, set.end(), e,
+		[](const instance& y, const std::pair<instance, instance>& x) -> bool { return y < x.first; });
+	size_t index = lo - set.begin();
+	if(lo == hi) {
+		//Common case for adds in the middle: new interval.
+		set.insert(lo, std::make_pair(b, e));
 		cnt += symbols_in_interval(b, e);
-		return;
-	}
-	//Just insert it.
-	auto itr = set.lower_bound(std::make_pair(b, e));
-	if(itr != set.end() && itr->first == b && itr->second == e)
-		return;
-	set.insert(std::make_pair(b, e));
-	cnt += symbols_in_interval(b, e);
-	itr = set.lower_bound(std::make_pair(b, e));
-	auto itr1 = itr;
-	auto itr2 = itr;
-	if(itr1 != set.begin()) itr1--;
-	itr2++;
-	bool have1 = (itr1 != itr);
-	instance rangebase = b;
-	//If the thing is entierely in itr1, undo the add.
-	if(have1 && b >= itr1->first && e <= itr1->second) {
-		cnt -= symbols_in_interval(b, e);
-		set.erase(itr);
-		return;
-	}
-	//Attach the thing to itr1 if appropriate.
-	if(have1 && b <= itr1->second) {
-		cnt -= symbols_in_interval(b, itr1->second);
-		rangebase = itr1->first;
-		set.insert(std::make_pair(itr1->first, e));
-		auto tmp = set.lower_bound(std::make_pair(itr1->first, e));
-		set.erase(itr1);
-		set.erase(itr);
-		itr = tmp;
-		have1 = false;
-	}
-	while(itr2 != set.end()) {
-		if(e < itr2->first)
-			break;	//Nothing to merge anymore.
-		if(e >= itr2->second && (rangebase != itr2->first || e != itr2->second)) {
-			//This entiere range is subsumed.
-			cnt -= symbols_in_interval(itr2->first, itr2->second);
-			auto tmp = itr2;
-			itr2++;
-			set.erase(tmp);
-		} else if(e < itr2->second) {
-			//Combines with range.
-			cnt -= symbols_in_interval(itr2->first, e);
-			if(rangebase != itr2->first) {
-				set.insert(std::make_pair(rangebase, itr2->second));
-				set.erase(itr2);
-			}
-			set.erase(itr);
-			break;
-		}
+		return index;
 	}
+	instance nb = std::min(b, lo->first);
+	instance ne = std::max(e, (hi - 1)->second);
+	if(hi - lo == 1 && nb == lo->first && ne == lo->second)
+		return std::numeric_limits<size_t>::max();	//Already in set.
+	for(auto i = lo; i != hi; i++)
+		cnt -= symbols_in_interval(i->first, i->second);
+	cnt += symbols_in_interval(nb, ne);
+	lo->first = nb;
+	lo->second = ne;
+	set.erase(lo + 1, hi);
+	return index;
 }
 
 bool rrdata_set::_in_set(const instance& b, const instance& e)
 {
 	if(b == e)
 		return true;
-	if(data.empty())
+	//The only candidate is the last interval starting at or before b.
+	auto itr = std::upper_bound(data.begin(), data.end(), b,
+		[](const instance& y, const std::pair<instance, instance>& x) -> bool { return y < x.first; });
+	if(itr == data.begin())
 		return false;
-	auto itr = data.lower_bound(std::make_pair(b, e));
-	if(itr == data.end()) {
-		//If there is anything, it must be the last node.
-		auto r = *data.rbegin();
-		return (r.first <= b && r.second >= e);
-	} else {
-		//It may be this node or the previous one.
-		if(itr->first <= b && itr->second >= e)
-			return true;
-		itr--;
-		return (itr->first <= b && itr->second >= e);
-	}
+	itr--;
+	return (itr->first <= b && itr->second >= e);
 }
 
 std::string rrdata_set::debug_dump()
@@ -463,7 +446,7 @@ std::string rrdata_set::debug_dump()
 	return x.str();
 }
 
-uint64_t rrdata_set::debug_nodecount(std::set<std::pair<instance, instance>>& set)
+uint64_t rrdata_set::debug_nodecount(interval_list& set)
 {
 	uint64_t x = 0;
 	for(auto i : set)
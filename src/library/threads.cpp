@@ -1,8 +1,109 @@
 #include "threads.hpp"
 #include <cstdint>
+#include <exception>
 
 namespace threads
 {
+namespace
+{
+	//Threads running parallel_for() items, shared by all callers. Started when first needed, and kept running.
+	struct pool
+	{
+		pool() : fn(NULL), next(0), count(0), done(0), run_id(0), helpers(0), max_helpers(0) {}
+		void run(size_t _count, unsigned nthreads, const std::function<void(size_t i)>& _fn)
+		{
+			alock h(mutex);
+			if(fn) {
+				//Another caller is using the threads, run on this thread.
+				h.unlock();
+				for(size_t i = 0; i < _count; i++)
+					_fn(i);
+				return;
+			}
+			try {
+				while(workers.size() + 1 < nthreads)
+					workers.push_back(new thread([this]() { this->worker_loop(); }));
+			} catch(...) {
+				//Just use fewer threads.
+			}
+			fn = &_fn;
+			count = _count;
+			next = 0;
+			done = 0;
+			run_id++;
+			helpers = 0;
+			max_helpers = nthreads - 1;
+			work_cond.notify_all();
+			run_items(h);
+			while(done < count)
+				done_cond.wait(h);
+			fn = NULL;
+			std::exception_ptr e = error;
+			error = std::exception_ptr();
+			h.unlock();
+			if(e)
+				std::rethrow_exception(e);
+		}
+	private:
+		void worker_loop()
+		{
+			alock h(mutex);
+			uint64_t seen = 0;
+			while(true) {
+				while(!fn || seen == run_id)
+					work_cond.wait(h);
+				seen = run_id;
+				//Workers beyond what the caller asked for sit this run out.
+				if(helpers >= max_helpers)
+					continue;
+				helpers++;
+				run_items(h);
+			}
+		}
+		//Run items until none are left. Called with lock held.
+		void run_items(alock& h)
+		{
+			while(next < count) {
+				size_t i = next++;
+				h.unlock();
+				std::exception_ptr e;
+				try {
+					(*fn)(i);
+				} catch(...) {
+					e = std::current_exception();
+				}
+				h.lock();
+				if(e && !error) {
+					//Don't start any more items.
+					error = e;
+					count = next;
+				}
+				if(++done == count)
+					done_cond.notify_all();
+			}
+		}
+		const std::function<void(size_t i)>* fn;
+		size_t next;
+		size_t count;
+		size_t done;
+		uint64_t run_id;
+		unsigned helpers;
+		unsigned max_helpers;
+		std::exception_ptr error;
+		std::vector<thread*> workers;
+		lock mutex;
+		cv work_cond;
+		cv done_cond;
+	};
+
+	pool& get_pool()
+	{
+		//Never freed, the workers run until exit.
+		static pool* p = new pool;
+		return *p;
+	}
+}
+
 void lock_multiple(std::initializer_list<lock*> locks)
 {
 	uintptr_t next = 0;
@@ -58,4 +159,18 @@ template<typename T> void _unlock_multiple(T locks)
 void unlock_multiple(std::initializer_list<lock*> locks) { _unlock_multiple(locks); }
 void unlock_multiple(std::vector<lock*> locks) { _unlock_multiple(locks); }
 
+void parallel_for(size_t count, const std::function<void(size_t i)>& fn, unsigned nthreads)
+{
+	if(!nthreads)
+		nthreads = thread::hardware_concurrency();
+	if(nthreads > count)
+		nthreads = count;
+	if(nthreads < 2) {
+		for(size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+	get_pool().run(count, nthreads, fn);
+}
+
 }
@@ -1,6 +1,8 @@
 #include "zip.hpp"
 #include "directory.hpp"
+#include "minmax.hpp"
 #include "serialization.hpp"
+#include "threads.hpp"
 
 #include <cstdint>
 #include <cstring>
@@ -117,73 +119,43 @@ namespace
 		std::vector<char>& stream;
 	};
 
-	class size_and_crc_filter_impl
-	{
-	public:
-		typedef char char_type;
-
-		size_and_crc_filter_impl()
-		{
-			dsize = 0;
-			crc = ::crc32(0, NULL, 0);
-		}
-
-		void close()
-		{
-		}
-
-		bool filter(const char*& src_begin, const char* src_end, char*& dest_begin, char* dest_end,
-			bool flush)
-		{
-			ptrdiff_t amount = src_end - src_begin;
-			if(flush && amount == 0)
-				return false;
-			if(amount > dest_end - dest_begin)
-				amount = dest_end - dest_begin;
-			dsize += amount;
-			crc = ::crc32(crc, reinterpret_cast<const unsigned char*>(src_begin), amount);
-			memcpy(dest_begin, src_begin, amount);
-			src_begin += amount;
-			dest_begin += amount;
-			return true;
-		}
-
-		uint32_t size()
-		{
-			return dsize;
-		}
+	//Members are compressed and written once this much uncompressed data is waiting.
+	const size_t max_pending_bytes = 64 << 20;
 
-		uint32_t crc32()
-		{
-			return crc;
-		}
-	private:
-		uint32_t dsize;
-		uint32_t crc;
-	};
-
-	class size_and_crc_filter : public boost::iostreams::symmetric_filter<size_and_crc_filter_impl,
-		std::allocator<char>>
+	//Deflate a piece of member. The piece continues from dict (the preceding data) and unless last, ends in sync
+	//flush, so raw deflate streams of consequtive pieces can be concatenated.
+	void deflate_piece(std::vector<char>& out, const char* data, size_t size, const char* dict, size_t dictsize,
+		int level, bool last)
 	{
-		typedef symmetric_filter<size_and_crc_filter_impl, std::allocator<char>> base_type;
-	public:
-		typedef typename base_type::char_type char_type;
-		typedef typename base_type::category category;
-		size_and_crc_filter(int bsize)
-			: base_type(bsize)
-		{
+		z_stream z;
+		memset(&z, 0, sizeof(z));
+		if(deflateInit2(&z, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw std::runtime_error("Can't initialize deflate");
+		if(dictsize && deflateSetDictionary(&z, reinterpret_cast<const Bytef*>(dict), dictsize) != Z_OK) {
+			deflateEnd(&z);
+			throw std::runtime_error("Can't set deflate dictionary");
 		}
-
-		uint32_t size()
-		{
-			return filter().size();
-		}
-
-		uint32_t crc32()
-		{
-			return filter().crc32();
+		out.resize(deflateBound(&z, size) + 16);
+		z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+		z.avail_in = size;
+		size_t used = 0;
+		while(true) {
+			if(used == out.size())
+				out.resize(2 * out.size());
+			z.next_out = reinterpret_cast<Bytef*>(&out[used]);
+			z.avail_out = out.size() - used;
+			int r = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+			used = out.size() - z.avail_out;
+			if(r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) {
+				deflateEnd(&z);
+				throw std::runtime_error("Deflate failed");
+			}
+			if(last ? (r == Z_STREAM_END) : (z.avail_in == 0 && z.avail_out != 0))
+				break;
 		}
-	};
+		deflateEnd(&z);
+		out.resize(used);
+	}
 
 	struct zipfile_member_info
 	{
@@ -394,7 +366,7 @@ void reader::read_raw_file(const std::string& member, std::vector<char>& out) th
 
 writer::writer(const std::string& zipfile, unsigned _compression) throw(std::bad_alloc, std::runtime_error)
 {
-	compression = _compression;
+	compression = min(_compression, 9U);
 	zipfile_path = zipfile;
 	temp_path = zipfile + ".tmp";
 	zipstream = new std::ofstream(temp_path.c_str(), std::ios::binary);
@@ -402,18 +374,26 @@ writer::writer(const std::string& zipfile, unsigned _compression) throw(std::bad
 		throw std::runtime_error("Can't open zipfile '" + temp_path + "' for writing");
 	committed = false;
 	system_stream = true;
+	block_parallel = true;
+	max_threads = 0;
+	pending_bytes = 0;
 }
 
 writer::writer(std::ostream& stream, unsigned _compression) throw(std::bad_alloc, std::runtime_error)
 {
-	compression = _compression;
+	compression = min(_compression, 9U);
 	zipstream = &stream;
 	committed = false;
 	system_stream = false;
+	block_parallel = true;
+	max_threads = 0;
+	pending_bytes = 0;
 }
 
 writer::~writer() throw()
 {
+	for(auto i : pending)
+		delete i;
 	if(!committed && system_stream)
 		remove(temp_path.c_str());
 	if(system_stream)
@@ -426,6 +406,7 @@ void writer::commit() throw(std::bad_alloc, std::logic_error, std::runtime_error
 		throw std::logic_error("Can't commit twice");
 	if(open_file != "")
 		throw std::logic_error("Can't commit with file open");
+	write_pending();
 	std::vector<unsigned char> directory_entry;
 	uint32_t cdirsize = 0;
 	uint32_t cdiroff = zipstream->tellp();
@@ -485,15 +466,9 @@ std::ostream& writer::create_file(const std::string& name) throw(std::bad_alloc,
 		throw std::logic_error("Can't open file with file open");
 	if(name == "")
 		throw std::runtime_error("Bad member name");
-	current_compressed_file.resize(0);
+	current_file.resize(0);
 	s = new boost::iostreams::filtering_ostream();
-	s->push(size_and_crc_filter(4096));
-	if(compression) {
-		boost::iostreams::zlib_params params;
-		params.noheader = true;
-		s->push(boost::iostreams::zlib_compressor(params));
-	}
-	s->push(vector_output(current_compressed_file));
+	s->push(vector_output(current_file));
 	open_file = name;
 	return *s;
 }
@@ -502,13 +477,86 @@ void writer::close_file() throw(std::bad_alloc, std::logic_error, std::runtime_e
 {
 	if(open_file == "")
 		throw std::logic_error("Can't close file with no file open");
-	uint32_t ucs, cs, crc32;
 	boost::iostreams::close(*s);
-	size_and_crc_filter& f = *s->component<size_and_crc_filter>(0);
-	cs = current_compressed_file.size();
-	ucs = f.size();
-	crc32 = f.crc32();
 	delete s;
+	pending_file* f = new pending_file;
+	f->name = open_file;
+	std::swap(f->data, current_file);
+	open_file = "";
+	size_t nblocks = 1;
+	if(compression && block_parallel && f->data.size() > parallel_blocksize)
+		nblocks = (f->data.size() + parallel_blocksize - 1) / parallel_blocksize;
+	f->blocks.resize(nblocks);
+	f->crcs.resize(nblocks);
+	if(!compression)
+		f->crcs[0] = ::crc32(::crc32(0, NULL, 0), reinterpret_cast<const Bytef*>(f->data.data()),
+			f->data.size());
+	try {
+		pending.push_back(f);
+	} catch(...) {
+		delete f;
+		throw;
+	}
+	pending_bytes += f->data.size();
+	if(pending_bytes >= max_pending_bytes)
+		write_pending();
+}
+
+void writer::compress_block(pending_file& f, size_t block)
+{
+	size_t size = f.data.size();
+	size_t start = 0;
+	size_t end = size;
+	if(f.blocks.size() > 1) {
+		start = block * parallel_blocksize;
+		end = min(start + parallel_blocksize, size);
+	}
+	const char* data = f.data.data();
+	size_t dictsize = min(start, (size_t)32768);
+	deflate_piece(f.blocks[block], data + start, end - start, data + start - dictsize, dictsize, compression,
+		block == f.blocks.size() - 1);
+	f.crcs[block] = ::crc32(::crc32(0, NULL, 0), reinterpret_cast<const Bytef*>(data + start), end - start);
+}
+
+void writer::write_pending()
+{
+	//Compress blocks of all waiting members at once, then write the members in order.
+	std::vector<std::pair<pending_file*, size_t>> jobs;
+	if(compression)
+		for(auto i : pending)
+			for(size_t j = 0; j < i->blocks.size(); j++)
+				jobs.push_back(std::make_pair(i, j));
+	try {
+		threads::parallel_for(jobs.size(), [this, &jobs](size_t i) {
+			compress_block(*jobs[i].first, jobs[i].second);
+		}, max_threads);
+	} catch(std::bad_alloc& e) {
+		throw;
+	} catch(std::exception& e) {
+		throw std::runtime_error(std::string("Can't compress ZIP file member: ") + e.what());
+	}
+	while(!pending.empty()) {
+		write_member(*pending.front());
+		pending_bytes -= pending.front()->data.size();
+		delete pending.front();
+		pending.pop_front();
+	}
+}
+
+void writer::write_member(pending_file& f)
+{
+	uint32_t ucs = f.data.size();
+	uint32_t cs = 0;
+	uint32_t crc32 = f.crcs[0];
+	if(compression) {
+		for(size_t i = 0; i < f.blocks.size(); i++) {
+			cs += f.blocks[i].size();
+			if(i > 0)
+				crc32 = ::crc32_combine(crc32, f.crcs[i], min(f.data.size() - i * parallel_blocksize,
+					parallel_blocksize));
+		}
+	} else
+		cs = ucs;
 
 	base_offset = zipstream->tellp();
 	if(base_offset == (uint32_t)-1)
@@ -524,20 +572,22 @@ void writer::close_file() throw(std::bad_alloc, std::logic_error, std::runtime_e
 	serialization::u32l(header + 14, crc32);
 	serialization::u32l(header + 18, cs);
 	serialization::u32l(header + 22, ucs);
-	serialization::u16l(header + 26, open_file.length());
+	serialization::u16l(header + 26, f.name.length());
 	zipstream->write(reinterpret_cast<char*>(header), 30);
-	zipstream->write(open_file.c_str(), open_file.length());
-	zipstream->write(&current_compressed_file[0], current_compressed_file.size());
+	zipstream->write(f.name.c_str(), f.name.length());
+	if(compression) {
+		for(auto& i : f.blocks)
+			zipstream->write(&i[0], i.size());
+	} else
+		zipstream->write(f.data.data(), f.data.size());
 	if(!*zipstream)
 		throw std::runtime_error("Can't write member to ZIP file");
-	current_compressed_file.resize(0);
 	file_info info;
 	info.crc = crc32;
 	info.uncompressed_size = ucs;
 	info.compressed_size = cs;
 	info.offset = base_offset;
-	files[open_file] = info;
-	open_file = "";
+	files[f.name] = info;
 }
 
 void writer::write_linefile(const std::string& member, const std::string& value, bool conditional)
@@ -228,6 +228,7 @@ namespace
 		else if(m == emulator_runmode::PAUSE) L.pushstring("pause");
 		else if(m == emulator_runmode::PAUSE_BREAK) L.pushstring("pause_break");
 		else if(m == emulator_runmode::CORRUPT) L.pushstring("corrupt");
+		else if(m == emulator_runmode::TURBO_SEEK) L.pushstring("turbo_seek");
 		else L.pushstring("unknown");
 		return 1;
 	}
@@ -78,6 +78,7 @@ namespace
 			dw = _dw;
 			dh = _dh;
 			outside = _outside;
+			band_palette_ok = false;
 		}
 
 		render_object_bitmap(int32_t _x, int32_t _y, lua::objpin<lua_dbitmap>& _bitmap, int32_t _x0,
@@ -91,6 +92,7 @@ namespace
 			dw = _dw;
 			dh = _dh;
 			outside = _outside;
+			band_palette_ok = false;
 		}
 
 		~render_object_bitmap() throw()
@@ -104,6 +106,27 @@ namespace
 				kill_request_ifeq(b2.object(), obj);
 		}
 
+		bool get_band_rows(int64_t& first, int64_t& last) throw()
+		{
+			first = (int64_t)y - y0;
+			last = first + (b ? b->height : b2->height);
+			return true;
+		}
+
+		void set_band_mode(bool enable) throw()
+		{
+			//Copy the palette, so the bands don't all wait for the palette lock.
+			band_palette_ok = false;
+			if(!enable || !b)
+				return;
+			try {
+				threads::alock h(p->palette_mutex);
+				band_palette.assign(p->colors, p->colors + p->color_count);
+				band_palette_ok = true;
+			} catch(...) {
+			}
+		}
+
 		template<bool T> void composite_op(struct framebuffer::fb<T>& scr) throw()
 		{
 			uint32_t oX = x + scr.get_origin_x() - x0;
@@ -124,7 +147,11 @@ namespace
 			range sX = range::make_s(-x + x0, scr.get_last_blit_width());
 			range sY = range::make_s(-y + y0, scr.get_last_blit_height());
 
-			if(b)
+			if(b && band_palette_ok)
+				lua_bitmap_composite(scr, oX, oY, bX, bY, sX, sY, outside,
+					lua_bitmap_holder<T>(*b, band_palette.empty() ? NULL : &band_palette[0],
+					band_palette.size()));
+			else if(b)
 				lua_bitmap_composite(scr, oX, oY, bX, bY, sX, sY, outside,
 					lua_bitmap_holder<T>(*b, *p));
 			else
@@ -145,6 +172,8 @@ namespace
 		uint32_t dw;
 		uint32_t dh;
 		bool outside;
+		std::vector<framebuffer::color> band_palette;
+		bool band_palette_ok;
 	};
 
 	struct operand_dbitmap
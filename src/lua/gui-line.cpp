@@ -2,16 +2,22 @@
 #include "lua/internal.hpp"
 #include "library/framebuffer.hpp"
 #include "library/lua-framebuffer.hpp"
+#include "library/minmax.hpp"
 
 namespace
 {
-	struct render_object_line : public framebuffer::object
+	//Drawn in batches.
+	struct render_object_line
 	{
 		render_object_line(int32_t _x1, int32_t _x2, int32_t _y1, int32_t _y2, framebuffer::color _color)
 			throw()
 			: x1(_x1), y1(_y1), x2(_x2), y2(_y2), color(_color) {}
-		~render_object_line() throw() {}
-		template<bool X> void op(struct framebuffer::fb<X>& scr) throw()
+		void rows(int64_t& first, int64_t& last) const throw()
+		{
+			first = min(y1, y2);
+			last = (int64_t)max(y1, y2) + 1;
+		}
+		template<bool X> void draw(struct framebuffer::fb<X>& scr) throw()
 		{
 			size_t swidth = scr.get_width();
 			size_t sheight = scr.get_height();
@@ -79,9 +85,6 @@ nodraw2:
 				}
 			}
 		}
-		void operator()(struct framebuffer::fb<true>& scr) throw()  { op(scr); }
-		void operator()(struct framebuffer::fb<false>& scr) throw() { op(scr); }
-		void clone(framebuffer::queue& q) const throw(std::bad_alloc) { q.clone_helper(this); }
 	private:
 		int32_t x1;
 		int32_t y1;
@@ -100,7 +103,7 @@ nodraw2:
 
 		P(x1, y1, x2, y2, P.optional(pcolor, 0xFFFFFFU));
 
-		core.lua2->render_ctx->queue->create_add<render_object_line>(x1, x2, y1, y2, pcolor);
+		core.lua2->render_ctx->queue->create_add_batched<render_object_line>(x1, x2, y1, y2, pcolor);
 		return 0;
 	}
 
@@ -5,12 +5,17 @@
 
 namespace
 {
-	struct render_object_pixel : public framebuffer::object
+	//Drawn in batches.
+	struct render_object_pixel
 	{
 		render_object_pixel(int32_t _x, int32_t _y, framebuffer::color _color) throw()
 			: x(_x), y(_y), color(_color) {}
-		~render_object_pixel() throw() {}
-		template<bool X> void op(struct framebuffer::fb<X>& scr) throw()
+		void rows(int64_t& first, int64_t& last) const throw()
+		{
+			first = y;
+			last = (int64_t)y + 1;
+		}
+		template<bool X> void draw(struct framebuffer::fb<X>& scr) throw()
 		{
 			int32_t _x = x + scr.get_origin_x();
 			int32_t _y = y + scr.get_origin_y();
@@ -20,9 +25,6 @@ namespace
 				return;
 			color.apply(scr.rowptr(_y)[_x]);
 		}
-		void operator()(struct framebuffer::fb<true>& scr) throw()  { op(scr); }
-		void operator()(struct framebuffer::fb<false>& scr) throw() { op(scr); }
-		void clone(framebuffer::queue& q) const throw(std::bad_alloc) { q.clone_helper(this); }
 	private:
 		int32_t x;
 		int32_t y;
@@ -39,7 +41,7 @@ namespace
 
 		P(x, y, P.optional(pcolor, 0xFFFFFFU));
 
-		core.lua2->render_ctx->queue->create_add<render_object_pixel>(x, y, pcolor);
+		core.lua2->render_ctx->queue->create_add_batched<render_object_pixel>(x, y, pcolor);
 		return 0;
 	}
 
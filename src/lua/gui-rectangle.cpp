@@ -13,6 +13,12 @@ namespace
 			: x(_x), y(_y), width(_width), height(_height), outline(_outline), fill(_fill),
 			thickness(_thickness) {}
 		~render_object_rectangle() throw() {}
+		bool get_band_rows(int64_t& first, int64_t& last) throw()
+		{
+			first = y;
+			last = first + (uint32_t)height;
+			return true;
+		}
 		template<bool X> void op(struct framebuffer::fb<X>& scr) throw()
 		{
 			uint32_t oX = x + scr.get_origin_x();
@@ -7,14 +7,23 @@
 
 namespace
 {
-	struct render_object_text : public framebuffer::object
+	//Drawn in batches.
+	struct render_object_text
 	{
 		render_object_text(int32_t _x, int32_t _y, const std::string& _text, framebuffer::color _fg,
 			framebuffer::color _bg, framebuffer::color _hl, bool _hdbl = false, bool _vdbl = false)
 			throw()
-			: x(_x), y(_y), text(_text), fg(_fg), bg(_bg), hl(_hl), hdbl(_hdbl), vdbl(_vdbl) {}
-		~render_object_text() throw() {}
-		template<bool X> void op(struct framebuffer::fb<X>& scr) throw()
+			: x(_x), y(_y), text(_text), fg(_fg), bg(_bg), hl(_hl), hdbl(_hdbl), vdbl(_vdbl)
+		{
+			height = main_font.get_metrics(text, x, hdbl, vdbl).second;
+		}
+		void rows(int64_t& first, int64_t& last) const throw()
+		{
+			//One row of halo on both sides.
+			first = (int64_t)y - 1;
+			last = (int64_t)y + height + 1;
+		}
+		template<bool X> void draw(struct framebuffer::fb<X>& scr) throw()
 		{
 			auto size = main_font.get_metrics(text, x, hdbl, vdbl);
 			auto orig_size = size;
@@ -45,9 +54,6 @@ namespace
 			halo_blit(scr, mem, size.first, size.second, orig_size.first, orig_size.second, rx, ry, bg,
 				fg, hl);
 		}
-		void operator()(struct framebuffer::fb<true>& scr) throw()  { op(scr); }
-		void operator()(struct framebuffer::fb<false>& scr) throw() { op(scr); }
-		void clone(framebuffer::queue& q) const throw(std::bad_alloc) { q.clone_helper(this); }
 	private:
 		int32_t x;
 		int32_t y;
@@ -57,6 +63,7 @@ namespace
 		framebuffer::color hl;
 		bool hdbl;
 		bool vdbl;
+		size_t height;
 	};
 
 	template<bool hdbl, bool vdbl>
@@ -71,7 +78,7 @@ namespace
 
 		P(x, y, text, P.optional(fg, 0xFFFFFFU), P.optional(bg, -1), P.optional(hl, -1));
 
-		core.lua2->render_ctx->queue->create_add<render_object_text>(x, y, text, fg, bg, hl, hdbl, vdbl);
+		core.lua2->render_ctx->queue->create_add_batched<render_object_text>(x, y, text, fg, bg, hl, hdbl, vdbl);
 		return 0;
 	}
 
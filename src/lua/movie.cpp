@@ -116,6 +116,8 @@ namespace
 		//Cut off the hash.
 		if(u2->console_state.savestate.size() >= 32)
 			u2->console_state.savestate.resize(u2->console_state.savestate.size() - 32);
+		if(core.rom->paged_savestates())
+			u2->console_state.page_out();
 		//Now the remaining field ptr is somewhat nastier.
 		uint64_t f = 0;
 		uint64_t s = mfile.input->size();
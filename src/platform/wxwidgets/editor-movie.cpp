@@ -49,6 +49,7 @@ enum
 	wxID_DELETE_SUBFRAME,
 	wxID_POSITION_LOCK,
 	wxID_RUN_TO_FRAME,
+	wxID_TURBO_TO_FRAME,
 	wxID_APPEND_FRAMES,
 	wxID_TRUNCATE,
 	wxID_SCROLL_FRAME,
@@ -796,7 +797,7 @@ private:
 		void do_insert_frame_after(uint64_t row, bool multi);
 		void do_delete_frame(uint64_t row1, uint64_t row2, bool wholeframe);
 		void do_truncate(uint64_t row);
-		void do_set_stop_at_frame();
+		void do_set_stop_at_frame(bool turbo);
 		void do_scroll_to_frame();
 		void do_scroll_to_current_frame();
 		void do_copy(uint64_t row1, uint64_t row2, unsigned port, unsigned controller);
@@ -1376,7 +1377,7 @@ void wxeditor_movie::_moviepanel::do_truncate(uint64_t row)
 	signal_repaint();
 }
 
-void wxeditor_movie::_moviepanel::do_set_stop_at_frame()
+void wxeditor_movie::_moviepanel::do_set_stop_at_frame(bool turbo)
 {
 	CHECK_UI_THREAD;
 	uint64_t curframe;
@@ -1398,8 +1399,8 @@ void wxeditor_movie::_moviepanel::do_set_stop_at_frame()
 		wxMessageBox(wxT("The movie is already past that point"), _T("Error"), wxICON_EXCLAMATION | wxOK, m);
 		return;
 	}
-	inst.iqueue->run([frame]() {
-		set_stop_at_frame(frame);
+	inst.iqueue->run([frame, turbo]() {
+		set_stop_at_frame(frame, turbo);
 	});
 }
 
@@ -1612,7 +1613,10 @@ void wxeditor_movie::_moviepanel::on_popup_menu(wxCommandEvent& e)
 		do_truncate(press_line);
 		return;
 	case wxID_RUN_TO_FRAME:
-		do_set_stop_at_frame();
+		do_set_stop_at_frame(false);
+		return;
+	case wxID_TURBO_TO_FRAME:
+		do_set_stop_at_frame(true);
 		return;
 	case wxID_SCROLL_FRAME:
 		do_scroll_to_frame();
@@ -1982,6 +1986,7 @@ void wxeditor_movie::_moviepanel::on_mouse2(unsigned x, unsigned y, bool polarit
 	menu.Append(wxID_SCROLL_FRAME, wxT("Scroll to frame..."));
 	menu.Append(wxID_SCROLL_CURRENT_FRAME, wxT("Scroll to current frame"));
 	menu.Append(wxID_RUN_TO_FRAME, wxT("Run to frame..."));
+	menu.Append(wxID_TURBO_TO_FRAME, wxT("Turbo seek to frame..."));
 	menu.Append(wxID_CHANGE_LINECOUNT, wxT("Change number of lines visible"));
 	menu.AppendCheckItem(wxID_POSITION_LOCK, wxT("Lock scroll to playback"))->Check(position_locked);
 	menu.AppendSeparator();
@@ -764,9 +764,8 @@ void wxwindow_memorysearch::panel::prepare_paint()
 			}
 		}
 		if(addr_count <= CANDIDATE_LIMIT) {
-			std::list<uint64_t> addrs2 = ms->get_candidates();
 			unsigned long j = 0;
-			for(auto i : addrs2) {
+			for(auto i : *ms) {
 				std::string row = _parent->format_address(i) + " ";
 				row += (_parent->*displays[_parent->typecode])(i, _parent->hexmode, false);
 				row += " (Was: ";
@@ -834,8 +833,7 @@ void wxwindow_memorysearch::dump_candidates_text()
 		std::ofstream out(filename);
 		auto ms = msearch;
 		inst.iqueue->run([ms, this, &out]() {
-			std::list<uint64_t> addrs2 = ms->get_candidates();
-			for(auto i : addrs2) {
+			for(auto i : *ms) {
 				std::string row = format_address(i) + " ";
 				row += (this->*displays[this->typecode])(i, this->hexmode, false);
 				row += " (Was: ";
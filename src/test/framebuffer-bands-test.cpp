@@ -0,0 +1,214 @@
+#include "framebuffer.hpp"
+#include "range.hpp"
+#include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+
+uint64_t get_utime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+//Lowest screen height band-safe objects have been drawn on, to check the bands were used.
+std::atomic<size_t> min_height_seen;
+
+void saw_height(size_t h)
+{
+	size_t old = min_height_seen;
+	while(h < old && !min_height_seen.compare_exchange_weak(old, h));
+}
+
+//Band-safe rectangle, same arithmetic as gui.rectangle.
+struct rect_obj : public framebuffer::object
+{
+	rect_obj(int32_t _x, int32_t _y, uint32_t _w, uint32_t _h, framebuffer::color _c) throw()
+		: x(_x), y(_y), w(_w), h(_h), c(_c) {}
+	bool get_band_rows(int64_t& first, int64_t& last) throw()
+	{
+		first = y;
+		last = first + h;
+		return true;
+	}
+	template<bool X> void op(struct framebuffer::fb<X>& scr) throw()
+	{
+		saw_height(scr.get_height());
+		uint32_t oX = x + scr.get_origin_x();
+		uint32_t oY = y + scr.get_origin_y();
+		range bX = (range::make_w(scr.get_width()) - oX) & range::make_w(w);
+		range bY = (range::make_w(scr.get_height()) - oY) & range::make_w(h);
+		for(uint32_t r = bY.low(); r != bY.high(); r++) {
+			typename framebuffer::fb<X>::element_t* rptr = scr.rowptr(oY + r);
+			size_t eptr = oX + bX.low();
+			for(uint32_t j = bX.low(); j != bX.high(); j++, eptr++)
+				c.apply(rptr[eptr]);
+		}
+	}
+	void operator()(struct framebuffer::fb<true>& scr) throw() { op(scr); }
+	void operator()(struct framebuffer::fb<false>& scr) throw() { op(scr); }
+	void clone(framebuffer::queue& q) const throw(std::bad_alloc) { q.clone_helper(this); }
+private:
+	int32_t x, y;
+	uint32_t w, h;
+	framebuffer::color c;
+};
+
+//Batched pixel, same arithmetic as gui.pixel.
+struct pixel_obj
+{
+	pixel_obj(int32_t _x, int32_t _y, framebuffer::color _c) throw() : x(_x), y(_y), c(_c) {}
+	void rows(int64_t& first, int64_t& last) const throw()
+	{
+		first = y;
+		last = (int64_t)y + 1;
+	}
+	template<bool X> void draw(struct framebuffer::fb<X>& scr) throw()
+	{
+		int32_t _x = x + scr.get_origin_x();
+		int32_t _y = y + scr.get_origin_y();
+		if(_x < 0 || static_cast<uint32_t>(_x) >= scr.get_width())
+			return;
+		if(_y < 0 || static_cast<uint32_t>(_y) >= scr.get_height())
+			return;
+		c.apply(scr.rowptr(_y)[_x]);
+	}
+private:
+	int32_t x, y;
+	framebuffer::color c;
+};
+
+//Not band-safe: blends a diagonal across the whole screen, so it ends runs of band-safe objects.
+struct barrier_obj : public framebuffer::object
+{
+	barrier_obj(framebuffer::color _c) throw() : c(_c) {}
+	template<bool X> void op(struct framebuffer::fb<X>& scr) throw()
+	{
+		for(size_t i = 0; i < scr.get_width() && i < scr.get_height(); i++)
+			c.apply(scr.rowptr(i)[i]);
+	}
+	void operator()(struct framebuffer::fb<true>& scr) throw() { op(scr); }
+	void operator()(struct framebuffer::fb<false>& scr) throw() { op(scr); }
+	void clone(framebuffer::queue& q) const throw(std::bad_alloc) { q.clone_helper(this); }
+private:
+	framebuffer::color c;
+};
+
+framebuffer::color random_color()
+{
+	//Translucent, so drawing order matters.
+	return framebuffer::color((int64_t)(rand() & 0xFFFFFF) | ((int64_t)(32 + rand() % 192) << 24));
+}
+
+//Objects partly above, below, left and right of the screen, with barriers between some runs.
+void fill_queue(framebuffer::queue& q, unsigned seed, int32_t ox, int32_t oy, int32_t w, int32_t h)
+{
+	srand(seed);
+	for(unsigned i = 0; i < 400; i++) {
+		int32_t x = rand() % (w + 40) - 20 - ox;
+		int32_t y = rand() % (h + 40) - 20 - oy;
+		switch(rand() % 8) {
+		case 0:
+			q.create_add<barrier_obj>(random_color());
+			break;
+		case 1:
+		case 2:
+			q.create_add<rect_obj>(x, y, rand() % 100, rand() % 100, random_color());
+			break;
+		default:
+			for(unsigned j = 0; j < 20; j++)
+				q.create_add_batched<pixel_obj>(x + j, y + j / 2, random_color());
+		}
+	}
+}
+
+template<bool X> void render(framebuffer::fb<X>& scr, bool upside_down, size_t ox, size_t oy, unsigned bands,
+	unsigned seed)
+{
+	const size_t w = 320, h = 240;
+	scr.reallocate(w, h, upside_down);
+	scr.set_origin(ox, oy);
+	for(size_t y = 0; y < h; y++)
+		for(size_t x = 0; x < w; x++)
+			scr.rowptr(y)[x] = (typename framebuffer::fb<X>::element_t)(x * 0x10203 + y * 0x30201);
+	framebuffer::queue q;
+	fill_queue(q, seed, ox, oy, w, h);
+	framebuffer::queue::set_forced_bands(bands);
+	q.run(scr);
+	framebuffer::queue::set_forced_bands(0);
+}
+
+template<bool X> bool same(framebuffer::fb<X>& a, framebuffer::fb<X>& b)
+{
+	for(size_t y = 0; y < a.get_height(); y++)
+		if(memcmp(a.rowptr(y), b.rowptr(y), a.get_width() * sizeof(typename framebuffer::fb<X>::element_t)))
+			return false;
+	return true;
+}
+
+template<bool X> int test(const char* name)
+{
+	//Origins above and below the band starts, including zero where every band but the first starts below it.
+	size_t origins[][2] = {{0, 0}, {3, 5}, {10, 57}, {20, 150}, {0, 239}};
+	unsigned band_counts[] = {2, 3, 4, 7, 16};
+	int failures = 0;
+	for(unsigned ud = 0; ud < 2; ud++) {
+		for(auto& o : origins) {
+			unsigned seed = o[0] * 1000 + o[1];
+			framebuffer::fb<X> ref;
+			render(ref, ud, o[0], o[1], 1, seed);
+			for(auto bands : band_counts) {
+				framebuffer::fb<X> scr;
+				min_height_seen = ~(size_t)0;
+				render(scr, ud, o[0], o[1], bands, seed);
+				bool used_bands = (min_height_seen < scr.get_height());
+				bool ok = used_bands && same(ref, scr);
+				std::cout << name << (ud ? " upside-down" : "") << " origin " << o[0] << "," << o[1]
+					<< " " << bands << " bands..." << (ok ? "\e[32mPASS\e[0m" :
+					(used_bands ? "\e[31mFAILED\e[0m" : "\e[31mNOT BANDED\e[0m")) << std::endl;
+				if(!ok)
+					failures++;
+			}
+		}
+	}
+	return failures;
+}
+
+int bench()
+{
+	//Many short runs: band-safe objects alternating with barriers.
+	framebuffer::fb<false> scr;
+	scr.reallocate(512, 448);
+	framebuffer::queue q;
+	for(unsigned i = 0; i < 2000; i++) {
+		q.create_add<rect_obj>(i % 400, i % 300, 16, 8, random_color());
+		q.create_add<barrier_obj>(random_color());
+	}
+	uint64_t t = get_utime();
+	for(unsigned i = 0; i < 20; i++)
+		q.run(scr);
+	t = get_utime() - t;
+	std::cout << "Short runs: " << (t / 20.0) << "us/frame" << std::endl;
+	//Few long runs of full-screen objects.
+	framebuffer::queue q2;
+	for(unsigned i = 0; i < 50; i++)
+		q2.create_add<rect_obj>(0, 0, 512, 448, random_color());
+	t = get_utime();
+	for(unsigned i = 0; i < 20; i++)
+		q2.run(scr);
+	t = get_utime() - t;
+	std::cout << "Long run: " << (t / 20.0) << "us/frame" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1 && !strcmp(argv[1], "bench"))
+		return bench();
+	int failures = test<false>("32-bit") + test<true>("64-bit");
+	if(failures)
+		std::cerr << failures << " failures" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+#include "portctrl-data.hpp"
+#include "portctrl-parse.hpp"
+#include "binarystream.hpp"
+#include "json.hpp"
+#include "string.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+portctrl::type_set* types;
+
+//Load system port and a multitap.
+void make_types(const JSON::node& root)
+{
+	std::string system, multitap;
+	for(size_t i = 0; i < root["ports"].index_count(); i++) {
+		std::string sym = root["ports"].index(i)["symbol"].as_string8();
+		std::string ptr = (stringfmt() << "ports/" << i).str();
+		if(sym == "psystem") system = ptr;
+		if(sym == "multitap") multitap = ptr;
+	}
+	std::vector<portctrl::type*> t;
+	t.push_back(new portctrl::type_generic(root, system));
+	t.push_back(new portctrl::type_generic(root, multitap));
+	portctrl::index_map m;
+	types = &portctrl::type_set::make(t, m);
+}
+
+//Fill vector with frames spanning several pages and a partial page.
+void fill(portctrl::frame_vector& fv, size_t frames)
+{
+	srand(42);
+	portctrl::frame f = fv.blank_frame(true);
+	for(size_t i = 0; i < frames; i++) {
+		for(unsigned c = 0; c < 4; c++)
+			for(unsigned b = 0; b < 12; b++)
+				f.axis3(1, c, b, (rand() % 4) == 0);
+		f.sync(i % 5 != 0);
+		fv.append(f);
+	}
+}
+
+size_t test_frames(portctrl::frame_vector& fv)
+{
+	return 3 * fv.get_frames_per_page() + 17;
+}
+
+std::string as_text(portctrl::frame_vector& fv)
+{
+	std::string s;
+	fv.serialize_text(0, fv.size(), s);
+	return s;
+}
+
+std::shared_ptr<unsigned char> as_binary(portctrl::frame_vector& fv, size_t& size)
+{
+	binarystream::output out;
+	fv.save_binary(out);
+	std::string s = out.get();
+	size = s.length();
+	std::shared_ptr<unsigned char> data(new unsigned char[size ? size : 1],
+		std::default_delete<unsigned char[]>());
+	memcpy(data.get(), s.c_str(), size);
+	return data;
+}
+
+struct test
+{
+	const char* name;
+	std::function<bool()> run;
+};
+
+struct test tests[] = {
+	{"adopt round-trip", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		size_t size;
+		auto data = as_binary(fv, size);
+		portctrl::frame_vector fv2(*types);
+		fv2.adopt_binary(data, size);
+		return fv2.size() == fv.size() && fv2.count_frames() == fv.count_frames() &&
+			as_text(fv2) == as_text(fv);
+	}},{"adopt does not copy full pages", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		size_t size;
+		auto data = as_binary(fv, size);
+		portctrl::frame_vector fv2(*types);
+		fv2.adopt_binary(data, size);
+		const portctrl::frame_vector& cfv2 = fv2;
+		return cfv2.get_page_buffer(0) == data.get() &&
+			cfv2.get_page_buffer(1) == data.get() + fv2.get_stride() * fv2.get_frames_per_page();
+	}},{"write to adopted vector copies page", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		size_t size;
+		auto data = as_binary(fv, size);
+		std::string before(reinterpret_cast<char*>(data.get()), size);
+		portctrl::frame_vector fv2(*types);
+		fv2.adopt_binary(data, size);
+		fv2[3].axis3(1, 0, 0, !fv2[3].axis3(1, 0, 0));
+		fv2[3].sync(!fv2[3].sync());
+		std::string after(reinterpret_cast<char*>(data.get()), size);
+		return before == after && as_text(fv2) != as_text(fv) && fv2[3].sync() != fv[3].sync();
+	}},{"adopt empty", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		std::shared_ptr<unsigned char> data(new unsigned char[1], std::default_delete<unsigned char[]>());
+		fv.adopt_binary(data, 0);
+		return fv.size() == 0 && fv.count_frames() == 0;
+	}},{"copy shares pages", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		portctrl::frame_vector fv2(fv);
+		const portctrl::frame_vector& cfv = fv;
+		const portctrl::frame_vector& cfv2 = fv2;
+		return cfv.get_page_buffer(1) == cfv2.get_page_buffer(1) && fv2.count_frames() == fv.count_frames();
+	}},{"write to copy", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		std::string before = as_text(fv);
+		portctrl::frame_vector fv2(*types);
+		fv2 = fv;
+		size_t x = fv.get_frames_per_page() + 5;
+		fv2[x].axis3(1, 1, 2, !fv2[x].axis3(1, 1, 2));
+		const portctrl::frame_vector& cfv = fv;
+		const portctrl::frame_vector& cfv2 = fv2;
+		return as_text(fv) == before && as_text(fv2) != before &&
+			cfv.get_page_buffer(0) == cfv2.get_page_buffer(0) &&
+			cfv.get_page_buffer(1) != cfv2.get_page_buffer(1);
+	}},{"write to original", []() {
+		portctrl::frame_vector fv(*types);
+		fill(fv, test_frames(fv));
+		portctrl::frame_vector fv2(fv);
+		std::string before = as_text(fv2);
+		fv[0].axis3(1, 0, 0, !fv[0].axis3(1, 0, 0));
+		fv.resize(fv.size() - 3);
+		return as_text(fv2) == before && fv2.size() == fv.size() + 3;
+	}},{NULL, []() { return false; }}
+};
+
+int main(int argc, char** argv)
+{
+	std::string filename = (argc > 1) ? argv[1] : "src/emulation/bsnes-legacy/ports.json";
+	std::ifstream in(filename);
+	if(!in) {
+		std::cerr << "Can't open " << filename << std::endl;
+		return 1;
+	}
+	std::string doc((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	make_types(JSON::node(doc));
+	struct test* t = tests;
+	while(t->name) {
+		std::cout << t->name << "..." << std::flush;
+		try {
+			if(t->run())
+				std::cout << "\e[32mPASS\e[0m" << std::endl;
+			else {
+				std::cout << "\e[31mFAILED\e[0m" << std::endl;
+				return 1;
+			}
+		} catch(std::exception& e) {
+			std::cout << "\e[31mEXCEPTION: " << e.what() << "\e[0m" << std::endl;
+			return 1;
+		} catch(...) {
+			std::cout << "\e[31mUNKNOWN EXCEPTION\e[0m" << std::endl;
+			return 1;
+		}
+		t++;
+	}
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "hooktable.hpp"
+#include <iostream>
+#include <list>
+#include <map>
+#include <cstdlib>
+#include <sys/time.h>
+
+struct hook
+{
+	hook() : calls(0) {}
+	void callback(uint64_t addr, uint64_t value) { calls += value; }
+	uint64_t calls;
+};
+
+uint64_t get_utime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+const uint64_t all_addresses = 0xFFFFFFFFFFFFFFFFULL;
+const unsigned iterations = 50000000;
+
+//The old map-and-copy dispatch, for reference.
+struct map_dispatch
+{
+	typedef std::list<hook*> cb_list;
+	std::map<uint64_t, cb_list> cb;
+	cb_list dummy_cb;
+	void add(uint64_t addr, hook* h) { cb[addr].push_back(h); }
+	void operator()(uint64_t addr, uint64_t value)
+	{
+		cb_list* cb1 = cb.count(all_addresses) ? &cb[all_addresses] : &dummy_cb;
+		cb_list* cb2 = cb.count(addr) ? &cb[addr] : &dummy_cb;
+		auto _cb1 = *cb1;
+		auto _cb2 = *cb2;
+		for(auto& i : _cb1) i->callback(addr, value);
+		for(auto& i : _cb2) i->callback(addr, value);
+	}
+};
+
+struct table_dispatch
+{
+	hooktable::table<hook> cb;
+	table_dispatch() : cb(all_addresses) {}
+	void add(uint64_t addr, hook* h) { cb.add(addr, h); }
+	void operator()(uint64_t addr, uint64_t value)
+	{
+		if(!cb.maybe(addr)) return;
+		hooktable::table<hook>::guard g(cb);
+		auto cb1 = cb.wildcard();
+		auto cb2 = cb.lookup(addr);
+		if(cb1) for(auto i : *cb1) i->callback(addr, value);
+		if(cb2) for(auto i : *cb2) i->callback(addr, value);
+	}
+};
+
+template<typename T> void bench(const char* name, T& d, unsigned nhooks, hook& h)
+{
+	//Hook nhooks addresses in WRAM bank, then access both hooked and unhooked addresses.
+	for(unsigned i = 0; i < nhooks; i++)
+		d.add(0x7E0000 + i * 16, &h);
+	uint64_t t1 = get_utime();
+	for(unsigned i = 0; i < iterations; i++)
+		d(0x7E0000 + (i % nhooks) * 16, 1);
+	uint64_t hooked = get_utime() - t1;
+	t1 = get_utime();
+	for(unsigned i = 0; i < iterations; i++)
+		d(0x800000 + (i & 0x7FFF), 1);
+	uint64_t unhooked = get_utime() - t1;
+	std::cout << name << " (" << nhooks << " hooks): hooked " << (1000.0 * hooked / iterations)
+		<< "ns/access, unhooked " << (1000.0 * unhooked / iterations) << "ns/access" << std::endl;
+}
+
+int main()
+{
+	hook h;
+	unsigned counts[] = {1, 16, 256};
+	for(unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		map_dispatch m;
+		table_dispatch t;
+		bench("map+copy", m, counts[i], h);
+		bench("hooktable", t, counts[i], h);
+	}
+	if(h.calls != 6ULL * iterations)
+		std::cerr << "Error: Unexpected number of calls " << h.calls << std::endl;
+	return 0;
+}
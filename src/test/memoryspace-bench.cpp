@@ -0,0 +1,98 @@
+#include "memoryspace.hpp"
+#include "serialization.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/time.h>
+
+uint64_t get_utime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+const unsigned iterations = 50000000;
+
+//The old locked binary search translation, for reference.
+struct locked_space
+{
+	threads::lock mlock;
+	std::vector<memory_space::region*> regions;
+	locked_space(const std::list<memory_space::region*>& r)
+	{
+		regions.insert(regions.end(), r.begin(), r.end());
+		std::sort(regions.begin(), regions.end(),
+			[](memory_space::region* a, memory_space::region* b) -> bool { return a->base < b->base; });
+	}
+	std::pair<memory_space::region*, uint64_t> lookup(uint64_t address)
+	{
+		threads::alock m(mlock);
+		size_t lb = 0;
+		size_t ub = regions.size();
+		while(lb < ub) {
+			size_t mb = (lb + ub) / 2;
+			if(regions[mb]->base > address) {
+				ub = mb;
+				continue;
+			}
+			if(regions[mb]->last_address() < address) {
+				lb = mb + 1;
+				continue;
+			}
+			return std::make_pair(regions[mb], address - regions[mb]->base);
+		}
+		return std::make_pair(reinterpret_cast<memory_space::region*>(NULL), 0);
+	}
+	template<typename T> T read(uint64_t addr)
+	{
+		auto g = lookup(addr);
+		if(!g.first || g.second + sizeof(T) > g.first->size)
+			return 0;
+		return serialization::read_endian<T>(g.first->direct_map + g.second, g.first->endian);
+	}
+};
+
+template<typename T> void bench(const char* name, T& s, const uint64_t* addrs, unsigned naddrs)
+{
+	uint64_t sum = 0;
+	uint64_t t1 = get_utime();
+	for(unsigned i = 0; i < iterations; i++)
+		sum += s.template read<uint16_t>(addrs[i % naddrs]);
+	uint64_t t = get_utime() - t1;
+	std::cout << name << ": " << (1000.0 * t / iterations) << "ns/read (checksum " << sum << ")" << std::endl;
+}
+
+int main()
+{
+	//Roughly SNES-like layout.
+	static unsigned char wram[131072], sram[8192], vram[65536], oam[544], cgram[512], apuram[65536];
+	std::list<memory_space::region*> regions;
+	regions.push_back(new memory_space::region_direct("WRAM", 0x007E0000, -1, wram, sizeof(wram)));
+	regions.push_back(new memory_space::region_direct("SRAM", 0x10000000, -1, sram, sizeof(sram)));
+	regions.push_back(new memory_space::region_direct("VRAM", 0x00010000, -1, vram, sizeof(vram)));
+	regions.push_back(new memory_space::region_direct("OAM", 0x00020000, -1, oam, sizeof(oam)));
+	regions.push_back(new memory_space::region_direct("CGRAM", 0x00021000, -1, cgram, sizeof(cgram)));
+	regions.push_back(new memory_space::region_direct("APURAM", 0x00022000, -1, apuram, sizeof(apuram)));
+	for(unsigned i = 0; i < sizeof(wram); i++)
+		wram[i] = i;
+
+	memory_space m;
+	m.set_regions(regions);
+	locked_space l(regions);
+
+	//Same page over and over (typical watch of a few variables), then scattered over regions.
+	uint64_t local[16];
+	for(unsigned i = 0; i < 16; i++)
+		local[i] = 0x7E0000 + 0x100 + 2 * i;
+	uint64_t scattered[1024];
+	uint64_t bases[] = {0x7E0000, 0x10000000, 0x10000, 0x20000, 0x21000, 0x22000};
+	for(unsigned i = 0; i < 1024; i++)
+		scattered[i] = bases[rand() % 6] + (rand() % 256) * 2;
+
+	bench("locked, local", l, local, 16);
+	bench("memory_space, local", m, local, 16);
+	bench("locked, scattered", l, scattered, 1024);
+	bench("memory_space, scattered", m, scattered, 1024);
+	return 0;
+}
@@ -0,0 +1,183 @@
+#include "portctrl-data.hpp"
+#include "portctrl-parse.hpp"
+#include "json.hpp"
+#include "string.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <sys/time.h>
+
+uint64_t get_utime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+const size_t frames = 500000;
+
+struct port_variant
+{
+	const char* name;
+	portctrl::type_set* set;
+	std::vector<portctrl::type*> types;
+};
+
+//Load system port and two multitaps, either JITted or interpreted.
+void make_types(port_variant& v, const JSON::node& root, bool dynamic)
+{
+	if(dynamic)
+		unsetenv("PTG_NO_DYNAMIC");
+	else
+		setenv("PTG_NO_DYNAMIC", "1", 1);
+	std::string system, multitap;
+	for(size_t i = 0; i < root["ports"].index_count(); i++) {
+		std::string sym = root["ports"].index(i)["symbol"].as_string8();
+		std::string ptr = (stringfmt() << "ports/" << i).str();
+		if(sym == "psystem") system = ptr;
+		if(sym == "multitap") multitap = ptr;
+	}
+	v.types.push_back(new portctrl::type_generic(root, system));
+	v.types.push_back(new portctrl::type_generic(root, multitap));
+	v.types.push_back(new portctrl::type_generic(root, multitap));
+	portctrl::index_map m;
+	v.set = &portctrl::type_set::make(v.types, m);
+}
+
+void fill_random(portctrl::frame_vector& fv)
+{
+	srand(42);
+	portctrl::frame f = fv.blank_frame(true);
+	for(size_t i = 0; i < frames; i++) {
+		for(unsigned p = 1; p < 3; p++)
+			for(unsigned c = 0; c < 4; c++)
+				for(unsigned b = 0; b < 12; b++)
+					f.axis3(p, c, b, (rand() % 4) == 0);
+		f.sync(i % 5 != 0);
+		fv.append(f);
+	}
+}
+
+std::string serialize_per_frame(portctrl::frame_vector& fv)
+{
+	std::ostringstream s;
+	char buffer[MAX_SERIALIZED_SIZE];
+	for(size_t i = 0; i < fv.size(); i++) {
+		fv[i].serialize(buffer);
+		s << buffer << std::endl;
+	}
+	return s.str();
+}
+
+void deserialize_per_frame(portctrl::frame_vector& fv, const std::string& text)
+{
+	std::istringstream s(text);
+	portctrl::frame tmp = fv.blank_frame(false);
+	std::string x;
+	while(std::getline(s, x)) {
+		if(x != "") {
+			tmp.deserialize(x.c_str());
+			fv.append(tmp);
+		}
+	}
+}
+
+int64_t read_all(portctrl::frame_vector& fv)
+{
+	int64_t sum = 0;
+	const portctrl::frame_vector& cfv = fv;
+	for(size_t i = 0; i < cfv.size(); i++) {
+		portctrl::frame f = cfv[i];
+		for(unsigned p = 1; p < 3; p++)
+			for(unsigned c = 0; c < 4; c++)
+				for(unsigned b = 0; b < 12; b++)
+					sum += f.axis3(p, c, b);
+	}
+	return sum;
+}
+
+void write_all(portctrl::frame_vector& fv)
+{
+	for(size_t i = 0; i < fv.size(); i++) {
+		portctrl::frame f = fv[i];
+		for(unsigned p = 1; p < 3; p++)
+			for(unsigned c = 0; c < 4; c++)
+				for(unsigned b = 0; b < 12; b++)
+					f.axis3(p, c, b, (b + i) & 1);
+	}
+}
+
+void report(const char* variant, const char* what, uint64_t t)
+{
+	std::cout << variant << ": " << what << " " << (1000.0 * t / frames) << "ns/frame" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	std::string filename = (argc > 1) ? argv[1] : "src/emulation/bsnes-legacy/ports.json";
+	std::ifstream in(filename);
+	if(!in) {
+		std::cerr << "Can't open " << filename << std::endl;
+		return 1;
+	}
+	std::string doc((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	JSON::node root(doc);
+
+	port_variant variants[2] = {{"interpreted"}, {"dynamic"}};
+	make_types(variants[0], root, false);
+	make_types(variants[1], root, true);
+
+	std::string reference;
+	int failures = 0;
+	for(auto& v : variants) {
+		portctrl::frame_vector fv(*v.set);
+		fill_random(fv);
+
+		uint64_t t = get_utime();
+		std::string text = serialize_per_frame(fv);
+		report(v.name, "serialize (per frame)", get_utime() - t);
+
+		t = get_utime();
+		std::string text2;
+		fv.serialize_text(0, fv.size(), text2);
+		report(v.name, "serialize (bulk)", get_utime() - t);
+
+		if(reference == "")
+			reference = text;
+		if(text != reference || text2 != reference) {
+			std::cerr << v.name << ": Serialized text differs" << std::endl;
+			failures++;
+		}
+
+		portctrl::frame_vector fv2(*v.set);
+		t = get_utime();
+		deserialize_per_frame(fv2, text);
+		report(v.name, "deserialize (per frame)", get_utime() - t);
+
+		portctrl::frame_vector fv3(*v.set);
+		t = get_utime();
+		fv3.deserialize_text(text.c_str(), text.length());
+		report(v.name, "deserialize (bulk)", get_utime() - t);
+
+		std::string check2, check3;
+		fv2.serialize_text(0, fv2.size(), check2);
+		fv3.serialize_text(0, fv3.size(), check3);
+		if(check2 != reference || check3 != reference || fv3.count_frames() != fv.count_frames()) {
+			std::cerr << v.name << ": Deserialization does not round-trip" << std::endl;
+			failures++;
+		}
+
+		t = get_utime();
+		int64_t sum = read_all(fv);
+		report(v.name, "read 96 controls", get_utime() - t);
+		t = get_utime();
+		write_all(fv);
+		report(v.name, "write 96 controls", get_utime() - t);
+		std::cout << v.name << ": checksum " << sum << std::endl;
+	}
+	if(failures)
+		std::cerr << failures << " failures" << std::endl;
+	return failures ? 1 : 0;
+}
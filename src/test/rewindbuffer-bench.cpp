@@ -0,0 +1,65 @@
+#include "rewindbuffer.hpp"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <sys/time.h>
+
+uint64_t get_utime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+const unsigned frames = 3600;		//One minute at 60fps.
+const size_t state_size = 400000;	//Roughly a SNES savestate.
+
+//Simulate one frame of emulation: a handful of small clustered writes into "WRAM" plus one bulk DMA-like write.
+void simulate_frame(std::vector<char>& state, unsigned writes, unsigned frame)
+{
+	for(unsigned i = 0; i < writes; i++) {
+		size_t base = rand() % 131072;
+		for(unsigned j = 0; j < 4; j++)
+			state[base + j] = rand();
+	}
+	size_t dma = 131072 + (frame % 64) * 1024;
+	for(unsigned j = 0; j < 512; j++)
+		state[dma + j] = rand();
+	//Frame counter like fields in header.
+	memcpy(&state[state_size - 8], &frame, sizeof(frame));
+}
+
+void bench(unsigned writes)
+{
+	srand(writes);
+	rewindbuffer::ring<unsigned> r(1ULL << 40);
+	std::vector<char> state(state_size);
+	for(size_t i = 0; i < state_size; i++)
+		state[i] = rand();
+	uint64_t t = 0;
+	for(unsigned i = 0; i < frames; i++) {
+		simulate_frame(state, writes, i);
+		uint64_t t1 = get_utime();
+		r.push(state, i);
+		t += get_utime() - t1;
+	}
+	size_t usage = r.memory_usage();
+	uint64_t t2 = get_utime();
+	std::vector<char> tmp;
+	unsigned aux, expect = frames;
+	while(r.pop(&tmp, &aux))
+		if(aux != --expect)
+			std::cerr << "Error: Unexpected frame " << aux << " (expected " << expect << ")" << std::endl;
+	t2 = get_utime() - t2;
+	std::cout << writes << " writes/frame: " << (usage / 1048576.0) << "MB/minute (raw "
+		<< (1.0 * frames * state_size / 1048576) << "MB), push " << (1.0 * t / frames) << "us/frame, pop "
+		<< (1.0 * t2 / frames) << "us/frame" << std::endl;
+}
+
+int main()
+{
+	unsigned counts[] = {16, 256, 4096};
+	for(unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+		bench(counts[i]);
+	return 0;
+}
@@ -4,6 +4,16 @@
 #include <iostream>
 #include "library/directory.hpp"
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+
+uint64_t get_utime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
 
 uint64_t get_file_size(const std::string& filename)
 {
@@ -33,10 +43,10 @@ struct test tests[] = {
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000763234676";
 	}},{"instance string ctor #2", []() {
 		rrdata_set::instance i("0000000000000000000000000000000000000000000000000000000763afba76");
-		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000763AFBA76";
+		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000763afba76";
 	}},{"instance string ctor #3", []() {
-		rrdata_set::instance i("0000000000000000000000000000000000000000000000000000000763AFBA76");
-		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000763AFBA76";
+		rrdata_set::instance i("0000000000000000000000000000000000000000000000000000000763afba76");
+		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000763afba76";
 	}},{"< #1", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000000");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000000");
@@ -46,11 +56,11 @@ struct test tests[] = {
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000001");
 		return i1 < i2;
 	}},{"< #3", []() {
-		rrdata_set::instance i1("00000000000000000000000000000000000000000000000000000000000000FF");
+		rrdata_set::instance i1("00000000000000000000000000000000000000000000000000000000000000ff");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000100");
 		return i1 < i2;
 	}},{"< #4", []() {
-		rrdata_set::instance i1("00000000000000000000000000000000000000000000000000000000000000FF");
+		rrdata_set::instance i1("00000000000000000000000000000000000000000000000000000000000000ff");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000100");
 		return !(i2 < i1);
 	}},{"== #1", []() {
@@ -74,29 +84,29 @@ struct test tests[] = {
 		i++;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000002";
 	}},{"post-++ #3", []() {
-		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000000F");
+		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000000f");
 		i++;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000010";
 	}},{"post-++ #4", []() {
-		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000FF");
+		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000ff");
 		i++;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000100";
 	}},{"post-++ #5", []() {
-		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000FFFF");
+		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000ffff");
 		i++;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000010000";
 	}},{"post-++ #6", []() {
-		rrdata_set::instance i("000000000000000000000000000000000000000000000000FFFFFFFFFFFFFFFF");
+		rrdata_set::instance i("000000000000000000000000000000000000000000000000ffffffffffffffff");
 		i++;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000010000000000000000";
 	}},{"post-++ #7", []() {
-		rrdata_set::instance i("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+		rrdata_set::instance i("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
 		i++;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000000";
 	}},{"post-++ #8", []() {
-		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000FE");
+		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000fe");
 		i++;
-		return (stringfmt() << i).str() == "00000000000000000000000000000000000000000000000000000000000000FF";
+		return (stringfmt() << i).str() == "00000000000000000000000000000000000000000000000000000000000000ff";
 	}},{"pre-++ #1", []() {
 		rrdata_set::instance i("0000000000000000000000000000000000000000000000000000000000000000");
 		++i;
@@ -106,29 +116,29 @@ struct test tests[] = {
 		++i;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000002";
 	}},{"pre-++ #3", []() {
-		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000000F");
+		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000000f");
 		++i;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000010";
 	}},{"pre-++ #4", []() {
-		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000FF");
+		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000ff");
 		++i;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000100";
 	}},{"pre-++ #5", []() {
-		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000FFFF");
+		rrdata_set::instance i("000000000000000000000000000000000000000000000000000000000000ffff");
 		++i;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000010000";
 	}},{"pre-++ #6", []() {
-		rrdata_set::instance i("000000000000000000000000000000000000000000000000FFFFFFFFFFFFFFFF");
+		rrdata_set::instance i("000000000000000000000000000000000000000000000000ffffffffffffffff");
 		++i;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000010000000000000000";
 	}},{"pre-++ #7", []() {
-		rrdata_set::instance i("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+		rrdata_set::instance i("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
 		++i;
 		return (stringfmt() << i).str() == "0000000000000000000000000000000000000000000000000000000000000000";
 	}},{"pre-++ #8", []() {
-		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000FE");
+		rrdata_set::instance i("00000000000000000000000000000000000000000000000000000000000000fe");
 		++i;
-		return (stringfmt() << i).str() == "00000000000000000000000000000000000000000000000000000000000000FF";
+		return (stringfmt() << i).str() == "00000000000000000000000000000000000000000000000000000000000000ff";
 	}},{"Operator+ #1", []() {
 		rrdata_set::instance i("0000000000000000000000000000000000000000000000000000000000000000");
 		i = i + 0x12;
@@ -174,7 +184,7 @@ struct test tests[] = {
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000123");
 		return (i1 - i2) == 0x113;
 	}},{"Operator- #6", []() {
-		rrdata_set::instance i1("00000000000000000000000000000000000000000000000000000000FFFFFFFE");
+		rrdata_set::instance i1("00000000000000000000000000000000000000000000000000000000fffffffe");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000000");
 		return (i1 - i2) == 0xFFFFFFFEU;
 	}},{"Operator- #7", []() {
@@ -187,7 +197,7 @@ struct test tests[] = {
 		return (i1 - i2) == 0xFFFFFFFFU;
 	}},{"Operator- #9", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000000");
-		rrdata_set::instance i2("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+		rrdata_set::instance i2("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
 		return (i1 - i2) == 1;
 	}},{"rrdata init", []() {
 		rrdata_set s;
@@ -259,54 +269,54 @@ struct test tests[] = {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000009");
 		rrdata_set::instance i3("0000000000000000000000000000000000000000000000000000000000000007");
-		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000F");
+		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000f");
 		rrdata_set s;
 		s.debug_add(i1, i2);
 		s.debug_add(i3, i4);
 		return s.debug_dump() == "10[{0000000000000000000000000000000000000000000000000000000000000005,"
-			"000000000000000000000000000000000000000000000000000000000000000F}]";
+			"000000000000000000000000000000000000000000000000000000000000000f}]";
 	}},{"rrdata bridging add", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
-		rrdata_set::instance i2("000000000000000000000000000000000000000000000000000000000000000A");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000B");
-		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000F");
-		rrdata_set::instance i5("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i2("000000000000000000000000000000000000000000000000000000000000000a");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000b");
+		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000f");
+		rrdata_set::instance i5("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set s;
 		s.debug_add(i1, i2);
 		s.debug_add(i3, i4);
 		s.debug_add(i5);
 		return s.debug_dump() == "10[{0000000000000000000000000000000000000000000000000000000000000005,"
-			"000000000000000000000000000000000000000000000000000000000000000F}]";
+			"000000000000000000000000000000000000000000000000000000000000000f}]";
 	}},{"rrdata bridging add #2", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
-		rrdata_set::instance i2("000000000000000000000000000000000000000000000000000000000000000A");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000B");
-		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000F");
+		rrdata_set::instance i2("000000000000000000000000000000000000000000000000000000000000000a");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000b");
+		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000f");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000008");
-		rrdata_set::instance i6("000000000000000000000000000000000000000000000000000000000000000D");
+		rrdata_set::instance i6("000000000000000000000000000000000000000000000000000000000000000d");
 		rrdata_set s;
 		s.debug_add(i1, i2);
 		s.debug_add(i3, i4);
 		s.debug_add(i5, i6);
 		return s.debug_dump() == "10[{0000000000000000000000000000000000000000000000000000000000000005,"
-			"000000000000000000000000000000000000000000000000000000000000000F}]";
+			"000000000000000000000000000000000000000000000000000000000000000f}]";
 	}},{"rrdata discontinuous reverse", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000009");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
-		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000F");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
+		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000f");
 		rrdata_set s;
 		s.debug_add(i3, i4);
 		s.debug_add(i1, i2);
 		return s.debug_dump() == "9[{0000000000000000000000000000000000000000000000000000000000000005,"
 			"0000000000000000000000000000000000000000000000000000000000000009}{"
-			"000000000000000000000000000000000000000000000000000000000000000A,"
-			"000000000000000000000000000000000000000000000000000000000000000F}]";
+			"000000000000000000000000000000000000000000000000000000000000000a,"
+			"000000000000000000000000000000000000000000000000000000000000000f}]";
 	}},{"rrdata elide next #1", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000010");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
-		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000F");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
+		rrdata_set::instance i4("000000000000000000000000000000000000000000000000000000000000000f");
 		rrdata_set s;
 		s.debug_add(i3, i4);
 		s.debug_add(i1, i2);
@@ -315,7 +325,7 @@ struct test tests[] = {
 	}},{"rrdata elide next #2", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000010");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000010");
 		rrdata_set s;
 		s.debug_add(i3, i4);
@@ -325,10 +335,10 @@ struct test tests[] = {
 	}},{"rrdata elide next multiple", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000050");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000014");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000020");
-		rrdata_set::instance i6("000000000000000000000000000000000000000000000000000000000000002F");
+		rrdata_set::instance i6("000000000000000000000000000000000000000000000000000000000000002f");
 		rrdata_set s;
 		s.debug_add(i3, i4);
 		s.debug_add(i5, i6);
@@ -338,10 +348,10 @@ struct test tests[] = {
 	}},{"rrdata elide next multiple (OOR)", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000050");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000014");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000020");
-		rrdata_set::instance i6("000000000000000000000000000000000000000000000000000000000000002F");
+		rrdata_set::instance i6("000000000000000000000000000000000000000000000000000000000000002f");
 		rrdata_set::instance i7("0000000000000000000000000000000000000000000000000000000000000060");
 		rrdata_set::instance i8("0000000000000000000000000000000000000000000000000000000000000070");
 		rrdata_set s;
@@ -356,7 +366,7 @@ struct test tests[] = {
 	}},{"rrdata elide next onehalf", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000050");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000014");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000020");
 		rrdata_set::instance i6("0000000000000000000000000000000000000000000000000000000000000055");
@@ -369,7 +379,7 @@ struct test tests[] = {
 	}},{"rrdata elide next onehalf (OOR)", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000050");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000014");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000020");
 		rrdata_set::instance i6("0000000000000000000000000000000000000000000000000000000000000055");
@@ -387,7 +397,7 @@ struct test tests[] = {
 	}},{"rrdata elide next onehalf and prev", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000050");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000014");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000020");
 		rrdata_set::instance i6("0000000000000000000000000000000000000000000000000000000000000055");
@@ -403,7 +413,7 @@ struct test tests[] = {
 	}},{"rrdata elide next onehalf and prev (exact)", []() {
 		rrdata_set::instance i1("0000000000000000000000000000000000000000000000000000000000000005");
 		rrdata_set::instance i2("0000000000000000000000000000000000000000000000000000000000000050");
-		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000A");
+		rrdata_set::instance i3("000000000000000000000000000000000000000000000000000000000000000a");
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000014");
 		rrdata_set::instance i5("0000000000000000000000000000000000000000000000000000000000000020");
 		rrdata_set::instance i6("0000000000000000000000000000000000000000000000000000000000000055");
@@ -474,7 +484,7 @@ struct test tests[] = {
 	}},{"In set (split)", []() {
 		rrdata_set s;
 		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000045");
-		rrdata_set::instance i5("000000000000000000000000000000000000000000000000000000000000004F");
+		rrdata_set::instance i5("000000000000000000000000000000000000000000000000000000000000004f");
 		rrdata_set::instance i6("0000000000000000000000000000000000000000000000000000000000000050");
 		rrdata_set::instance i7("0000000000000000000000000000000000000000000000000000000000000059");
 		rrdata_set::instance i8("0000000000000000000000000000000000000000000000000000000000000046");
@@ -482,11 +492,10 @@ struct test tests[] = {
 		s.debug_add(i4, i5);
 		s.debug_add(i6, i7);
 		return !s.debug_in_set(i8, i9);
-	}},{"Set internal, add internal", []() {
+	}},{"Add from counter", []() {
 		rrdata_set s;
-		rrdata_set::instance i4("0000000000000000000000000000000000000000000000000000000000000045");
-		s.set_internal(i4);
-		s.add_internal();
+		rrdata_set::instance n("0000000000000000000000000000000000000000000000000000000000000045");
+		s.add(n++);
 		return s.debug_dump() == "1[{0000000000000000000000000000000000000000000000000000000000000045,"
 			"0000000000000000000000000000000000000000000000000000000000000046}]";
 	}},{"Empty count", []() {
@@ -494,18 +503,21 @@ struct test tests[] = {
 		return s.count() == 0;
 	}},{"count 1 node", []() {
 		rrdata_set s;
-		s.add_internal();
+		rrdata_set::instance n;
+		s.add(n++);
 		return s.count() == 0;
 	}},{"count 2 node", []() {
 		rrdata_set s;
-		s.add_internal();
-		s.add_internal();
+		rrdata_set::instance n;
+		s.add(n++);
+		s.add(n++);
 		return s.count() == 1;
 	}},{"count 3 node", []() {
 		rrdata_set s;
-		s.add_internal();
-		s.add_internal();
-		s.add_internal();
+		rrdata_set::instance n;
+		s.add(n++);
+		s.add(n++);
+		s.add(n++);
 		return s.count() == 2;
 	}},{"Count rrdata #1", []() {
 		rrdata_set s;
@@ -543,7 +555,7 @@ struct test tests[] = {
 		s.read(data);
 		std::string ans = "542232[{0000000000000000000000000000000000000000000000000000000000000001,"
 			"0000000000000000000000000000000000000000000000000000000000084617}{"
-			"00000000000000000000000000000000000000000000000000000000000846FF,"
+			"00000000000000000000000000000000000000000000000000000000000846ff,"
 			"0000000000000000000000000000000000000000000000000000000000084701}]";
 		return s.debug_dump() == ans;
 	}},{"read/write rrdata #1", []() {
@@ -623,42 +635,40 @@ struct test tests[] = {
 			data2.size()));
 	}},{"Basic rrdata with backing file", []() {
 		rrdata_set s;
+		rrdata_set::instance n("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
 		unlink("foo.tmp");
 		s.read_base("foo.tmp", false);
-		s.set_internal(rrdata_set::instance(
-			"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCD0A"));
 		if(get_file_size("foo.tmp") != 0)
 			return false;
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 32)
 			return false;
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 64)
 			return false;
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 96)
 			return false;
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 128)
 			return false;
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 160)
 			return false;
 		return true;
 	}},{"Reopen backing file", []() {
 		rrdata_set s;
+		rrdata_set::instance n("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
 		unlink("foo.tmp");
 		s.read_base("foo.tmp", false);
-		s.set_internal(rrdata_set::instance(
-			"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCD0A"));
 		if(get_file_size("foo.tmp") != 0)
 			return false;
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 32)
 			return false;
 		s.close();
 		s.read_base("foo.tmp", false);
-		s.add_internal();
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 64)
 			return false;
 		return true;
@@ -669,54 +679,50 @@ struct test tests[] = {
 		return true;
 	}},{"Switch to self", []() {
 		rrdata_set s;
+		rrdata_set::instance n("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
 		unlink("foo.tmp");
 		s.read_base("foo.tmp", false);
-		s.set_internal(rrdata_set::instance(
-			"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCD0A"));
-		s.add_internal();
+		s.add(n++);
 		s.read_base("foo.tmp", false);
-		s.add_internal();
+		s.add(n++);
 		return s.count() == 1;
 	}},{"Switch to another", []() {
 		rrdata_set s;
+		rrdata_set::instance n("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
 		unlink("foo.tmp");
 		unlink("foo2.tmp");
 		s.read_base("foo.tmp", false);
-		s.set_internal(rrdata_set::instance(
-			"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCD0A"));
-		s.add_internal();
+		s.add(n++);
 		s.read_base("foo2.tmp", false);
-		s.add_internal();
-		s.add_internal();
+		s.add(n++);
+		s.add(n++);
 		//std::cerr << s.debug_dump() << std::endl;
 		return s.count() == 1;
 	}},{"Lazy mode", []() {
 		rrdata_set s;
+		rrdata_set::instance n("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
 		unlink("foo.tmp");
 		s.read_base("foo.tmp", true);
-		s.set_internal(rrdata_set::instance(
-			"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCD0A"));
-		s.add_internal();
-		s.add_internal();
+		s.add(n++);
+		s.add(n++);
 		s.read_base("foo.tmp", false);
-		s.add_internal();
-		s.add_internal();
+		s.add(n++);
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 128)
 			return false;
 		return s.count() == 3;
 	}},{"Lazy mode with previous file", []() {
 		rrdata_set s;
+		rrdata_set::instance n("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
 		unlink("foo.tmp");
 		unlink("foo2.tmp");
 		s.read_base("foo2.tmp", false);
 		s.read_base("foo.tmp", true);
-		s.set_internal(rrdata_set::instance(
-			"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCD0A"));
-		s.add_internal();
-		s.add_internal();
+		s.add(n++);
+		s.add(n++);
 		s.read_base("foo.tmp", false);
-		s.add_internal();
-		s.add_internal();
+		s.add(n++);
+		s.add(n++);
 		if(get_file_size("foo.tmp") != 128)
 			return false;
 		return s.count() == 3;
@@ -743,29 +749,111 @@ struct test tests[] = {
 		if(get_file_size("foo.tmp") != 320)
 			return false;
 		return true;
+	}},{"Incremental write matches full write", []() {
+		rrdata_set s;
+		rrdata_set::instance i("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcd0a");
+		rrdata_set::instance j("0123456789abcdef0123456789abcdef0123456789abcdef0123456789ab0000");
+		std::vector<char> a;
+		for(unsigned k = 0; k < 100; k++) {
+			s.add(i + 3 * k);
+			s.add(j + k);
+			s.write(a);
+			std::vector<char> b(s.size_emerg());
+			rrdata_set::esave_state st;
+			size_t w = s.write_emerg(st, &b[0], b.size());
+			if(w != b.size() || a != b)
+				return false;
+		}
+		return rrdata_set::count(a) == 199;
 	}},
 };
 
-int main()
+//Random load ID, like the ones each session starts from.
+rrdata_set::instance random_instance()
 {
-	struct test* t = tests;
-	while(t->name) {
-		std::cout << t->name << "..." << std::flush;
+	unsigned char buf[RRDATA_BYTES];
+	for(unsigned i = 0; i < RRDATA_BYTES; i++)
+		buf[i] = rand();
+	return rrdata_set::instance(buf);
+}
+
+int bench()
+{
+	//Project with 100 sessions of 20000 rerecords each.
+	rrdata_set s;
+	uint64_t t = get_utime();
+	for(unsigned i = 0; i < 100; i++) {
+		rrdata_set::instance b = random_instance();
+		for(unsigned j = 0; j < 20000; j++)
+			s.add(b++);
+	}
+	t = get_utime() - t;
+	std::cout << "Sequential add: " << (1000.0 * t / 2000000) << "ns/add" << std::endl;
+
+	//Saves during the last session: few new rerecords between saves.
+	std::vector<char> out;
+	rrdata_set::instance b = random_instance();
+	uint64_t tw = 0, te = 0;
+	for(unsigned i = 0; i < 1000; i++) {
+		s.add(b++);
+		uint64_t t1 = get_utime();
+		s.write(out);
+		uint64_t t2 = get_utime();
+		std::vector<char> full(s.size_emerg());
+		rrdata_set::esave_state st;
+		s.write_emerg(st, &full[0], full.size());
+		uint64_t t3 = get_utime();
+		tw += t2 - t1;
+		te += t3 - t2;
+		if(out != full) {
+			std::cout << "Incremental and full write differ!" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "Write (incremental): " << (tw / 1000.0) << "us/save, full encode: " << (te / 1000.0)
+		<< "us/save (" << out.size() << " bytes)" << std::endl;
+
+	//Worst case: every load ID is its own interval.
+	rrdata_set s2;
+	t = get_utime();
+	for(unsigned i = 0; i < 200000; i++)
+		s2.add(random_instance());
+	t = get_utime() - t;
+	std::cout << "Random add: " << (1000.0 * t / 200000) << "ns/add" << std::endl;
+	t = get_utime();
+	for(unsigned i = 0; i < 100; i++) {
+		s2.add(random_instance());
+		s2.write(out);
+	}
+	t = get_utime() - t;
+	std::cout << "Write after random add: " << (t / 100.0) << "us/save (" << out.size() << " bytes)"
+		<< std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1 && !strcmp(argv[1], "bench"))
+		return bench();
+	int failures = 0;
+	for(auto& t : tests) {
+		std::cout << t.name << "..." << std::flush;
 		try {
-			if(t->run())
+			if(t.run())
 				std::cout << "\e[32mPASS\e[0m" << std::endl;
 			else {
 				std::cout << "\e[31mFAILED\e[0m" << std::endl;
-				return 1;
+				failures++;
 			}
 		} catch(std::exception& e) {
 			std::cout << "\e[31mEXCEPTION: " << e.what() << "\e[0m" << std::endl;
-			return 1;
+			failures++;
 		} catch(...) {
 			std::cout << "\e[31mUNKNOWN EXCEPTION\e[0m" << std::endl;
-			return 1;
+			failures++;
 		}
-		t++;
 	}
-	return 0;
+	if(failures)
+		std::cerr << failures << " failures" << std::endl;
+	return failures ? 1 : 0;
 }
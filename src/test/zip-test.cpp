@@ -0,0 +1,103 @@
+#include "zip.hpp"
+#include "string.hpp"
+#include "serialization.hpp"
+#include <iostream>
+#include <fstream>
+#include <set>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+const char* filename = "zip-test.tmp";
+
+//Read names of members in central directory of ZIP file.
+std::set<std::string> central_directory(const std::string& file)
+{
+	std::ifstream in(file, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::set<std::string> names;
+	if(data.length() < 22)
+		return names;
+	const char* end = data.data() + data.length() - 22;
+	if(serialization::u32l(end) != 0x06054b50)
+		return names;
+	size_t entries = serialization::u16l(end + 10);
+	size_t offset = serialization::u32l(end + 16);
+	for(size_t i = 0; i < entries; i++) {
+		if(offset + 46 > data.length())
+			break;
+		const char* e = data.data() + offset;
+		if(serialization::u32l(e) != 0x02014b50)
+			break;
+		size_t nlen = serialization::u16l(e + 28);
+		size_t xlen = serialization::u16l(e + 30);
+		size_t clen = serialization::u16l(e + 32);
+		names.insert(std::string(e + 46, nlen));
+		offset += 46 + nlen + xlen + clen;
+	}
+	return names;
+}
+
+std::string member_content(unsigned i)
+{
+	std::string s;
+	for(unsigned j = 0; j < 20000 * (i + 1); j++)
+		s.push_back('a' + (j * j + i) % 26);
+	return s;
+}
+
+//Some nonempty members, then several empty ones last, like a new movie.
+bool write_and_check(unsigned compression, unsigned nthreads)
+{
+	std::set<std::string> expected;
+	{
+		zip::writer w(filename, compression);
+		w.set_threads(nthreads);
+		for(unsigned i = 0; i < 3; i++) {
+			std::string name = (stringfmt() << "member" << i).str();
+			w.create_file(name) << member_content(i);
+			w.close_file();
+			expected.insert(name);
+		}
+		for(unsigned i = 0; i < 5; i++) {
+			std::string name = (stringfmt() << "empty" << i).str();
+			w.create_file(name);
+			w.close_file();
+			expected.insert(name);
+		}
+		w.commit();
+	}
+	if(central_directory(filename) != expected) {
+		std::cout << "Members missing from central directory" << std::endl;
+		return false;
+	}
+	zip::reader r(filename);
+	for(unsigned i = 0; i < 3; i++) {
+		std::vector<char> out;
+		r.read_raw_file((stringfmt() << "member" << i).str(), out);
+		if(std::string(out.begin(), out.end()) != member_content(i)) {
+			std::cout << "Member content differs" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	unsigned compressions[] = {0, 1, 7, 9, 100};
+	unsigned threadcounts[] = {1, 2, 4};
+	int failures = 0;
+	for(auto c : compressions)
+		for(auto t : threadcounts) {
+			std::cout << "Compression " << c << ", " << t << " threads..." << std::flush;
+			bool ok = true;
+			for(unsigned i = 0; i < 200 && ok; i++)
+				ok = write_and_check(c, t);
+			std::cout << (ok ? "\e[32mPASS\e[0m" : "\e[31mFAILED\e[0m") << std::endl;
+			if(!ok)
+				failures++;
+		}
+	unlink(filename);
+	return failures ? 1 : 0;
+}
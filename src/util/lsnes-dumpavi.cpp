@@ -109,7 +109,7 @@ namespace
 				CORE().command->invoke("quit-emulator");
 			}
 		}
-		void on_sample(short l, short r)
+		void on_samples(const int16_t* samples, size_t count, bool stereo)
 		{
 			//We aren't interested in samples.
 		}
@@ -0,0 +1,124 @@
+#include "interface/disassembler.hpp"
+#include "library/binarytrace.hpp"
+#include "library/hex.hpp"
+#include "library/string.hpp"
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+	struct cpu_state
+	{
+		std::string name;
+		binarytrace::cpu_info info;
+		std::vector<disassembler*> disasms;
+	};
+
+	void set_cpu(cpu_state& c, const binarytrace::record& r)
+	{
+		c.name = r.name;
+		c.info = r.info;
+		c.disasms.clear();
+		for(auto& i : r.info.disassemblers) {
+			try {
+				c.disasms.push_back(&disassembler::byname(i));
+			} catch(std::exception& e) {
+				std::cerr << "Warning: No disassembler '" << i << "' for CPU '" << r.name << "'"
+					<< std::endl;
+				c.disasms.push_back(NULL);
+			}
+		}
+	}
+
+	std::string disassemble(cpu_state& c, const binarytrace::insn& i)
+	{
+		disassembler* d = (i.variant < c.disasms.size()) ? c.disasms[i.variant] : NULL;
+		if(!d) {
+			std::string out = "db";
+			for(unsigned j = 0; j < sizeof(i.opcode); j++)
+				out = out + " $" + hex::to8(i.opcode[j]);
+			return out;
+		}
+		unsigned idx = 0;
+		return d->disassemble(i.pc, [&i, &idx]() -> unsigned char {
+			return (idx < sizeof(i.opcode)) ? i.opcode[idx++] : 0;
+		});
+	}
+
+	std::string registers(cpu_state& c, const binarytrace::insn& i)
+	{
+		std::string out;
+		size_t off = 0;
+		for(auto& r : c.info.registers) {
+			if(off + r.second > i.reglen)
+				break;
+			uint64_t v = 0;
+			for(unsigned j = 0; j < r.second; j++)
+				v |= (uint64_t)i.regs[off + j] << (8 * j);
+			off += r.second;
+			std::string h = hex::to64(v);
+			out = out + " " + r.first + "=" + h.substr(h.length() - 2 * r.second);
+		}
+		return out;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filename;
+	std::string only_cpu;
+	bool show_regs = true;
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		regex_results r;
+		if(r = regex("--cpu=(.+)", arg))
+			only_cpu = r[1];
+		else if(arg == "--no-registers")
+			show_regs = false;
+		else if(arg.length() > 0 && arg[0] == '-') {
+			std::cerr << "Usage: " << argv[0] << " [--cpu=<name>] [--no-registers] <trace>" << std::endl;
+			return 2;
+		} else
+			filename = arg;
+	}
+	if(filename == "") {
+		std::cerr << "Usage: " << argv[0] << " [--cpu=<name>] [--no-registers] <trace>" << std::endl;
+		return 2;
+	}
+	try {
+		binarytrace::reader rd(filename);
+		binarytrace::record r;
+		std::map<unsigned, cpu_state> cpus;
+		while(rd.read(r)) {
+			switch(r.type) {
+			case binarytrace::record::CPU:
+				set_cpu(cpus[r.cpu], r);
+				break;
+			case binarytrace::record::FRAME:
+				std::cout << "--- Frame " << r.frame << " ---\n";
+				break;
+			case binarytrace::record::INSN: {
+				cpu_state& c = cpus[r.cpu];
+				if(only_cpu != "" && c.name != only_cpu)
+					break;
+				std::cout << c.name << " " << hex::to24(r.i.pc) << " " << disassemble(c, r.i);
+				if(show_regs)
+					std::cout << " ;" << registers(c, r.i) << " @" << (r.i.stamp >> 16) << ","
+						<< (r.i.stamp & 0xFFFF);
+				std::cout << "\n";
+				break;
+			}
+			case binarytrace::record::TEXT:
+				if(only_cpu != "" && cpus[r.cpu].name != only_cpu)
+					break;
+				std::cout << r.text << "\n";
+				break;
+			}
+		}
+	} catch(std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,453 @@
+#include "lsnes.hpp"
+
+#include "core/command.hpp"
+#include "core/controller.hpp"
+#include "core/debug.hpp"
+#include "core/dispatch.hpp"
+#include "core/framerate.hpp"
+#include "core/instance.hpp"
+#include "core/keymapper.hpp"
+#include "core/loadlib.hpp"
+#include "core/mainloop.hpp"
+#include "core/messages.hpp"
+#include "core/misc.hpp"
+#include "core/moviedata.hpp"
+#include "core/random.hpp"
+#include "core/rom.hpp"
+#include "core/settings.hpp"
+#include "core/window.hpp"
+#include "interface/romtype.hpp"
+#include "library/crandom.hpp"
+#include "library/directory.hpp"
+#include "library/hex.hpp"
+#include "library/string.hpp"
+#include "library/threads.hpp"
+#include "lua/lua.hpp"
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+/*
+ * lsnes-verify [<options>] [--jobs=<n>] [--list=<file>] [--verbose] <movie>...
+ *
+ * Each movie is played to its end in a separate worker process (this same program, invoked with
+ * --verify-worker=<resultfile>), with no video or audio output. The list file has one movie per line, optionally
+ * prefixed by the expected state hash and whitespace (the format of the hash column printed by this program). Other
+ * options (--firmware-path=, --setting-*=, --load-library=, ROM options) are passed to the workers.
+ */
+
+namespace
+{
+	//Result of playing one movie.
+	struct verify_result
+	{
+		std::string movie;
+		std::string expected;		//Expected state hash, or "" if not known.
+		std::string status;		//OK or ERROR from worker.
+		std::string hash;		//Hash of final state.
+		uint64_t frames;		//Frames emulated.
+		uint64_t usec;			//Time taken emulating.
+		std::string error;		//Error message if status is ERROR.
+	};
+
+	bool is_hash(const std::string& s)
+	{
+		if(s.length() != 64)
+			return false;
+		for(auto i : s)
+			if(!((i >= '0' && i <= '9') || (i >= 'a' && i <= 'f')))
+				return false;
+		return true;
+	}
+
+	void write_result(const std::string& filename, const verify_result& r)
+	{
+		std::ofstream out(filename);
+		out << r.status << std::endl << r.hash << std::endl << r.frames << std::endl << r.usec << std::endl
+			<< r.error << std::endl;
+	}
+
+	void read_result(const std::string& filename, verify_result& r)
+	{
+		std::ifstream in(filename);
+		std::string frames, usec;
+		if(!std::getline(in, r.status) || !std::getline(in, r.hash) || !std::getline(in, frames) ||
+			!std::getline(in, usec)) {
+			r.status = "ERROR";
+			r.error = "Worker did not report result";
+			return;
+		}
+		std::getline(in, r.error);
+		try {
+			r.frames = boost::lexical_cast<uint64_t>(frames);
+			r.usec = boost::lexical_cast<uint64_t>(usec);
+		} catch(std::exception& e) {
+			r.status = "ERROR";
+			r.error = "Worker reported bad result";
+		}
+	}
+
+	//Hashes the state once the movie has been played through and asks the emulator to quit.
+	class verify_hook : public debug_context::callback_base
+	{
+	public:
+		verify_hook(uint64_t _end_frame)
+		{
+			end_frame = _end_frame;
+			start_frame = 0;
+			start_time = 0;
+			end_time = 0;
+			started = false;
+			done = false;
+			lsnes_instance.dbg->add_callback(0, debug_context::DEBUG_FRAME, *this);
+		}
+		~verify_hook()
+		{
+			lsnes_instance.dbg->remove_callback(0, debug_context::DEBUG_FRAME, *this);
+		}
+		void callback(const debug_context::params& p)
+		{
+			if(done)
+				return;
+			if(!started) {
+				start_frame = p.frame.frame;
+				start_time = framerate_regulator::get_utime();
+				started = true;
+			}
+			//The frame about to be emulated is past the end, so every movie frame has been emulated.
+			if(p.frame.frame <= end_frame)
+				return;
+			end_time = framerate_regulator::get_utime();
+			auto x = CORE().rom->save_core_state();
+			hash = hex::b_to((uint8_t*)&x[x.size() - 32], 32);
+			done = true;
+			CORE().command->invoke("quit-emulator");
+		}
+		void killed(uint64_t addr, debug_context::etype type)
+		{
+		}
+		uint64_t frames() { return done ? end_frame + 1 - start_frame : 0; }
+		uint64_t usec() { return end_time - start_time; }
+		std::string hash;
+		bool done;
+	private:
+		uint64_t end_frame;
+		uint64_t start_frame;
+		uint64_t start_time;
+		uint64_t end_time;
+		bool started;
+	};
+
+	void apply_options(const std::vector<std::string>& cmdline)
+	{
+		for(auto i : cmdline) {
+			regex_results r;
+			if(r = regex("--firmware-path=(.*)", i)) {
+				try {
+					lsnes_instance.setcache->set("firmwarepath", r[1]);
+				} catch(std::exception& e) {
+					std::cerr << "Can't set firmware path to '" << r[1] << "': " << e.what() << std::endl;
+				}
+			}
+			if(r = regex("--setting-(.*)=(.*)", i)) {
+				try {
+					lsnes_instance.setcache->set(r[1], r[2]);
+				} catch(std::exception& e) {
+					std::cerr << "Can't set " << r[1] << " to '" << r[2] << "': " << e.what()
+						<< std::endl;
+				}
+			}
+			if(r = regex("--load-library=(.*)", i)) {
+				try {
+					with_loaded_library(*new loadlib::module(loadlib::library(r[1])));
+					handle_post_loadlibrary();
+				} catch(std::runtime_error& e) {
+					std::cerr << "Can't load '" << r[1] << "': " << e.what() << std::endl;
+				}
+			}
+		}
+	}
+
+	//Play one movie in this process. Returns the exit code.
+	int run_worker(const std::vector<std::string>& cmdline, const std::string& movfn,
+		const std::string& resultfile)
+	{
+		verify_result res;
+		res.movie = movfn;
+		res.status = "ERROR";
+		res.frames = 0;
+		res.usec = 0;
+
+		reached_main();
+		set_random_seed();
+		platform::init();
+		init_lua();
+		messages << "lsnes version: lsnes rr" << lsnes_version << std::endl;
+		autoload_libraries();
+		apply_options(cmdline);
+
+		init_main_callbacks();
+		struct loaded_rom r;
+		try {
+			std::map<std::string, std::string> tmp;
+			r = construct_rom(movfn, cmdline);
+			r.load(tmp, 1000000000, 0);
+		} catch(std::bad_alloc& e) {
+			OOM_panic();
+		} catch(std::exception& e) {
+			res.error = std::string("Can't load ROM: ") + e.what();
+			write_result(resultfile, res);
+			quit_lua();
+			return 1;
+		}
+		lsnes_instance.framerate->set_nominal_framerate(r.region_approx_framerate());
+
+		try {
+			moviefile* movie = new moviefile(movfn, r.get_internal_rom_type());
+			*lsnes_instance.rom = r;
+			lsnes_instance.rom->set_internal_region(movie->gametype->get_region());
+			lsnes_instance.rom->load(movie->settings, movie->movie_rtc_second, movie->movie_rtc_subsecond);
+			verify_hook hook(movie->get_frame_count());
+			//Main loop takes ownership of the movie.
+			main_loop(r, *movie, true);
+			if(hook.done) {
+				res.status = "OK";
+				res.hash = hook.hash;
+				res.frames = hook.frames();
+				res.usec = hook.usec();
+			} else
+				res.error = "Emulation stopped before end of movie";
+		} catch(std::bad_alloc& e) {
+			OOM_panic();
+		} catch(std::exception& e) {
+			res.error = e.what();
+		}
+		write_result(resultfile, res);
+		quit_lua();
+		lsnes_instance.mlogic->release_memory();
+		lsnes_instance.buttons->cleanup();
+		return (res.status == "OK") ? 0 : 1;
+	}
+
+	void read_list(const std::string& filename, std::vector<verify_result>& movies)
+	{
+		std::ifstream in(filename);
+		if(!in) {
+			std::cerr << "Can't open movie list '" << filename << "'" << std::endl;
+			exit(2);
+		}
+		std::string line;
+		while(std::getline(in, line)) {
+			istrip_CR(line);
+			if(line == "" || line[0] == '#')
+				continue;
+			verify_result r;
+			regex_results x;
+			if((x = regex("([0-9a-f]+)[ \t]+(.*)", line)) && is_hash(x[1])) {
+				r.expected = x[1];
+				r.movie = x[2];
+			} else
+				r.movie = line;
+			movies.push_back(r);
+		}
+	}
+
+	void report(verify_result& r, unsigned& failures)
+	{
+		std::string verdict;
+		if(r.status != "OK")
+			verdict = "ERROR";
+		else if(r.expected == "")
+			verdict = "PLAYED";
+		else if(r.expected == r.hash)
+			verdict = "SYNC";
+		else
+			verdict = "DESYNC";
+		if(verdict == "ERROR" || verdict == "DESYNC")
+			failures++;
+		std::ostringstream line;
+		line << (r.hash != "" ? r.hash : std::string(64, '-')) << "  " << r.movie << "\t" << verdict;
+		if(r.status == "OK") {
+			double fps = r.usec ? 1000000.0 * r.frames / r.usec : 0;
+			line << "\t" << r.frames << " frames\t" << fps << " fps";
+		} else
+			line << "\t" << r.error;
+		if(verdict == "DESYNC")
+			line << "\t(expected " << r.expected << ")";
+		std::cout << line.str() << std::endl;
+	}
+
+	std::vector<std::string> worker_args(const std::string& argv0, const std::vector<std::string>& options,
+		const std::string& resultfile, const std::string& movie)
+	{
+		std::vector<std::string> args;
+		args.push_back(argv0);
+		args.insert(args.end(), options.begin(), options.end());
+		args.push_back("--verify-worker=" + resultfile);
+		args.push_back(movie);
+		return args;
+	}
+
+	std::vector<const char*> make_argv(const std::vector<std::string>& args)
+	{
+		std::vector<const char*> argv;
+		for(auto& i : args)
+			argv.push_back(i.c_str());
+		argv.push_back(NULL);
+		return argv;
+	}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+	int spawn_worker(const std::vector<std::string>& args, bool verbose)
+	{
+		auto argv = make_argv(args);
+		pid_t pid = fork();
+		if(pid < 0)
+			throw std::runtime_error("Can't fork worker process");
+		if(pid == 0) {
+			if(!verbose) {
+				int fd = open("/dev/null", O_WRONLY);
+				if(fd >= 0) {
+					dup2(fd, 1);
+					dup2(fd, 2);
+					close(fd);
+				}
+			}
+			execvp(argv[0], const_cast<char* const*>(&argv[0]));
+			_exit(127);
+		}
+		return pid;
+	}
+
+	void run_workers(const std::string& argv0, const std::vector<std::string>& options,
+		std::vector<verify_result>& movies, unsigned jobs, bool verbose, unsigned& failures)
+	{
+		//Running workers by pid, with their movie index and result file.
+		std::map<pid_t, std::pair<size_t, std::string>> running;
+		size_t next = 0;
+		while(next < movies.size() || !running.empty()) {
+			while(next < movies.size() && running.size() < jobs) {
+				std::string resultfile = get_temp_file();
+				pid_t pid = spawn_worker(worker_args(argv0, options, resultfile, movies[next].movie),
+					verbose);
+				running[pid] = std::make_pair(next++, resultfile);
+			}
+			int status;
+			pid_t pid = waitpid(-1, &status, 0);
+			if(pid < 0)
+				throw std::runtime_error("Can't wait for worker process");
+			if(!running.count(pid))
+				continue;
+			verify_result& r = movies[running[pid].first];
+			read_result(running[pid].second, r);
+			if(WIFSIGNALED(status)) {
+				r.status = "ERROR";
+				r.error = (stringfmt() << "Worker killed by signal " << WTERMSIG(status)).str();
+			}
+			remove(running[pid].second.c_str());
+			running.erase(pid);
+			report(r, failures);
+		}
+	}
+#else
+	void run_workers(const std::string& argv0, const std::vector<std::string>& options,
+		std::vector<verify_result>& movies, unsigned jobs, bool verbose, unsigned& failures)
+	{
+		//No fork() here, so play the movies one after another.
+		for(auto& i : movies) {
+			std::string resultfile = get_temp_file();
+			auto args = worker_args(argv0, options, resultfile, i.movie);
+			auto argv = make_argv(args);
+			_spawnvp(_P_WAIT, argv[0], &argv[0]);
+			read_result(resultfile, i);
+			remove(resultfile.c_str());
+			report(i, failures);
+		}
+	}
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	try {
+		crandom::init();
+	} catch(std::exception& e) {
+		std::cerr << "Error initializing system RNG" << std::endl;
+		return 2;
+	}
+
+	std::vector<std::string> cmdline;
+	for(int i = 1; i < argc; i++)
+		cmdline.push_back(argv[i]);
+
+	//Worker mode: play exactly one movie.
+	for(auto i : cmdline) {
+		regex_results r;
+		if(r = regex("--verify-worker=(.*)", i)) {
+			std::string movfn;
+			for(auto j : cmdline)
+				if(j.length() > 0 && j[0] != '-')
+					movfn = j;
+			return run_worker(cmdline, movfn, r[1]);
+		}
+	}
+
+	unsigned jobs = threads::thread::hardware_concurrency();
+	bool verbose = false;
+	std::vector<std::string> options;
+	std::vector<verify_result> movies;
+	for(auto i : cmdline) {
+		regex_results r;
+		if(r = regex("--jobs=(.*)", i)) {
+			try {
+				jobs = boost::lexical_cast<unsigned>(r[1]);
+			} catch(std::exception& e) {
+				std::cerr << "Bad --jobs: " << r[1] << std::endl;
+				return 2;
+			}
+		} else if(r = regex("--list=(.*)", i))
+			read_list(r[1], movies);
+		else if(i == "--verbose")
+			verbose = true;
+		else if(i.length() > 0 && i[0] == '-')
+			options.push_back(i);
+		else {
+			verify_result m;
+			m.movie = i;
+			movies.push_back(m);
+		}
+	}
+	if(!jobs)
+		jobs = 1;
+	if(movies.empty()) {
+		std::cerr << "Syntax: " << argv[0] << " [<options>] [--jobs=<n>] [--list=<file>] [--verbose] "
+			"<movie>..." << std::endl;
+		return 2;
+	}
+	for(auto& i : movies) {
+		i.frames = 0;
+		i.usec = 0;
+	}
+
+	unsigned failures = 0;
+	uint64_t t = framerate_regulator::get_utime();
+	try {
+		run_workers(argv[0], options, movies, jobs, verbose, failures);
+	} catch(std::exception& e) {
+		std::cerr << "FATAL: " << e.what() << std::endl;
+		return 2;
+	}
+	t = framerate_regulator::get_utime() - t;
+	std::cout << movies.size() << " movies, " << failures << " failed, " << (t / 1000000) << "s" << std::endl;
+	return failures ? 1 : 0;
+}
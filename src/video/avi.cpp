@@ -2,6 +2,7 @@
 #include "video/avi/writer.hpp"
 
 #include "video/avi/codec.hpp"
+#include "video/avi/parallel.hpp"
 
 #include "core/advdumper.hpp"
 #include "core/dispatch.hpp"
@@ -97,6 +98,10 @@ namespace
 		"AVI‣Right padding", 0);
 	settingvar::supervariable<settingvar::model_int<0, 999999999>> max_frames_per_segment(lsnes_setgrp,
 		"avi-maxframes", "AVI‣Max frames per segment", 0);
+	settingvar::supervariable<settingvar::model_int<0, 64>> encoder_threads(lsnes_setgrp, "avi-threads",
+		"AVI‣Encoder threads (0 = number of CPUs)", 0);
+	settingvar::supervariable<settingvar::model_int<1, 65536>> encoder_buffer(lsnes_setgrp, "avi-thread-buffer",
+		"AVI‣Encoder buffer (MB)", 512);
 #ifdef WITH_SECRET_RABBIT_CODE
 	settingvar::enumeration soundrates {"nearest-common", "round-down", "round-up", "multiply",
 		"High quality 44.1kHz", "High quality 48kHz"};
@@ -160,12 +165,12 @@ namespace
 		avi_worker(const struct avi_info& info);
 		~avi_worker();
 		void entry();
-		void queue_video(uint32_t* _frame, uint32_t stride, uint32_t width, uint32_t height, uint32_t fps_n,
+		void queue_video(const uint32_t* _frame, uint32_t stride, uint32_t width, uint32_t height, uint32_t fps_n,
 			uint32_t fps_d);
 		void queue_audio(int16_t* data, size_t samples);
 	private:
 		avi_writer aviout;
-		uint32_t* frame;
+		const uint32_t* frame;
 		uint32_t frame_width;
 		uint32_t frame_stride;
 		uint32_t frame_height;
@@ -194,7 +199,7 @@ namespace
 	{
 	}
 
-	void avi_worker::queue_video(uint32_t* _frame, uint32_t stride, uint32_t width, uint32_t height,
+	void avi_worker::queue_video(const uint32_t* _frame, uint32_t stride, uint32_t width, uint32_t height,
 		uint32_t fps_n, uint32_t fps_d)
 	{
 		rethrow();
@@ -354,7 +359,13 @@ again:
 			info.max_frames = max_frames_per_segment(*core.settings);
 			info.prefix = prefix;
 			rpair(vcodec, acodec) = find_codecs(mode);
-			info.vcodec = vcodec->get_instance();
+			unsigned threads = encoder_threads(*core.settings);
+			if(!threads)
+				threads = threads::thread::hardware_concurrency();
+			//Frames between keyframes are compressed in parallel, so the buffer should fit a group per
+			//thread.
+			size_t buffer = static_cast<size_t>(encoder_buffer(*core.settings)) << 20;
+			info.vcodec = new avi_parallel_codec(*vcodec, threads, buffer);
 			info.acodec = acodec->get_instance();
 			try {
 				unsigned srate_setting = soundrate_setting(*core.settings);
@@ -412,40 +423,51 @@ again:
 				rpair(hscl, vscl) = core.rom->get_scale_factors(_frame.get_width(),
 					_frame.get_height());
 			}
-			if(!render_video_hud(dscr, _frame, fps_n, fps_d, hscl, vscl, dlb(*core.settings),
-				dtb(*core.settings), drb(*core.settings), dbb(*core.settings),
-				[this]() -> void { this->worker->wait_busy(); }))
+			//The previous frame is held until the worker is done with it, so Lua HUD and scaling of this
+			//frame overlap encoding of the previous one.
+			auto f = render_video_hud_shared<false>(_frame, fps_n, fps_d, hscl, vscl, dlb(*core.settings),
+				dtb(*core.settings), drb(*core.settings), dbb(*core.settings));
+			worker->wait_busy();
+			current_frame = f;
+			if(!f)
 				return;
-			worker->queue_video(dscr.rowptr(0), dscr.get_stride(), dscr.get_width(), dscr.get_height(),
-				fps_n, fps_d);
+			worker->queue_video(f->rowptr(0), f->get_stride(), f->get_width(), f->get_height(), fps_n,
+				fps_d);
 			have_dumped_frame = true;
 		}
-		void on_sample(short l, short r)
+		void on_samples(const int16_t* samples, size_t count, bool stereo)
 		{
+			size_t step = stereo ? 2 : 1;
 			if(resampler_w) {
 				if(!have_dumped_frame)
 					return;
-				sbuffer[sbuffer_fill++] = l;
-				sbuffer[sbuffer_fill++] = r;
-				if(sbuffer_fill == sbuffer.size()) {
-					resampler_w->sendblock(&sbuffer[0], sbuffer_fill / chans);
-					sbuffer_fill = 0;
+				for(size_t i = 0; i < count; i++) {
+					sbuffer[sbuffer_fill++] = samples[step * i];
+					sbuffer[sbuffer_fill++] = samples[step * i + step - 1];
+					if(sbuffer_fill == sbuffer.size()) {
+						resampler_w->sendblock(&sbuffer[0], sbuffer_fill / chans);
+						sbuffer_fill = 0;
+					}
 				}
-				soxdumper->sample(l, r);
+				soxdumper->samples(samples, count, stereo);
 				return;
 			}
-			short x[2];
-			x[0] = l;
-			x[1] = r;
-			dcounter += soundrate.first;
-			while(dcounter < soundrate.second * audio_record_rate + soundrate.first) {
-				if(have_dumped_frame)
-					worker->queue_audio(x, 2);
+			//Duplicate or drop samples to match the recording rate, and queue the whole block at once.
+			abuffer.clear();
+			for(size_t i = 0; i < count; i++) {
 				dcounter += soundrate.first;
+				while(dcounter < soundrate.second * audio_record_rate + soundrate.first) {
+					abuffer.push_back(samples[step * i]);
+					abuffer.push_back(samples[step * i + step - 1]);
+					dcounter += soundrate.first;
+				}
+				dcounter -= (soundrate.second * audio_record_rate + soundrate.first);
+			}
+			if(have_dumped_frame) {
+				if(!abuffer.empty())
+					worker->queue_audio(&abuffer[0], abuffer.size());
+				soxdumper->samples(samples, count, stereo);
 			}
-			dcounter -= (soundrate.second * audio_record_rate + soundrate.first);
-			if(have_dumped_frame)
-				soxdumper->sample(l, r);
 		}
 		void on_rate_change(uint32_t n, uint32_t d)
 		{
@@ -470,13 +492,14 @@ again:
 	private:
 		master_dumper& mdumper;
 		sox_dumper* soxdumper;
-		framebuffer::fb<false> dscr;
+		std::shared_ptr<const framebuffer::fb<false>> current_frame;
 		unsigned dcounter;
 		bool have_dumped_frame;
 		std::pair<uint32_t, uint32_t> soundrate;
 		uint32_t audio_record_rate;
 		std::vector<short> sbuffer;
 		size_t sbuffer_fill;
+		std::vector<short> abuffer;
 		uint32_t chans;
 	};
 
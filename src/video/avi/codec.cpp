@@ -26,6 +26,16 @@ void avi_video_codec::send_performance_counters(uint64_t b, uint64_t w)
 {
 }
 
+unsigned avi_video_codec::keyframe_interval()
+{
+	return 0;
+}
+
+void avi_video_codec::flush()
+{
+	//Do nothing.
+}
+
 avi_audio_codec::format::format(uint16_t tag)
 {
 	max_bytes_per_sec = 200000;
@@ -143,6 +153,9 @@ void avi_output_stream::start(std::ostream& out, avi_video_codec& _vcodec, avi_a
 	acodec = &_acodec;
 	vcodec = &_vcodec;
 	achans = channels;
+	video_frames_in = 0;
+	video_packets_out = 0;
+	held_audio.clear();
 	video_timer.rate(fps_n, fps_d);
 	audio_timer.rate(samplerate);
 
@@ -158,18 +171,38 @@ void avi_output_stream::frame(uint32_t* frame, uint32_t stride)
 	if(!in_segment)
 		throw std::runtime_error("Trying to write to non-open AVI");
 	vcodec->frame(frame, stride);
-	while(!vcodec->ready())
-		write_pkt(avifile, vcodec->getpacket(), 0);
+	video_frames_in++;
+	write_video_packets();
 	avifile.hdrl.videotrack.strh.add_frames(1);
 }
 
+void avi_output_stream::write_video_packets()
+{
+	while(!vcodec->ready()) {
+		write_pkt(avifile, vcodec->getpacket(), 0);
+		video_packets_out++;
+	}
+	while(!held_audio.empty() && held_audio.front().first <= video_packets_out) {
+		write_pkt(avifile, held_audio.front().second, 1);
+		held_audio.pop_front();
+	}
+}
+
+void avi_output_stream::write_audio_packet(const avi_packet& pkt)
+{
+	if(held_audio.empty() && video_packets_out >= video_frames_in)
+		write_pkt(avifile, pkt, 1);
+	else
+		held_audio.push_back(std::make_pair(video_frames_in, pkt));
+}
+
 void avi_output_stream::samples(int16_t* samples, size_t samplecount)
 {
 	if(!in_segment)
 		throw std::runtime_error("Trying to write to non-open AVI");
 	acodec->samples(samples, samplecount);
 	while(!acodec->ready())
-		write_pkt(avifile, acodec->getpacket(), 1);
+		write_audio_packet(acodec->getpacket());
 	avifile.hdrl.audiotrack.strh.add_frames(samplecount);
 	for(size_t i = 0; i < samplecount; i++)
 		audio_timer.increment();
@@ -181,12 +214,18 @@ void avi_output_stream::flushaudio()
 		throw std::runtime_error("Trying to write to non-open AVI");
 	acodec->flush();
 	while(!acodec->ready())
-		write_pkt(avifile, acodec->getpacket(), 1);
+		write_audio_packet(acodec->getpacket());
 }
 
 void avi_output_stream::end()
 {
 	flushaudio();	//In case audio codec uses internal buffering...
+	vcodec->flush();
+	write_video_packets();
+	//Should be empty unless video codec dropped frames.
+	for(auto& i : held_audio)
+		write_pkt(avifile, i.second, 1);
+	held_audio.clear();
 	avifile.finish_avi();
 	in_segment = false;
 }
@@ -24,6 +24,7 @@ namespace
 		void frame(uint32_t* data, uint32_t stride);
 		bool ready();
 		avi_packet getpacket();
+		unsigned keyframe_interval();
 	private:
 		void readrow(uint32_t* rptr);
 		avi_packet out;
@@ -123,6 +124,11 @@ namespace
 		return out;
 	}
 
+	unsigned avi_codec_cscd::keyframe_interval()
+	{
+		return max_pframes + 1;
+	}
+
 	void avi_codec_cscd::readrow(uint32_t* rptr)
 	{
 		if(!rptr)
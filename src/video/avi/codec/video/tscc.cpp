@@ -183,6 +183,7 @@ namespace
 		void frame(uint32_t* data, uint32_t stride);
 		bool ready();
 		avi_packet getpacket();
+		unsigned keyframe_interval();
 	private:
 		void readrow(uint32_t* rptr);
 		avi_packet out;
@@ -308,6 +309,11 @@ namespace
 		return out;
 	}
 
+	unsigned avi_codec_tscc::keyframe_interval()
+	{
+		return max_pframes + 1;
+	}
+
 	avi_video_codec_type rgb("tscc", "TSCC video codec",
 		[]() -> avi_video_codec* {
 			return new avi_codec_tscc(clvl(*CORE().settings), kint(*CORE().settings));
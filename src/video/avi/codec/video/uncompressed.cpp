@@ -16,6 +16,7 @@ namespace
 		void frame(uint32_t* data, uint32_t stride);
 		bool ready();
 		avi_packet getpacket();
+		unsigned keyframe_interval();
 	private:
 		void readrow(uint32_t* rptr);
 		avi_packet out;
@@ -74,6 +75,11 @@ namespace
 		return out;
 	}
 
+	unsigned avi_codec_uncompressed::keyframe_interval()
+	{
+		return 1;
+	}
+
 	void avi_codec_uncompressed::readrow(uint32_t* rptr)
 	{
 		if(!rptr)
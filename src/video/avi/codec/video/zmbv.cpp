@@ -44,6 +44,7 @@ namespace
 		void frame(uint32_t* data, uint32_t stride);
 		bool ready();
 		avi_packet getpacket();
+		unsigned keyframe_interval();
 	private:
 		//The current pending packet, if any.
 		avi_packet out;
@@ -348,6 +349,11 @@ compress:
 		return out;
 	}
 
+	unsigned avi_codec_zmbv::keyframe_interval()
+	{
+		return max_pframes + 1;
+	}
+
 	//ZMBV encoder factory object.
 	avi_video_codec_type rgb("zmbv", "Zip Motion Blocks Video codec",
 		[]() -> avi_video_codec* {
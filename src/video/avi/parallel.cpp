@@ -0,0 +1,233 @@
+#include "video/avi/parallel.hpp"
+#include <cstring>
+
+//Groups are made at least this many frames long to cut down on thread switching.
+#define MIN_GROUP 8
+
+struct avi_parallel_codec::worker
+{
+	avi_parallel_codec* parent;
+	avi_video_codec* codec;
+	threads::thread* thread;
+	std::deque<job> input;		//The first job is the one being compressed.
+	std::deque<avi_packet> output;
+};
+
+void* avi_parallel_codec::worker_trampoline(worker* w)
+{
+	w->parent->worker_loop(*w);
+	return NULL;
+}
+
+avi_parallel_codec::avi_parallel_codec(avi_video_codec_type& type, unsigned threads, size_t _maxbuffer)
+{
+	quitting = false;
+	maxbuffer = _maxbuffer;
+	width = height = fps_n = fps_d = 0;
+	queued_frames = 0;
+	max_queued = 1;
+	current = 0;
+	group_left = 0;
+	try {
+		do {
+			worker* w = new worker;
+			w->parent = this;
+			w->codec = NULL;
+			w->thread = NULL;
+			workers.push_back(w);
+			w->codec = type.get_instance();
+		} while(workers.size() < threads && workers[0]->codec->keyframe_interval());
+		unsigned interval = workers[0]->codec->keyframe_interval();
+		parallel = (workers.size() > 1);
+		group_size = interval ? (MIN_GROUP + interval - 1) / interval * interval : 0;
+		if(parallel)
+			for(auto i : workers)
+				i->thread = new threads::thread(worker_trampoline, i);
+	} catch(...) {
+		threads::alock h(mlock);
+		quitting = true;
+		condition.notify_all();
+		h.unlock();
+		for(auto i : workers) {
+			if(i->thread) {
+				i->thread->join();
+				delete i->thread;
+			}
+			delete i->codec;
+			delete i;
+		}
+		throw;
+	}
+}
+
+avi_parallel_codec::~avi_parallel_codec()
+{
+	{
+		threads::alock h(mlock);
+		quitting = true;
+		condition.notify_all();
+	}
+	for(auto i : workers) {
+		if(i->thread) {
+			i->thread->join();
+			delete i->thread;
+		}
+		delete i->codec;
+		delete i;
+	}
+}
+
+avi_video_codec::format avi_parallel_codec::reset(uint32_t _width, uint32_t _height, uint32_t _fps_n,
+	uint32_t _fps_d)
+{
+	threads::alock h(mlock);
+	while(queued_frames)
+		condition.wait(h);
+	//Packets not read by now are from the previous segment.
+	groups.clear();
+	for(auto i : workers)
+		i->output.clear();
+	width = _width;
+	height = _height;
+	fps_n = _fps_n;
+	fps_d = _fps_d;
+	size_t framesize = 4 * static_cast<size_t>(width) * height;
+	max_queued = (framesize && maxbuffer > framesize) ? maxbuffer / framesize : 1;
+	current = workers.size() - 1;
+	group_left = 0;
+	//The workers are idle, so this can't race with them.
+	return workers[0]->codec->reset(width, height, fps_n, fps_d);
+}
+
+void avi_parallel_codec::frame(uint32_t* data, uint32_t stride)
+{
+	if(!parallel) {
+		workers[0]->codec->frame(data, stride);
+		return;
+	}
+	job j;
+	j.data.resize(static_cast<size_t>(width) * height);
+	for(uint32_t y = 0; y < height; y++)
+		memcpy(&j.data[y * width], data + y * stride, sizeof(uint32_t) * width);
+
+	threads::alock h(mlock);
+	check_error();
+	while(queued_frames >= max_queued) {
+		condition.wait(h);
+		check_error();
+	}
+	if(!group_left) {
+		current = (current + 1) % workers.size();
+		group_left = group_size;
+		group g;
+		g.w = workers[current];
+		g.frames = 0;
+		g.packets = 0;
+		groups.push_back(g);
+	}
+	//The codec is reset at start of each group, so the first frame is a keyframe.
+	workers[current]->input.push_back(job());
+	workers[current]->input.back().reset = (group_left == group_size);
+	workers[current]->input.back().g = &groups.back();
+	std::swap(workers[current]->input.back().data, j.data);
+	groups.back().frames++;
+	group_left--;
+	queued_frames++;
+	condition.notify_all();
+}
+
+bool avi_parallel_codec::ready()
+{
+	if(!parallel)
+		return workers[0]->codec->ready();
+	threads::alock h(mlock);
+	check_error();
+	//Skip groups that have been completely compressed and read, except the group still being filled. Codecs may
+	//emit any number of packets per frame, so only the frames tell if a group is complete.
+	while(!groups.empty() && !groups.front().frames && !groups.front().packets &&
+		(groups.size() > 1 || !group_left))
+		groups.pop_front();
+	return groups.empty() || !groups.front().packets;
+}
+
+avi_packet avi_parallel_codec::getpacket()
+{
+	if(!parallel)
+		return workers[0]->codec->getpacket();
+	threads::alock h(mlock);
+	group& g = groups.front();
+	avi_packet p;
+	std::swap(p, g.w->output.front());
+	g.w->output.pop_front();
+	g.packets--;
+	return p;
+}
+
+void avi_parallel_codec::send_performance_counters(uint64_t b, uint64_t w)
+{
+	//The codecs may be busy in worker threads.
+	if(!parallel)
+		workers[0]->codec->send_performance_counters(b, w);
+}
+
+unsigned avi_parallel_codec::keyframe_interval()
+{
+	return workers[0]->codec->keyframe_interval();
+}
+
+void avi_parallel_codec::flush()
+{
+	if(!parallel) {
+		workers[0]->codec->flush();
+		return;
+	}
+	threads::alock h(mlock);
+	while(queued_frames)
+		condition.wait(h);
+	check_error();
+}
+
+void avi_parallel_codec::check_error()
+{
+	if(error != "")
+		throw std::runtime_error(error);
+}
+
+void avi_parallel_codec::worker_loop(worker& w)
+{
+	threads::alock h(mlock);
+	while(true) {
+		while(!quitting && w.input.empty())
+			condition.wait(h);
+		if(w.input.empty())
+			return;
+		//The front job stays put while other jobs are appended.
+		job& j = w.input.front();
+		h.unlock();
+		std::deque<avi_packet> out;
+		std::string err;
+		try {
+			if(j.reset)
+				w.codec->reset(width, height, fps_n, fps_d);
+			w.codec->frame(&j.data[0], width);
+			while(!w.codec->ready())
+				out.push_back(w.codec->getpacket());
+		} catch(std::bad_alloc& e) {
+			err = "Out of memory";
+		} catch(std::exception& e) {
+			err = e.what();
+		}
+		h.lock();
+		for(auto& i : out) {
+			w.output.push_back(avi_packet());
+			std::swap(w.output.back(), i);
+		}
+		if(err != "" && error == "")
+			error = err;
+		j.g->packets += out.size();
+		j.g->frames--;
+		w.input.pop_front();
+		queued_frames--;
+		condition.notify_all();
+	}
+}
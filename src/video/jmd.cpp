@@ -122,29 +122,34 @@ out:
 
 		void on_frame(struct framebuffer::raw& _frame, uint32_t fps_n, uint32_t fps_d)
 		{
-			if(!render_video_hud(dscr, _frame, fps_n, fps_d, 1, 1, 0, 0, 0, 0, NULL))
+			auto scr = render_video_hud_shared<false>(_frame, fps_n, fps_d, 1, 1, 0, 0, 0, 0);
+			if(!scr)
 				return;
 			frame_buffer f;
 			f.ts = get_next_video_ts(fps_n, fps_d);
 			//We'll compress the frame here.
-			f.data = compress_frame(dscr.rowptr(0), dscr.get_stride(), dscr.get_width(),
-				dscr.get_height());
+			f.data = compress_frame(scr->rowptr(0), scr->get_stride(), scr->get_width(),
+				scr->get_height());
 			frames.push_back(f);
 			flush_buffers(false);
 			have_dumped_frame = true;
 		}
 
-		void on_sample(short l, short r)
+		void on_samples(const int16_t* block, size_t count, bool stereo)
 		{
-			uint64_t ts = get_next_audio_ts();
-			if(have_dumped_frame) {
-				sample_buffer s;
-				s.ts = ts;
-				s.l = l;
-				s.r = r;
-				samples.push_back(s);
-				flush_buffers(false);
+			size_t step = stereo ? 2 : 1;
+			for(size_t i = 0; i < count; i++) {
+				uint64_t ts = get_next_audio_ts();
+				if(have_dumped_frame) {
+					sample_buffer s;
+					s.ts = ts;
+					s.l = block[step * i];
+					s.r = block[step * i + step - 1];
+					samples.push_back(s);
+				}
 			}
+			if(have_dumped_frame)
+				flush_buffers(false);
 		}
 		void on_rate_change(uint32_t n, uint32_t d)
 		{
@@ -186,7 +191,6 @@ out:
 			return ret;
 		}
 
-		framebuffer::fb<false> dscr;
 		unsigned dcounter;
 		bool have_dumped_frame;
 		uint64_t audio_w;
@@ -241,7 +245,7 @@ out:
 			c = dptr / 4;
 		}
 
-		std::vector<char> compress_frame(uint32_t* memory, uint32_t stride, uint32_t width, uint32_t height)
+		std::vector<char> compress_frame(const uint32_t* memory, uint32_t stride, uint32_t width, uint32_t height)
 		{
 			std::vector<char> ret;
 			z_stream stream;
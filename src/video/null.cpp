@@ -49,7 +49,7 @@ namespace
 		{
 			//Do nothing.
 		}
-		void on_sample(short l, short r)
+		void on_samples(const int16_t* samples, size_t count, bool stereo)
 		{
 			//Do nothing.
 		}
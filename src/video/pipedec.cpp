@@ -128,11 +128,12 @@ namespace
 		}
 		void on_frame(struct framebuffer::raw& _frame, uint32_t fps_n, uint32_t fps_d)
 		{
-			if(!render_video_hud(dscr, _frame, fps_n, fps_d, 1, 1, 0, 0, 0, 0, NULL))
+			auto scr = render_video_hud_shared<false>(_frame, fps_n, fps_d, 1, 1, 0, 0, 0, 0);
+			if(!scr)
 				return;
-			size_t w = dscr.get_width();
-			size_t h = dscr.get_height();
-			uint32_t stride = dscr.get_stride();
+			size_t w = scr->get_width();
+			size_t h = scr->get_height();
+			uint32_t stride = scr->get_stride();
 
 			if(!video || last_width != w || last_height != h || last_fps_n != fps_n ||
 				last_fps_d != fps_d) {
@@ -162,20 +163,20 @@ namespace
 			char* data2 = &tmp[alignment];
 			for(size_t i = 0; i < h; i++) {
 				size_t ri = upsidedown ? (h - i - 1) : i;
-				char* data = reinterpret_cast<char*>(dscr.rowptr(ri));
+				const uint32_t* data = scr->rowptr(ri);
 				if(bits32)
 					if(swap)
 						framebuffer::copy_swap4(reinterpret_cast<uint8_t*>(data2),
-							reinterpret_cast<uint32_t*>(data), stride);
+							data, stride);
 					else
 						memcpy(data2, data, 4 * stride);
 				else
 					if(swap)
 						framebuffer::copy_drop4s(reinterpret_cast<uint8_t*>(data2),
-							reinterpret_cast<uint32_t*>(data), stride);
+							data, stride);
 					else
 						framebuffer::copy_drop4(reinterpret_cast<uint8_t*>(data2),
-							reinterpret_cast<uint32_t*>(data), stride);
+							data, stride);
 
 				if(fwrite(data2, bits32 ? 4 : 3, w, video) < w)
 					messages << "Video write error" << std::endl;
@@ -183,10 +184,10 @@ namespace
 			have_dumped_frame = true;
 		}
 
-		void on_sample(short l, short r)
+		void on_samples(const int16_t* samples, size_t count, bool stereo)
 		{
 			if(have_dumped_frame && audio)
-				audio->sample(l, r);
+				audio->samples(samples, count, stereo);
 		}
 		void on_rate_change(uint32_t n, uint32_t d)
 		{
@@ -205,7 +206,6 @@ namespace
 		FILE* video;
 		sox_dumper* audio;
 		bool have_dumped_frame;
-		struct framebuffer::fb<false> dscr;
 		bool upsidedown;
 		bool bits32;
 		bool swap;
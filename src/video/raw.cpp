@@ -105,35 +105,37 @@ namespace
 			rpair(hscl, vscl) = core.rom->get_scale_factors(_frame.get_width(),
 				_frame.get_height());
 			if(bits64) {
-				size_t w = dscr2.get_width();
-				size_t h = dscr2.get_height();
-				size_t s = dscr2.get_stride();
+				auto scr = render_video_hud_shared<true>(_frame, fps_n, fps_d, hscl, vscl, 0, 0, 0, 0);
+				if(!scr)
+					return;
+				size_t w = scr->get_width();
+				size_t h = scr->get_height();
+				size_t s = scr->get_stride();
 				std::vector<uint16_t> tmp;
 				tmp.resize(8 * s + 8);
 				uint32_t alignment = (16 - reinterpret_cast<size_t>(&tmp[0])) % 16 / 2;
-				if(!render_video_hud(dscr2, _frame, fps_n, fps_d, hscl, vscl, 0, 0, 0, 0, NULL))
-					return;
 				for(size_t i = 0; i < h; i++) {
 					if(!swap)
-						framebuffer::copy_swap4(&tmp[alignment], dscr2.rowptr(i), s);
+						framebuffer::copy_swap4(&tmp[alignment], scr->rowptr(i), s);
 					else
-						memcpy(&tmp[alignment], dscr2.rowptr(i), 8 * w);
+						memcpy(&tmp[alignment], scr->rowptr(i), 8 * w);
 					video->write(reinterpret_cast<char*>(&tmp[alignment]), 8 * w);
 				}
 			} else {
-				size_t w = dscr.get_width();
-				size_t h = dscr.get_height();
-				size_t s = dscr2.get_stride();
+				auto scr = render_video_hud_shared<false>(_frame, fps_n, fps_d, hscl, vscl, 0, 0, 0, 0);
+				if(!scr)
+					return;
+				size_t w = scr->get_width();
+				size_t h = scr->get_height();
+				size_t s = scr->get_stride();
 				std::vector<uint8_t> tmp;
 				tmp.resize(4 * s + 16);
 				uint32_t alignment = (16 - reinterpret_cast<size_t>(&tmp[0])) % 16;
-				if(!render_video_hud(dscr, _frame, fps_n, fps_d, hscl, vscl, 0, 0, 0, 0, NULL))
-					return;
 				for(size_t i = 0; i < h; i++) {
 					if(!swap)
-						framebuffer::copy_swap4(&tmp[alignment], dscr.rowptr(i), s);
+						framebuffer::copy_swap4(&tmp[alignment], scr->rowptr(i), s);
 					else
-						memcpy(&tmp[alignment], dscr.rowptr(i), 4 * w);
+						memcpy(&tmp[alignment], scr->rowptr(i), 4 * w);
 					video->write(reinterpret_cast<char*>(&tmp[alignment]), 4 * w);
 				}
 			}
@@ -142,13 +144,16 @@ namespace
 			have_dumped_frame = true;
 		}
 
-		void on_sample(short l, short r)
+		void on_samples(const int16_t* samples, size_t count, bool stereo)
 		{
 			if(have_dumped_frame && audio) {
-				char buffer[4];
-				serialization::s16b(buffer + 0, l);
-				serialization::s16b(buffer + 2, r);
-				audio->write(buffer, 4);
+				size_t step = stereo ? 2 : 1;
+				abuffer.resize(4 * count);
+				for(size_t i = 0; i < count; i++) {
+					serialization::s16b(&abuffer[4 * i + 0], samples[step * i]);
+					serialization::s16b(&abuffer[4 * i + 2], samples[step * i + step - 1]);
+				}
+				audio->write(&abuffer[0], abuffer.size());
 			}
 		}
 		void on_rate_change(uint32_t n, uint32_t d)
@@ -165,11 +170,10 @@ namespace
 		}
 	private:
 		std::ostream* audio;
+		std::vector<char> abuffer;
 		std::ostream* video;
 		void (*deleter)(void* f);
 		bool have_dumped_frame;
-		struct framebuffer::fb<false> dscr;
-		struct framebuffer::fb<true> dscr2;
 		bool swap;
 		bool bits64;
 		master_dumper& mdumper;
@@ -71,6 +71,34 @@ void sox_dumper::close() throw(std::bad_alloc, std::runtime_error)
 	sox_file.close();
 }
 
+void sox_dumper::samples(const int16_t* samples, size_t count, bool stereo) throw(std::bad_alloc,
+	std::runtime_error)
+{
+	const size_t block = 1024;
+	size_t chans = samplebuffer.size();
+	std::vector<char> out(block * 4 * chans);
+	while(count > 0) {
+		size_t n = (count < block) ? count : block;
+		char* o = &out[0];
+		for(size_t i = 0; i < n; i++) {
+			int16_t l = stereo ? samples[2 * i + 0] : samples[i];
+			int16_t r = stereo ? samples[2 * i + 1] : samples[i];
+			for(size_t j = 0; j < chans; j++) {
+				int32_t v = (j == 0) ? (static_cast<int32_t>(l) << 16) : (j == 1) ?
+					(static_cast<int32_t>(r) << 16) : 0;
+				serialization::u32l(o, static_cast<uint32_t>(v));
+				o += 4;
+			}
+		}
+		sox_file.write(&out[0], o - &out[0]);
+		if(!sox_file)
+			throw std::runtime_error("Failed to dump sample");
+		samples_dumped += n;
+		samples += (stereo ? 2 : 1) * n;
+		count -= n;
+	}
+}
+
 void sox_dumper::internal_dump_sample()
 {
 	for(size_t i = 0; i < samplebuffer.size(); ++i)